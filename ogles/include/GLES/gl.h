@@ -108,7 +108,7 @@ typedef void (*_GLfuncptr)();
 #define GL_OES_compressed_paletted_texture 1
 /*#define GL_OES_draw_texture             1*/
 #define GL_OES_matrix_get                 1
-/*#define GL_OES_matrix_palette		      1*/
+#define GL_OES_matrix_palette             1
 #define GL_OES_point_size_array           1
 #define GL_OES_point_sprite               1
 #define GL_OES_read_format                1
@@ -662,6 +662,7 @@ typedef void (*_GLfuncptr)();
 #define GL_MAX_VERTEX_UNITS_OES           0x86A4
 #define GL_MAX_PALETTE_MATRICES_OES       0x8842
 #define GL_MATRIX_PALETTE_OES             0x8840
+#define GL_CURRENT_PALETTE_MATRIX_OES     0x8843
 #define GL_MATRIX_INDEX_ARRAY_OES         0x8844
 #define GL_WEIGHT_ARRAY_OES               0x86AD
 
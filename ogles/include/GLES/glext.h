@@ -68,10 +68,36 @@ extern "C" {
 
 
 #define GL_OES_query_matrix		    1
+#define GL_VIN_index_buffer_optimize	1
+#define GL_VIN_jit_profile				1
 
 /* OES_query_matrix */
 GLAPI GLbitfield APIENTRY glQueryMatrixxOES(GLfixed *mantissa, GLint *exponent);
 
+/*
+ * The enumerant values of the VIN extensions below are not registered with
+ * Khronos. They are provisional and will change once a range of values has
+ * been assigned; applications should refer to them by name only.
+ */
+
+/* VIN_index_buffer_optimize */
+/*
+ * A GL_STATIC_DRAW element array buffer specified while the hint is not
+ * GL_DONT_CARE keeps a private copy of its indices, reordered for the vertex
+ * cache. The copy is made by the first glDrawElements call that draws the
+ * whole buffer as GL_TRIANGLES with GL_UNSIGNED_SHORT indices, and is read
+ * by such calls only; the buffer contents, and the indices read by other
+ * draw calls, remain as specified.
+ */
+#define GL_INDEX_BUFFER_OPTIMIZE_HINT_VIN		0x6200
+#define GL_VERTEX_CACHE_SIZE_VIN				0x6201
+#define GL_BUFFER_OPTIMIZED_VIN					0x6202
+#define GL_BUFFER_CACHE_MISSES_BEFORE_VIN		0x6203
+#define GL_BUFFER_CACHE_MISSES_AFTER_VIN		0x6204
+
+/* VIN_jit_profile */
+#define GL_JIT_PROFILE_HINT_VIN					0x6205
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,304 @@
+// ==========================================================================
+//
+// Buffer.cpp			Buffer Object Class for 3D Rendering Library
+//
+// --------------------------------------------------------------------------
+//
+// 08-30-2004		Hans-Martin Will	initial version
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "Buffer.h"
+
+
+using namespace EGL;
+
+
+// --------------------------------------------------------------------------
+// Index buffer optimization (VIN_index_buffer_optimize)
+//
+// Static triangle lists are reordered using the Tipsify algorithm, see
+// Sander, Nehab & Barczak: Fast Triangle Reordering for Vertex Locality
+// and Reduced Overdraw, SIGGRAPH 2007. The algorithm targets the FIFO
+// vertex cache of EGL_VERTEX_CACHE_SIZE entries used by DrawElements.
+// --------------------------------------------------------------------------
+
+
+namespace {
+
+	// simulate the post-transform vertex cache and count the number of
+	// vertices that need to be transformed
+	U32 CountCacheMisses(const GLushort * indices, size_t count) {
+		I32 cache[EGL_VERTEX_CACHE_SIZE];
+		size_t next = 0;
+		U32 misses = 0;
+
+		for (size_t slot = 0; slot < EGL_VERTEX_CACHE_SIZE; ++slot) {
+			cache[slot] = -1;
+		}
+
+		while (count--) {
+			I32 vertex = *indices++;
+			size_t slot;
+
+			for (slot = 0; slot < EGL_VERTEX_CACHE_SIZE; ++slot) {
+				if (cache[slot] == vertex)
+					break;
+			}
+
+			if (slot == EGL_VERTEX_CACHE_SIZE) {
+				cache[next] = vertex;
+				next = (next + 1) % EGL_VERTEX_CACHE_SIZE;
+				++misses;
+			}
+		}
+
+		return misses;
+	}
+
+	// reorder the triangles in the index array; returns false if the 
+	// working storage could not be allocated
+	bool TipsifyTriangles(GLushort * indices, size_t count) {
+
+		const I32 cacheSize = EGL_VERTEX_CACHE_SIZE;
+		size_t numTriangles = count / 3;
+		size_t numVertices = 0;
+		size_t index;
+
+		for (index = 0; index < count; ++index) {
+			if (indices[index] >= numVertices)
+				numVertices = indices[index] + 1;
+		}
+
+		// working storage; all arrays are carved out of a single block
+		U32 * memory = static_cast<U32 *>(malloc(sizeof(U32) * 
+			(4 * numVertices + 1 + 4 * count + numTriangles)));
+
+		if (!memory) {
+			return false;
+		}
+
+		U32 * liveCount		= memory;								// live triangles per vertex
+		U32 * cacheTime		= liveCount + numVertices;				// time stamp of entry into cache
+		U32 * offset		= cacheTime + numVertices;				// start of adjacency list
+		U32 * fill			= offset + numVertices + 1;				// fill pointer of adjacency list
+		U32 * adjacency		= fill + numVertices;					// vertex -> triangle
+		U32 * deadEnd		= adjacency + count;					// dead-end vertex stack
+		U32 * candidates	= deadEnd + count;						// candidates for next fan
+		U32 * output		= candidates + count;
+		U32 * emitted		= output + count;						// triangle has been emitted
+
+		memset(liveCount, 0, sizeof(U32) * numVertices);
+		memset(cacheTime, 0, sizeof(U32) * numVertices);
+		memset(emitted, 0, sizeof(U32) * numTriangles);
+
+		for (index = 0; index < count; ++index) {
+			++liveCount[indices[index]];
+		}
+
+		offset[0] = 0;
+
+		for (index = 0; index < numVertices; ++index) {
+			offset[index + 1] = offset[index] + liveCount[index];
+			fill[index] = offset[index];
+		}
+
+		for (index = 0; index < count; ++index) {
+			adjacency[fill[indices[index]]++] = index / 3;
+		}
+
+		I32 fanVertex = 0;
+		U32 time = cacheSize + 1;
+		size_t cursor = 0;
+		size_t deadEndTop = 0;
+		size_t outputCount = 0;
+
+		while (fanVertex >= 0) {
+			size_t numCandidates = 0;
+
+			// emit all remaining triangles adjacent to the fanning vertex
+			for (U32 adj = offset[fanVertex]; adj < offset[fanVertex + 1]; ++adj) {
+				U32 triangle = adjacency[adj];
+
+				if (emitted[triangle])
+					continue;
+
+				for (size_t corner = 0; corner < 3; ++corner) {
+					U32 vertex = indices[triangle * 3 + corner];
+
+					output[outputCount++] = vertex;
+					deadEnd[deadEndTop++] = vertex;
+					candidates[numCandidates++] = vertex;
+					--liveCount[vertex];
+
+					if (time - cacheTime[vertex] > static_cast<U32>(cacheSize)) {
+						cacheTime[vertex] = time++;
+					}
+				}
+
+				emitted[triangle] = 1;
+			}
+
+			// select the next fanning vertex among the candidates: prefer
+			// the oldest vertex that will still be in the cache after its
+			// remaining triangles have been emitted
+			I32 best = -1, bestPriority = -1;
+
+			for (size_t candidate = 0; candidate < numCandidates; ++candidate) {
+				U32 vertex = candidates[candidate];
+
+				if (liveCount[vertex] > 0) {
+					I32 priority = 0;
+
+					if (time - cacheTime[vertex] + 2 * liveCount[vertex] <= static_cast<U32>(cacheSize)) {
+						priority = time - cacheTime[vertex];
+					}
+
+					if (priority > bestPriority) {
+						bestPriority = priority;
+						best = vertex;
+					}
+				}
+			}
+
+			if (best < 0) {
+				// dead end; try recently used vertices first, then continue
+				// in input order
+				while (deadEndTop > 0) {
+					U32 vertex = deadEnd[--deadEndTop];
+
+					if (liveCount[vertex] > 0) {
+						best = vertex;
+						break;
+					}
+				}
+
+				while (best < 0 && cursor < numVertices) {
+					if (liveCount[cursor] > 0) {
+						best = cursor;
+					}
+
+					++cursor;
+				}
+			}
+
+			fanVertex = best;
+		}
+
+		assert(outputCount == numTriangles * 3);
+
+		for (index = 0; index < outputCount; ++index) {
+			indices[index] = static_cast<GLushort>(output[index]);
+		}
+
+		free(memory);
+		return true;
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// Select the indices read by a draw call
+//
+// A draw call that reads all of the buffer as a triangle list of unsigned
+// short indices reads the reordered copy of the indices; the first such
+// call creates the copy. Other draw calls read the indices as specified.
+//
+// Parameters:
+//	mode		-	The primitive type of the draw call
+//	count		-	The number of indices drawn
+//	type		-	The type of the indices
+//	offset		-	The offset of the first index drawn in the buffer
+// --------------------------------------------------------------------------
+const void * Buffer :: GetIndices(GLenum mode, GLsizei count, GLenum type, size_t offset) {
+
+	if (mode == GL_TRIANGLES && type == GL_UNSIGNED_SHORT && offset == 0 &&
+		count * sizeof(GLushort) == m_Size) {
+
+		if (m_OptimizationPending) {
+			m_OptimizationPending = false;
+			OptimizeTriangleIndices();
+		}
+
+		if (m_OptimizedIndices) {
+			return m_OptimizedIndices;
+		}
+	}
+
+	return static_cast<const U8 *>(m_Data) + offset;
+}
+
+void Buffer :: OptimizeTriangleIndices() {
+
+	// the buffer contents are interpreted as triangle list using
+	// unsigned short indices
+	if (!m_Data || !m_Size || m_Size % (3 * sizeof(GLushort))) {
+		return;
+	}
+
+	const GLushort * indices = static_cast<const GLushort *>(m_Data);
+	size_t count = m_Size / sizeof(GLushort);
+
+	GLushort * optimized = static_cast<GLushort *>(malloc(m_Size));
+
+	if (!optimized) {
+		return;
+	}
+
+	memcpy(optimized, indices, m_Size);
+
+	if (!TipsifyTriangles(optimized, count)) {
+		free(optimized);
+		return;
+	}
+
+	U32 missesBefore = CountCacheMisses(indices, count);
+	U32 missesAfter = CountCacheMisses(optimized, count);
+
+	if (missesAfter < missesBefore) {
+		m_OptimizedIndices = optimized;
+		SetOptimization(missesBefore, missesAfter);
+	} else {
+		free(optimized);
+		SetOptimization(missesBefore, missesBefore);
+	}
+}
+
+void Buffer :: ResetOptimization() {
+
+	if (m_OptimizedIndices) {
+		free(m_OptimizedIndices);
+		m_OptimizedIndices = 0;
+	}
+
+	m_Optimized = false;
+	m_CacheMissesBefore = m_CacheMissesAfter = 0;
+}
@@ -52,14 +52,20 @@ namespace EGL {
 	class Buffer { 
 
 	public:
-		Buffer(): m_Data(0), m_Size(0), m_Usage(BufferUsageStaticDraw) { }
+		Buffer(): m_Data(0), m_Size(0), m_Usage(BufferUsageStaticDraw),
+			m_OptimizationPending(false), m_OptimizedIndices(0) { 
+			ResetOptimization();
+		}
 
 		~Buffer() { 
 			Deallocate();
+			ResetOptimization();
 		}
 
 		bool Allocate(size_t size, BufferUsage usage) {
 			Deallocate();
+			ResetOptimization();
+			m_OptimizationPending = false;
 
 			if (size) {
 				m_Data = malloc(size);
@@ -96,10 +102,60 @@ namespace EGL {
 			return m_Usage;
 		}
 
+		// ----------------------------------------------------------------------
+		// Index buffer optimization; the reordered indices are a private copy,
+		// so the contents of the buffer remain as specified. The miss counts
+		// are determined by simulating the post-transform vertex cache.
+		// ----------------------------------------------------------------------
+
+		// the indices to read for a draw call
+		const void * GetIndices(GLenum mode, GLsizei count, GLenum type, size_t offset);
+
+		// drop the reordered indices and the statistics
+		void ResetOptimization();
+
+		bool IsOptimized() const {
+			return m_Optimized;
+		}
+
+		U32 GetCacheMissesBefore() const {
+			return m_CacheMissesBefore;
+		}
+
+		U32 GetCacheMissesAfter() const {
+			return m_CacheMissesAfter;
+		}
+
+		// the layout of the indices is only known once the buffer is drawn;
+		// the first draw call of the whole buffer as a triangle list
+		// optimizes it
+		void SetOptimizationPending(bool pending) {
+			m_OptimizationPending = pending;
+		}
+
+		bool IsOptimizationPending() const {
+			return m_OptimizationPending;
+		}
+
+	private:
+		void OptimizeTriangleIndices();
+
+		void SetOptimization(U32 missesBefore, U32 missesAfter) {
+			m_Optimized = true;
+			m_CacheMissesBefore = missesBefore;
+			m_CacheMissesAfter = missesAfter;
+		}
+
 	private:
 		void *		m_Data;
 		size_t		m_Size;
 		BufferUsage m_Usage;
+
+		bool		m_OptimizationPending;
+		GLushort *	m_OptimizedIndices;		// reordered copy of m_Data, or 0
+		bool		m_Optimized;
+		U32			m_CacheMissesBefore;
+		U32			m_CacheMissesAfter;
 	};
 
 }
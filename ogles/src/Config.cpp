@@ -302,11 +302,75 @@ namespace {
 		    0,				//	EGLint	transparentBlueValue,
 		    240,			//  EGLint	width,
 		    320				//  EGLint	height
+	    ),
+   	    // ----------------------------------------------------------------------
+	    // RGB 565, depth 16, no stencil, multisample, as PBuffer or Windows surface
+	    // ----------------------------------------------------------------------
+	    Config(
+			ColorFormatRGB565,
+			DepthStencilFormatDepth16,
+		    16,				//	EGLint	bufferSize,
+		    5,				//	EGLint	redSize,
+		    6,				//	EGLint	greenSize,
+		    5,				//	EGLint	blueSize,
+		    0,				//	EGLint	alphaSize,
+		    EGL_NONE,		//	EGLint	configCaveat,
+		    9,				//	EGLint	configID,
+		    16,				//	EGLint	depthSize,
+		    0,				//	EGLint	level,
+		    1024,			//	EGLint	maxPBufferWidth,
+		    1024,			//	EGLint	maxPBufferHeight,
+		    1024 * 1024,	//	EGLint	mxPBufferPixels,
+		    EGL_FALSE,		//	EGLint	nativeRenderable,
+		    0,				//	EGLint	nativeVisualID,
+		    EGL_NONE,		//	EGLint	nativeVisualType,
+		    1,				//	EGLint	sampleBuffers,
+		    EGL_NUM_SAMPLES,//	EGLint	samples,
+		    0,				//	EGLint	stencilSize,
+		    EGL_PBUFFER_BIT | EGL_WINDOW_BIT,//	EGLint	surfaceType,
+		    EGL_NONE,		//	EGLint	transparentType,
+		    0,				//	EGLint	transparentRedValue,
+		    0,				//	EGLint	transparentGreenValue,
+		    0,				//	EGLint	transparentBlueValue,
+		    240,			//  EGLint	width,
+		    320				//  EGLint	height
+	    ),
+   	    // ----------------------------------------------------------------------
+	    // RGB 565, depth 16, stencil 16, multisample, as PBuffer or Windows surface
+	    // ----------------------------------------------------------------------
+	    Config(
+			ColorFormatRGB565,
+			DepthStencilFormatDepth16Stencil16,
+		    16,				//	EGLint	bufferSize,
+		    5,				//	EGLint	redSize,
+		    6,				//	EGLint	greenSize,
+		    5,				//	EGLint	blueSize,
+		    0,				//	EGLint	alphaSize,
+		    EGL_NONE,		//	EGLint	configCaveat,
+		    10,				//	EGLint	configID,
+		    16,				//	EGLint	depthSize,
+		    0,				//	EGLint	level,
+		    1024,			//	EGLint	maxPBufferWidth,
+		    1024,			//	EGLint	maxPBufferHeight,
+		    1024 * 1024,	//	EGLint	mxPBufferPixels,
+		    EGL_FALSE,		//	EGLint	nativeRenderable,
+		    0,				//	EGLint	nativeVisualID,
+		    EGL_NONE,		//	EGLint	nativeVisualType,
+		    1,				//	EGLint	sampleBuffers,
+		    EGL_NUM_SAMPLES,//	EGLint	samples,
+		    16,				//	EGLint	stencilSize,
+		    EGL_PBUFFER_BIT | EGL_WINDOW_BIT,//	EGLint	surfaceType,
+		    EGL_NONE,		//	EGLint	transparentType,
+		    0,				//	EGLint	transparentRedValue,
+		    0,				//	EGLint	transparentGreenValue,
+		    0,				//	EGLint	transparentBlueValue,
+		    240,			//  EGLint	width,
+		    320				//  EGLint	height
 	    )
     };
 
     // total number of supported configurations
-    const int s_NumConfigurations = 8;
+    const int s_NumConfigurations = 10;
 };
 
 Config :: Config(
@@ -727,14 +791,14 @@ bool Config :: Matches(const EGLint * attribList) const {
 			break;
 
 		case EGL_SAMPLES:
-			if (m_Samples > value) {
+			if (m_Samples < value) {
 				return false;
 			}
 
 			break;
 
 		case EGL_SAMPLE_BUFFERS:
-			if (m_SampleBuffers > value) {
+			if (m_SampleBuffers < value) {
 				return false;
 			}
 
@@ -61,6 +61,16 @@ Context :: Context(const Config & config)
 	m_ModelViewMatrixStack(16),
 	m_CurrentMatrixStack(&m_ModelViewMatrixStack),
 	m_MatrixMode(GL_MODELVIEW),
+	m_CompositeModelViewEpoch(~0u),
+	m_CompositeProjectionEpoch(~0u),
+	m_InverseModelViewEpoch(~0u),
+	m_FullInverseModelViewEpoch(~0u),
+	m_InverseRescaleNormal(false),
+	m_PaletteProjectionEpoch(~0u),
+	m_PaletteRescaleNormal(false),
+	m_CurrentPaletteMatrix(0),
+	m_BlendValid(false),
+	m_PaletteSkinning(false),
 	m_Scissor(0, 0, config.GetConfigAttrib(EGL_WIDTH), config.GetConfigAttrib(EGL_HEIGHT)),
 	m_Viewport(0, 0, config.GetConfigAttrib(EGL_WIDTH), config.GetConfigAttrib(EGL_HEIGHT)),
 
@@ -70,14 +80,12 @@ Context :: Context(const Config & config)
 	m_TwoSidedLightning(false),
 	m_LightEnabled(0),				// no light on
 	m_CullFaceEnabled(false),
-	m_DitherEnabled(false),
 	m_ReverseFaceOrientation(false),
 	m_CullMode(CullModeBack),
 	m_ColorMaterialEnabled(false),
 	m_NormalizeEnabled(false),
 	m_RescaleNormalEnabled(false),
 	m_PolygonOffsetFillEnabled(false),
-	m_MultiSampleEnabled(false),
 	m_SampleAlphaToCoverageEnabled(false),
 	m_SampleAlphaToOneEnabled(false),
 	m_SampleCoverageEnabled(false),
@@ -105,6 +113,8 @@ Context :: Context(const Config & config)
 	m_NormalArrayEnabled(false),
 	m_ColorArrayEnabled(false),
 	m_PointSizeArrayEnabled(false),
+	m_MatrixIndexArrayEnabled(false),
+	m_WeightArrayEnabled(false),
 
 	// buffers
 	m_CurrentArrayBuffer(0),
@@ -117,6 +127,9 @@ Context :: Context(const Config & config)
 	m_DefaultNormal(0, 0, EGL_ONE),
 	m_DefaultRGBA(EGL_ONE, EGL_ONE, EGL_ONE, EGL_ONE),
 
+	// OES_matrix_palette extension
+	m_MatrixPaletteEnabled(false),
+
 	// pixel store state
 	m_PixelStorePackAlignment(4),
 	m_PixelStoreUnpackAlignment(4),
@@ -130,12 +143,16 @@ Context :: Context(const Config & config)
 	m_LineSmoothHint(GL_DONT_CARE),
 	m_FogHint(GL_DONT_CARE),
 	m_GenerateMipmapHint(GL_DONT_CARE),
+	m_IndexBufferOptimizeHint(GL_DONT_CARE),
+	m_JitProfileHint(GL_DONT_CARE),
 
 	// primitive state
 	m_DrawPrimitiveFunction(0),
 	m_EndPrimitiveFunction(0),
 	m_PrimitiveState(0),
-	m_NextIndex(0)
+	m_NextIndex(0),
+	m_PointBatchCount(0),
+	m_PointBatchInitialized(0)
 {
 	DepthRangex(VIEWPORT_NEAR, VIEWPORT_FAR);
 	ClearDepthx(EGL_ONE);
@@ -164,6 +181,10 @@ Context :: Context(const Config & config)
 	}
 
 	memset(&m_ClipPlanes, 0, sizeof(m_ClipPlanes));
+
+	for (size_t index = 0; index < MATRIX_PALETTE_SIZE; ++index) {
+		m_PaletteEpoch[index] = ~0u;
+	}
 }
 
 
@@ -184,6 +205,7 @@ Context :: ~Context() {
 		delete m_Rasterizer;
 		m_Rasterizer = 0;
 	}
+
 }
 
 
@@ -358,7 +380,7 @@ void Context :: Toggle(GLenum cap, bool value) {
 		break;
 
 	case GL_DITHER:
-		m_DitherEnabled = value;
+		GetRasterizerState()->EnableDither(value);
 		break;
 
 	case GL_STENCIL_TEST:
@@ -431,7 +453,6 @@ void Context :: Toggle(GLenum cap, bool value) {
 
 	case GL_RESCALE_NORMAL:
 		m_RescaleNormalEnabled = value;
-		UpdateInverseModelViewMatrix();
 		break;
 
 	case GL_POLYGON_OFFSET_FILL:
@@ -439,7 +460,7 @@ void Context :: Toggle(GLenum cap, bool value) {
 		break;
 
 	case GL_MULTISAMPLE:
-		m_MultiSampleEnabled = value;
+		GetRasterizerState()->EnableMultisample(value);
 		break;
 
 	case GL_SAMPLE_ALPHA_TO_COVERAGE:
@@ -454,6 +475,10 @@ void Context :: Toggle(GLenum cap, bool value) {
 		m_SampleCoverageEnabled = value;
 		break;
 
+	case GL_MATRIX_PALETTE_OES:
+		m_MatrixPaletteEnabled = value;
+		break;
+
 	default:
 		RecordError(GL_INVALID_ENUM);
 		return;
@@ -486,7 +511,10 @@ void Context :: Hint(GLenum target, GLenum mode) {
 
 	case GL_PERSPECTIVE_CORRECTION_HINT:
 		m_PerspectiveCorrectionHint = mode;
-		m_RasterizerState.SetPerspectiveCorrection(mode != GL_FASTEST);
+		m_RasterizerState.SetPerspectiveCorrection(
+			mode == GL_FASTEST ? RasterizerState::PerspectiveCorrectionFastest :
+			mode == GL_NICEST ? RasterizerState::PerspectiveCorrectionNicest :
+								RasterizerState::PerspectiveCorrectionDontCare);
 		break;
 
 	case GL_POINT_SMOOTH_HINT:
@@ -497,6 +525,26 @@ void Context :: Hint(GLenum target, GLenum mode) {
 		m_GenerateMipmapHint = mode;
 		break;
 
+	case GL_INDEX_BUFFER_OPTIMIZE_HINT_VIN:
+		m_IndexBufferOptimizeHint = mode;
+		break;
+
+#if EGL_USE_JIT
+	case GL_JIT_PROFILE_HINT_VIN:
+		m_JitProfileHint = mode;
+
+		// only the functions compiled for this context are profiled
+		if (mode == GL_FASTEST) {
+			m_FunctionCache.SetProfileFlags(JitProfileOff);
+		} else if (mode == GL_NICEST) {
+			m_FunctionCache.SetProfileFlags(JitProfileAll);
+		} else {
+			m_FunctionCache.SetProfileFlags(PipelinePart::GetDefaultProfileFlags());
+		}
+
+		break;
+#endif
+
 	default:
 		RecordError(GL_INVALID_ENUM);
 		return;
@@ -714,10 +762,17 @@ void Context :: GetIntegerv(GLenum pname, GLint *params) {
 		break;
 
 	case GL_MAX_PALETTE_MATRICES_OES:
-	case GL_MAX_VERTEX_UNITS_OES:
 		params[0] = MATRIX_PALETTE_SIZE;
 		break;
 
+	case GL_MAX_VERTEX_UNITS_OES:
+		params[0] = MATRIX_PALETTE_VERTEX_UNITS;
+		break;
+
+	case GL_CURRENT_PALETTE_MATRIX_OES:
+		params[0] = m_CurrentPaletteMatrix;
+		break;
+
 //		params[0] = EGL_NUM_TEXTURE_UNITS;
 //		break;
 
@@ -773,6 +828,30 @@ void Context :: GetIntegerv(GLenum pname, GLint *params) {
 		params[0] = m_PointSizeArray.stride;
 		break;
 
+	case GL_MATRIX_INDEX_ARRAY_SIZE_OES:
+		params[0] = m_MatrixIndexArray.size;
+		break;
+
+	case GL_MATRIX_INDEX_ARRAY_TYPE_OES:
+		params[0] = m_MatrixIndexArray.type;
+		break;
+
+	case GL_MATRIX_INDEX_ARRAY_STRIDE_OES:
+		params[0] = m_MatrixIndexArray.stride;
+		break;
+
+	case GL_WEIGHT_ARRAY_SIZE_OES:
+		params[0] = m_WeightArray.size;
+		break;
+
+	case GL_WEIGHT_ARRAY_TYPE_OES:
+		params[0] = m_WeightArray.type;
+		break;
+
+	case GL_WEIGHT_ARRAY_STRIDE_OES:
+		params[0] = m_WeightArray.stride;
+		break;
+
 	case GL_VERTEX_ARRAY_BUFFER_BINDING:
 		params[0] = m_VertexArray.boundBuffer;
 		break;
@@ -797,6 +876,14 @@ void Context :: GetIntegerv(GLenum pname, GLint *params) {
 		params[0] = m_PointSizeArray.boundBuffer;
 		break;
 
+	case GL_MATRIX_INDEX_ARRAY_BUFFER_BINDING_OES:
+		params[0] = m_MatrixIndexArray.boundBuffer;
+		break;
+
+	case GL_WEIGHT_ARRAY_BUFFER_BINDING_OES:
+		params[0] = m_WeightArray.boundBuffer;
+		break;
+
 	case GL_ARRAY_BUFFER_BINDING:
 		params[0] = m_CurrentArrayBuffer;
 		break;
@@ -980,6 +1067,20 @@ void Context :: GetIntegerv(GLenum pname, GLint *params) {
 		params[0] = m_GenerateMipmapHint;
 		break;
 
+	case GL_INDEX_BUFFER_OPTIMIZE_HINT_VIN:
+		params[0] = m_IndexBufferOptimizeHint;
+		break;
+
+#if EGL_USE_JIT
+	case GL_JIT_PROFILE_HINT_VIN:
+		params[0] = m_JitProfileHint;
+		break;
+#endif
+
+	case GL_VERTEX_CACHE_SIZE_VIN:
+		params[0] = EGL_VERTEX_CACHE_SIZE;
+		break;
+
 	default:
 		RecordError(GL_INVALID_ENUM);
 	}
@@ -1171,6 +1272,14 @@ void Context :: GetPointerv(GLenum pname, void **params) {
 		params[0] = const_cast<void *>(m_PointSizeArray.pointer);
 		break;
 
+	case GL_MATRIX_INDEX_ARRAY_POINTER_OES:
+		params[0] = const_cast<void *>(m_MatrixIndexArray.pointer);
+		break;
+
+	case GL_WEIGHT_ARRAY_POINTER_OES:
+		params[0] = const_cast<void *>(m_WeightArray.pointer);
+		break;
+
 
 	default:
 		RecordError(GL_INVALID_ENUM);
@@ -1195,6 +1304,15 @@ GLboolean Context :: IsEnabled(GLenum cap) {
 	case GL_POINT_SIZE_ARRAY_OES:
 		return m_PointSizeArrayEnabled;
 
+	case GL_MATRIX_INDEX_ARRAY_OES:
+		return m_MatrixIndexArrayEnabled;
+
+	case GL_WEIGHT_ARRAY_OES:
+		return m_WeightArrayEnabled;
+
+	case GL_MATRIX_PALETTE_OES:
+		return m_MatrixPaletteEnabled;
+
 	case GL_NORMALIZE:
 		return m_NormalizeEnabled;
 
@@ -1273,7 +1391,7 @@ GLboolean Context :: IsEnabled(GLenum cap) {
 		return m_RasterizerState.IsPointSpriteEnabled();
 
 	case GL_MULTISAMPLE:
-		return m_MultiSampleEnabled;
+		return m_RasterizerState.IsEnabledMultisample();
 
 	case GL_SAMPLE_ALPHA_TO_COVERAGE:
 		return m_SampleAlphaToCoverageEnabled;
@@ -1285,7 +1403,7 @@ GLboolean Context :: IsEnabled(GLenum cap) {
 		return m_SampleCoverageEnabled;
 
 	case GL_DITHER:
-		return m_DitherEnabled;
+		return m_RasterizerState.IsEnabledDither();
 
 	default:
 		RecordError(GL_INVALID_ENUM);
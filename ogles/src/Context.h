@@ -71,6 +71,8 @@ namespace EGL {
 		enum {
 			NUM_CLIP_PLANES = 6,
 			MATRIX_PALETTE_SIZE = 9,
+			MATRIX_PALETTE_VERTEX_UNITS = 4,	// max. matrices per vertex
+			POINT_BATCH_SIZE = 32,				// points processed per batch
 
 			VIEWPORT_NEAR = 0,
 			VIEWPORT_FAR = EGL_ONE
@@ -251,6 +253,12 @@ namespace EGL {
 		/* OES_point_size_array */
 		void PointSizePointer(GLenum type, GLsizei stride, const GLvoid *pointer);
 
+		/* OES_matrix_palette */
+		void CurrentPaletteMatrix(GLuint index);
+		void LoadPaletteFromModelViewMatrix(void);
+		void MatrixIndexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+		void WeightPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer);
+
 		/* binary shaders */
 		void RegisterBinaryShader(GLenum type, const GLvoid *pointer);
 		void UnregisterBinaryShader(GLenum type);
@@ -275,6 +283,10 @@ namespace EGL {
 			return m_Rasterizer;
 		}
 
+		const FunctionCacheStatistics & GetFunctionCacheStatistics() const {
+			return m_FunctionCache.GetStatistics();
+		}
+
 		MultiTexture * GetCurrentTexture() {
 			return m_Rasterizer->GetTexture(m_ActiveTexture);
 		}
@@ -305,9 +317,17 @@ namespace EGL {
 			return CurrentMatrixStack()->CurrentMatrix();
 		}
 
+		void UpdateMatrices(void);
 		void UpdateInverseModelViewMatrix(void);
+		void UpdateFullInverseModelViewMatrix(void);
+		void UpdatePaletteMatrices(void);
+		void BlendPaletteMatrices(int index);
 		void RebuildMatrices(void);
 		void MultMatrix(const Matrix4x4 & m);
+#if EGL_USE_FLOAT_VERTEX
+		void MultMatrix(const Matrix4x4f & m);
+		void LoadMatrix(const Matrix4x4f & m);
+#endif
 
 		// SGIS_generate_mipmap extension
 		void UpdateMipmaps(void);
@@ -330,7 +350,9 @@ namespace EGL {
 		void DrawTriangle(int index);
 		void DrawTriangleStrip(int index);
 		void DrawTriangleFan(int index);
+		void DrawIndexedTriangle(int index);
 
+		void EndPoint();
 		void EndLineLoop();
 		
 		// ----------------------------------------------------------------------
@@ -339,6 +361,15 @@ namespace EGL {
 
 private:
 		void SelectArrayElement(int index, Vertex * rasterPos);
+		void SelectArrayAttributes(int index, Vertex * rasterPos);
+#if EGL_USE_FLOAT_VERTEX
+		void SelectArrayElementFloat(int index, Vertex * rasterPos);
+#endif
+		Vertex * CachedArrayElement(int index);
+		void ResetVertexCache();
+		void ResetPointBatch();
+		void TransformPoints();
+		void FlushPoints();
 		EGL_Fixed SelectPointSizeArrayElement(int index);
 
 		typedef void (Context::*LightVertexFunction)(Vertex * rasterPos, LightMode mode);
@@ -348,6 +379,7 @@ private:
 		typedef void (*FetchVertexFunction)(const RenderInfo * info, int index, Vertex * result);
 
 		void PrepareRendering();
+		void InitVertexDefaults(Vertex & vertex);
 		void PrepareArray(VertexArray& array, bool enabled, ArrayState& arrayState, ArrayInfo& arrayInfo, bool isColor = false);
 		void BeginRendering();
 
@@ -370,7 +402,6 @@ private:
 		// ----------------------------------------------------------------------
 		// Perform clipping, depth division & actual call into rasterizer
 		// ----------------------------------------------------------------------
-		void RenderPoint(Vertex& point, EGL_Fixed size);
 		void RenderLine(Vertex& from, Vertex& to);
 		void RenderTriangle(Vertex& a, Vertex& b, Vertex& c);
 
@@ -398,6 +429,47 @@ private:
 		Matrix4x4			m_ModelViewProjectionMatrix;
 		GLenum				m_MatrixMode;
 
+		// matrix stack epochs the derived matrices above were computed from
+		U32					m_CompositeModelViewEpoch;
+		U32					m_CompositeProjectionEpoch;
+		U32					m_InverseModelViewEpoch;
+		U32					m_FullInverseModelViewEpoch;
+		bool				m_InverseRescaleNormal;
+
+#if EGL_USE_FLOAT_VERTEX
+		// matrices of the floating point vertex pipeline, derived from the
+		// floating point matrices of the matrix stacks
+		Matrix4x4f			m_FloatModelViewMatrix;
+		Matrix4x4f			m_FloatModelViewProjectionMatrix;
+		Matrix4x4f			m_FloatInverseModelViewMatrix;
+		bool				m_FloatVertexPath;		// vertex array is GL_FLOAT
+#endif
+
+		// matrix palette and the matrices derived from each palette entry
+		MatrixStack			m_MatrixPaletteStack[MATRIX_PALETTE_SIZE];
+		Matrix4x4			m_PaletteModelViewProjectionMatrix[MATRIX_PALETTE_SIZE];
+		Matrix4x4			m_PaletteInverseModelViewMatrix[MATRIX_PALETTE_SIZE];
+		U32					m_PaletteEpoch[MATRIX_PALETTE_SIZE];
+		U32					m_PaletteProjectionEpoch;
+		bool				m_PaletteRescaleNormal;
+		size_t				m_CurrentPaletteMatrix;
+
+		// matrices blended for the most recently skinned vertex; they are
+		// reused as long as consecutive vertices have the same indices and weights
+		Matrix4x4			m_BlendedModelViewMatrix;
+		Matrix4x4			m_BlendedModelViewProjectionMatrix;
+		Matrix4x4			m_BlendedInverseModelViewMatrix;
+		Vec3D				m_BlendedDefaultNormal;	// in the absence of a normal array
+		GLubyte				m_BlendIndices[MATRIX_PALETTE_VERTEX_UNITS];
+		EGL_Fixed			m_BlendWeights[MATRIX_PALETTE_VERTEX_UNITS];
+		bool				m_BlendValid;
+		bool				m_PaletteSkinning;		// palette enabled and arrays present
+
+		// matrices used for vertex transformation by the current draw call
+		const Matrix4x4 *	m_VertexModelViewMatrix;
+		const Matrix4x4 *	m_VertexModelViewProjectionMatrix;
+		const Matrix4x4 *	m_VertexInverseModelViewMatrix;
+
 		// ----------------------------------------------------------------------
 		// Viewport configuration
 		// ----------------------------------------------------------------------
@@ -420,6 +492,8 @@ private:
 		bool				m_NormalArrayEnabled: 1;
 		bool				m_ColorArrayEnabled:1;
 		bool				m_PointSizeArrayEnabled: 1;
+		bool				m_MatrixIndexArrayEnabled: 1;
+		bool				m_WeightArrayEnabled: 1;
 		bool				m_TexCoordArrayEnabled[EGL_NUM_TEXTURE_UNITS];
 
 		VertexArray			m_VertexArray;
@@ -427,6 +501,8 @@ private:
 		VertexArray			m_ColorArray;
 		VertexArray			m_TexCoordArray[EGL_NUM_TEXTURE_UNITS];
 		VertexArray			m_PointSizeArray;
+		VertexArray			m_MatrixIndexArray;
+		VertexArray			m_WeightArray;
 
 		// ----------------------------------------------------------------------
 		// Default values if arrays are disabled
@@ -450,6 +526,8 @@ private:
 		GLenum				m_LineSmoothHint;
 		GLenum				m_FogHint;
 		GLenum				m_GenerateMipmapHint;
+		GLenum				m_IndexBufferOptimizeHint;
+		GLenum				m_JitProfileHint;
 
 		// ----------------------------------------------------------------------
 		// Rendering State
@@ -484,17 +562,16 @@ private:
 		bool				m_LightingEnabled: 1;		// is lightning enabled?
 		bool				m_TwoSidedLightning: 1;	// do we have two-sided lightning
 		bool				m_CullFaceEnabled: 1;
-		bool				m_DitherEnabled: 1;
 		bool				m_ReverseFaceOrientation: 1;
 		bool				m_ColorMaterialEnabled: 1;
 		bool				m_NormalizeEnabled: 1;
 		bool				m_RescaleNormalEnabled: 1;
 		bool				m_PolygonOffsetFillEnabled: 1;
-		bool				m_MultiSampleEnabled: 1;
 		bool				m_SampleAlphaToCoverageEnabled: 1;
 		bool				m_SampleAlphaToOneEnabled: 1;
 		bool				m_SampleCoverageEnabled: 1;
 		bool				m_GenerateMipmaps: 1;
+		bool				m_MatrixPaletteEnabled: 1;
 
 		I32					m_PixelStorePackAlignment;
 		I32					m_PixelStoreUnpackAlignment;
@@ -546,6 +623,19 @@ private:
 
 		Vertex			m_Input[3];			// for primtive rendering
 		Vertex			m_Temporary[16];	// temporary coordinates
+
+		// post-transform vertex cache for indexed triangle lists
+		Vertex			m_VertexCache[EGL_VERTEX_CACHE_SIZE];
+		I32				m_VertexCacheIndex[EGL_VERTEX_CACHE_SIZE];
+		U32				m_VertexCacheNext;
+		Vertex *		m_IndexedInput[3];
+
+		// batch of points collected between Begin and End
+		Vertex			m_PointBatch[POINT_BATCH_SIZE];
+		I32				m_PointBatchIndex[POINT_BATCH_SIZE];	// array index of each point
+		EGL_Fixed		m_PointBatchSize[POINT_BATCH_SIZE];
+		size_t			m_PointBatchCount;
+		size_t			m_PointBatchInitialized;	// vertices with defaults set
 	};
 
 
@@ -585,11 +675,31 @@ private:
 	#if EGL_USE_JIT
 	inline void Context :: SelectArrayElement(int index, Vertex * rasterPos) {
 
+#if EGL_USE_FLOAT_VERTEX
+		if (m_FloatVertexPath) {
+			SelectArrayElementFloat(index, rasterPos);
+			return;
+		}
+#endif
+
+		if (m_PaletteSkinning) {
+			// the generated code picks up the blended matrices via m_RenderInfo
+			BlendPaletteMatrices(index);
+		}
+
 		m_FetchVertexFunction(&m_RenderInfo, index, rasterPos);
 
+		if (m_PaletteSkinning && m_RenderState.NeedsNormal && !m_NormalArray.effectivePointer) {
+			rasterPos->m_EyeNormal = m_BlendedDefaultNormal;
+		}
+
 		if (rasterPos->m_ClipCoords.w() < 0) 
 			rasterPos->m_ClipCoords = -rasterPos->m_ClipCoords;
 
+#if EGL_USE_FLOAT_VERTEX
+		rasterPos->m_Float = 0;
+#endif
+
 		CalcCC(rasterPos);
 
 		rasterPos->m_Lit = Unlit;
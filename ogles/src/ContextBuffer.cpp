@@ -167,7 +167,15 @@ void Context :: BufferData(GLenum target, GLsizeiptr size, const GLvoid *data, G
 	Buffer * buffer = m_Buffers.GetObject(*currentBuffer);
 
 	if (buffer->Allocate(size, bufferUsage)) {
-		memcpy(buffer->GetData(), data, size);
+		if (data) {
+			memcpy(buffer->GetData(), data, size);
+
+			// the indices are reordered by the first draw call using all of
+			// them as a triangle list
+			buffer->SetOptimizationPending(target == GL_ELEMENT_ARRAY_BUFFER && 
+				bufferUsage == BufferUsageStaticDraw &&
+				m_IndexBufferOptimizeHint != GL_DONT_CARE);
+		}
 	} else {
 		RecordError(GL_OUT_OF_MEMORY);
 	}
@@ -196,6 +204,11 @@ void Context :: BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, c
 	U8 * bufferData = static_cast<U8 *>(buffer->GetData()) + offset;
 
 	memcpy(bufferData, data, size);
+
+	// the reordered indices no longer match the buffer contents; they are
+	// derived again by the next draw call of the whole buffer
+	buffer->SetOptimizationPending(buffer->IsOptimizationPending() || buffer->IsOptimized());
+	buffer->ResetOptimization();
 }
 
 void Context :: GetBufferParameteriv(GLenum target, GLenum pname, GLint *params) {
@@ -221,6 +234,18 @@ void Context :: GetBufferParameteriv(GLenum target, GLenum pname, GLint *params)
 		params[0] = GL_WRITE_ONLY;
 		break;
 
+	case GL_BUFFER_OPTIMIZED_VIN:
+		params[0] = buffer->IsOptimized();
+		break;
+
+	case GL_BUFFER_CACHE_MISSES_BEFORE_VIN:
+		params[0] = buffer->GetCacheMissesBefore();
+		break;
+
+	case GL_BUFFER_CACHE_MISSES_AFTER_VIN:
+		params[0] = buffer->GetCacheMissesAfter();
+		break;
+
 	default:
 		RecordError(GL_INVALID_ENUM);
 		return;
@@ -114,9 +114,18 @@ void Context :: Fogfv (GLenum pname, const GLfloat *params) {
 }
 
 void Context :: Frustumf (GLfloat left, GLfloat right, GLfloat bottom, GLfloat top, GLfloat zNear, GLfloat zFar) {
+#if EGL_USE_FLOAT_VERTEX
+	if (left == right || top == bottom || zNear <= 0 || zFar <= 0) {
+		RecordError(GL_INVALID_VALUE);
+		return;
+	}
+
+	MultMatrix(Matrix4x4f::CreateFrustrum(left, right, bottom, top, zNear, zFar));
+#else
 	Frustumx(EGL_FixedFromFloat(left), EGL_FixedFromFloat(right),
 		EGL_FixedFromFloat(bottom), EGL_FixedFromFloat(top), 
 		EGL_FixedFromFloat(zNear), EGL_FixedFromFloat(zFar));
+#endif
 }
 
 void Context :: LightModelf (GLenum pname, GLfloat param) {
@@ -205,6 +214,9 @@ void Context :: LineWidth (GLfloat width) {
 }
 
 void Context :: LoadMatrixf (const GLfloat *m) {
+#if EGL_USE_FLOAT_VERTEX
+	LoadMatrix(Matrix4x4f(m));
+#else
 	GLfixed mx[16];
 
 	for (int index = 0; index < 16; ++index) {
@@ -212,6 +224,7 @@ void Context :: LoadMatrixf (const GLfloat *m) {
 	}
 
 	LoadMatrixx(mx);
+#endif
 }
 
 void Context :: Materialf (GLenum face, GLenum pname, GLfloat param) {
@@ -253,6 +266,9 @@ void Context :: Materialfv (GLenum face, GLenum pname, const GLfloat *params) {
 }
 
 void Context :: MultMatrixf (const GLfloat *m) {
+#if EGL_USE_FLOAT_VERTEX
+	MultMatrix(Matrix4x4f(m));
+#else
 	GLfixed mx[16];
 
 	for (int index = 0; index < 16; ++index) {
@@ -260,6 +276,7 @@ void Context :: MultMatrixf (const GLfloat *m) {
 	}
 
 	MultMatrixx(mx);
+#endif
 }
 
 void Context :: MultiTexCoord4f (GLenum target, GLfloat s, GLfloat t, GLfloat r, GLfloat q) {
@@ -273,9 +290,13 @@ void Context :: Normal3f (GLfloat nx, GLfloat ny, GLfloat nz) {
 }
 
 void Context :: Orthof (GLfloat left, GLfloat right, GLfloat bottom, GLfloat top, GLfloat zNear, GLfloat zFar) {
+#if EGL_USE_FLOAT_VERTEX
+	MultMatrix(Matrix4x4f::CreateOrtho(left, right, bottom, top, zNear, zFar));
+#else
 	Orthox(EGL_FixedFromFloat(left), EGL_FixedFromFloat(right),
 		EGL_FixedFromFloat(bottom), EGL_FixedFromFloat(top),
 		EGL_FixedFromFloat(zNear), EGL_FixedFromFloat(zFar));
+#endif
 }
 
 void Context :: PointSize (GLfloat size) {
@@ -287,8 +308,12 @@ void Context :: PolygonOffset (GLfloat factor, GLfloat units) {
 }
 
 void Context :: Rotatef (GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+#if EGL_USE_FLOAT_VERTEX
+	MultMatrix(Matrix4x4f::CreateRotate(angle, x, y, z));
+#else
 	Rotatex(EGL_FixedFromFloat(angle), EGL_FixedFromFloat(x),
 		EGL_FixedFromFloat(y), EGL_FixedFromFloat(z));
+#endif
 }
 
 void Context :: SampleCoverage (GLclampf value, GLboolean invert) {
@@ -296,7 +321,11 @@ void Context :: SampleCoverage (GLclampf value, GLboolean invert) {
 }
 
 void Context :: Scalef (GLfloat x, GLfloat y, GLfloat z) {
+#if EGL_USE_FLOAT_VERTEX
+	MultMatrix(Matrix4x4f::CreateScale(x, y, z));
+#else
 	Scalex(EGL_FixedFromFloat(x), EGL_FixedFromFloat(y), EGL_FixedFromFloat(z));
+#endif
 }
 
 void Context :: TexEnvf (GLenum target, GLenum pname, GLfloat param) {
@@ -349,7 +378,11 @@ void Context :: TexParameterf (GLenum target, GLenum pname, GLfloat param) {
 }
 
 void Context :: Translatef (GLfloat x, GLfloat y, GLfloat z) {
+#if EGL_USE_FLOAT_VERTEX
+	MultMatrix(Matrix4x4f::CreateTranslate(x, y, z));
+#else
 	Translatex(EGL_FixedFromFloat(x), EGL_FixedFromFloat(y), EGL_FixedFromFloat(z));
+#endif
 }
 
 void Context :: ClipPlanef(GLenum plane, const GLfloat *equation) {
@@ -390,6 +423,14 @@ namespace {
 			*out++ = EGL_FloatFromFixed(*in++);
 		}
 	}
+
+#if EGL_USE_FLOAT_VERTEX
+	void CopyFloatMatrix(const Matrix4x4f & matrix, GLfloat * out) {
+		for (int index = 0; index < 16; ++index) {
+			*out++ = matrix.Element(index);
+		}
+	}
+#endif
 }
 
 
@@ -445,6 +486,19 @@ void Context :: GetFloatv(GLenum pname, GLfloat *params) {
 
 		break;
 
+#if EGL_USE_FLOAT_VERTEX
+	case GL_MODELVIEW_MATRIX:
+		CopyFloatMatrix(m_ModelViewMatrixStack.CurrentFloatMatrix(), params);
+		break;
+
+	case GL_PROJECTION_MATRIX:
+		CopyFloatMatrix(m_ProjectionMatrixStack.CurrentFloatMatrix(), params);
+		break;
+
+	case GL_TEXTURE_MATRIX:
+		CopyFloatMatrix(m_TextureMatrixStack[m_ActiveTexture].CurrentFloatMatrix(), params);
+		break;
+#else
 	case GL_MODELVIEW_MATRIX:
 	case GL_PROJECTION_MATRIX:
 	case GL_TEXTURE_MATRIX:
@@ -453,6 +507,7 @@ void Context :: GetFloatv(GLenum pname, GLfloat *params) {
 		}
 
 		break;
+#endif
 	}
 
 }
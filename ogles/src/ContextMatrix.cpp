@@ -38,6 +38,7 @@
 
 
 #include "stdafx.h"
+#include <string.h>
 #include "Context.h"
 #include "RasterizerState.h"
 
@@ -62,6 +63,10 @@ void Context :: MatrixMode(GLenum mode) {
 		m_CurrentMatrixStack = &m_TextureMatrixStack[m_ActiveTexture];
 		break;
 
+	case GL_MATRIX_PALETTE_OES:
+		m_CurrentMatrixStack = &m_MatrixPaletteStack[m_CurrentPaletteMatrix];
+		break;
+
 	default:
 		RecordError(GL_INVALID_ENUM);
 		return;
@@ -70,20 +75,64 @@ void Context :: MatrixMode(GLenum mode) {
 	m_MatrixMode = mode;
 }
 
+// --------------------------------------------------------------------------
+// The composite and inverse matrices derived from the modelview and
+// projection matrices are only recomputed when they are actually needed,
+// and only if the matrix stacks they are derived from have changed since.
+// This way a sequence of matrix operations between two drawing calls
+// results in at most one recalculation.
+// --------------------------------------------------------------------------
+
 void Context :: RebuildMatrices(void) {
-	if (m_CurrentMatrixStack == &m_ModelViewMatrixStack) {
-		m_InverseModelViewMatrix = m_ModelViewMatrixStack.CurrentMatrix().InverseUpper3(m_RescaleNormalEnabled);
-		m_FullInverseModelViewMatrix = m_ModelViewMatrixStack.CurrentMatrix().Inverse();
-		m_ModelViewProjectionMatrix = m_ProjectionMatrixStack.CurrentMatrix() * m_ModelViewMatrixStack.CurrentMatrix();
-	} else if (m_CurrentMatrixStack == &m_ProjectionMatrixStack) {
-		m_ModelViewProjectionMatrix = m_ProjectionMatrixStack.CurrentMatrix() * m_ModelViewMatrixStack.CurrentMatrix();
-	} else if (m_MatrixMode == GL_TEXTURE) {
+	if (m_MatrixMode == GL_TEXTURE) {
 		m_RenderState.TextureMatrixIdentity[m_ActiveTexture] = m_TextureMatrixStack[m_ActiveTexture].CurrentMatrix().IsIdentity();
 	}
 }
 
+void Context :: UpdateMatrices(void) {
+	U32 modelViewEpoch = m_ModelViewMatrixStack.GetEpoch();
+	U32 projectionEpoch = m_ProjectionMatrixStack.GetEpoch();
+
+	if (modelViewEpoch != m_CompositeModelViewEpoch || 
+		projectionEpoch != m_CompositeProjectionEpoch) {
+		m_ModelViewProjectionMatrix = m_ProjectionMatrixStack.CurrentMatrix() * m_ModelViewMatrixStack.CurrentMatrix();
+
+#if EGL_USE_FLOAT_VERTEX
+		m_FloatModelViewMatrix = m_ModelViewMatrixStack.CurrentFloatMatrix();
+		m_FloatModelViewProjectionMatrix = m_ProjectionMatrixStack.CurrentFloatMatrix() * m_FloatModelViewMatrix;
+#endif
+
+		m_CompositeModelViewEpoch = modelViewEpoch;
+		m_CompositeProjectionEpoch = projectionEpoch;
+	}
+
+	UpdateInverseModelViewMatrix();
+}
+
 void Context :: UpdateInverseModelViewMatrix(void) {
-	m_InverseModelViewMatrix = m_ModelViewMatrixStack.CurrentMatrix().InverseUpper3(m_RescaleNormalEnabled);
+	U32 modelViewEpoch = m_ModelViewMatrixStack.GetEpoch();
+
+	if (modelViewEpoch != m_InverseModelViewEpoch ||
+		m_RescaleNormalEnabled != m_InverseRescaleNormal) {
+		m_InverseModelViewMatrix = m_ModelViewMatrixStack.CurrentMatrix().InverseUpper3(m_RescaleNormalEnabled);
+
+#if EGL_USE_FLOAT_VERTEX
+		m_FloatInverseModelViewMatrix = 
+			m_ModelViewMatrixStack.CurrentFloatMatrix().InverseUpper3(m_RescaleNormalEnabled);
+#endif
+
+		m_InverseModelViewEpoch = modelViewEpoch;
+		m_InverseRescaleNormal = m_RescaleNormalEnabled;
+	}
+}
+
+void Context :: UpdateFullInverseModelViewMatrix(void) {
+	U32 modelViewEpoch = m_ModelViewMatrixStack.GetEpoch();
+
+	if (modelViewEpoch != m_FullInverseModelViewEpoch) {
+		m_FullInverseModelViewMatrix = m_ModelViewMatrixStack.CurrentMatrix().Inverse();
+		m_FullInverseModelViewEpoch = modelViewEpoch;
+	}
 }
 
 void Context :: LoadIdentity(void) { 
@@ -107,6 +156,24 @@ void Context :: MultMatrixx(const GLfixed *m) {
 	MultMatrix(Matrix4x4(m));
 }
 
+#if EGL_USE_FLOAT_VERTEX
+
+// --------------------------------------------------------------------------
+// Matrix operations given in floating point; see ContextFloat.cpp
+// --------------------------------------------------------------------------
+
+void Context :: MultMatrix(const Matrix4x4f & m) {
+	CurrentMatrixStack()->MultMatrix(m);
+	RebuildMatrices();
+}
+
+void Context :: LoadMatrix(const Matrix4x4f & m) {
+	CurrentMatrixStack()->LoadMatrix(m);
+	RebuildMatrices();
+}
+
+#endif
+
 void Context :: PopMatrix(void) { 
 
 	if (CurrentMatrixStack()->PopMatrix()) {
@@ -125,6 +192,125 @@ void Context :: PushMatrix(void) {
 	}
 }
 
+// --------------------------------------------------------------------------
+// Matrix palette extension
+// --------------------------------------------------------------------------
+
+void Context :: CurrentPaletteMatrix(GLuint index) {
+	if (index >= MATRIX_PALETTE_SIZE) {
+		RecordError(GL_INVALID_VALUE);
+		return;
+	}
+
+	m_CurrentPaletteMatrix = index;
+
+	if (m_MatrixMode == GL_MATRIX_PALETTE_OES) {
+		m_CurrentMatrixStack = &m_MatrixPaletteStack[m_CurrentPaletteMatrix];
+	}
+}
+
+void Context :: LoadPaletteFromModelViewMatrix(void) {
+	m_MatrixPaletteStack[m_CurrentPaletteMatrix].LoadMatrix(m_ModelViewMatrixStack.CurrentMatrix());
+}
+
+// --------------------------------------------------------------------------
+// Palette matrices are given in eye coordinates; for each entry we keep
+// the product with the projection matrix and the matrix used to transform
+// normals, which are recomputed lazily like their modelview counterparts.
+// --------------------------------------------------------------------------
+void Context :: UpdatePaletteMatrices(void) {
+	U32 projectionEpoch = m_ProjectionMatrixStack.GetEpoch();
+	bool projectionChanged = projectionEpoch != m_PaletteProjectionEpoch;
+	bool rescaleChanged = m_RescaleNormalEnabled != m_PaletteRescaleNormal;
+
+	for (size_t index = 0; index < MATRIX_PALETTE_SIZE; ++index) {
+		const Matrix4x4& matrix = m_MatrixPaletteStack[index].CurrentMatrix();
+		U32 epoch = m_MatrixPaletteStack[index].GetEpoch();
+		bool matrixChanged = epoch != m_PaletteEpoch[index];
+
+		if (matrixChanged || projectionChanged) {
+			m_PaletteModelViewProjectionMatrix[index] = m_ProjectionMatrixStack.CurrentMatrix() * matrix;
+		}
+
+		if (matrixChanged || rescaleChanged) {
+			m_PaletteInverseModelViewMatrix[index] = matrix.InverseUpper3(m_RescaleNormalEnabled);
+		}
+
+		m_PaletteEpoch[index] = epoch;
+	}
+
+	m_PaletteProjectionEpoch = projectionEpoch;
+	m_PaletteRescaleNormal = m_RescaleNormalEnabled;
+}
+
+// --------------------------------------------------------------------------
+// Determine the blended matrices for the vertex at the given array index.
+// Skinned meshes usually have long runs of vertices bound to the same
+// matrices with the same weights, so the result of the previous call is
+// reused if the indices and weights have not changed. Indices beyond the
+// end of the palette are clamped to its last entry.
+//
+// Parameters:
+//	index		-	The array index of the vertex
+// --------------------------------------------------------------------------
+void Context :: BlendPaletteMatrices(int index) {
+	GLubyte indices[MATRIX_PALETTE_VERTEX_UNITS];
+	EGL_Fixed weights[MATRIX_PALETTE_VERTEX_UNITS];
+
+	size_t units = m_MatrixIndexArray.size < m_WeightArray.size ? m_MatrixIndexArray.size : m_WeightArray.size;
+
+	m_MatrixIndexArray.FetchUnsignedByteValues(index, indices);
+	m_WeightArray.FetchValues(index, weights);
+
+	if (m_BlendValid &&
+		!memcmp(indices, m_BlendIndices, units * sizeof(GLubyte)) &&
+		!memcmp(weights, m_BlendWeights, units * sizeof(EGL_Fixed))) {
+		return;
+	}
+
+	EGL_Fixed modelView[16], modelViewProjection[16], inverseModelView[16];
+
+	memset(modelView, 0, sizeof modelView);
+	memset(modelViewProjection, 0, sizeof modelViewProjection);
+	memset(inverseModelView, 0, sizeof inverseModelView);
+
+	for (size_t unit = 0; unit < units; ++unit) {
+		EGL_Fixed weight = weights[unit];
+		size_t paletteIndex = indices[unit];
+
+		m_BlendIndices[unit] = indices[unit];
+		m_BlendWeights[unit] = weight;
+
+		if (!weight) {
+			continue;
+		}
+
+		if (paletteIndex >= MATRIX_PALETTE_SIZE) {
+			paletteIndex = MATRIX_PALETTE_SIZE - 1;
+		}
+
+		const EGL_Fixed * mv = m_MatrixPaletteStack[paletteIndex].CurrentMatrix().GetArray();
+		const EGL_Fixed * mvp = m_PaletteModelViewProjectionMatrix[paletteIndex].GetArray();
+		const EGL_Fixed * inv = m_PaletteInverseModelViewMatrix[paletteIndex].GetArray();
+
+		for (size_t element = 0; element < 16; ++element) {
+			modelView[element]				+= EGL_Mul(weight, mv[element]);
+			modelViewProjection[element]	+= EGL_Mul(weight, mvp[element]);
+			inverseModelView[element]		+= EGL_Mul(weight, inv[element]);
+		}
+	}
+
+	m_BlendedModelViewMatrix = Matrix4x4(modelView);
+	m_BlendedModelViewProjectionMatrix = Matrix4x4(modelViewProjection);
+	m_BlendedInverseModelViewMatrix = Matrix4x4(inverseModelView);
+
+	if (m_RenderState.NeedsNormal && !m_NormalArray.effectivePointer) {
+		m_BlendedDefaultNormal = m_BlendedInverseModelViewMatrix.Multiply3x3(m_DefaultNormal);
+	}
+
+	m_BlendValid = true;
+}
+
 // --------------------------------------------------------------------------
 // Calculation of specific matrixes
 // --------------------------------------------------------------------------
@@ -69,60 +69,225 @@ inline EGL_Fixed Context :: SelectPointSizeArrayElement(int index) {
 }
 
 
+// --------------------------------------------------------------------------
+// Point batching
+//
+// Points are collected into a batch of up to POINT_BATCH_SIZE array indices
+// before being processed. The transformation, culling and the distance
+// attenuation of the point size run as separate passes over the whole
+// batch, and the surviving points are handed to the rasterizer in a single
+// call, so that setup can be shared between points of the same size. The
+// rasterizer clips the point squares against the surface and the scissor
+// rectangle.
+// --------------------------------------------------------------------------
+
+void Context :: ResetPointBatch() {
+	// the defaults are only needed for vertices fetched by generated code,
+	// so they are set when a vertex of the batch is first used
+	m_PointBatchCount = 0;
+	m_PointBatchInitialized = 0;
+}
+
+
 void Context :: DrawPoint(int index) {
-	EGL_Fixed size = SelectPointSizeArrayElement(index);
-	SelectArrayElement(index, &m_Input[0]);
-	RenderPoint(m_Input[0], size);
+	m_PointBatchIndex[m_PointBatchCount] = index;
+	m_PointBatchSize[m_PointBatchCount] = SelectPointSizeArrayElement(index);
+
+	if (++m_PointBatchCount == POINT_BATCH_SIZE) {
+		FlushPoints();
+	}
 }
 
 
-void Context :: RenderPoint(Vertex& point, EGL_Fixed size) {
+// --------------------------------------------------------------------------
+// Transform the points of the batch. The positions are transformed in one
+// pass over the batch, and the remaining attributes are only fetched for
+// points within the view volume. Skinned points, and fixed point arrays in
+// JIT builds, go through the regular vertex fetch.
+// --------------------------------------------------------------------------
+void Context :: TransformPoints() {
+
+	size_t index;
+
+#if EGL_USE_FLOAT_VERTEX
+	if (m_FloatVertexPath) {
+		for (index = 0; index < m_PointBatchCount; ++index) {
+			Vertex& point = m_PointBatch[index];
+			const GLfloat * coords = 
+				static_cast<const GLfloat *>(m_VertexArray.GetRowPointer(m_PointBatchIndex[index]));
+			float * clip = point.m_FloatClipCoords;
+
+			m_FloatModelViewProjectionMatrix.Multiply(coords, m_VertexArray.size, clip);
+
+			if (clip[3] < 0) {
+				clip[0] = -clip[0];
+				clip[1] = -clip[1];
+				clip[2] = -clip[2];
+				clip[3] = -clip[3];
+			}
+
+			point.m_Float = 1;
+			CalcCC(&point);
+		}
+
+		bool needsEyeCoords = m_RenderState.NeedsEyeCoords || m_ClipPlaneEnabled || m_PointSizeAttenuate;
+
+		for (index = 0; index < m_PointBatchCount; ++index) {
+			Vertex& point = m_PointBatch[index];
+
+			if (point.m_cc)
+				continue;
+
+			if (needsEyeCoords) {
+				const GLfloat * coords = 
+					static_cast<const GLfloat *>(m_VertexArray.GetRowPointer(m_PointBatchIndex[index]));
+				float eye[4];
+
+				m_FloatModelViewMatrix.Multiply(coords, m_VertexArray.size, eye);
+				point.m_EyeCoords = Vec4D(EGL_FixedFromFloat(eye[0]), EGL_FixedFromFloat(eye[1]),
+										  EGL_FixedFromFloat(eye[2]), EGL_FixedFromFloat(eye[3]));
+			}
+
+			SelectArrayAttributes(m_PointBatchIndex[index], &point);
+			point.m_Lit = Unlit;
+		}
+
+		return;
+	}
+#endif
+
+#if !EGL_USE_JIT
+	if (!m_PaletteSkinning) {
+		Vec4D coords[POINT_BATCH_SIZE];
+
+		for (index = 0; index < m_PointBatchCount; ++index) {
+			Vertex& point = m_PointBatch[index];
+
+			m_VertexArray.FetchValues(m_PointBatchIndex[index], coords[index].getArray());
+			m_VertexModelViewProjectionMatrix->Multiply(coords[index], point.m_ClipCoords);
+
+			if (point.m_ClipCoords.w() < 0) 
+				point.m_ClipCoords = -point.m_ClipCoords;
+
+#if EGL_USE_FLOAT_VERTEX
+			point.m_Float = 0;
+#endif
+
+			CalcCC(&point);
+		}
+
+		for (index = 0; index < m_PointBatchCount; ++index) {
+			Vertex& point = m_PointBatch[index];
+
+			if (point.m_cc)
+				continue;
+
+			m_VertexModelViewMatrix->Multiply(coords[index], point.m_EyeCoords);
+			SelectArrayAttributes(m_PointBatchIndex[index], &point);
+			point.m_Lit = Unlit;
+		}
 
-	// in principle, the scissor test can be included in here
-	if (point.m_cc)
 		return;
+	}
+#endif
+
+	for (index = 0; index < m_PointBatchCount; ++index) {
+		if (index >= m_PointBatchInitialized) {
+			InitVertexDefaults(m_PointBatch[index]);
+			m_PointBatchInitialized = index + 1;
+		}
+
+		SelectArrayElement(m_PointBatchIndex[index], &m_PointBatch[index]);
+	}
+}
+
+
+void Context :: EndPoint() {
+	FlushPoints();
+}
+
+
+void Context :: FlushPoints() {
 
-	// any user defined clip planes?
-	if (m_ClipPlaneEnabled) {
-		for (size_t index = 0, mask = 1; index < NUM_CLIP_PLANES; ++index, mask <<= 1) {
-			if (m_ClipPlaneEnabled & mask) {
-				if (point.m_EyeCoords * m_ClipPlanes[index] < 0) {
-					return;
+	Vertex * points[POINT_BATCH_SIZE];
+	EGL_Fixed sizes[POINT_BATCH_SIZE];
+	size_t count = 0, index;
+
+	TransformPoints();
+
+	// trivial rejection against the view volume and user clip planes
+	for (index = 0; index < m_PointBatchCount; ++index) {
+		Vertex& point = m_PointBatch[index];
+
+		if (point.m_cc)
+			continue;
+
+		if (m_ClipPlaneEnabled) {
+			bool clipped = false;
+
+			for (size_t plane = 0, mask = 1; plane < NUM_CLIP_PLANES; ++plane, mask <<= 1) {
+				if ((m_ClipPlaneEnabled & mask) &&
+					point.m_EyeCoords * m_ClipPlanes[plane] < 0) {
+					clipped = true;
+					break;
 				}
 			}
+
+			if (clipped)
+				continue;
 		}
+
+		points[count] = &point;
+		sizes[count] = m_PointBatchSize[index];
+		++count;
 	}
 
-	ClipCoordsToWindowCoords(point);
+	m_PointBatchCount = 0;
+
+	if (!count)
+		return;
 
-	if (m_VaryingInfo->colorIndex >= 0) {
-		if (m_LightingEnabled) {
-			LightVertex(&point, Front);
-			point.m_Color[Front].toArray(point.m_Varying + m_VaryingInfo->colorIndex);
-		} else {
-			point.m_Color[Unlit].toArray(point.m_Varying + m_VaryingInfo->colorIndex);
+	for (index = 0; index < count; ++index) {
+		Vertex& point = *points[index];
+
+		ClipCoordsToWindowCoords(point);
+
+		if (m_VaryingInfo->colorIndex >= 0) {
+			if (m_LightingEnabled) {
+				LightVertex(&point, Front);
+				point.m_Color[Front].toArray(point.m_Varying + m_VaryingInfo->colorIndex);
+			} else {
+				point.m_Color[Unlit].toArray(point.m_Varying + m_VaryingInfo->colorIndex);
+			}
 		}
-	}
 
-	if (m_VaryingInfo->fogIndex >= 0) {
-		point.m_Varying[m_VaryingInfo->fogIndex] = FogDensity(EGL_Abs(point.m_EyeCoords.z()));
+		if (m_VaryingInfo->fogIndex >= 0) {
+			point.m_Varying[m_VaryingInfo->fogIndex] = FogDensity(EGL_Abs(point.m_EyeCoords.z()));
+		}
 	}
 
 	if (m_PointSizeAttenuate) {
-		EGL_Fixed eyeDistance = EGL_Abs(point.m_EyeCoords.z());
+		const EGL_Fixed a = m_PointDistanceAttenuation[0];
+		const EGL_Fixed b = m_PointDistanceAttenuation[1];
+		const EGL_Fixed c = m_PointDistanceAttenuation[2];
+
+		for (index = 0; index < count; ++index) {
+			EGL_Fixed eyeDistance = EGL_Abs(points[index]->m_EyeCoords.z());
 
-		EGL_Fixed factor =
-			EGL_InvSqrt(m_PointDistanceAttenuation[0] +
-						EGL_Mul(m_PointDistanceAttenuation[1], eyeDistance) +
-						EGL_Mul(m_PointDistanceAttenuation[2], EGL_Mul(eyeDistance, eyeDistance)));
+			EGL_Fixed factor =
+				EGL_InvSqrt(a + EGL_Mul(b, eyeDistance) +
+							EGL_Mul(c, EGL_Mul(eyeDistance, eyeDistance)));
 
-		size = EGL_Mul(size, factor);
+			sizes[index] = EGL_Mul(sizes[index], factor);
+		}
 	}
 
-	// as long as we do not have anti-aliasing, determining the effective point size here is fine
-	EGL_Fixed pointSize = EGL_Max(size, EGL_ONE);
+	for (index = 0; index < count; ++index) {
+		// as long as we do not have anti-aliasing, determining the effective point size here is fine
+		sizes[index] = EGL_Max(sizes[index], EGL_ONE);
+	}
 
-	m_Rasterizer->RasterPoint(point, pointSize);
+	m_Rasterizer->RasterPoints(points, sizes, count);
 }
 
 
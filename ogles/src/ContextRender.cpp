@@ -97,6 +97,14 @@ void Context :: ToggleClientState(GLenum array, bool value) {
 		m_PointSizeArrayEnabled = value;
 		break;
 
+	case GL_MATRIX_INDEX_ARRAY_OES:
+		m_MatrixIndexArrayEnabled = value;
+		break;
+
+	case GL_WEIGHT_ARRAY_OES:
+		m_WeightArrayEnabled = value;
+		break;
+
 	default:
 		RecordError(GL_INVALID_ENUM);
 	}
@@ -282,6 +290,70 @@ void Context :: TexCoordPointer(GLint size, GLenum type, GLsizei stride, const G
 	m_TexCoordArray[m_ClientActiveTexture].boundBuffer = m_CurrentArrayBuffer;
 }
 
+void Context :: MatrixIndexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer) {
+
+	if (type != GL_UNSIGNED_BYTE) {
+		RecordError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (size < 1 || size > MATRIX_PALETTE_VERTEX_UNITS) {
+		RecordError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (stride < 0) {
+		RecordError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (stride == 0) {
+		stride = sizeof (GLubyte) * size;
+	}
+
+	m_MatrixIndexArray.pointer = pointer;
+	m_MatrixIndexArray.stride = stride;
+	m_MatrixIndexArray.type = type;
+	m_MatrixIndexArray.size = size;
+	m_MatrixIndexArray.boundBuffer = m_CurrentArrayBuffer;
+}
+
+void Context :: WeightPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer) {
+
+	if (type != GL_FIXED && type != GL_FLOAT) {
+		RecordError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (size < 1 || size > MATRIX_PALETTE_VERTEX_UNITS) {
+		RecordError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (stride < 0) {
+		RecordError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (stride == 0) {
+		switch (type) {
+		case GL_FIXED:
+			stride = sizeof (GLfixed) * size;
+			break;
+
+		case GL_FLOAT:
+			stride = sizeof (GLfloat) * size;
+			break;
+		}
+	}
+
+	m_WeightArray.pointer = pointer;
+	m_WeightArray.stride = stride;
+	m_WeightArray.type = type;
+	m_WeightArray.size = size;
+	m_WeightArray.boundBuffer = m_CurrentArrayBuffer;
+}
+
 
 // --------------------------------------------------------------------------
 // Default values if corrsponding array is disabled
@@ -355,9 +427,7 @@ void Context :: PrepareRendering() {
 	m_NextIndex = 0;
 
 	// get current transformation matrices
-	m_RenderInfo.ModelviewProjectionMatrix = m_ModelViewProjectionMatrix.GetArray();
-	m_RenderInfo.ModelviewMatrix = m_ModelViewMatrixStack.CurrentMatrix().GetArray();
-	m_RenderInfo.InvModelviewMatrix = m_InverseModelViewMatrix.GetArray();
+	UpdateMatrices();
 		
 	
 	// initialize the state information for fetching vertices
@@ -419,6 +489,32 @@ void Context :: PrepareRendering() {
 	ArrayInfo dummyInfo;
 	
 	PrepareArray(m_PointSizeArray, m_PointSizeArrayEnabled, dummyState, dummyInfo);
+	PrepareArray(m_MatrixIndexArray, m_MatrixIndexArrayEnabled, dummyState, dummyInfo);
+	PrepareArray(m_WeightArray, m_WeightArrayEnabled, dummyState, dummyInfo);
+
+	m_PaletteSkinning = m_MatrixPaletteEnabled &&
+		m_MatrixIndexArray.effectivePointer && m_WeightArray.effectivePointer;
+
+	if (m_PaletteSkinning) {
+		// the blended matrices are updated per vertex in BlendPaletteMatrices
+		UpdatePaletteMatrices();
+		m_BlendValid = false;
+		m_VertexModelViewMatrix = &m_BlendedModelViewMatrix;
+		m_VertexModelViewProjectionMatrix = &m_BlendedModelViewProjectionMatrix;
+		m_VertexInverseModelViewMatrix = &m_BlendedInverseModelViewMatrix;
+	} else {
+		m_VertexModelViewMatrix = &m_ModelViewMatrixStack.CurrentMatrix();
+		m_VertexModelViewProjectionMatrix = &m_ModelViewProjectionMatrix;
+		m_VertexInverseModelViewMatrix = &m_InverseModelViewMatrix;
+	}
+
+	m_RenderInfo.ModelviewProjectionMatrix = m_VertexModelViewProjectionMatrix->GetArray();
+	m_RenderInfo.ModelviewMatrix = m_VertexModelViewMatrix->GetArray();
+	m_RenderInfo.InvModelviewMatrix = m_VertexInverseModelViewMatrix->GetArray();
+
+#if EGL_USE_FLOAT_VERTEX
+	m_FloatVertexPath = m_VertexArrayEnabled && m_VertexArray.type == GL_FLOAT && !m_PaletteSkinning;
+#endif
 
 	m_TransformedDefaultNormal = m_InverseModelViewMatrix.Multiply3x3(m_DefaultNormal);
 
@@ -427,17 +523,25 @@ void Context :: PrepareRendering() {
 									&m_RenderState, &m_RenderState.Varying);
 
 	for (size_t index = 0; index < elementsof(m_Input); ++index) {
-		m_Input[index].m_EyeNormal = m_TransformedDefaultNormal;
-		m_Input[index].m_Color[Unlit] = m_DefaultRGBA;
+		InitVertexDefaults(m_Input[index]);
+	}
+}
 
-		// do we need texture coordinates?
-		for (size_t unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
-			I32 base = m_VaryingInfo->textureBase[unit];
 
-			if (base >= 0) {
-				m_Input[index].m_Varying[base]     = m_DefaultTransformedTextureCoords[unit].x();
-				m_Input[index].m_Varying[base + 1] = m_DefaultTransformedTextureCoords[unit].y();
-			}
+// --------------------------------------------------------------------------
+// Initialize the vertex attributes that are not fetched from an array
+// --------------------------------------------------------------------------
+void Context :: InitVertexDefaults(Vertex & vertex) {
+	vertex.m_EyeNormal = m_TransformedDefaultNormal;
+	vertex.m_Color[Unlit] = m_DefaultRGBA;
+
+	// do we need texture coordinates?
+	for (size_t unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		I32 base = m_VaryingInfo->textureBase[unit];
+
+		if (base >= 0) {
+			vertex.m_Varying[base]     = m_DefaultTransformedTextureCoords[unit].x();
+			vertex.m_Varying[base + 1] = m_DefaultTransformedTextureCoords[unit].y();
 		}
 	}
 }
@@ -451,14 +555,17 @@ inline void Context :: BeginRendering() {
 
 
 bool Context :: Begin(GLenum mode) {
+	// the compiled functions stay valid until End
+	m_FunctionCache.Enter();
 	PrepareRendering();
 	
 	switch (mode) {
 	case GL_POINTS:
 		m_Rasterizer->PreparePoint();
 		m_DrawPrimitiveFunction = &Context::DrawPoint;
-		m_EndPrimitiveFunction = 0;
+		m_EndPrimitiveFunction = &Context::EndPoint;
 		m_Rasterizer->BeginPoint();
+		ResetPointBatch();
 		break;
 
 	case GL_LINES:
@@ -504,6 +611,7 @@ bool Context :: Begin(GLenum mode) {
 		break;
 
 	default:
+		m_FunctionCache.Leave();
 		RecordError(GL_INVALID_ENUM);
 		return false;
 	}
@@ -519,6 +627,8 @@ void Context :: End() {
 
 	m_DrawPrimitiveFunction = 0;
 	m_EndPrimitiveFunction = 0;
+
+	m_FunctionCache.Leave();
 }
 
 void Context :: DrawArrays(GLenum mode, GLint first, GLsizei count) {
@@ -556,78 +666,87 @@ void Context :: DrawElements(GLenum mode, GLsizei count, GLenum type, const GLvo
 	}
 
 	if (m_CurrentElementArrayBuffer) {
-		U8 * bufferBase =
-			static_cast<U8 *>(m_Buffers.GetObject(m_CurrentElementArrayBuffer)->GetData());
+		Buffer * buffer = m_Buffers.GetObject(m_CurrentElementArrayBuffer);
 
-		if (!bufferBase) {
+		if (!buffer->GetData()) {
 			RecordError(GL_INVALID_OPERATION);
 			return;
 		}
 
 		size_t offset = static_cast<const U8 *>(indices) - static_cast<const U8 *>(0);
-		indices = bufferBase + offset;
+		indices = buffer->GetIndices(mode, count, type, offset);
 	}
 
 	if (!indices) {
 		return;
 	}
 
+	if (type != GL_UNSIGNED_BYTE && type != GL_UNSIGNED_SHORT) {
+		RecordError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (!Begin(mode)) {
+		return;
+	}
+
+	if (mode == GL_TRIANGLES) {
+		// indexed triangle lists share transformed vertices through the
+		// post-transform vertex cache
+		ResetVertexCache();
+		m_DrawPrimitiveFunction = &Context::DrawIndexedTriangle;
+	}
+
 	if (type == GL_UNSIGNED_BYTE) {
 		const GLubyte * ptr = reinterpret_cast<const GLubyte *>(indices);
 
-		if (Begin(mode)) {
-			while (count-- > 0) {
-				(this->*m_DrawPrimitiveFunction)(*ptr++);
-			}
-
-			End();
+		while (count-- > 0) {
+			(this->*m_DrawPrimitiveFunction)(*ptr++);
 		}
-	} else if (type == GL_UNSIGNED_SHORT) {
+	} else {
 		const GLushort * ptr = reinterpret_cast<const GLushort *>(indices);
 
-		if (Begin(mode)) {
-			while (count-- > 0) {
-				(this->*m_DrawPrimitiveFunction)(*ptr++);
-			}
-
-			End();
+		while (count-- > 0) {
+			(this->*m_DrawPrimitiveFunction)(*ptr++);
 		}
-	} else {
-		RecordError(GL_INVALID_ENUM);
 	}
+
+	End();
 }
 
 
-#if !EGL_USE_JIT
+#if !EGL_USE_JIT || EGL_USE_FLOAT_VERTEX
 // --------------------------------------------------------------------------
-// Load all the current coordinates from either a specific array or from
-// the common settings.
+// Load the normal, color and texture coordinates of a vertex from either a
+// specific array or from the common settings.
 //
 // Parameters:
 //	index		-	The array index from which any array coordinates should
 //					be retrieved.
 // --------------------------------------------------------------------------
-void Context :: SelectArrayElement(int index, Vertex * rasterPos) {
-
-	assert(m_VertexArray.effectivePointer);
-
-	{
-		// readly should have cases for size = 2, 3, 4
-		Vec4D currentVertex;
-
-		m_VertexArray.FetchValues(index, currentVertex.getArray());
-		m_ModelViewProjectionMatrix.Multiply(currentVertex, rasterPos->m_ClipCoords);
-
-		// do we need eye-coords (e.g. fog, light, or user-clipping)
-		m_ModelViewMatrixStack.CurrentMatrix().Multiply(currentVertex, rasterPos->m_EyeCoords);
-	}
+void Context :: SelectArrayAttributes(int index, Vertex * rasterPos) {
 
 	// do we need normals?
 	if (m_NormalArray.effectivePointer) {
-		Vec3D normal;
+#if EGL_USE_FLOAT_VERTEX
+		if (m_NormalArray.type == GL_FLOAT && !m_PaletteSkinning) {
+			float normal[3];
+
+			m_FloatInverseModelViewMatrix.Multiply3x3(
+				static_cast<const GLfloat *>(m_NormalArray.GetRowPointer(index)), normal);
+			rasterPos->m_EyeNormal = Vec3D(EGL_FixedFromFloat(normal[0]),
+										   EGL_FixedFromFloat(normal[1]),
+										   EGL_FixedFromFloat(normal[2]));
+		} else
+#endif
+		{
+			Vec3D normal;
 
-		m_NormalArray.FetchValues(index, normal.getArray());
-		rasterPos->m_EyeNormal = m_InverseModelViewMatrix.Multiply3x3(normal);
+			m_NormalArray.FetchValues(index, normal.getArray());
+			rasterPos->m_EyeNormal = m_VertexInverseModelViewMatrix->Multiply3x3(normal);
+		}
+	} else if (m_PaletteSkinning) {
+		rasterPos->m_EyeNormal = m_BlendedDefaultNormal;
 	} else {
 		rasterPos->m_EyeNormal = m_TransformedDefaultNormal;
 	}
@@ -667,10 +786,54 @@ void Context :: SelectArrayElement(int index, Vertex * rasterPos) {
 			}
 		}
 	}
+}
+#endif // !EGL_USE_JIT || EGL_USE_FLOAT_VERTEX
+
+
+#if !EGL_USE_JIT
+// --------------------------------------------------------------------------
+// Load all the current coordinates from either a specific array or from
+// the common settings.
+//
+// Parameters:
+//	index		-	The array index from which any array coordinates should
+//					be retrieved.
+// --------------------------------------------------------------------------
+void Context :: SelectArrayElement(int index, Vertex * rasterPos) {
+
+#if EGL_USE_FLOAT_VERTEX
+	if (m_FloatVertexPath) {
+		SelectArrayElementFloat(index, rasterPos);
+		return;
+	}
+#endif
+
+	assert(m_VertexArray.effectivePointer);
+
+	if (m_PaletteSkinning) {
+		BlendPaletteMatrices(index);
+	}
+
+	{
+		// readly should have cases for size = 2, 3, 4
+		Vec4D currentVertex;
+
+		m_VertexArray.FetchValues(index, currentVertex.getArray());
+		m_VertexModelViewProjectionMatrix->Multiply(currentVertex, rasterPos->m_ClipCoords);
+
+		// do we need eye-coords (e.g. fog, light, or user-clipping)
+		m_VertexModelViewMatrix->Multiply(currentVertex, rasterPos->m_EyeCoords);
+	}
+
+	SelectArrayAttributes(index, rasterPos);
 
 	if (rasterPos->m_ClipCoords.w() < 0) 
 		rasterPos->m_ClipCoords = -rasterPos->m_ClipCoords;
 
+#if EGL_USE_FLOAT_VERTEX
+	rasterPos->m_Float = 0;
+#endif
+
 	CalcCC(rasterPos);
 
 	rasterPos->m_Lit = Unlit;
@@ -678,6 +841,57 @@ void Context :: SelectArrayElement(int index, Vertex * rasterPos) {
 #endif // EGL_USE_JIT
 
 
+#if EGL_USE_FLOAT_VERTEX
+// --------------------------------------------------------------------------
+// Floating point variant of SelectArrayElement for GL_FLOAT vertex arrays.
+// The coordinates are transformed without prior conversion to fixed point;
+// the clip coordinates are retained as floating point values through
+// clipping and face culling until they are mapped to window coordinates
+// in ClipCoordsToWindowCoords. Eye coordinates are converted to fixed point
+// for lighting, fog and user clip planes.
+//
+// Parameters:
+//	index		-	The array index from which any array coordinates should
+//					be retrieved.
+// --------------------------------------------------------------------------
+void Context :: SelectArrayElementFloat(int index, Vertex * rasterPos) {
+
+	assert(m_VertexArray.effectivePointer);
+
+	const GLfloat * coords = static_cast<const GLfloat *>(m_VertexArray.GetRowPointer(index));
+	float * clip = rasterPos->m_FloatClipCoords;
+
+	m_FloatModelViewProjectionMatrix.Multiply(coords, m_VertexArray.size, clip);
+
+	if (clip[3] < 0) {
+		clip[0] = -clip[0];
+		clip[1] = -clip[1];
+		clip[2] = -clip[2];
+		clip[3] = -clip[3];
+	}
+
+	// m_ClipCoords is not written: clip coordinates outside the 16.16 range
+	// would overflow, and CalcCC, clipping and culling use the float values
+
+	// do we need eye-coords (e.g. fog, light, user-clipping or point size attenuation)
+	if (m_RenderState.NeedsEyeCoords || m_ClipPlaneEnabled || m_PointSizeAttenuate) {
+		float eye[4];
+
+		m_FloatModelViewMatrix.Multiply(coords, m_VertexArray.size, eye);
+		rasterPos->m_EyeCoords = Vec4D(EGL_FixedFromFloat(eye[0]), EGL_FixedFromFloat(eye[1]),
+									   EGL_FixedFromFloat(eye[2]), EGL_FixedFromFloat(eye[3]));
+	}
+
+	SelectArrayAttributes(index, rasterPos);
+
+	rasterPos->m_Float = 1;
+	CalcCC(rasterPos);
+
+	rasterPos->m_Lit = Unlit;
+}
+#endif // EGL_USE_FLOAT_VERTEX
+
+
 namespace {
 	void DumpVertices(size_t inputCount, Vertex * input[]) {
 		printf("Number of vertices: %d\n", inputCount);
@@ -793,21 +1007,46 @@ size_t Context :: ClipPrimitive(size_t inputCount, Vertex * input[], Vertex * ou
 					vinside = vprev; 
 				}
 
-				EGL_Fixed ci = vinside->m_ClipCoords[coord];
-				EGL_Fixed wi = vinside->m_ClipCoords.w();
-				EGL_Fixed co = voutside->m_ClipCoords[coord];
-				EGL_Fixed wo = voutside->m_ClipCoords.w();
+				Vertex & newVertex = *nextTemporary++;
 
-				if (!(plane & 1)) {
-					wi = -wi; wo = -wo;
-				}
+				I32 coeff;
 
-				EGL_Fixed num = wi - ci;
-				EGL_Fixed denom = co - ci - wo + wi;
+#if EGL_USE_FLOAT_VERTEX
+				if (vinside->m_Float & voutside->m_Float) {
+					float fci = vinside->m_FloatClipCoords[coord];
+					float fwi = vinside->m_FloatClipCoords[3];
+					float fco = voutside->m_FloatClipCoords[coord];
+					float fwo = voutside->m_FloatClipCoords[3];
 
-				Vertex & newVertex = *nextTemporary++;
+					if (!(plane & 1)) {
+						fwi = -fwi; fwo = -fwo;
+					}
+
+					float fcoeff = (fwi - fci) / (fco - fci - fwo + fwi);
+
+					if (fcoeff < 0.0f)
+						fcoeff = 0.0f;
+					else if (fcoeff > 1.0f)
+						fcoeff = 1.0f;
+
+					coeff = static_cast<I32>(fcoeff * static_cast<float>(1 << 28));
+				} else
+#endif
+				{
+					EGL_Fixed ci = vinside->m_ClipCoords[coord];
+					EGL_Fixed wi = vinside->m_ClipCoords.w();
+					EGL_Fixed co = voutside->m_ClipCoords[coord];
+					EGL_Fixed wo = voutside->m_ClipCoords.w();
+
+					if (!(plane & 1)) {
+						wi = -wi; wo = -wo;
+					}
 
-				I32 coeff = Coeff4q28(num, denom);
+					EGL_Fixed num = wi - ci;
+					EGL_Fixed denom = co - ci - wo + wi;
+
+					coeff = Coeff4q28(num, denom);
+				}
 
 				if (coeff < (1 << 27))
 					Interpolate(newVertex, *vinside, *voutside, coeff, numVarying);
@@ -847,6 +1086,39 @@ size_t Context :: ClipPrimitive(size_t inputCount, Vertex * input[], Vertex * ou
 
 void Context :: ClipCoordsToWindowCoords(Vertex & pos) {
 
+#if EGL_USE_FLOAT_VERTEX
+	if (pos.m_Float) {
+		// this is the boundary between the floating point vertex pipeline
+		// and the fixed point rasterizer
+		float x = pos.m_FloatClipCoords[0];
+		float y = pos.m_FloatClipCoords[1];
+		float z = pos.m_FloatClipCoords[2];
+		float w = pos.m_FloatClipCoords[3];
+
+		if (x < -w)	x = -w;
+		if (x > w)	x = w;
+		if (y < -w)	y = -w;
+		if (y > w)	y = w;
+		if (z < -w)	z = -w;
+		if (z > w)	z = w;
+
+		float invW = w > 0.0f ? 1.0f / w : 0.0f;
+
+		// 1/w is passed on as 4.28 value
+		float scaledInvW = invW * static_cast<float>(1 << 28);
+		pos.m_WindowCoords.invW = scaledInvW >= 2147483647.0f ? 0x7fffffff : static_cast<I32>(scaledInvW);
+
+		pos.m_WindowCoords.x = 
+			static_cast<I32>(x * invW * static_cast<float>(m_ViewportScale.x())) + m_ViewportOrigin.x();
+		pos.m_WindowCoords.y = 
+			static_cast<I32>(y * invW * static_cast<float>(m_ViewportScale.y())) + m_ViewportOrigin.y();
+		pos.m_WindowCoords.depth = 
+			EGL_CLAMP(static_cast<I32>(z * invW * static_cast<float>(m_DepthRangeFactor)) + m_DepthRangeBase, 0, 0xffff);
+
+		return;
+	}
+#endif
+
 	// perform depth division
 	EGL_Fixed x = pos.m_ClipCoords.x();
 	EGL_Fixed y = pos.m_ClipCoords.y();
@@ -923,5 +1195,6 @@ void Context :: ClipPlanex(GLenum plane, const GLfixed *equation) {
 	}
 
 	size_t index = plane - GL_CLIP_PLANE0;
+	UpdateFullInverseModelViewMatrix();
 	m_ClipPlanes[index] = m_FullInverseModelViewMatrix.Transpose() * Vec4D(equation);
 }
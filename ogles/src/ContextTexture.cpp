@@ -680,6 +680,9 @@ namespace {
 		U32 srcWidth = src->GetWidth();
 		U32 srcHeight = src->GetHeight();
 
+		// combine the samples of multisample surfaces
+		src->Resolve();
+
 		// ---------------------------------------------------------------------
 		// clip lower left corner
 		// ---------------------------------------------------------------------
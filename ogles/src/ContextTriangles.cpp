@@ -92,49 +92,68 @@ namespace {
 	inline EGL_Fixed Round(EGL_Fixed value) {
 		return (value + 8) >> 4;
 	}
-}
 
-void Context :: RenderTriangle(Vertex& a, Vertex& b, Vertex& c) {
+	// determine the orientation of a triangle from the clip coordinates of its vertices
+	inline bool IsClockwise(const Vertex& a, const Vertex& b, const Vertex& c) {
+#if EGL_USE_FLOAT_VERTEX
+		if (a.m_Float & b.m_Float & c.m_Float) {
+			const float * x = a.m_FloatClipCoords;
+			const float * y = b.m_FloatClipCoords;
+			const float * z = c.m_FloatClipCoords;
 
-	if (a.m_cc & b.m_cc & c.m_cc)
-		return;
+			double sign =
+				+ x[3] * (static_cast<double>(y[0]) * z[1] - static_cast<double>(z[0]) * y[1])
+				- y[3] * (static_cast<double>(x[0]) * z[1] - static_cast<double>(z[0]) * x[1])
+				+ z[3] * (static_cast<double>(x[0]) * y[1] - static_cast<double>(y[0]) * x[1]);
 
-	U8 mask = a.m_cc | b.m_cc | c.m_cc;
+			return sign < 0;
+		}
+#endif
 
-	EGL_Fixed x0 = a.m_ClipCoords.w();
-	EGL_Fixed x1 = a.m_ClipCoords.x();
-	EGL_Fixed x2 = a.m_ClipCoords.y();
+		EGL_Fixed x0 = a.m_ClipCoords.w();
+		EGL_Fixed x1 = a.m_ClipCoords.x();
+		EGL_Fixed x2 = a.m_ClipCoords.y();
 								
-	EGL_Fixed y0 = b.m_ClipCoords.w();
-	EGL_Fixed y1 = b.m_ClipCoords.x();
-	EGL_Fixed y2 = b.m_ClipCoords.y();
+		EGL_Fixed y0 = b.m_ClipCoords.w();
+		EGL_Fixed y1 = b.m_ClipCoords.x();
+		EGL_Fixed y2 = b.m_ClipCoords.y();
 								
-	EGL_Fixed z0 = c.m_ClipCoords.w();
-	EGL_Fixed z1 = c.m_ClipCoords.x();
-	EGL_Fixed z2 = c.m_ClipCoords.y();
+		EGL_Fixed z0 = c.m_ClipCoords.w();
+		EGL_Fixed z1 = c.m_ClipCoords.x();
+		EGL_Fixed z2 = c.m_ClipCoords.y();
 
-	bool cw;
-	I64 sign;
+		I64 sign;
 	
-	sign = 
-			+ (x0 >> 12) * (static_cast<I64>(y1 >> 12) * (z2 >> 12) - static_cast<I64>(z1 >> 12) * (y2 >> 12))
-			- (y0 >> 12) * (static_cast<I64>(x1 >> 12) * (z2 >> 12) - static_cast<I64>(z1 >> 12) * (x2 >> 12))
-			+ (z0 >> 12) * (static_cast<I64>(x1 >> 12) * (y2 >> 12) - static_cast<I64>(y1 >> 12) * (x2 >> 12));
-
-	if (sign <= -(1 << 6))
-		cw = true;
-	else if (sign >= (1 << 6))
-		cw = false;
-	else {
-		// This code assumes that truncation is handled properly, e.g. the sign is always correct,
-		// and the lower 63 bits are the properly truncated result of the overall product.
 		sign = 
-				+ x0 * (static_cast<I64>(y1) * z2 - static_cast<I64>(z1) * y2)
-				- y0 * (static_cast<I64>(x1) * z2 - static_cast<I64>(z1) * x2)
-				+ z0 * (static_cast<I64>(x1) * y2 - static_cast<I64>(y1) * x2);
-
-		cw = sign < 0;
+				+ (x0 >> 12) * (static_cast<I64>(y1 >> 12) * (z2 >> 12) - static_cast<I64>(z1 >> 12) * (y2 >> 12))
+				- (y0 >> 12) * (static_cast<I64>(x1 >> 12) * (z2 >> 12) - static_cast<I64>(z1 >> 12) * (x2 >> 12))
+				+ (z0 >> 12) * (static_cast<I64>(x1 >> 12) * (y2 >> 12) - static_cast<I64>(y1 >> 12) * (x2 >> 12));
+
+		if (sign <= -(1 << 6))
+			return true;
+		else if (sign >= (1 << 6))
+			return false;
+		else {
+			// This code assumes that truncation is handled properly, e.g. the sign is always correct,
+			// and the lower 63 bits are the properly truncated result of the overall product.
+			sign = 
+					+ x0 * (static_cast<I64>(y1) * z2 - static_cast<I64>(z1) * y2)
+					- y0 * (static_cast<I64>(x1) * z2 - static_cast<I64>(z1) * x2)
+					+ z0 * (static_cast<I64>(x1) * y2 - static_cast<I64>(y1) * x2);
+
+			return sign < 0;
+		}
 	}
+}
+
+void Context :: RenderTriangle(Vertex& a, Vertex& b, Vertex& c) {
+
+	if (a.m_cc & b.m_cc & c.m_cc)
+		return;
+
+	U8 mask = a.m_cc | b.m_cc | c.m_cc;
+
+	bool cw = IsClockwise(a, b, c);
 
 	bool backFace = cw ^ m_ReverseFaceOrientation;
 
@@ -217,6 +236,48 @@ void Context :: DrawTriangle(int index) {
 	}
 }
 
+// --------------------------------------------------------------------------
+// Post-transform vertex cache for indexed triangle lists
+//
+// The cache is a FIFO of EGL_VERTEX_CACHE_SIZE entries, which is the
+// configuration the index buffer optimizer in ContextBuffer.cpp is tuned
+// for. Entries are valid for the duration of a single DrawElements call.
+// --------------------------------------------------------------------------
+
+void Context :: ResetVertexCache() {
+	for (size_t slot = 0; slot < EGL_VERTEX_CACHE_SIZE; ++slot) {
+		m_VertexCacheIndex[slot] = -1;
+		InitVertexDefaults(m_VertexCache[slot]);
+	}
+
+	m_VertexCacheNext = 0;
+}
+
+Vertex * Context :: CachedArrayElement(int index) {
+	for (size_t slot = 0; slot < EGL_VERTEX_CACHE_SIZE; ++slot) {
+		if (m_VertexCacheIndex[slot] == index) {
+			return &m_VertexCache[slot];
+		}
+	}
+
+	Vertex * vertex = &m_VertexCache[m_VertexCacheNext];
+	m_VertexCacheIndex[m_VertexCacheNext] = index;
+	m_VertexCacheNext = (m_VertexCacheNext + 1) % EGL_VERTEX_CACHE_SIZE;
+
+	SelectArrayElement(index, vertex);
+
+	return vertex;
+}
+
+void Context :: DrawIndexedTriangle(int index) {
+	m_IndexedInput[m_NextIndex] = CachedArrayElement(index);
+
+	if (++m_NextIndex == 3) {
+		RenderTriangle(*m_IndexedInput[0], *m_IndexedInput[1], *m_IndexedInput[2]);
+		m_NextIndex = 0;
+	}
+}
+
 void Context :: DrawTriangleStrip(int index) {
 	SelectArrayElement(index, &m_Input[m_NextIndex]);
 
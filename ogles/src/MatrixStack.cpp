@@ -45,20 +45,28 @@ using namespace EGL;
 
 MatrixStack :: MatrixStack(I32 maxStackElements)
 :	m_StackSize(maxStackElements),
-	m_StackPointer(0)
+	m_StackPointer(0),
+	m_Epoch(0)
 {
 	m_Stack = new Matrix4x4[maxStackElements];
+#if EGL_USE_FLOAT_VERTEX
+	m_FloatStack = new Matrix4x4f[maxStackElements];
+#endif
 }
 
 
 MatrixStack :: ~MatrixStack() {
 	delete[] m_Stack;
+#if EGL_USE_FLOAT_VERTEX
+	delete[] m_FloatStack;
+#endif
 }
 
 
 bool MatrixStack :: PopMatrix(void) {
 	if (m_StackPointer > 0) {
 		--m_StackPointer;
+		++m_Epoch;
 		return true;
 	} else {
 		return false;
@@ -70,6 +78,9 @@ bool MatrixStack :: PushMatrix(void) {
 
 	if (m_StackPointer < m_StackSize - 1) {
 		m_Stack[m_StackPointer + 1] = m_Stack[m_StackPointer];
+#if EGL_USE_FLOAT_VERTEX
+		m_FloatStack[m_StackPointer + 1] = m_FloatStack[m_StackPointer];
+#endif
 		++m_StackPointer;
 		return true;
 	} else {
@@ -79,15 +90,43 @@ bool MatrixStack :: PushMatrix(void) {
 
 
 void MatrixStack :: MultMatrix(const Matrix4x4& matrix) {
-	LoadMatrix(CurrentMatrix() * matrix);
+#if EGL_USE_FLOAT_VERTEX
+	m_FloatStack[m_StackPointer] = m_FloatStack[m_StackPointer] * Matrix4x4f(matrix);
+#endif
+	CurrentMatrix() = CurrentMatrix() * matrix;
+	++m_Epoch;
 }
 
 
 void MatrixStack :: LoadIdentity(void) {
 	CurrentMatrix().MakeIdentity();
+#if EGL_USE_FLOAT_VERTEX
+	m_FloatStack[m_StackPointer].MakeIdentity();
+#endif
+	++m_Epoch;
 }
 
 
 void MatrixStack :: LoadMatrix(const Matrix4x4& matrix) {
 	CurrentMatrix() = matrix;
+#if EGL_USE_FLOAT_VERTEX
+	m_FloatStack[m_StackPointer] = matrix;
+#endif
+	++m_Epoch;
 }
+
+
+#if EGL_USE_FLOAT_VERTEX
+
+void MatrixStack :: MultMatrix(const Matrix4x4f& matrix) {
+	LoadMatrix(m_FloatStack[m_StackPointer] * matrix);
+}
+
+
+void MatrixStack :: LoadMatrix(const Matrix4x4f& matrix) {
+	m_FloatStack[m_StackPointer] = matrix;
+	CurrentMatrix() = matrix.ToFixed();
+	++m_Epoch;
+}
+
+#endif
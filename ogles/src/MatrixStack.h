@@ -66,6 +66,20 @@ namespace EGL {
 			return m_Stack[m_StackPointer];
 		}
 
+#if EGL_USE_FLOAT_VERTEX
+		// ----------------------------------------------------------------------
+		// Each matrix has a floating point counterpart for the floating point
+		// vertex pipeline. Operations given in floating point are carried out
+		// on it, and the fixed point matrix is derived from the result.
+		// ----------------------------------------------------------------------
+		void MultMatrix(const Matrix4x4f &matrix);
+		void LoadMatrix(const Matrix4x4f &matrix);
+
+		inline const Matrix4x4f & CurrentFloatMatrix() const {
+			return m_FloatStack[m_StackPointer];
+		}
+#endif
+
 		inline I32 GetStackSize() const {
 			return m_StackSize;
 		}
@@ -74,11 +88,23 @@ namespace EGL {
 			return m_StackPointer + 1;
 		}
 
+		// ----------------------------------------------------------------------
+		// The epoch is advanced whenever the current matrix may have changed;
+		// it allows for lazy recomputation of derived matrices.
+		// ----------------------------------------------------------------------
+		inline U32 GetEpoch() const {
+			return m_Epoch;
+		}
+
 	private:
 
 		Matrix4x4	*m_Stack;
+#if EGL_USE_FLOAT_VERTEX
+		Matrix4x4f	*m_FloatStack;
+#endif
 		I32			m_StackPointer;
 		I32			m_StackSize;
+		U32			m_Epoch;
 	};
 }
 
@@ -71,6 +71,75 @@
 #	define EGL_USE_JIT  0
 #endif
 
+// compile the functions of the triangle block pipeline on a background
+// thread. Meanwhile, triangles are rasterized by the C block functions,
+// whose results differ from the compiled code in the low bits of colors and
+// texture coordinates, so a frame may show both; off unless requested.
+#ifndef EGL_USE_ASYNC_JIT
+#	define EGL_USE_ASYNC_JIT	0
+#endif
+
+#if !EGL_USE_JIT
+#	undef EGL_USE_ASYNC_JIT
+#	define EGL_USE_ASYNC_JIT	0
+#endif
+
+// the C block functions rasterize triangles without the JIT, and stand in
+// for the functions that the asynchronous JIT has not compiled yet
+#define EGL_USE_C_BLOCK_FUNCTIONS	(!EGL_USE_JIT || EGL_USE_ASYNC_JIT)
+
+// share the compiled functions between the contexts of a process; this
+// needs the synchronization primitives of the platform
+#ifndef EGL_USE_SHARED_FUNCTION_CACHE
+#	if defined(EGL_ON_WINCE)
+#		define EGL_USE_SHARED_FUNCTION_CACHE	1
+#	else
+#		define EGL_USE_SHARED_FUNCTION_CACHE	0
+#	endif
+#endif
+
+
+// use a floating point vertex pipeline for GL_FLOAT vertex arrays; this only
+// pays off on hosts that have a hardware floating point unit
+#ifndef EGL_USE_FLOAT_VERTEX
+#	if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__) || \
+	   (defined(__VFP_FP__) && !defined(__SOFTFP__))
+#		define EGL_USE_FLOAT_VERTEX	1
+#	else
+#		define EGL_USE_FLOAT_VERTEX	0
+#	endif
+#endif
+
+// use SSE for the floating point matrix kernels
+#ifndef EGL_USE_SSE
+#	if EGL_USE_FLOAT_VERTEX && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#		define EGL_USE_SSE			1
+#	else
+#		define EGL_USE_SSE			0
+#	endif
+#endif
+
+// use SSE2 for the block kernels of the C rasterizer and the fixed point
+// matrix kernels
+#ifndef EGL_USE_SSE2
+#	if !EGL_USE_JIT && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#		define EGL_USE_SSE2			1
+#	else
+#		define EGL_USE_SSE2			0
+#	endif
+#endif
+
+// use NEON for the fixed point matrix kernels
+#ifndef EGL_USE_NEON
+#	if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#		define EGL_USE_NEON			1
+#	else
+#		define EGL_USE_NEON			0
+#	endif
+#endif
+
+#define EGL_USE_SIMD_MATRIX			(EGL_USE_SSE2 || EGL_USE_NEON)
+
 
 #ifndef EGL_RELEASE
 #	define EGL_RELEASE				"1.0.0"
@@ -82,13 +151,23 @@
 #else
 #	define EGL_CONFIG_VERSION			"OpenGL ES-CM 1.1"
 #endif
+// extensions that only exist with generated code
+#if EGL_USE_JIT
+#	define EGL_JIT_EXTENSIONS		" GL_VIN_jit_profile"
+#else
+#	define EGL_JIT_EXTENSIONS		""
+#endif
+
 #define EGL_CONFIG_EXTENSIONS		"GL_OES_fixed_point "\
 									"GL_OES_single_precision "\
 									"GL_OES_read_format "\
 									"GL_OES_query_matrix "\
 									"GL_OES_point_size_array "\
+									"GL_OES_matrix_palette "\
 									"GL_OES_point_sprite "\
-									"GL_OES_compressed_paletted_texture"
+									"GL_OES_compressed_paletted_texture "\
+									"GL_VIN_index_buffer_optimize"\
+									EGL_JIT_EXTENSIONS
 
 #	define EGL_CONFIG_RENDERER		"Software"
 
@@ -111,8 +190,30 @@
 #define EGL_LOG_RASTER_BLOCK_SIZE	3
 #define EGL_RASTER_BLOCK_SIZE		(1 << EGL_LOG_RASTER_BLOCK_SIZE)
 
-// minimum triangle area for perspective interpolation; value in 24.8
-#define EGL_MIN_TRIANGLE_PERSPECTIVE	0x400
+// number of samples per pixel of multisample surfaces
+#define EGL_NUM_SAMPLES				4
+
+// number of entries in the post-transform vertex cache used for indexed
+// triangle lists; the index buffer optimizer targets the same FIFO size
+#define EGL_VERTEX_CACHE_SIZE		16
+
+// screen space error of affine interpolation tolerated for each value of
+// GL_PERSPECTIVE_CORRECTION_HINT before a triangle is interpolated with
+// perspective correction; values in pixels as 16.16
+#define EGL_PERSPECTIVE_ERROR_FASTEST	0x20000
+#define EGL_PERSPECTIVE_ERROR_DONT_CARE	0x8000
+#define EGL_PERSPECTIVE_ERROR_NICEST	0x1000
+
+// triangles covering at least this many pixels are set up in blocks of 2x2
+// raster blocks; triangles covering fewer pixels prune the quadrants of each
+// raster block against their edges
+#define EGL_LARGE_TRIANGLE_AREA		1024
+#define EGL_SMALL_TRIANGLE_AREA		32
+
+// collect a histogram of the rasterized triangles by size
+#ifndef EGL_RASTER_STATISTICS
+#	define EGL_RASTER_STATISTICS	0
+#endif
 
 // --------------------------------------------------------------------------
 // type definitions
@@ -227,8 +227,12 @@ void RasterInfo::Init(Surface * surface, I32 y, I32 x) {
 		assert(false);
 	}
 
-	RasterSurface.ColorBuffer = surface->GetColorBuffer() + (offset << RasterSurface.ColorOffsetShift);	
+	// multisample surfaces are rendered into the first sample plane
+	RasterSurface.ColorBuffer = surface->GetSampleColorBuffer() + (offset << RasterSurface.ColorOffsetShift);	
 	RasterSurface.DepthStencilBuffer = surface->GetDepthStencilBuffer() + (depthStencilOffset << RasterSurface.DepthStencilOffsetShift);
+	RasterSurface.Samples = surface->GetSamples();
+	RasterSurface.SampleColorStride = surface->GetSampleColorStride();
+	RasterSurface.SampleDepthStencilStride = surface->GetSampleDepthStencilStride();
 
 	InversionTablePtr = InversionTable;
 }
@@ -240,8 +244,17 @@ void RasterInfo::Init(Surface * surface, I32 y, I32 x) {
 
 Rasterizer :: Rasterizer(RasterizerState * state, FunctionCache * cache):
 	m_State(state),
-	m_FunctionCache(cache)
+	m_FunctionCache(cache),
+	m_LineQuads(false),
+	m_MipmapPerQuad(true)
 {
+#if EGL_USE_JIT
+	m_CompiledBlockFunctions = false;
+#endif
+
+#if EGL_RASTER_STATISTICS
+	ResetTriangleStatistics();
+#endif
 }
 
 
@@ -263,6 +276,13 @@ RasterizerState * Rasterizer :: GetState() const {
 }
 
 
+#if EGL_RASTER_STATISTICS
+void Rasterizer :: ResetTriangleStatistics() {
+	memset(&m_TriangleStatistics, 0, sizeof(m_TriangleStatistics));
+}
+#endif
+
+
 void Rasterizer :: SetTexture(size_t unit, MultiTexture * texture) {
 	m_Texture[unit] = texture;
 }
@@ -317,6 +337,8 @@ void Rasterizer :: AllocateVaryings() {
 				case ColorFormatRGBA4444:
 				case ColorFormatRGBA5551:
 					break;
+				default:
+					break;
 				}
 
 				break;
@@ -473,6 +495,8 @@ void Rasterizer :: AllocateVaryings() {
 
 				break;
 
+			default:
+				break;
 			}
 		}
 	}
@@ -545,9 +569,19 @@ void Rasterizer :: PrepareTexture() {
 
 void Rasterizer :: Prepare() {
 	PrepareTexture();
+
+#if EGL_USE_C_BLOCK_FUNCTIONS
+	PrepareColorRow();
+	PrepareShade();
+#endif
 }
 
-#if !EGL_USE_JIT
+#if EGL_USE_C_BLOCK_FUNCTIONS
+
+// --------------------------------------------------------------------------
+// Fragment stages of the C rasterizer; with the asynchronous JIT, the C
+// block functions stand in for the compiled ones while those are compiled
+// --------------------------------------------------------------------------
 
 inline void Rasterizer :: Fragment(I32 x, I32 y, U32 depth, EGL_Fixed tu[], EGL_Fixed tv[],
 								   EGL_Fixed fogDensity, const Color& baseColor, EGL_Fixed coverage) {
@@ -560,16 +594,35 @@ inline void Rasterizer :: Fragment(I32 x, I32 y, U32 depth, EGL_Fixed tu[], EGL_
 
 	// fragment level clipping (for now)
 	if (m_State->m_ScissorTest.Enabled) {
-		if (x < m_State->m_ScissorTest.X || x - m_State->m_ScissorTest.X >= m_State->m_ScissorTest.Width ||
-			y < m_State->m_ScissorTest.Y || y - m_State->m_ScissorTest.Y >= m_State->m_ScissorTest.Height) {
+		if (x < m_State->m_ScissorTest.X || static_cast<U32>(x - m_State->m_ScissorTest.X) >= m_State->m_ScissorTest.Width ||
+			y < m_State->m_ScissorTest.Y || static_cast<U32>(y - m_State->m_ScissorTest.Y) >= m_State->m_ScissorTest.Height) {
 			return;
 		}
 	}
 
 	m_RasterInfo.Init(m_Surface, y, x);
 
-	if (FragmentDepthStencil(&m_RasterInfo, &m_RasterInfo.RasterSurface, 0, depth)) {
-		FragmentColorAlpha(&m_RasterInfo, &m_RasterInfo.RasterSurface, 0, tu, tv, baseColor, fogDensity, coverage);
+	// the fragment covers all samples of the pixel; it is shaded once for
+	// the samples that pass the depth and stencil tests
+	SurfaceInfo surfaceInfo = m_RasterInfo.RasterSurface;
+	const U8 * dither = DitherRow(y);
+	bool shaded = false, visible = false;
+	Color color;
+
+	for (U32 sample = 0; sample < surfaceInfo.Samples; ++sample) {
+		if (FragmentDepthStencil(&m_RasterInfo, &surfaceInfo, 0, depth)) {
+			if (!shaded) {
+				shaded = true;
+				visible = FragmentShade(tu, tv, baseColor, fogDensity, coverage, color);
+			}
+
+			if (visible) {
+				FragmentColorOutput(&surfaceInfo, 0, color, dither ? dither + (x & 3) : 0);
+			}
+		}
+
+		surfaceInfo.ColorBuffer += surfaceInfo.SampleColorStride;
+		surfaceInfo.DepthStencilBuffer += surfaceInfo.SampleDepthStencilStride;
 	}
 }
 
@@ -751,7 +804,6 @@ U32 Rasterizer :: UpdateStencilValue(RasterizerState::StencilOp op, U32 stencilV
 }
 
 void Rasterizer::WriteDepthStencil(void * depthStencilAddr, U32 oldDepth, U32 newDepth, U32 oldStencil, U32 newStencil) {
-	int stencilBits;
 	U32 stencilBitMask, stencilWriteMask = m_State->GetStencilMask();
 	U32 depthWriteMask = m_State->GetDepthMask() ? 0xffffffff : 0;
 	int stencilShift, depthShift;
@@ -762,7 +814,6 @@ void Rasterizer::WriteDepthStencil(void * depthStencilAddr, U32 oldDepth, U32 ne
 		return;
 
 	case DepthStencilFormatDepth16:
-		stencilBits = 0;
 		stencilBitMask = 0;
 		stencilWriteMask = 0;
 		depthWriteMask &= 0xffff;
@@ -771,7 +822,6 @@ void Rasterizer::WriteDepthStencil(void * depthStencilAddr, U32 oldDepth, U32 ne
 		break;
 
 	case DepthStencilFormatDepth16Stencil16:
-		stencilBits = 16;
 		stencilBitMask = 0xffff;
 		stencilWriteMask &= stencilBitMask;
 		depthWriteMask &= 0xffff;
@@ -926,6 +976,42 @@ bool Rasterizer::FragmentDepthStencil(const RasterInfo * rasterInfo,
 }
 
 namespace {
+	// thresholds of the 4x4 ordered dither matrix, each row repeated across
+	// the width of a block; blocks are aligned to the dither matrix
+	const U8 DitherMatrix[4][EGL_RASTER_BLOCK_SIZE] = {
+		{  0,  8,  2, 10,  0,  8,  2, 10 },
+		{ 12,  4, 14,  6, 12,  4, 14,  6 },
+		{  3, 11,  1,  9,  3, 11,  1,  9 },
+		{ 15,  7, 13,  5, 15,  7, 13,  5 },
+	};
+
+	// add the dither offset for a component that is truncated to the given
+	// number of bits; the value is scaled down first so the sum cannot
+	// exceed 255, which also leaves exact 8 bit expansions of stored values
+	// unchanged
+	inline U16 DitherLane(U16 value, U32 threshold, I32 bits) {
+		return value - (value >> bits) + ((threshold << 4) >> bits);
+	}
+
+	Color DitherColor(const Color& color, U32 threshold, ColorFormat format) {
+		switch (format) {
+		case ColorFormatRGBA4444:
+			return Color(DitherLane(color.R(), threshold, 4), DitherLane(color.G(), threshold, 4),
+						 DitherLane(color.B(), threshold, 4), DitherLane(color.A(), threshold, 4));
+
+		case ColorFormatRGBA5551:
+			return Color(DitherLane(color.R(), threshold, 5), DitherLane(color.G(), threshold, 5),
+						 DitherLane(color.B(), threshold, 5), DitherLane(color.A(), threshold, 1));
+
+		case ColorFormatRGB565:
+			return Color(DitherLane(color.R(), threshold, 5), DitherLane(color.G(), threshold, 6),
+						 DitherLane(color.B(), threshold, 5), color.A());
+
+		default:
+			return color;
+		}
+	}
+
 	Color FetchColor(const SurfaceInfo * surfaceInfo, size_t offset) {
 		switch (surfaceInfo->ColorFormat) {
 		case ColorFormatRGBA4444:
@@ -971,14 +1057,14 @@ namespace {
 	}
 }
 
-void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
-									const SurfaceInfo * surfaceInfo,
-									U32 offset, EGL_Fixed tu[], EGL_Fixed tv[],
-									const Color& baseColor, EGL_Fixed fog, 
-									EGL_Fixed coverage)
-	// fragment rendering with signature corresponding to function fragment
-	// generated by code generator
-{
+const U8 * Rasterizer :: DitherRow(I32 y) const {
+	return m_State->m_DitherEnabled ? DitherMatrix[y & 3] : 0;
+}
+
+
+bool Rasterizer::FragmentShade(EGL_Fixed tu[], EGL_Fixed tv[],
+							   const Color& baseColor, EGL_Fixed fog,
+							   EGL_Fixed coverage, Color& result) {
 	Color color(baseColor);
 
 	// have offset, color, texOffset, texture
@@ -1086,6 +1172,8 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 				case RasterizerState::TextureModeCombineSubtract:
 					combineAlpha = SubU8(arg[0].a, arg[1].a, scaleAlpha);
 					break;
+				default:
+					break;
 				}
 
 				EGL_Fixed scaleRGB = m_State->m_Texture[unit].ScaleRGB;
@@ -1175,6 +1263,8 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 							case RasterizerState::TextureModeAdd:
 								color = Color(color.r, color.g, color.b, MulU8(color.a, texColor.a));
 								break;
+							default:
+								break;
 						}
 						break;
 
@@ -1207,6 +1297,8 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 										ClampU8(color.b + texColor.b),
 										color.a);
 								break;
+							default:
+								break;
 						}
 						break;
 
@@ -1240,6 +1332,8 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 										ClampU8(color.b + texColor.b),
 										color.a);
 								break;
+							default:
+								break;
 						}
 						break;
 
@@ -1279,6 +1373,8 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 										ClampU8(color.b + texColor.b),
 										MulU8(color.a, texColor.a));
 								break;
+							default:
+								break;
 						}
 						break;
 
@@ -1320,6 +1416,8 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 										ClampU8(color.b + texColor.b),
 										MulU8(color.a, texColor.a));
 								break;
+							default:
+								break;
 						}
 						break;
 				}
@@ -1353,11 +1451,17 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 		}
 
 		if (!alphaTest) {
-			return;
+			return false;
 		}
 	}
 
-	// have color, offset
+	result = color;
+	return true;
+}
+
+
+void Rasterizer::FragmentColorOutput(const SurfaceInfo * surfaceInfo, U32 offset,
+									 Color color, const U8 * dither) {
 
 	// Blending
 	if (m_State->m_Blend.Enabled) {
@@ -1452,6 +1556,10 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 	Color maskedColor =
 		color.Mask(m_State->m_Mask.Red, m_State->m_Mask.Green, m_State->m_Mask.Blue, m_State->m_Mask.Alpha);
 
+	if (dither) {
+		maskedColor = DitherColor(maskedColor, dither[offset], surfaceInfo->ColorFormat);
+	}
+
 	if (m_State->m_LogicOp.Enabled) {
 
 		U32 oldValue = FetchColor(surfaceInfo, offset).ConvertToRGBA();
@@ -1532,7 +1640,465 @@ void Rasterizer::FragmentColorAlpha(const RasterInfo * rasterInfo,
 	}
 }
 
-#endif // !EGL_USE_JIT
+
+// --------------------------------------------------------------------------
+// Color output of a row of a block
+//
+// The row functions unpack the source colors and the destination pixels of
+// a row into 16-bit lanes per component, combine the lanes, and pack and
+// store the pixels selected by the row mask. They cover the common
+// combinations of color format and blend function without logic operation
+// and color mask; FragmentColorOutput handles all other cases per pixel.
+// The arithmetic, including dithering, matches FragmentColorOutput bit for
+// bit.
+// --------------------------------------------------------------------------
+
+namespace {
+
+	// a row of colors with one lane per pixel and component
+	struct ColorLanes {
+		U16		r[EGL_RASTER_BLOCK_SIZE];
+		U16		g[EGL_RASTER_BLOCK_SIZE];
+		U16		b[EGL_RASTER_BLOCK_SIZE];
+		U16		a[EGL_RASTER_BLOCK_SIZE];
+	};
+
+	inline U16 MulLane(U16 color, U16 factor) {
+		U16 prod = color * factor;
+
+		return (prod + (prod >> 7)) >> 8;
+	}
+
+	inline U16 ClampLane(U16 value) {
+		return value > Color::MAX ? (U16) Color::MAX : value;
+	}
+
+	struct Pixel565 {
+		typedef U16 Type;
+
+		static void Unpack(const U16 * pixels, PixelMask mask, ColorLanes & lanes) {
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+				U16 u565 = (mask & (1u << ix)) ? pixels[ix] : 0;
+				U16 r = (u565 & 0xF800u) >> 8;
+				U16 g = (u565 & 0x07E0u) >> 3;
+				U16 b = (u565 & 0x001Fu) << 3;
+
+				lanes.r[ix] = r | (r >> 5);
+				lanes.g[ix] = g | (g >> 6);
+				lanes.b[ix] = b | (b >> 5);
+				lanes.a[ix] = Color::MAX;
+			}
+		}
+
+		static void Dither(ColorLanes & lanes, const U8 * dither) {
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+				lanes.r[ix] = DitherLane(lanes.r[ix], dither[ix], 5);
+				lanes.g[ix] = DitherLane(lanes.g[ix], dither[ix], 6);
+				lanes.b[ix] = DitherLane(lanes.b[ix], dither[ix], 5);
+			}
+		}
+
+		static void Pack(const ColorLanes & lanes, PixelMask mask, U16 * pixels) {
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+				if (mask & (1u << ix)) {
+					pixels[ix] = (lanes.b[ix] & 0xF8) >> 3 | (lanes.g[ix] & 0xFC) << 3 | (lanes.r[ix] & 0xF8) << 8;
+				}
+			}
+		}
+	};
+
+	struct PixelRGBA8 {
+		typedef U32 Type;
+
+		static void Unpack(const U32 * pixels, PixelMask mask, ColorLanes & lanes) {
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+				U32 rgba = (mask & (1u << ix)) ? pixels[ix] : 0;
+
+				lanes.r[ix] = (rgba >> 24) & 0xff;
+				lanes.g[ix] = (rgba >> 16) & 0xff;
+				lanes.b[ix] = (rgba >>  8) & 0xff;
+				lanes.a[ix] =  rgba        & 0xff;
+			}
+		}
+
+		static void Dither(ColorLanes &, const U8 *) {
+		}
+
+		static void Pack(const ColorLanes & lanes, PixelMask mask, U32 * pixels) {
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+				if (mask & (1u << ix)) {
+					pixels[ix] = lanes.r[ix] << 24 | lanes.g[ix] << 16 | lanes.b[ix] << 8 | lanes.a[ix];
+				}
+			}
+		}
+	};
+
+	// no blending: the source replaces the destination
+	struct BlendOpaque {
+		enum { ReadsDestination = 0 };
+
+		static void Apply(const ColorLanes & src, ColorLanes & dst) {
+			dst = src;
+		}
+	};
+
+	// GL_ONE, GL_ONE
+	struct BlendAdditive {
+		enum { ReadsDestination = 1 };
+
+		static void Apply(const ColorLanes & src, ColorLanes & dst) {
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+				dst.r[ix] = ClampLane(src.r[ix] + dst.r[ix]);
+				dst.g[ix] = ClampLane(src.g[ix] + dst.g[ix]);
+				dst.b[ix] = ClampLane(src.b[ix] + dst.b[ix]);
+				dst.a[ix] = ClampLane(src.a[ix] + dst.a[ix]);
+			}
+		}
+	};
+
+	// GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+	struct BlendAlpha {
+		enum { ReadsDestination = 1 };
+
+		static void Apply(const ColorLanes & src, ColorLanes & dst) {
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+				U16 alpha = src.a[ix], oneMinusAlpha = Color::MAX - src.a[ix];
+
+				dst.r[ix] = ClampLane(MulLane(alpha, src.r[ix]) + MulLane(oneMinusAlpha, dst.r[ix]));
+				dst.g[ix] = ClampLane(MulLane(alpha, src.g[ix]) + MulLane(oneMinusAlpha, dst.g[ix]));
+				dst.b[ix] = ClampLane(MulLane(alpha, src.b[ix]) + MulLane(oneMinusAlpha, dst.b[ix]));
+				dst.a[ix] = ClampLane(MulLane(alpha, src.a[ix]) + MulLane(oneMinusAlpha, dst.a[ix]));
+			}
+		}
+	};
+
+	template <class Pixel, class Blend>
+	void ColorRow(const SurfaceInfo * surfaceInfo, const Color * colors, const U8 * dither,
+				  PixelMask mask) {
+		typename Pixel::Type * pixels = reinterpret_cast<typename Pixel::Type *>(surfaceInfo->ColorBuffer);
+		ColorLanes src, dst;
+
+		for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+			src.r[ix] = colors[ix].R();
+			src.g[ix] = colors[ix].G();
+			src.b[ix] = colors[ix].B();
+			src.a[ix] = colors[ix].A();
+		}
+
+		if (Blend::ReadsDestination) {
+			Pixel::Unpack(pixels, mask, dst);
+		}
+
+		Blend::Apply(src, dst);
+
+		if (dither) {
+			Pixel::Dither(dst, dither);
+		}
+
+		Pixel::Pack(dst, mask, pixels);
+	}
+}
+
+
+void Rasterizer :: PrepareColorRow() {
+	m_ColorRowFunction = 0;
+
+	if (m_State->m_LogicOp.Enabled ||
+		!m_State->m_Mask.Red || !m_State->m_Mask.Green || !m_State->m_Mask.Blue || !m_State->m_Mask.Alpha) {
+		return;
+	}
+
+	enum { Opaque, Additive, Alpha, Other } blend = Opaque;
+
+	if (m_State->m_Blend.Enabled) {
+		if (m_State->m_Blend.FuncSrc == RasterizerState::BlendFuncSrcOne &&
+			m_State->m_Blend.FuncDst == RasterizerState::BlendFuncDstOne) {
+			blend = Additive;
+		} else if (m_State->m_Blend.FuncSrc == RasterizerState::BlendFuncSrcSrcAlpha &&
+			m_State->m_Blend.FuncDst == RasterizerState::BlendFuncDstOneMinusSrcAlpha) {
+			blend = Alpha;
+		} else {
+			blend = Other;
+		}
+	}
+
+	switch (m_State->GetColorFormat()) {
+	case ColorFormatRGB565:
+		switch (blend) {
+		case Opaque:	m_ColorRowFunction = &ColorRow<Pixel565, BlendOpaque>;		break;
+		case Additive:	m_ColorRowFunction = &ColorRow<Pixel565, BlendAdditive>;	break;
+		case Alpha:		m_ColorRowFunction = &ColorRow<Pixel565, BlendAlpha>;		break;
+		default:																	break;
+		}
+
+		break;
+
+	case ColorFormatRGBA8:
+		switch (blend) {
+		case Opaque:	m_ColorRowFunction = &ColorRow<PixelRGBA8, BlendOpaque>;	break;
+		case Additive:	m_ColorRowFunction = &ColorRow<PixelRGBA8, BlendAdditive>;	break;
+		case Alpha:		m_ColorRowFunction = &ColorRow<PixelRGBA8, BlendAlpha>;		break;
+		default:																	break;
+		}
+
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+void Rasterizer :: ColorRowOutput(const SurfaceInfo * surfaceInfo, const Color * colors,
+								  const U8 * dither, PixelMask mask) {
+	if (m_ColorRowFunction) {
+		m_ColorRowFunction(surfaceInfo, colors, dither, mask);
+	} else {
+		for (I32 ix = 0; mask; ++ix, mask >>= 1) {
+			if (mask & 1) {
+				FragmentColorOutput(surfaceInfo, ix, colors[ix], dither);
+			}
+		}
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// Specialized shading of the C block rasterizer
+//
+// The shade functions below compute the color of a pixel of a quad for the
+// common state combinations: untextured, or a single RGB565 or RGBA8
+// texture with nearest or linear filtering, repeat or clamp to edge
+// wrapping and modulate or replace texture environment, all without fog
+// and alpha test. Each combination is a template instance; PrepareShade
+// selects it from a table indexed by the state, and QuadFragmentShade
+// falls back to FragmentShade for all other state. The arithmetic matches
+// FragmentShade bit for bit.
+// --------------------------------------------------------------------------
+
+namespace {
+
+	struct TexelRGB565 {
+		static Color Fetch(const void * data, I32 offset) {
+			return Color::From565(reinterpret_cast<const U16 *>(data)[offset]);
+		}
+
+		static Color Replace(const Color & color, const Color & texColor) {
+			return Color(texColor.r, texColor.g, texColor.b, color.a);
+		}
+
+		static Color Modulate(const Color & color, const Color & texColor) {
+			return Color(MulU8(color.r, texColor.r), MulU8(color.g, texColor.g),
+						 MulU8(color.b, texColor.b), color.a);
+		}
+	};
+
+	struct TexelRGBA8 {
+		static Color Fetch(const void * data, I32 offset) {
+			const U8 * ptr = reinterpret_cast<const U8 *>(data) + (offset << 2);
+			return Color(ptr[0], ptr[1], ptr[2], ptr[3]);
+		}
+
+		static Color Replace(const Color &, const Color & texColor) {
+			return texColor;
+		}
+
+		static Color Modulate(const Color & color, const Color & texColor) {
+			return color * texColor;
+		}
+	};
+
+	struct WrapRepeat {
+		static EGL_Fixed Apply(EGL_Fixed coord) {
+			return coord & 0xffff;
+		}
+	};
+
+	struct WrapClampToEdge {
+		static EGL_Fixed Apply(EGL_Fixed coord) {
+			return coord < 0 ? 0 : coord >= EGL_ONE ? EGL_ONE - 1 : coord;
+		}
+	};
+
+	struct FilterNearest {
+		enum { Linear = 0 };
+	};
+
+	struct FilterLinear {
+		enum { Linear = 1 };
+	};
+
+	struct EnvReplace {
+		enum { Modulates = 0 };
+	};
+
+	struct EnvModulate {
+		enum { Modulates = 1 };
+	};
+
+	template <class Texel, class Wrap>
+	inline Color FetchNearest(const Texture * texture, EGL_Fixed tu, EGL_Fixed tv) {
+		I32 texX = EGL_IntFromFixed(texture->GetWidth() * Wrap::Apply(tu));
+		I32 texY = EGL_IntFromFixed(texture->GetHeight() * Wrap::Apply(tv));
+
+		return Texel::Fetch(texture->GetData(), texX + (texY << texture->GetLogWidth()));
+	}
+
+	template <class Texel, class Wrap>
+	inline Color FetchLinear(const Texture * texture, EGL_Fixed tu, EGL_Fixed tv) {
+		I32 logWidth = texture->GetLogWidth();
+		I32 logHeight = texture->GetLogHeight();
+
+		EGL_Fixed tu0 = tu - (0x8000 >> logWidth);
+		EGL_Fixed tu1 = tu + (0x7fff >> logWidth);
+		EGL_Fixed tv0 = tv - (0x8000 >> logHeight);
+		EGL_Fixed tv1 = tv + (0x7fff >> logHeight);
+
+		U32 alpha = EGL_FractionFromFixed(tu0 << logWidth) >> 8;
+		U32 beta = EGL_FractionFromFixed(tv0 << logHeight) >> 8;
+
+		return Color::BlendAlpha(Color::BlendAlpha(FetchNearest<Texel, Wrap>(texture, tu1, tv1),
+												   FetchNearest<Texel, Wrap>(texture, tu0, tv1), alpha),
+								 Color::BlendAlpha(FetchNearest<Texel, Wrap>(texture, tu1, tv0),
+												   FetchNearest<Texel, Wrap>(texture, tu0, tv0), alpha),
+								 beta);
+	}
+
+	inline Color ShadeBaseColor(const VaryingInfo * varyingInfo, I32 varying[][2], I32 step) {
+		I32 colorIndex = varyingInfo->colorIndex;
+
+		if (colorIndex < 0) {
+			return Color();
+		}
+
+		return FractionalColor(
+			varying[colorIndex][0] + step * varying[colorIndex][1],
+			varying[colorIndex + 1][0] + step * varying[colorIndex + 1][1],
+			varying[colorIndex + 2][0] + step * varying[colorIndex + 2][1],
+			varying[colorIndex + 3][0] + step * varying[colorIndex + 3][1]);
+	}
+
+	void ShadeColor(const RasterInfo *, const VaryingInfo * varyingInfo,
+					I32 varying[][2], I32 step, Color & color) {
+		color = ShadeBaseColor(varyingInfo, varying, step);
+	}
+
+	template <class Texel, class Wrap, class Filter, class Env>
+	void ShadeTexture(const RasterInfo * rasterInfo, const VaryingInfo * varyingInfo,
+					  I32 varying[][2], I32 step, Color & color) {
+		const Texture * texture = rasterInfo->Textures[0];
+		I32 textureBase = varyingInfo->textureBase[0];
+
+		EGL_Fixed tu = varying[textureBase][0] + step * varying[textureBase][1];
+		EGL_Fixed tv = varying[textureBase + 1][0] + step * varying[textureBase + 1][1];
+
+		Color texColor = Filter::Linear ?
+			FetchLinear<Texel, Wrap>(texture, tu, tv) :
+			FetchNearest<Texel, Wrap>(texture, tu, tv);
+
+		color = ShadeBaseColor(varyingInfo, varying, step);
+		color = Env::Modulates ? Texel::Modulate(color, texColor) : Texel::Replace(color, texColor);
+	}
+
+	// indexed by texture format, wrapping mode, filter mode and environment
+	ShadeFunction * const ShadeTextureFunctions[2][2][2][2] = {
+		{
+			{
+				{ &ShadeTexture<TexelRGB565, WrapRepeat, FilterNearest, EnvReplace>,
+				  &ShadeTexture<TexelRGB565, WrapRepeat, FilterNearest, EnvModulate> },
+				{ &ShadeTexture<TexelRGB565, WrapRepeat, FilterLinear, EnvReplace>,
+				  &ShadeTexture<TexelRGB565, WrapRepeat, FilterLinear, EnvModulate> },
+			},
+			{
+				{ &ShadeTexture<TexelRGB565, WrapClampToEdge, FilterNearest, EnvReplace>,
+				  &ShadeTexture<TexelRGB565, WrapClampToEdge, FilterNearest, EnvModulate> },
+				{ &ShadeTexture<TexelRGB565, WrapClampToEdge, FilterLinear, EnvReplace>,
+				  &ShadeTexture<TexelRGB565, WrapClampToEdge, FilterLinear, EnvModulate> },
+			},
+		},
+		{
+			{
+				{ &ShadeTexture<TexelRGBA8, WrapRepeat, FilterNearest, EnvReplace>,
+				  &ShadeTexture<TexelRGBA8, WrapRepeat, FilterNearest, EnvModulate> },
+				{ &ShadeTexture<TexelRGBA8, WrapRepeat, FilterLinear, EnvReplace>,
+				  &ShadeTexture<TexelRGBA8, WrapRepeat, FilterLinear, EnvModulate> },
+			},
+			{
+				{ &ShadeTexture<TexelRGBA8, WrapClampToEdge, FilterNearest, EnvReplace>,
+				  &ShadeTexture<TexelRGBA8, WrapClampToEdge, FilterNearest, EnvModulate> },
+				{ &ShadeTexture<TexelRGBA8, WrapClampToEdge, FilterLinear, EnvReplace>,
+				  &ShadeTexture<TexelRGBA8, WrapClampToEdge, FilterLinear, EnvModulate> },
+			},
+		},
+	};
+}
+
+
+void Rasterizer :: PrepareShade() {
+	m_ShadeFunction = 0;
+
+	if (m_State->m_Fog.Enabled || m_State->m_Alpha.Enabled) {
+		return;
+	}
+
+	for (size_t unit = 1; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		if (m_State->m_Texture[unit].Enabled) {
+			return;
+		}
+	}
+
+	const RasterizerState::TextureState & texture = m_State->m_Texture[0];
+
+	if (!texture.Enabled) {
+		m_ShadeFunction = &ShadeColor;
+		return;
+	}
+
+	if (!m_Texture[0] || texture.WrappingModeS != texture.WrappingModeT) {
+		return;
+	}
+
+	I32 format, wrap, filter, env;
+
+	switch (texture.InternalFormat) {
+	case ColorFormatRGB565:	format = 0;	break;
+	case ColorFormatRGBA8:	format = 1;	break;
+	default:							return;
+	}
+
+	switch (texture.WrappingModeS) {
+	case RasterizerState::WrappingModeRepeat:		wrap = 0;	break;
+	case RasterizerState::WrappingModeClampToEdge:	wrap = 1;	break;
+	default:													return;
+	}
+
+	switch (m_State->GetMinFilterMode(0)) {
+	case RasterizerState::FilterModeNearest:	filter = 0;	break;
+	case RasterizerState::FilterModeLinear:		filter = 1;	break;
+	default:												return;
+	}
+
+	switch (texture.Mode) {
+	case RasterizerState::TextureModeReplace:	env = 0;	break;
+	case RasterizerState::TextureModeModulate:	env = 1;	break;
+
+	case RasterizerState::TextureModeDecal:
+		// decal of an opaque texture is replace
+		if (format != 0) {
+			return;
+		}
+
+		env = 0;
+		break;
+
+	default:
+		return;
+	}
+
+	m_ShadeFunction = ShadeTextureFunctions[format][wrap][filter][env];
+}
+
+#endif // EGL_USE_C_BLOCK_FUNCTIONS
 
 // --------------------------------------------------------------------------
 // Prepare rasterizer with according to current state settings
@@ -1549,6 +2115,31 @@ void Rasterizer :: PrepareLine() {
 	Prepare();
 	m_FunctionCache->PrepareFunction(PipelinePart::PartRasterLine,
 									 m_State, &m_VaryingInfo);
+
+	m_LineQuads = m_State->GetLineWidth() > EGL_ONE || m_State->IsLineSmoothEnabled();
+
+	if (m_LineQuads) {
+		// the quads may extend beyond the surface by half the line width
+		m_LineQuadState = *m_State;
+
+		I32 x0 = 0, y0 = 0;
+		I32 x1 = m_Surface->GetWidth(), y1 = m_Surface->GetHeight();
+
+		if (m_State->IsEnabledScissorTest()) {
+			x0 = EGL_Max(x0, m_State->m_ScissorTest.X);
+			y0 = EGL_Max(y0, m_State->m_ScissorTest.Y);
+			x1 = EGL_Min(x1, m_State->m_ScissorTest.X + m_State->m_ScissorTest.Width);
+			y1 = EGL_Min(y1, m_State->m_ScissorTest.Y + m_State->m_ScissorTest.Height);
+		}
+
+		m_LineQuadState.EnableScissorTest(true);
+		m_LineQuadState.SetScissor(x0, y0, EGL_Max(x1 - x0, 0), EGL_Max(y1 - y0, 0));
+
+		RasterizerState * state = m_State;
+		m_State = &m_LineQuadState;
+		PrepareTriangle();
+		m_State = state;
+	}
 }
 
 void Rasterizer :: BeginPoint() {
@@ -1567,6 +2158,13 @@ void Rasterizer :: BeginLine() {
 		m_FunctionCache->GetFunction(PipelinePart::PartRasterLine,
 									 m_State);
 
+	if (m_LineQuads) {
+		RasterizerState * state = m_State;
+		m_State = &m_LineQuadState;
+		BeginTriangle();
+		m_State = state;
+	}
+
 	m_RasterInfo.Init(m_Surface, 0);
 	memset(m_RasterInfo.MipmapLevel, 0, sizeof(m_RasterInfo.MipmapLevel));
 }
@@ -1575,10 +2173,126 @@ void Rasterizer :: End() {
 }
 
 
+// --------------------------------------------------------------------------
+// Rasterize a wide or smooth line as quads of two triangles each, which
+// take the block path of triangles. Aliased wide lines are parallelograms
+// that extend along the minor axis by the width rounded to whole pixels.
+// Smooth lines are rectangles with a fringe of one pixel on either side,
+// across which the alpha of the line falls off to zero; together with
+// blending this approximates the pixel coverage of the line. The fringe
+// needs the color varying; without it, smooth lines are rectangles
+// without a fringe.
+// --------------------------------------------------------------------------
+
+void Rasterizer :: RasterWideLine(const Vertex& from, const Vertex& to) {
+
+	EGL_Fixed deltaX = to.m_WindowCoords.x - from.m_WindowCoords.x;
+	EGL_Fixed deltaY = to.m_WindowCoords.y - from.m_WindowCoords.y;
+
+	if (!deltaX && !deltaY)
+		return;
+
+	EGL_Fixed width = m_State->GetLineWidth();
+	bool smooth = m_State->IsLineSmoothEnabled();
+
+	RasterizerState * state = m_State;
+	m_State = &m_LineQuadState;
+
+	if (smooth) {
+		// unit normal of the line
+		EGL_Fixed major = EGL_Max(EGL_Abs(deltaX), EGL_Abs(deltaY));
+		EGL_Fixed dirX = EGL_Div(deltaX, major);
+		EGL_Fixed dirY = EGL_Div(deltaY, major);
+		EGL_Fixed length = EGL_Sqrt(EGL_Mul(dirX, dirX) + EGL_Mul(dirY, dirY));
+		EGL_Fixed normalX = EGL_Div(-dirY, length);
+		EGL_Fixed normalY = EGL_Div(dirX, length);
+
+		// a pixel at distance d from the line is covered by about
+		// min(width, 1) up to |width - 1| / 2, falling to 0 at (width + 1) / 2
+		EGL_Fixed inner = EGL_Abs(width - EGL_ONE) / 2;
+		EGL_Fixed outer = (width + EGL_ONE) / 2;
+		EGL_Fixed peak = EGL_Min(width, EGL_ONE);
+
+		if (m_VaryingInfo.colorIndex < 0) {
+			inner = width / 2;
+			peak = EGL_ONE;
+		}
+
+		EGL_Fixed innerX = EGL_Mul(normalX, inner), innerY = EGL_Mul(normalY, inner);
+		EGL_Fixed outerX = EGL_Mul(normalX, outer), outerY = EGL_Mul(normalY, outer);
+
+		if (inner > 0) {
+			RasterLineStrip(from, to, -innerX, -innerY, innerX, innerY, peak, peak);
+		}
+
+		if (m_VaryingInfo.colorIndex >= 0) {
+			RasterLineStrip(from, to, innerX, innerY, outerX, outerY, peak, 0);
+			RasterLineStrip(from, to, -innerX, -innerY, -outerX, -outerY, peak, 0);
+		}
+	} else {
+		EGL_Fixed half = EGL_Max(EGL_Round(width), 1) << (EGL_PRECISION - 1);
+
+		if (EGL_Abs(deltaX) >= EGL_Abs(deltaY)) {
+			RasterLineStrip(from, to, 0, -half, 0, half, EGL_ONE, EGL_ONE);
+		} else {
+			RasterLineStrip(from, to, -half, 0, half, 0, EGL_ONE, EGL_ONE);
+		}
+	}
+
+	m_State = state;
+}
+
+
+void Rasterizer :: RasterLineStrip(const Vertex& from, const Vertex& to,
+								   EGL_Fixed innerX, EGL_Fixed innerY, EGL_Fixed outerX, EGL_Fixed outerY,
+								   EGL_Fixed innerAlpha, EGL_Fixed outerAlpha) {
+
+	Vertex corners[4] = { from, to, to, from };
+	I32 index;
+
+	for (index = 0; index < 4; ++index) {
+		bool inside = index < 2;
+
+		corners[index].m_WindowCoords.x += inside ? innerX : outerX;
+		corners[index].m_WindowCoords.y += inside ? innerY : outerY;
+
+		if (m_VaryingInfo.colorIndex >= 0) {
+			EGL_Fixed & alpha = corners[index].m_Varying[m_VaryingInfo.colorIndex + 3];
+			alpha = EGL_Mul(alpha, inside ? innerAlpha : outerAlpha);
+		}
+	}
+
+	// the triangles share their diagonal; the fill convention assigns
+	// the pixels on it to one of them
+	RasterQuadTriangle(corners[0], corners[1], corners[2]);
+	RasterQuadTriangle(corners[0], corners[2], corners[3]);
+}
+
+
+void Rasterizer :: RasterQuadTriangle(const Vertex& a, const Vertex& b, const Vertex& c) {
+
+	// RasterTriangle drops triangles of negative area
+	I64 area =
+		static_cast<I64>(c.m_WindowCoords.x - a.m_WindowCoords.x) * (a.m_WindowCoords.y - b.m_WindowCoords.y) -
+		static_cast<I64>(a.m_WindowCoords.x - b.m_WindowCoords.x) * (c.m_WindowCoords.y - a.m_WindowCoords.y);
+
+	if (area >= 0) {
+		RasterTriangle(a, b, c);
+	} else {
+		RasterTriangle(a, c, b);
+	}
+}
+
+
 #if !EGL_USE_JIT
 
 void Rasterizer :: RasterLine(Vertex& p_from, Vertex& p_to) {
 
+	if (m_LineQuads) {
+		RasterWideLine(p_from, p_to);
+		return;
+	}
+
 	if (EGL_Round(p_from.m_WindowCoords.x) == EGL_Round(p_to.m_WindowCoords.x) &&
 		EGL_Round(p_from.m_WindowCoords.y) == EGL_Round(p_to.m_WindowCoords.y)) {
 		// both ends of line on same pixel
@@ -1586,6 +2300,8 @@ void Rasterizer :: RasterLine(Vertex& p_from, Vertex& p_to) {
 		return;
 	}
 
+	AddDirtyRect(p_from.m_WindowCoords.x, p_from.m_WindowCoords.y, p_to.m_WindowCoords.x, p_to.m_WindowCoords.y);
+
 	EGL_Fixed deltaX = p_to.m_WindowCoords.x - p_from.m_WindowCoords.x;
 	EGL_Fixed deltaY = p_to.m_WindowCoords.y - p_from.m_WindowCoords.y;
 
@@ -1826,6 +2542,8 @@ void Rasterizer :: RasterPoint(const Vertex& point, EGL_Fixed size) {
 	I32 ymin = EGL_IntFromFixed(point.m_WindowCoords.y - halfSize + EGL_HALF);
 	I32 ymax = ymin + ((size - EGL_HALF) >> EGL_PRECISION);
 
+	m_Surface->AddDirtyRect(xmin, ymin, xmax + 1, ymax + 1);
+
 	EGL_Fixed depth = point.m_WindowCoords.depth;
 	FractionalColor baseColor(point.m_Varying + m_VaryingInfo.colorIndex);
 	EGL_Fixed fogDensity = point.m_Varying[m_VaryingInfo.fogIndex];
@@ -1892,4 +2610,114 @@ void Rasterizer :: RasterPoint(const Vertex& point, EGL_Fixed size) {
 	}
 }
 
+
+// --------------------------------------------------------------------------
+// Rasterize a batch of points as axis-aligned squares using the block
+// rasterizer. Each block covered by a point is processed with a coverage
+// mask for the part of the square within the block; depth and color are
+// constant across the square except for replaced sprite coordinates, which
+// are linear in x and y. Mipmap selection is shared between consecutive
+// points of the same size.
+// --------------------------------------------------------------------------
+
+void Rasterizer :: RasterPoints(const Vertex * const * points, const EGL_Fixed * sizes, size_t count) {
+
+	// clipping rectangle shared by all points of the batch; upper bounds are exclusive
+	I32 clipXMin = 0, clipYMin = 0;
+	I32 clipXMax = m_Surface->GetWidth();
+	I32 clipYMax = m_Surface->GetHeight();
+
+	if (m_State->m_ScissorTest.Enabled) {
+		clipXMin = EGL_Max(clipXMin, m_State->m_ScissorTest.X);
+		clipYMin = EGL_Max(clipYMin, m_State->m_ScissorTest.Y);
+		clipXMax = EGL_Min(clipXMax, m_State->m_ScissorTest.X + m_State->m_ScissorTest.Width);
+		clipYMax = EGL_Min(clipYMax, m_State->m_ScissorTest.Y + m_State->m_ScissorTest.Height);
+	}
+
+	if (clipXMin >= clipXMax || clipYMin >= clipYMax)
+		return;
+
+	const bool sprite = m_State->m_Point.SpriteEnabled;
+	const I32 numVarying = m_VaryingInfo.numVarying;
+
+	EGL_Fixed currentSize = 0;
+	EGL_Fixed delta = 0;
+
+	for (size_t index = 0; index < count; ++index) {
+		const Vertex& point = *points[index];
+		EGL_Fixed size = sizes[index];
+		EGL_Fixed halfSize = size / 2;
+
+		I32 xmin = EGL_IntFromFixed(point.m_WindowCoords.x - halfSize + EGL_HALF);
+		I32 xmax = xmin + ((size - EGL_HALF) >> EGL_PRECISION) + 1;
+		I32 ymin = EGL_IntFromFixed(point.m_WindowCoords.y - halfSize + EGL_HALF);
+		I32 ymax = ymin + ((size - EGL_HALF) >> EGL_PRECISION) + 1;
+
+		I32 x0 = EGL_Max(xmin, clipXMin);
+		I32 x1 = EGL_Min(xmax, clipXMax);
+		I32 y0 = EGL_Max(ymin, clipYMin);
+		I32 y1 = EGL_Min(ymax, clipYMax);
+
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+
+		m_Surface->AddDirtyRect(x0, y0, x1, y1);
+
+		// the mipmap level follows from the sprite coordinates per quad of pixels
+		if (sprite && size != currentSize) {
+			currentSize = size;
+			delta = EGL_Inverse(size);
+		}
+
+		// varying variables are constant across the square
+		I32 varying[EGL_MAX_NUM_VARYING][2][2];
+		I32 var;
+
+		for (var = 0; var < numVarying; ++var) {
+			varying[var][0][0] = varying[var][1][0] = point.m_Varying[var];
+			varying[var][0][1] = varying[var][1][1] = 0;
+		}
+
+		for (I32 by = y0 & ~(EGL_RASTER_BLOCK_SIZE - 1); by < y1; by += EGL_RASTER_BLOCK_SIZE) {
+			for (I32 bx = x0 & ~(EGL_RASTER_BLOCK_SIZE - 1); bx < x1; bx += EGL_RASTER_BLOCK_SIZE) {
+
+				// coverage of the square within the current block
+				I32 left = EGL_Max(x0 - bx, 0);
+				I32 right = EGL_Min(x1 - bx, EGL_RASTER_BLOCK_SIZE);
+				PixelMask rowMask = SpanPixelMask(left, right);
+				PixelMask pixelMask[EGL_NUM_SAMPLES * EGL_RASTER_BLOCK_SIZE];
+
+				for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+					pixelMask[iy] = (by + iy >= y0 && by + iy < y1) ? rowMask : 0;
+				}
+
+				m_RasterInfo.Init(m_Surface, by, bx);
+
+				if (!RasterBlockMaskedDepthStencil(bx, by, point.m_WindowCoords.depth, pixelMask))
+					continue;
+
+				if (sprite) {
+					for (size_t unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+						I32 textureBase = m_VaryingInfo.textureBase[unit];
+
+						if (textureBase >= 0 && m_State->m_Texture[unit].CoordReplaceEnabled) {
+							I32 tu0 = delta / 2 + (bx - xmin) * delta;
+							I32 tv0 = delta / 2 + (by - ymin) * delta;
+
+							varying[textureBase][0][0] = tu0;
+							varying[textureBase][1][0] = tu0 + (delta << EGL_LOG_RASTER_BLOCK_SIZE);
+							varying[textureBase][0][1] = varying[textureBase][1][1] = 0;
+
+							varying[textureBase + 1][0][0] = varying[textureBase + 1][1][0] = tv0;
+							varying[textureBase + 1][0][1] = varying[textureBase + 1][1][1] = delta;
+						}
+					}
+				}
+
+				RasterBlockColorAlpha(varying, pixelMask);
+			}
+		}
+	}
+}
+
 #endif // !EGL_USE_JIT
@@ -127,12 +127,36 @@ namespace EGL {
 		FractionalColor		m_Color[3];	// base color, front color, back color		
 		EGL_Fixed			m_Varying[EGL_MAX_NUM_VARYING];
 
+#if EGL_USE_FLOAT_VERTEX
+		float				m_FloatClipCoords[4];	// clip coords of float vertex pipeline
+#endif
+
 		unsigned			m_Lit : 2;	// unlit or lit vertex?
 		unsigned			m_cc : 6;	// culling flags
+
+#if EGL_USE_FLOAT_VERTEX
+		unsigned			m_Float : 1;	// m_FloatClipCoords are valid
+#endif
 	};
 
 	// set the culling mask for a vertex
 	inline void CalcCC(Vertex * vertex) {
+#if EGL_USE_FLOAT_VERTEX
+		if (vertex->m_Float) {
+			const float * clip = vertex->m_FloatClipCoords;
+
+			vertex->m_cc =
+				(clip[0] < -clip[3] ? (1 << 0) : 0) |
+				(clip[0] >  clip[3] ? (1 << 1) : 0) |
+				(clip[1] < -clip[3] ? (1 << 2) : 0) |
+				(clip[1] >  clip[3] ? (1 << 3) : 0) |
+				(clip[2] < -clip[3] ? (1 << 4) : 0) |
+				(clip[2] >  clip[3] ? (1 << 5) : 0);
+
+			return;
+		}
+#endif
+
 		vertex->m_cc =
 			(vertex->m_ClipCoords.x() < -vertex->m_ClipCoords.w() ? (1 << 0) : 0) |
 			(vertex->m_ClipCoords.x() >  vertex->m_ClipCoords.w() ? (1 << 1) : 0) |
@@ -152,6 +176,9 @@ namespace EGL {
 		I16					DepthStencilOffsetShift;			
 		ColorFormat			ColorFormat;
 		DepthStencilFormat	DepthStencilFormat;
+		U32					Samples;					// number of sample planes
+		I32					SampleColorStride;			// bytes between color planes
+		I32					SampleDepthStencilStride;	// bytes between depth/stencil planes
 	};
 
 	struct RasterInfo {
@@ -205,12 +232,40 @@ namespace EGL {
 	typedef U32 PixelMask;
 #endif
 
+	// pixel mask with the bits for pixels left <= ix < right set
+	inline PixelMask SpanPixelMask(I32 left, I32 right) {
+		return (PixelMask) (((2u << (right - 1)) - 1) & ~((1u << left) - 1));
+	}
+
+#if EGL_RASTER_STATISTICS
+	// histogram of the rasterized triangles; bucket i of Area counts the
+	// triangles covering [2^i - 1, 2^(i+1) - 1) pixels
+	struct TriangleStatistics {
+		enum {
+			NUM_AREA_BUCKETS = 16
+		};
+
+		U32		Area[NUM_AREA_BUCKETS];
+		U32		AffineTriangles;	// triangles interpolated without perspective correction
+		U32		CoveredBlocks;		// raster blocks passed to the color stage
+	};
+#endif
+
 	// signature for generated scanline functions
 	typedef void (LineFunction)(const RasterInfo * info, const Vertex * from, const Vertex * to);
 	typedef void (PointFunction)(const RasterInfo * info, const Vertex * pos, EGL_Fixed size);
 	typedef PixelMask (BlockDepthStencilFunction)(const RasterInfo * info, const Variables * variables, PixelMask * pixelMask);
 	typedef PixelMask (BlockEdgeDepthStencilFunction)(const RasterInfo * info, const Variables * variables, const Edges * edges, PixelMask * pixelMask);
 	typedef void (BlockColorAlphaFunction)(const RasterInfo * info, I32 varying[][2][2], const PixelMask * pixelMask);
+	typedef void (BlockDepthStencilColorAlphaFunction)(const RasterInfo * info, const Variables * variables, I32 varying[][2][2]);
+
+	// signature of the color output stage for a row of a block in the C rasterizer
+	typedef void (ColorRowFunction)(const SurfaceInfo * surfaceInfo, const Color * colors,
+									const U8 * dither, PixelMask mask);
+
+	// signature of a specialized shade stage for a pixel of a quad in the C rasterizer
+	typedef void (ShadeFunction)(const RasterInfo * rasterInfo, const VaryingInfo * varyingInfo,
+								 I32 varying[][2], I32 step, Color & color);
 
 	class Rasterizer {
 
@@ -264,14 +319,26 @@ namespace EGL {
 		// ----------------------------------------------------------------------
 
 		void RasterPoint(const Vertex& point, EGL_Fixed size);
+		void RasterPoints(const Vertex * const * points, const EGL_Fixed * sizes, size_t count);
 		void RasterLine(Vertex& from, Vertex& to);
 		void RasterTriangle(const Vertex& a, const Vertex& b,
 			const Vertex& c);
 
-		// inner loops of rasterization of triangles
+		// inner loops of rasterization of triangles; the C versions expect
+		// pixelMask to hold the scissor coverage of the block on entry
 		PixelMask RasterBlockDepthStencil(const Variables * variables, PixelMask * pixelMask);
 		PixelMask RasterBlockEdgeDepthStencil(const Variables * variables, const Edges * edges, PixelMask * pixelMask);
 		void RasterBlockColorAlpha(I32 varying[][2][2], const PixelMask * pixelMask);
+		PixelMask RasterBlockMaskedDepthStencil(I32 x, I32 y, U32 depth, PixelMask * pixelMask);
+
+		// On multisample surfaces, pixelMask holds the row masks of each
+		// sample plane in turn. The sample version of the edge test takes
+		// the scissor coverage in the first plane and offsets the edges and
+		// depth to each sample position; the masked test copies the coverage
+		// to all planes. The color stage shades each pixel covered by any
+		// sample once and writes it to the planes of the covered samples.
+		PixelMask RasterBlockSamplesDepthStencil(const Variables * variables, const Edges * edges,
+												 bool scissored, PixelMask * pixelMask);
 
 		// ----------------------------------------------------------------------
 		// State management
@@ -291,6 +358,14 @@ namespace EGL {
 		// ----------------------------------------------------------------------
 		void AllocateVaryings();
 
+#if EGL_RASTER_STATISTICS
+		// ----------------------------------------------------------------------
+		// triangle statistics
+		// ----------------------------------------------------------------------
+		const TriangleStatistics & GetTriangleStatistics() const	{ return m_TriangleStatistics; }
+		void ResetTriangleStatistics();
+#endif
+
 	private:
 		// ----------------------------------------------------------------------
 		// Rasterization of triangle
@@ -318,17 +393,76 @@ namespace EGL {
 			// will have special cases based on settings
 			// the coordinates are integer coordinates
 
+		PixelMask ScissorBlockMask(I32 x, I32 y, PixelMask * pixelMask) const;
+			// initialize the row masks of the block at x, y to its coverage
+			// by the scissor rectangle; returns 0 if the block is scissored
+
+		PixelMask DepthStencilBlock(I32 x, I32 y, I32 depth, I32 dX, I32 dY, PixelMask * pixelMask);
+			// depth and stencil test of the pixels of a block that are set in
+			// pixelMask; depth is 28.4 at the block origin
+
+		void SelectTriangleMipmapLevels(const Variables * vars);
+			// select the mipmap level of each texture unit for a triangle
+			// with affine interpolation of the texture coordinates
+
+		void SelectQuadMipmapLevels(I32 varying0[][2], I32 varying1[][2]);
+			// select the mipmap level of each texture unit from the derivatives
+			// of the texture coordinates across a quad of 2x2 pixels
+
+		bool QuadFragmentShade(I32 varying[][2], I32 step, Color& color);
+			// shade a pixel of a quad; the varying values are those of the quad
+			// row advanced by step pixels. Returns false if the fragment failed
+			// the alpha test
+
 		bool FragmentDepthStencil(const RasterInfo * rasterInfo, const SurfaceInfo * surfaceInfo,
 								  U32 offset, U32 depth);
 			// fragment rendering with signature corresponding to function fragment
 			// generated by code generator
 			// return true if the fragment passed depth and stencil tests
 
-		void FragmentColorAlpha(const RasterInfo * rasterInfo, const SurfaceInfo * surfaceInfo,
-								U32 offset, EGL_Fixed tu[], EGL_Fixed tv[],
-								const Color& baseColor, EGL_Fixed fog, EGL_Fixed coverage);
-			// fragment rendering with signature corresponding to function fragment
-			// generated by code generator
+		bool FragmentShade(EGL_Fixed tu[], EGL_Fixed tv[], const Color& baseColor,
+						   EGL_Fixed fog, EGL_Fixed coverage, Color& color);
+			// texturing, fog, coverage and alpha test of a fragment; returns
+			// false if the fragment failed the alpha test
+
+		void FragmentColorOutput(const SurfaceInfo * surfaceInfo, U32 offset, Color color,
+								 const U8 * dither);
+			// blending, color mask, dithering and logic operation of a fragment;
+			// dither holds the dither thresholds of the row indexed by offset,
+			// or is 0 if dithering is disabled
+
+		const U8 * DitherRow(I32 y) const;
+			// dither thresholds of the pixels of a block row at y, or 0 if
+			// dithering is disabled
+
+		void PrepareColorRow();
+			// select the row function for the current blend and mask state
+
+		void PrepareShade();
+			// select the shade function for the current texture, fog and
+			// alpha test state
+
+		void RasterWideLine(const Vertex& from, const Vertex& to);
+			// rasterize a wide or smooth line as quads through the triangle
+			// block functions
+
+		void RasterLineStrip(const Vertex& from, const Vertex& to,
+							 EGL_Fixed innerX, EGL_Fixed innerY, EGL_Fixed outerX, EGL_Fixed outerY,
+							 EGL_Fixed innerAlpha, EGL_Fixed outerAlpha);
+			// rasterize the quad between two offsets of a line; the alpha of
+			// the line is scaled by innerAlpha and outerAlpha at the offsets
+
+		void RasterQuadTriangle(const Vertex& a, const Vertex& b, const Vertex& c);
+			// rasterize a triangle of a line quad in either orientation
+
+		void ColorRowOutput(const SurfaceInfo * surfaceInfo, const Color * colors,
+							const U8 * dither, PixelMask mask);
+			// color output of the pixels of a row that are set in mask
+
+		void AddDirtyRect(EGL_Fixed x0, EGL_Fixed y0, EGL_Fixed x1, EGL_Fixed y1);
+			// mark the pixels within a margin of one pixel around the
+			// rectangle between two points as changed for the resolve of
+			// multisample surfaces
 
 		Color GetTexColor(const RasterizerState::TextureState * state, const Texture * texture, EGL_Fixed tu, EGL_Fixed tv,
 						  RasterizerState::FilterMode filterMode);
@@ -359,6 +493,40 @@ namespace EGL {
 		BlockEdgeDepthStencilFunction *	m_BlockEdgeDepthStencilFunction;
 		BlockColorAlphaFunction *		m_BlockColorAlphaFunction;
 
+		// wide and smooth lines are rasterized as quads; their state is
+		// scissored to the surface, as only the line centers are clipped
+		bool							m_LineQuads;
+		RasterizerState					m_LineQuadState;
+
+#if EGL_USE_C_BLOCK_FUNCTIONS
+		// stages of the C block functions
+		ColorRowFunction *				m_ColorRowFunction;	// 0 for per fragment output
+		ShadeFunction *					m_ShadeFunction;	// 0 for FragmentShade
+#endif
+
+#if EGL_USE_JIT
+		// block functions for blocks inside of the scissor rectangle
+		RasterizerState					m_UnscissoredState;
+		BlockDepthStencilFunction *		m_UnscissoredBlockDepthStencilFunction;
+		BlockEdgeDepthStencilFunction *	m_UnscissoredBlockEdgeDepthStencilFunction;
+
+		// the block functions of the triangle state are compiled; with the
+		// asynchronous JIT, triangles use the C block functions until the
+		// compiler thread is done
+		bool							m_CompiledBlockFunctions;
+
+		// color function for fully covered raster blocks of which all pixels
+		// passed the depth and stencil test; 0 until it has been compiled
+		BlockColorAlphaFunction *		m_BlockFullColorAlphaFunction;
+		bool							m_CompiledFullBlockFunction;
+
+		// depth/stencil and color function for fully covered raster blocks
+		// inside of the scissor rectangle, which processes both in a single
+		// pass; 0 if the alpha test is enabled or until it has been compiled
+		BlockDepthStencilColorAlphaFunction *	m_BlockDepthStencilColorAlphaFunction;
+		bool							m_CompiledDepthStencilColorAlphaFunction;
+#endif
+
 		// ----------------------------------------------------------------------
 		// internal state
 		// ----------------------------------------------------------------------
@@ -369,6 +537,11 @@ namespace EGL {
 
 		VaryingInfo				m_VaryingInfo;
 		bool					m_UseMipmap[EGL_NUM_TEXTURE_UNITS];
+		bool					m_MipmapPerQuad;	// C color stage selects levels per quad
+
+#if EGL_RASTER_STATISTICS
+		TriangleStatistics		m_TriangleStatistics;
+#endif
 	};
 
 
@@ -389,6 +562,11 @@ namespace EGL {
 		return m_Surface;
 	}
 
+	inline void Rasterizer :: AddDirtyRect(EGL_Fixed x0, EGL_Fixed y0, EGL_Fixed x1, EGL_Fixed y1) {
+		m_Surface->AddDirtyRect(EGL_IntFromFixed(EGL_Min(x0, x1)) - 1, EGL_IntFromFixed(EGL_Min(y0, y1)) - 1,
+								EGL_IntFromFixed(EGL_Max(x0, x1)) + 2, EGL_IntFromFixed(EGL_Max(y0, y1)) + 2);
+	}
+
 
 //	inline void Rasterizer :: RasterTriangle(const Vertex& a, const Vertex& b, const Vertex& c) {
 //		(this->*m_RasterTriangleFunction)(a, b, c);
@@ -397,17 +575,73 @@ namespace EGL {
 
 #	if EGL_USE_JIT
 
+	// generated point and line functions cover whole pixels; they are run
+	// once for each sample plane of a multisample surface
 	inline void Rasterizer :: RasterPoint(const Vertex& point, EGL_Fixed size) {
-		m_PointFunction(&m_RasterInfo, &point, size);
+		const Vertex * vertex = &point;
+		RasterPoints(&vertex, &size, 1);
+	}
+
+	inline void Rasterizer :: RasterPoints(const Vertex * const * points, const EGL_Fixed * sizes, size_t count) {
+		// the generated point function does not clip, so points whose square
+		// misses the surface or the scissor rectangle are rejected here
+		EGL_Fixed clipXMin = 0, clipYMin = 0;
+		EGL_Fixed clipXMax = EGL_FixedFromInt(m_Surface->GetWidth());
+		EGL_Fixed clipYMax = EGL_FixedFromInt(m_Surface->GetHeight());
+
+		if (m_State->m_ScissorTest.Enabled) {
+			clipXMin = EGL_Max(clipXMin, EGL_FixedFromInt(m_State->m_ScissorTest.X));
+			clipYMin = EGL_Max(clipYMin, EGL_FixedFromInt(m_State->m_ScissorTest.Y));
+			clipXMax = EGL_Min(clipXMax, EGL_FixedFromInt(m_State->m_ScissorTest.X + m_State->m_ScissorTest.Width));
+			clipYMax = EGL_Min(clipYMax, EGL_FixedFromInt(m_State->m_ScissorTest.Y + m_State->m_ScissorTest.Height));
+		}
+
+		for (size_t index = 0; index < count; ++index) {
+			const Vertex * point = points[index];
+			EGL_Fixed halfSize = sizes[index] / 2;
+
+			if (point->m_WindowCoords.x + halfSize < clipXMin ||
+				point->m_WindowCoords.x - halfSize > clipXMax ||
+				point->m_WindowCoords.y + halfSize < clipYMin ||
+				point->m_WindowCoords.y - halfSize > clipYMax) {
+				continue;
+			}
+
+			AddDirtyRect(point->m_WindowCoords.x - halfSize, point->m_WindowCoords.y - halfSize,
+						 point->m_WindowCoords.x + halfSize, point->m_WindowCoords.y + halfSize);
+
+			RasterInfo info = m_RasterInfo;
+
+			for (U32 sample = 0; sample < m_RasterInfo.RasterSurface.Samples; ++sample) {
+				m_PointFunction(&info, point, sizes[index]);
+
+				info.RasterSurface.ColorBuffer += info.RasterSurface.SampleColorStride;
+				info.RasterSurface.DepthStencilBuffer += info.RasterSurface.SampleDepthStencilStride;
+			}
+		}
 	}
 
 	inline void Rasterizer :: RasterLine(Vertex& p_from, Vertex& p_to) {
+		if (m_LineQuads) {
+			RasterWideLine(p_from, p_to);
+			return;
+		}
+
 		p_from.m_WindowCoords.x = ((p_from.m_WindowCoords.x + 0x800) & ~0xfff);
 		p_from.m_WindowCoords.y = ((p_from.m_WindowCoords.y + 0x800) & ~0xfff);
 		p_to.m_WindowCoords.x = ((p_to.m_WindowCoords.x + 0x800) & ~0xfff);
 		p_to.m_WindowCoords.y = ((p_to.m_WindowCoords.y + 0x800) & ~0xfff);
 
-		m_LineFunction(&m_RasterInfo, &p_from, &p_to);
+		AddDirtyRect(p_from.m_WindowCoords.x, p_from.m_WindowCoords.y, p_to.m_WindowCoords.x, p_to.m_WindowCoords.y);
+
+		RasterInfo info = m_RasterInfo;
+
+		for (U32 sample = 0; sample < m_RasterInfo.RasterSurface.Samples; ++sample) {
+			m_LineFunction(&info, &p_from, &p_to);
+
+			info.RasterSurface.ColorBuffer += info.RasterSurface.SampleColorStride;
+			info.RasterSurface.DepthStencilBuffer += info.RasterSurface.SampleDepthStencilStride;
+		}
 	}
 
 #	endif // EGL_USE_JIT
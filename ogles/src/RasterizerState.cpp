@@ -50,7 +50,9 @@ RasterizerState :: RasterizerState():
 	m_ShadingModel(ShadeModelSmooth),
 	m_SampleCoverage(EGL_ONE),
 	m_InvertSampleCoverage(false),
-	m_PerspectiveCorrection(true),
+	m_PerspectiveCorrection(PerspectiveCorrectionDontCare),
+	m_DitherEnabled(false),
+	m_MultisampleEnabled(true),
 	m_ColorFormat(ColorFormatInvalid),
 	m_DepthStencilFormat(DepthStencilFormatInvalid)
 {
@@ -82,7 +84,9 @@ bool RasterizerState :: CompareCommon(const RasterizerState& other) const {
 		m_SampleCoverage == other.m_SampleCoverage &&
 		m_InvertSampleCoverage == other.m_InvertSampleCoverage &&
 		
-		m_PerspectiveCorrection == other.m_PerspectiveCorrection;
+		m_PerspectiveCorrection == other.m_PerspectiveCorrection &&
+		m_DitherEnabled == other.m_DitherEnabled &&
+		m_MultisampleEnabled == other.m_MultisampleEnabled;
 }
 
 
@@ -136,5 +140,6 @@ bool RasterizerState :: ComparePolygonColorAlpha(const RasterizerState& other) c
 
 		m_SampleCoverage == other.m_SampleCoverage &&
 		m_InvertSampleCoverage == other.m_InvertSampleCoverage &&
-		m_PerspectiveCorrection == other.m_PerspectiveCorrection;
+		m_PerspectiveCorrection == other.m_PerspectiveCorrection &&
+		m_DitherEnabled == other.m_DitherEnabled;
 }
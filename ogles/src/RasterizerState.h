@@ -182,6 +182,12 @@ namespace EGL {
 			FilterModeLinear
 		};
 
+		enum PerspectiveCorrection {
+			PerspectiveCorrectionFastest,
+			PerspectiveCorrectionDontCare,
+			PerspectiveCorrectionNicest
+		};
+
 		typedef ColorFormat TextureFormat;
 
 	public:
@@ -246,8 +252,8 @@ namespace EGL {
 		WrappingMode GetWrappingModeT(size_t unit) const		{ return m_Texture[unit].WrappingModeT; }
 
 		void SetInternalFormat(size_t unit, TextureFormat format);
-		void SetPerspectiveCorrection(bool enabled);
-		bool GetPerspectiveCorrection() const;
+		void SetPerspectiveCorrection(PerspectiveCorrection mode);
+		PerspectiveCorrection GetPerspectiveCorrection() const;
 
 		void SetDepthRange(EGL_Fixed zNear, EGL_Fixed zFar);
 
@@ -257,6 +263,7 @@ namespace EGL {
 		bool IsEnabledFog() const;
 
 		void SetLineWidth(EGL_Fixed width);
+		EGL_Fixed GetLineWidth() const;
 		void SetLineSmoothEnabled(bool enabled);
 		bool IsLineSmoothEnabled() const;
 
@@ -297,6 +304,10 @@ namespace EGL {
 		BlendFuncDst GetBlendFuncDst() const;
 		void SetColorMask(bool red, bool green, bool blue, bool alpha);
 		Color GetColorMask() const;
+		void EnableDither(bool enabled);
+		bool IsEnabledDither() const;
+		void EnableMultisample(bool enabled);
+		bool IsEnabledMultisample() const;
 
 		void SetDepthFunc(ComparisonFunc func);
 		ComparisonFunc GetDepthFunc() const;
@@ -856,7 +867,9 @@ namespace EGL {
 
 		EGL_Fixed				m_SampleCoverage;
 		bool					m_InvertSampleCoverage;
-		bool					m_PerspectiveCorrection;
+		PerspectiveCorrection	m_PerspectiveCorrection;
+		bool					m_DitherEnabled;
+		bool					m_MultisampleEnabled;	// sample positions of multisample surfaces
 
 		ColorFormat				m_ColorFormat;
 		DepthStencilFormat		m_DepthStencilFormat;
@@ -920,6 +933,10 @@ namespace EGL {
 		m_Line.Width = width;
 	}
 
+	inline EGL_Fixed RasterizerState :: GetLineWidth() const {
+		return m_Line.Width;
+	}
+
 	inline void RasterizerState :: SetLogicOp(LogicOp opcode) {
 		m_LogicOp.Opcode = opcode;
 	}
@@ -1109,6 +1126,22 @@ namespace EGL {
 		return m_LogicOp.Enabled;
 	}
 
+	inline void RasterizerState :: EnableDither(bool enabled) {
+		m_DitherEnabled = enabled;
+	}
+
+	inline bool RasterizerState :: IsEnabledDither() const {
+		return m_DitherEnabled;
+	}
+
+	inline void RasterizerState :: EnableMultisample(bool enabled) {
+		m_MultisampleEnabled = enabled;
+	}
+
+	inline bool RasterizerState :: IsEnabledMultisample() const {
+		return m_MultisampleEnabled;
+	}
+
 	inline bool RasterizerState :: IsEnabledScissorTest() const {
 		return m_ScissorTest.Enabled;
 	}
@@ -1241,11 +1274,11 @@ namespace EGL {
 		return m_Texture[unit].ScaleAlpha;
 	}
 
-	inline void RasterizerState :: SetPerspectiveCorrection(bool enabled) {
-		m_PerspectiveCorrection = enabled;
+	inline void RasterizerState :: SetPerspectiveCorrection(PerspectiveCorrection mode) {
+		m_PerspectiveCorrection = mode;
 	}
 	
-	inline bool RasterizerState :: GetPerspectiveCorrection() const {
+	inline RasterizerState::PerspectiveCorrection RasterizerState :: GetPerspectiveCorrection() const {
 		return m_PerspectiveCorrection;
 	}
 
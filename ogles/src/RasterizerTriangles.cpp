@@ -49,6 +49,10 @@
 #include "Utils.h"
 #include "arm/FunctionCache.h"
 
+#if EGL_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace EGL;
 
 #ifdef min
@@ -117,6 +121,123 @@ namespace {
 
 		return x;
 	}
+
+	// sample positions of multisample surfaces on a rotated grid, in 1/16
+	// pixel relative to the pixel center; SampleExtent bounds the offsets
+	const I32 SamplePosition[EGL_NUM_SAMPLES][2] = {
+		{ -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 }
+	};
+
+	const I32 SampleExtent = 6;
+
+	// bound of the difference of an edge function between the center and
+	// the samples of a pixel
+	inline I32 SampleEdgeMargin(I32 fdy, I32 fdx) {
+		return ((EGL_Abs(fdy) + EGL_Abs(fdx)) * SampleExtent) >> 4;
+	}
+
+	// number of corners of a square of size 1 << logSize that are inside of
+	// an edge; cy is the edge value at the top left corner
+	inline I32 EdgeCorners(I32 cy, I32 fdy, I32 fdx, I32 logSize) {
+		return (cy > 0) + 
+			(cy + (fdy << logSize) > 0) +
+			(cy - (fdx << logSize) > 0) +
+			(cy + (fdy << logSize) - (fdx << logSize) > 0);
+	}
+
+#if EGL_USE_JIT
+	// copy the pixels of a raster block that are set in the row masks from
+	// one color plane to another; pitch is in bytes
+	template <class T>
+	void CopyBlockPixels(U8 * target, const U8 * source, I32 pitch, const PixelMask * mask) {
+		for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; ++iy, target += pitch, source += pitch) {
+			const T * from = reinterpret_cast<const T *>(source);
+			T * to = reinterpret_cast<T *>(target);
+
+			for (PixelMask rowMask = mask[iy]; rowMask; rowMask >>= 1, ++from, ++to) {
+				if (rowMask & 1) {
+					*to = *from;
+				}
+			}
+		}
+	}
+#endif
+
+	// Affine interpolation across a span of extent pixels displaces the
+	// perspective correct values by up to (sqrt(r) - 1) / (sqrt(r) + 1), or
+	// about (r - 1) / 4, of the span, where r is the ratio of the largest to
+	// the smallest 1/w; compare this error against bound (pixels as 16.16)
+	inline bool ExceedsAffineError(I32 minInvW, I32 maxInvW, I32 extent, I32 bound) {
+		if (minInvW <= 0)
+			return true;
+
+		return (static_cast<I64>(maxInvW - minInvW) * extent << 14) > static_cast<I64>(minInvW) * bound;
+	}
+
+	inline void ExtendRange(I32 value, bool & found, I32 & minValue, I32 & maxValue) {
+		if (!found) {
+			found = true;
+			minValue = maxValue = value;
+		} else {
+			minValue = EGL_Min(minValue, value);
+			maxValue = EGL_Max(maxValue, value);
+		}
+	}
+
+	// x extent of the part of a triangle within y0 <= y <= y1; coordinates
+	// are 28.4, the extent is widened by one unit to cover rounding of the
+	// edge intersections. Returns false if the triangle misses these rows.
+	bool RowExtent(const I32 x[3], const I32 y[3], I32 y0, I32 y1, I32 & xmin, I32 & xmax) {
+		bool found = false;
+
+		for (I32 i = 0; i < 3; ++i) {
+			I32 j = (i == 2) ? 0 : i + 1;
+
+			if (y[i] >= y0 && y[i] <= y1) {
+				ExtendRange(x[i], found, xmin, xmax);
+			}
+
+			// intersections of edge i, j with the boundaries of the rows
+			for (I32 yb = y0; ; yb = y1) {
+				if ((y[i] < yb && y[j] > yb) || (y[i] > yb && y[j] < yb)) {
+					I32 xb = x[i] + static_cast<I32>(static_cast<I64>(x[j] - x[i]) * (yb - y[i]) / (y[j] - y[i]));
+
+					ExtendRange(xb - 1, found, xmin, xmax);
+					ExtendRange(xb + 1, found, xmin, xmax);
+				}
+
+				if (yb == y1)
+					break;
+			}
+		}
+
+		return found;
+	}
+
+	// advance the interpolants and surface pointers of a row of blocks
+	// by a number of pixels
+	inline void AdvanceBlockRow(Variables & vars, I32 & depth, I32 numVarying,
+								U8 *& colorBuffer, U8 *& depthStencilBuffer,
+								const SurfaceInfo & surface, I32 pixels) {
+		depth += vars.Depth.dX * pixels;
+		vars.InvW.Value += vars.InvW.dX * pixels;
+
+		for (I32 index = numVarying; --index >= 0; ) {
+			vars.VaryingInvW[index].Value += vars.VaryingInvW[index].dX * pixels;
+		}
+
+		colorBuffer += pixels << surface.ColorOffsetShift;
+		depthStencilBuffer += (pixels * EGL_RASTER_BLOCK_SIZE) << surface.DepthStencilOffsetShift;
+	}
+
+	// bilinear interpolation of the values at the corners of a square of
+	// size 1 << logSize; corners[row][column]
+	inline I32 BlockCorner(const I32 corners[2][2], I32 x, I32 y, I32 logSize) {
+		I32 left = corners[0][0] + Mul(corners[1][0] - corners[0][0], y, logSize);
+		I32 right = corners[0][1] + Mul(corners[1][1] - corners[0][1], y, logSize);
+
+		return left + Mul(right - left, x, logSize);
+	}
 }
 
 
@@ -144,18 +265,56 @@ namespace EGL {
 void Rasterizer :: PrepareTriangle() {
 	Prepare();
 
-	m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockDepthStencil,
-									 m_State, &m_VaryingInfo);
+	// the block functions may be compiled in the background
+	bool compiled = true;
+
+	compiled &= m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockDepthStencil,
+												 m_State, &m_VaryingInfo, true);
 
-	m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockEdgeDepthStencil,
-									 m_State, &m_VaryingInfo);
+	compiled &= m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockEdgeDepthStencil,
+												 m_State, &m_VaryingInfo, true);
+
+	compiled &= m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockColorAlpha,
+												 m_State, &m_VaryingInfo, true);
+
+#if EGL_USE_JIT
+	// blocks inside of the scissor rectangle use code without scissor test
+	if (m_State->IsEnabledScissorTest()) {
+		m_UnscissoredState = *m_State;
+		m_UnscissoredState.EnableScissorTest(false);
+
+		compiled &= m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockDepthStencil,
+													 &m_UnscissoredState, &m_VaryingInfo, true);
+
+		compiled &= m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockEdgeDepthStencil,
+													 &m_UnscissoredState, &m_VaryingInfo, true);
+	}
 
-	m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockColorAlpha,
-									 m_State, &m_VaryingInfo);
+	m_CompiledBlockFunctions = compiled;
+
+	// the variant for fully covered blocks is not required to use the JIT
+	m_CompiledFullBlockFunction =
+		m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockFullColorAlpha,
+										 m_State, &m_VaryingInfo, true);
+
+	// the single pass function is used for blocks inside of the scissor
+	// rectangle only; with the alpha test enabled, whether depth and stencil
+	// are written would depend on the order of the tests, so such states
+	// keep the separate passes
+	m_CompiledDepthStencilColorAlphaFunction = !m_State->IsEnabledAlphaTest() &&
+		m_FunctionCache->PrepareFunction(PipelinePart::PartRasterBlockDepthStencilColorAlpha,
+										 m_State->IsEnabledScissorTest() ? &m_UnscissoredState : m_State,
+										 &m_VaryingInfo, true);
+#endif
 }
 
 void Rasterizer :: BeginTriangle() {
 	memset(m_RasterInfo.MipmapLevel, 0, sizeof(m_RasterInfo.MipmapLevel));
+#if EGL_USE_JIT
+	if (!m_CompiledBlockFunctions) {
+		return;
+	}
+#endif
 
 		m_BlockDepthStencilFunction = (BlockDepthStencilFunction *) //&RBDepthTestLess;
 		m_FunctionCache->GetFunction(PipelinePart::PartRasterBlockDepthStencil,
@@ -168,189 +327,653 @@ void Rasterizer :: BeginTriangle() {
 		m_BlockColorAlphaFunction = (BlockColorAlphaFunction *) //&RBTextureReplace;
 		m_FunctionCache->GetFunction(PipelinePart::PartRasterBlockColorAlpha,
 									 m_State);
+
+#if EGL_USE_JIT
+	if (m_State->IsEnabledScissorTest()) {
+		m_UnscissoredBlockDepthStencilFunction = (BlockDepthStencilFunction *)
+			m_FunctionCache->GetFunction(PipelinePart::PartRasterBlockDepthStencil,
+										 &m_UnscissoredState);
+
+		m_UnscissoredBlockEdgeDepthStencilFunction = (BlockEdgeDepthStencilFunction *)
+			m_FunctionCache->GetFunction(PipelinePart::PartRasterBlockEdgeDepthStencil,
+										 &m_UnscissoredState);
+	} else {
+		m_UnscissoredBlockDepthStencilFunction = m_BlockDepthStencilFunction;
+		m_UnscissoredBlockEdgeDepthStencilFunction = m_BlockEdgeDepthStencilFunction;
+	}
+
+	m_BlockFullColorAlphaFunction = m_CompiledFullBlockFunction ?
+		(BlockColorAlphaFunction *)
+			m_FunctionCache->GetFunction(PipelinePart::PartRasterBlockFullColorAlpha, m_State) :
+		0;
+
+	m_BlockDepthStencilColorAlphaFunction = m_CompiledDepthStencilColorAlphaFunction ?
+		(BlockDepthStencilColorAlphaFunction *)
+			m_FunctionCache->GetFunction(PipelinePart::PartRasterBlockDepthStencilColorAlpha,
+										 m_State->IsEnabledScissorTest() ? &m_UnscissoredState : m_State) :
+		0;
+#endif
 }
 
-#if !EGL_USE_JIT
+#if EGL_USE_C_BLOCK_FUNCTIONS
 
-PixelMask Rasterizer :: RasterBlockDepthStencil(const Variables * vars,
-												PixelMask * pixelMask) {
+// ---------------------------------------------------------------------------
+// Row kernels of the C block rasterizer
+//
+// The kernels evaluate a complete row of a block at once and produce the
+// PixelMask of the row directly. The SSE2 versions process the 8 pixels of
+// a row in two vectors of 32-bit edge values and one vector of 16-bit depth
+// values; other configurations use the equivalent scalar loops.
+// ---------------------------------------------------------------------------
+
+namespace {
+
+#if EGL_USE_SSE2 && EGL_RASTER_BLOCK_SIZE == 8
+
+	// combine two vectors of 32-bit lane masks into a pixel mask
+	inline PixelMask PixelMaskFromLanes(__m128i lo, __m128i hi) {
+		return (PixelMask)
+			(_mm_movemask_ps(_mm_castsi128_ps(lo)) | (_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4));
+	}
+
+	// expand a pixel mask into a vector of 16-bit lane masks
+	inline __m128i LanesFromPixelMask(PixelMask mask) {
+		const __m128i bits = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+		return _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(mask), bits), bits);
+	}
+
+	// clamp 32-bit lanes to the range of the depth buffer
+	inline __m128i ClampDepth(__m128i depth) {
+		const __m128i maxDepth = _mm_set1_epi32(0xffff);
+		__m128i over = _mm_or_si128(_mm_cmpgt_epi32(depth, maxDepth),
+									_mm_cmplt_epi32(depth, _mm_setzero_si128()));
+
+		return _mm_or_si128(_mm_andnot_si128(over, depth), _mm_and_si128(over, maxDepth));
+	}
+
+#endif
+
+	// -----------------------------------------------------------------------
+	// Coverage of a block row by the three edge functions of a triangle
+	// -----------------------------------------------------------------------
+	class EdgeRowKernel {
+	public:
+		EdgeRowKernel(const Edges * edges) {
+#if EGL_USE_SSE2 && EGL_RASTER_BLOCK_SIZE == 8
+			Init(0, edges->edge12.FDY);
+			Init(1, edges->edge23.FDY);
+			Init(2, edges->edge31.FDY);
+#else
+			m_FDY[0] = edges->edge12.FDY;
+			m_FDY[1] = edges->edge23.FDY;
+			m_FDY[2] = edges->edge31.FDY;
+#endif
+		}
+
+		// bit ix is set if all edge functions are positive at pixel ix;
+		// CX1, CX2, CX3 are the values at the first pixel of the row
+		PixelMask Row(I32 CX1, I32 CX2, I32 CX3) const {
+#if EGL_USE_SSE2 && EGL_RASTER_BLOCK_SIZE == 8
+			const __m128i zero = _mm_setzero_si128();
+			__m128i c1 = _mm_set1_epi32(CX1);
+			__m128i c2 = _mm_set1_epi32(CX2);
+			__m128i c3 = _mm_set1_epi32(CX3);
+
+			__m128i lo =
+				_mm_and_si128(_mm_and_si128(
+					_mm_cmpgt_epi32(_mm_add_epi32(c1, m_Lo[0]), zero),
+					_mm_cmpgt_epi32(_mm_add_epi32(c2, m_Lo[1]), zero)),
+					_mm_cmpgt_epi32(_mm_add_epi32(c3, m_Lo[2]), zero));
+
+			__m128i hi =
+				_mm_and_si128(_mm_and_si128(
+					_mm_cmpgt_epi32(_mm_add_epi32(c1, m_Hi[0]), zero),
+					_mm_cmpgt_epi32(_mm_add_epi32(c2, m_Hi[1]), zero)),
+					_mm_cmpgt_epi32(_mm_add_epi32(c3, m_Hi[2]), zero));
+
+			return PixelMaskFromLanes(lo, hi);
+#else
+			U32 mask = 0;
+
+			for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ix++) {
+				mask |= (U32) ((CX1 > 0) & (CX2 > 0) & (CX3 > 0)) << ix;
+
+				CX1 += m_FDY[0];
+				CX2 += m_FDY[1];
+				CX3 += m_FDY[2];
+			}
+
+			return (PixelMask) mask;
+#endif
+		}
+
+	private:
+#if EGL_USE_SSE2 && EGL_RASTER_BLOCK_SIZE == 8
+		void Init(I32 edge, I32 FDY) {
+			m_Lo[edge] = _mm_setr_epi32(0, FDY, 2 * FDY, 3 * FDY);
+			m_Hi[edge] = _mm_add_epi32(m_Lo[edge], _mm_set1_epi32(4 * FDY));
+		}
+
+		__m128i		m_Lo[3];		// edge offsets of pixels 0..3
+		__m128i		m_Hi[3];		// edge offsets of pixels 4..7
+#else
+		I32			m_FDY[3];
+#endif
+	};
+
+	// -----------------------------------------------------------------------
+	// Depth test of a block row against a 16-bit depth buffer without
+	// stencil. The comparison functions are encoded as the set of
+	// accepted outcomes: bit 0 for less, bit 1 for equal, bit 2 for greater.
+	// -----------------------------------------------------------------------
+	class DepthRowKernel {
+	public:
+		DepthRowKernel(RasterizerState::ComparisonFunc func, bool write, I32 dX)
+			: m_Func(func), m_Write(write), m_dX(dX)
+		{
+#if EGL_USE_SSE2 && EGL_RASTER_BLOCK_SIZE == 8
+			m_Less		= _mm_set1_epi16((func & 1) ? -1 : 0);
+			m_Equal		= _mm_set1_epi16((func & 2) ? -1 : 0);
+			m_Greater	= _mm_set1_epi16((func & 4) ? -1 : 0);
+			m_DepthLo	= _mm_setr_epi32(0, dX, 2 * dX, 3 * dX);
+			m_DepthHi	= _mm_add_epi32(m_DepthLo, _mm_set1_epi32(4 * dX));
+#endif
+		}
+
+		// test the pixels set in coverage; depth is 28.4 at the first
+		// pixel of the row; returns the mask of pixels that passed
+		PixelMask Row(U16 * zBuffer, I32 depth, PixelMask coverage) const {
+#if EGL_USE_SSE2 && EGL_RASTER_BLOCK_SIZE == 8
+			// depth values are biased into the signed range for packing and comparison
+			const __m128i bias32 = _mm_set1_epi32(0x8000);
+			const __m128i bias16 = _mm_set1_epi16((short) 0x8000);
+
+			__m128i base = _mm_set1_epi32(depth);
+			__m128i lo = ClampDepth(_mm_srai_epi32(_mm_add_epi32(base, m_DepthLo), 4));
+			__m128i hi = ClampDepth(_mm_srai_epi32(_mm_add_epi32(base, m_DepthHi), 4));
+			__m128i fragment = _mm_packs_epi32(_mm_sub_epi32(lo, bias32), _mm_sub_epi32(hi, bias32));
+
+			__m128i stored = _mm_loadu_si128(reinterpret_cast<const __m128i *>(zBuffer));
+			__m128i buffer = _mm_xor_si128(stored, bias16);
+
+			__m128i pass =
+				_mm_or_si128(_mm_or_si128(
+					_mm_and_si128(_mm_cmplt_epi16(fragment, buffer), m_Less),
+					_mm_and_si128(_mm_cmpeq_epi16(fragment, buffer), m_Equal)),
+					_mm_and_si128(_mm_cmpgt_epi16(fragment, buffer), m_Greater));
+
+			pass = _mm_and_si128(pass, LanesFromPixelMask(coverage));
+
+			PixelMask mask = (PixelMask)
+				_mm_movemask_epi8(_mm_packs_epi16(pass, _mm_setzero_si128()));
+
+			if (mask && m_Write) {
+				__m128i result =
+					_mm_or_si128(_mm_and_si128(pass, _mm_xor_si128(fragment, bias16)),
+								 _mm_andnot_si128(pass, stored));
+
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(zBuffer), result);
+			}
+
+			return mask;
+#else
+			U32 mask = 0;
+
+			for (I32 ix = 0; coverage; ix++, coverage >>= 1, depth += m_dX) {
+				if (coverage & 1) {
+					U32 value = (U32) (depth >> 4);
+					value = value > 0xffff ? 0xffff : value;
+
+					U32 stored = zBuffer[ix];
+					I32 outcome = value < stored ? 1 : value == stored ? 2 : 4;
+
+					if (m_Func & outcome) {
+						mask |= 1u << ix;
+
+						if (m_Write)
+							zBuffer[ix] = (U16) value;
+					}
+				}
+			}
+
+			return (PixelMask) mask;
+#endif
+		}
+
+	private:
+		I32			m_Func;
+		bool		m_Write;
+		I32			m_dX;
+
+#if EGL_USE_SSE2 && EGL_RASTER_BLOCK_SIZE == 8
+		__m128i		m_Less, m_Equal, m_Greater;
+		__m128i		m_DepthLo;		// depth offsets of pixels 0..3
+		__m128i		m_DepthHi;		// depth offsets of pixels 4..7
+#endif
+	};
+}
+
+
+namespace {
+
+	// Clear the quadrants of a raster block that are outside of an edge;
+	// used for small triangles, which cover only a fraction of their blocks
+	void PruneQuadrants(const Edges * edges, PixelMask * pixelMask) {
+		const I32 logQuadrant = EGL_LOG_RASTER_BLOCK_SIZE - 1;
+		const I32 quadrant = 1 << logQuadrant;
+		const Edge * edge[] = { &edges->edge12, &edges->edge23, &edges->edge31 };
+
+		for (I32 qy = 0; qy < EGL_RASTER_BLOCK_SIZE; qy += quadrant) {
+			for (I32 qx = 0; qx < EGL_RASTER_BLOCK_SIZE; qx += quadrant) {
+				for (I32 index = 0; index < 3; ++index) {
+					I32 cy = edge[index]->CY + edge[index]->FDY * qx - edge[index]->FDX * qy;
+
+					if (!EdgeCorners(cy, edge[index]->FDY, edge[index]->FDX, logQuadrant)) {
+						PixelMask clear = (PixelMask) ~SpanPixelMask(qx, qx + quadrant);
+
+						for (I32 iy = qy; iy < qy + quadrant; ++iy) {
+							pixelMask[iy] &= clear;
+						}
+
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+#endif // EGL_USE_C_BLOCK_FUNCTIONS
+
+#if EGL_USE_JIT
+
+namespace {
+
+	// true if no pixel of the raster block is masked
+	inline bool IsFullBlockMask(const PixelMask * pixelMask) {
+		PixelMask mask = SpanPixelMask(0, EGL_RASTER_BLOCK_SIZE);
+
+		for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; ++iy) {
+			mask &= pixelMask[iy];
+		}
+
+		return mask == SpanPixelMask(0, EGL_RASTER_BLOCK_SIZE);
+	}
+}
+
+#endif // EGL_USE_JIT
+
+#if EGL_USE_C_BLOCK_FUNCTIONS
+
+
+PixelMask Rasterizer :: ScissorBlockMask(I32 x, I32 y, PixelMask * pixelMask) const {
+
+	PixelMask rowMask = SpanPixelMask(0, EGL_RASTER_BLOCK_SIZE);
+	I32 top = 0, bottom = EGL_RASTER_BLOCK_SIZE;
+
+	if (m_State->IsEnabledScissorTest()) {
+		I32 left = EGL_Max(m_State->m_ScissorTest.X - x, 0);
+		I32 right = EGL_Min(m_State->m_ScissorTest.X + m_State->m_ScissorTest.Width - x, EGL_RASTER_BLOCK_SIZE);
+
+		top = EGL_Max(m_State->m_ScissorTest.Y - y, 0);
+		bottom = EGL_Min(m_State->m_ScissorTest.Y + m_State->m_ScissorTest.Height - y, EGL_RASTER_BLOCK_SIZE);
+
+		rowMask = (left < right && top < bottom) ? SpanPixelMask(left, right) : 0;
+	}
+
+    for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+		pixelMask[iy] = (iy >= top && iy < bottom) ? rowMask : 0;
+	}
+
+	return rowMask;
+}
+
+
+PixelMask Rasterizer :: DepthStencilBlock(I32 x, I32 y, I32 depth, I32 dX, I32 dY,
+										  PixelMask * pixelMask) {
 
 	PixelMask * mask = pixelMask, totalMask = 0;
-	I32 depth0 = vars->Depth.Value;
 
 	// initialize surface pointers in local info block
 	SurfaceInfo surfaceInfo = m_RasterInfo.RasterSurface;
+	const I32 depthStencilRowStride = EGL_RASTER_BLOCK_SIZE << surfaceInfo.DepthStencilOffsetShift;
 
-    for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+	// the row kernels may touch every pixel of a row, so they are restricted
+	// to blocks inside of the surface
+	if (m_State->m_DepthTest.Enabled && !m_State->m_Stencil.Enabled &&
+		m_State->GetDepthStencilFormat() == DepthStencilFormatDepth16 &&
+		x >= 0 && x + EGL_RASTER_BLOCK_SIZE <= m_Surface->GetWidth() &&
+		y >= 0 && y + EGL_RASTER_BLOCK_SIZE <= m_Surface->GetHeight()) {
 
-		PixelMask rowMask = 0;
+		DepthRowKernel kernel(m_State->m_DepthTest.Func, m_State->GetDepthMask(), dX);
 
-        for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ix++) {
+		for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+			if (*mask) {
+				*mask = kernel.Row(reinterpret_cast<U16 *>(surfaceInfo.DepthStencilBuffer), depth, *mask);
+				totalMask |= *mask;
+			}
 
-			bool written = false;
+			++mask;
+			depth += dY;
+			surfaceInfo.DepthStencilBuffer += depthStencilRowStride;
+		}
 
-            // test and write depth and stencil
-			if (!m_State->IsEnabledScissorTest() ||
-				m_State->m_ScissorTest.X <= vars->x + ix &&
-				m_State->m_ScissorTest.X + m_State->m_ScissorTest.Width > vars->x + ix &&
-				m_State->m_ScissorTest.Y <= vars->y + iy &&
-				m_State->m_ScissorTest.Y + m_State->m_ScissorTest.Height > vars->y + iy) {
-				written = FragmentDepthStencil(&m_RasterInfo, &surfaceInfo, ix, depth0 >> 4);
-			}
+		return totalMask;
+	}
 
-			rowMask = (rowMask >> 1) | (written ? (1 << (EGL_RASTER_BLOCK_SIZE - 1)) : 0);
-			depth0 += vars->Depth.dX;
-        }
+    for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+
+		PixelMask coverage = *mask;
+		U32 rowMask = 0;
+		I32 depth1 = depth;
 
-		*mask++ = rowMask;
-		totalMask |= rowMask;
+		for (I32 ix = 0; coverage; ix++, coverage >>= 1, depth1 += dX) {
+            // test and write depth and stencil
+			if ((coverage & 1) &&
+				FragmentDepthStencil(&m_RasterInfo, &surfaceInfo, ix, depth1 >> 4)) {
+				rowMask |= 1u << ix;
+			}
+		}
 
-		depth0 += vars->Depth.dY - (vars->Depth.dX << EGL_LOG_RASTER_BLOCK_SIZE);
+		*mask++ = (PixelMask) rowMask;
+		totalMask |= (PixelMask) rowMask;
 
-		surfaceInfo.DepthStencilBuffer += EGL_RASTER_BLOCK_SIZE << m_RasterInfo.RasterSurface.DepthStencilOffsetShift;
+		depth += dY;
+		surfaceInfo.DepthStencilBuffer += depthStencilRowStride;
     }
 
 	return totalMask;
 }
 
+
+PixelMask Rasterizer :: RasterBlockDepthStencil(const Variables * vars,
+												PixelMask * pixelMask) {
+
+	return DepthStencilBlock(vars->x, vars->y, vars->Depth.Value,
+							 vars->Depth.dX, vars->Depth.dY, pixelMask);
+}
+
 PixelMask Rasterizer :: RasterBlockEdgeDepthStencil(const Variables * vars,
 													const Edges * edges,
 													PixelMask * pixelMask) {
 
-	PixelMask * mask = pixelMask, totalMask = 0;
-	I32 depth0 = vars->Depth.Value;
-
-	// initialize surface pointers in local info block
-	SurfaceInfo surfaceInfo = m_RasterInfo.RasterSurface;
+	EdgeRowKernel kernel(edges);
 
 	I32 CY1 = edges->edge12.CY;
 	I32 CY2 = edges->edge23.CY;
 	I32 CY3 = edges->edge31.CY;
 
+	// restrict the scissor coverage to the inside of the triangle
     for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
-        GLint CX1 = CY1, CX2 = CY2, CX3 = CY3;
-		I32 depth1 = depth0;
-		PixelMask rowMask = 0;
-		bool done = false;
-
-        for(I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ix++) {
-            if (CX1 > 0 && CX2 > 0 && CX3 > 0) {
-				// test and write depth and stencil
-				bool written = false;
-
-				// test and write depth and stencil
-				if (!m_State->IsEnabledScissorTest() ||
-					m_State->m_ScissorTest.X <= vars->x + ix &&
-					m_State->m_ScissorTest.X + m_State->m_ScissorTest.Width > vars->x + ix &&
-					m_State->m_ScissorTest.Y <= vars->y + iy &&
-					m_State->m_ScissorTest.Y + m_State->m_ScissorTest.Height > vars->y + iy) {
-					written = FragmentDepthStencil(&m_RasterInfo, &surfaceInfo, ix, depth1 >> 4);
-				}
-
-				rowMask >>= 1;
-				rowMask |= written ? (1 << (EGL_RASTER_BLOCK_SIZE - 1)) : 0;
-				done = true;
-            } else if (done) {
-				rowMask >>= EGL_RASTER_BLOCK_SIZE - ix;
-				break;
-			} else {
-				rowMask >>= 1;
-			}
-
-            CX1 += edges->edge12.FDY;
-			CX2 += edges->edge23.FDY;
-			CX3 += edges->edge31.FDY;
-			depth1 += vars->Depth.dX;
-        }
-
-		*mask++ = rowMask;
-		totalMask |= rowMask;
+		if (pixelMask[iy]) {
+			pixelMask[iy] &= kernel.Row(CY1, CY2, CY3);
+		}
 
         CY1 -= edges->edge12.FDX;
 		CY2 -= edges->edge23.FDX;
 		CY3 -= edges->edge31.FDX;
+	}
 
-		depth0 += vars->Depth.dY;
+	return DepthStencilBlock(vars->x, vars->y, vars->Depth.Value,
+							 vars->Depth.dX, vars->Depth.dY, pixelMask);
+}
 
-		surfaceInfo.DepthStencilBuffer += EGL_RASTER_BLOCK_SIZE << m_RasterInfo.RasterSurface.DepthStencilOffsetShift;
-    }
+PixelMask Rasterizer :: RasterBlockMaskedDepthStencil(I32 x, I32 y, U32 depth,
+													  PixelMask * pixelMask) {
+
+	SurfaceInfo & surfaceInfo = m_RasterInfo.RasterSurface;
+	U8 * depthStencilBuffer = surfaceInfo.DepthStencilBuffer;
+	PixelMask totalMask = 0;
+
+	depth = depth > 0xffff ? 0xffff : depth;
+
+	// the first plane holds the coverage until the other planes have a copy
+	for (I32 sample = surfaceInfo.Samples; --sample >= 0; ) {
+		PixelMask * sampleMask = pixelMask + sample * EGL_RASTER_BLOCK_SIZE;
+
+		if (sample) {
+			memcpy(sampleMask, pixelMask, EGL_RASTER_BLOCK_SIZE * sizeof(PixelMask));
+		}
+
+		surfaceInfo.DepthStencilBuffer = depthStencilBuffer + sample * surfaceInfo.SampleDepthStencilStride;
+		totalMask |= DepthStencilBlock(x, y, depth << 4, 0, 0, sampleMask);
+	}
+
+	surfaceInfo.DepthStencilBuffer = depthStencilBuffer;
 
 	return totalMask;
 }
 
+void Rasterizer :: SelectQuadMipmapLevels(I32 varying0[][2], I32 varying1[][2]) {
+
+	for (I32 unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		I32 textureBase = m_VaryingInfo.textureBase[unit];
+
+		if (textureBase >= 0 && m_UseMipmap[unit]) {
+			I32 dUdX = varying0[textureBase][1];
+			I32 dUdY = varying1[textureBase][0] - varying0[textureBase][0];
+			I32 dVdX = varying0[textureBase + 1][1];
+			I32 dVdY = varying1[textureBase + 1][0] - varying0[textureBase + 1][0];
+
+			I32 maxDu = EGL_Max(EGL_Abs(dUdX), EGL_Abs(dUdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogWidth());
+			I32 maxDv = EGL_Max(EGL_Abs(dVdX), EGL_Abs(dVdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogHeight());
+
+			I32 rho = maxDu + maxDv;
+
+			// nearest/minification only selection; magnification uses the base level
+			m_RasterInfo.MipmapLevel[unit] = rho > 0 ? EGL_Min(Log2(rho), m_RasterInfo.MaxMipmapLevel[unit]) : 0;
+			m_RasterInfo.Textures[unit] = m_Texture[unit]->GetTexture(m_RasterInfo.MipmapLevel[unit]);
+		}
+	}
+}
+
+bool Rasterizer :: QuadFragmentShade(I32 varying[][2], I32 step, Color& color) {
+	if (m_ShadeFunction) {
+		m_ShadeFunction(&m_RasterInfo, &m_VaryingInfo, varying, step, color);
+		return true;
+	}
+
+	I32 tu[EGL_NUM_TEXTURE_UNITS], tv[EGL_NUM_TEXTURE_UNITS];
+	Color baseColor;
+	I32 fog;
+
+	for (I32 unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		I32 textureBase = m_VaryingInfo.textureBase[unit];
+
+		if (textureBase >= 0) {
+			tu[unit] = varying[textureBase][0] + step * varying[textureBase][1];
+			tv[unit] = varying[textureBase + 1][0] + step * varying[textureBase + 1][1];
+		}
+	}
+
+	if (m_VaryingInfo.colorIndex >= 0) {
+		I32 colorIndex = m_VaryingInfo.colorIndex;
+
+		baseColor = FractionalColor(
+			varying[colorIndex][0] + step * varying[colorIndex][1],
+			varying[colorIndex + 1][0] + step * varying[colorIndex + 1][1],
+			varying[colorIndex + 2][0] + step * varying[colorIndex + 2][1],
+			varying[colorIndex + 3][0] + step * varying[colorIndex + 3][1]);
+	}
+
+	if (m_VaryingInfo.fogIndex >= 0) {
+		fog = varying[m_VaryingInfo.fogIndex][0] + step * varying[m_VaryingInfo.fogIndex][1];
+	}
+
+	return FragmentShade(tu, tv, baseColor, fog, EGL_ONE, color);
+}
+
 void Rasterizer :: RasterBlockColorAlpha(I32 varying[][2][2],
 										 const PixelMask * pixelMask) {
 	const PixelMask * mask = pixelMask;
+	const I32 numVarying = m_VaryingInfo.numVarying;
+	const I32 samples = m_RasterInfo.RasterSurface.Samples;
+	const I32 sampleColorStride = m_RasterInfo.RasterSurface.SampleColorStride;
+	I32 index, sample;
 
-	// initialize surface pointers in local info block
-	SurfaceInfo surfaceInfo = m_RasterInfo.RasterSurface;
+	// the block is traversed in quads of 2x2 pixels; the shaded colors of
+	// both rows of the quads are written out a row at a time
+	SurfaceInfo surfaceInfo0 = m_RasterInfo.RasterSurface;
+	SurfaceInfo surfaceInfo1 = m_RasterInfo.RasterSurface;
+	surfaceInfo1.ColorBuffer += surfaceInfo1.Pitch << surfaceInfo1.ColorOffsetShift;
 
-    for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+	const I32 quadLineStride = (2 * surfaceInfo0.Pitch) << surfaceInfo0.ColorOffsetShift;
+
+	for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy += 2, mask += 2) {
 
-		I32 index;
+		// values and increments along the two rows of the quads
 		I32 varying0[EGL_MAX_NUM_VARYING][2];
-		PixelMask rowMask = *mask++;
+		I32 varying1[EGL_MAX_NUM_VARYING][2];
 
-		for (index = 0; index < m_VaryingInfo.numVarying; ++index) {
+		for (index = 0; index < numVarying; ++index) {
 			varying0[index][0] = varying[index][0][0];
 			varying0[index][1] = (varying[index][1][0] - varying[index][0][0]) >> EGL_LOG_RASTER_BLOCK_SIZE;
-		}
 
-        for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ix++) {
+			varying[index][0][0] += varying[index][0][1];
+			varying[index][1][0] += varying[index][1][1];
+
+			varying1[index][0] = varying[index][0][0];
+			varying1[index][1] = (varying[index][1][0] - varying[index][0][0]) >> EGL_LOG_RASTER_BLOCK_SIZE;
+
+			varying[index][0][0] += varying[index][0][1];
+			varying[index][1][0] += varying[index][1][1];
+		}
 
-			if (rowMask & 1) {
-				I32 tu[EGL_NUM_TEXTURE_UNITS], tv[EGL_NUM_TEXTURE_UNITS];
-				Color baseColor;
-				I32 fog;
+		Color colors0[EGL_RASTER_BLOCK_SIZE], colors1[EGL_RASTER_BLOCK_SIZE];
+		U32 outputMask0 = 0, outputMask1 = 0;
+		U32 rowMask0 = 0, rowMask1 = 0;
 
-				for (I32 unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
-					size_t textureBase = m_VaryingInfo.textureBase[unit];
+		// shade the pixels covered by any sample
+		for (sample = 0; sample < samples; ++sample) {
+			rowMask0 |= mask[sample * EGL_RASTER_BLOCK_SIZE];
+			rowMask1 |= mask[sample * EGL_RASTER_BLOCK_SIZE + 1];
+		}
 
-					if (textureBase >= 0) {
-						tu[unit] = varying0[textureBase][0];
-						tv[unit] = varying0[textureBase + 1][0];
-					}
-				}
+		for (I32 ix = 0; rowMask0 | rowMask1; ix += 2, rowMask0 >>= 2, rowMask1 >>= 2) {
 
-				if (m_VaryingInfo.colorIndex >= 0) {
-					//baseColor = FractionalColor(varying0 + m_VaryingInfo.colorIndex);
-					baseColor = FractionalColor(
-						varying0[m_VaryingInfo.colorIndex][0],
-						varying0[m_VaryingInfo.colorIndex + 1][0],
-						varying0[m_VaryingInfo.colorIndex + 2][0],
-						varying0[m_VaryingInfo.colorIndex + 3][0]);
+			if ((rowMask0 | rowMask1) & 3) {
+				if (m_MipmapPerQuad) {
+					SelectQuadMipmapLevels(varying0, varying1);
 				}
 
-				if (m_VaryingInfo.fogIndex >= 0) {
-					fog = varying0[m_VaryingInfo.fogIndex][0];
-				}
+				if ((rowMask0 & 1) && QuadFragmentShade(varying0, 0, colors0[ix]))		outputMask0 |= 1u << ix;
+				if ((rowMask0 & 2) && QuadFragmentShade(varying0, 1, colors0[ix + 1]))	outputMask0 |= 2u << ix;
+				if ((rowMask1 & 1) && QuadFragmentShade(varying1, 0, colors1[ix]))		outputMask1 |= 1u << ix;
+				if ((rowMask1 & 2) && QuadFragmentShade(varying1, 1, colors1[ix + 1]))	outputMask1 |= 2u << ix;
+			}
 
-				FragmentColorAlpha(&m_RasterInfo, &surfaceInfo, ix, tu, tv, baseColor, fog, EGL_ONE);
+			for (index = 0; index < numVarying; ++index) {
+				varying0[index][0] += varying0[index][1] << 1;
+				varying1[index][0] += varying1[index][1] << 1;
 			}
+		}
 
-			if (!(rowMask >>= 1))
-				break;
+		for (sample = 0; sample < samples; ++sample) {
+			U32 sampleMask0 = outputMask0 & mask[sample * EGL_RASTER_BLOCK_SIZE];
+			U32 sampleMask1 = outputMask1 & mask[sample * EGL_RASTER_BLOCK_SIZE + 1];
 
-			for (index = 0; index < m_VaryingInfo.numVarying; ++index) {
-				varying0[index][0] += varying0[index][1];
+			if (sampleMask0) {
+				ColorRowOutput(&surfaceInfo0, colors0, DitherRow(iy), (PixelMask) sampleMask0);
 			}
-        }
 
-		for (index = 0; index < m_VaryingInfo.numVarying; ++index) {
-			varying[index][0][0] += varying[index][0][1];
-			varying[index][1][0] += varying[index][1][1];
+			if (sampleMask1) {
+				ColorRowOutput(&surfaceInfo1, colors1, DitherRow(iy + 1), (PixelMask) sampleMask1);
+			}
+
+			surfaceInfo0.ColorBuffer += sampleColorStride;
+			surfaceInfo1.ColorBuffer += sampleColorStride;
 		}
 
-		surfaceInfo.ColorBuffer += surfaceInfo.Pitch << surfaceInfo.ColorOffsetShift;
-    }
+		surfaceInfo0.ColorBuffer += quadLineStride - samples * sampleColorStride;
+		surfaceInfo1.ColorBuffer += quadLineStride - samples * sampleColorStride;
+	}
 }
 
+#endif // EGL_USE_C_BLOCK_FUNCTIONS
+
+PixelMask Rasterizer :: RasterBlockSamplesDepthStencil(const Variables * vars,
+													   const Edges * edges,
+													   bool scissored,
+													   PixelMask * pixelMask) {
+
+	SurfaceInfo & surfaceInfo = m_RasterInfo.RasterSurface;
+	U8 * depthStencilBuffer = surfaceInfo.DepthStencilBuffer;
+	const bool multisample = m_State->IsEnabledMultisample();
+	PixelMask totalMask = 0;
+
+#if EGL_USE_JIT
+	const bool compiled = !EGL_USE_ASYNC_JIT || m_CompiledBlockFunctions;
+#else
+	const bool compiled = false;
+#endif
+
+	// the first plane holds the scissor coverage until the other planes
+	// have a copy; without GL_MULTISAMPLE all samples are at the center
+	for (I32 sample = surfaceInfo.Samples; --sample >= 0; ) {
+		PixelMask * sampleMask = pixelMask + sample * EGL_RASTER_BLOCK_SIZE;
+		I32 sx = multisample ? SamplePosition[sample][0] : 0;
+		I32 sy = multisample ? SamplePosition[sample][1] : 0;
+
+		Variables sampleVars = *vars;
+		Edges sampleEdges = *edges;
+
+		sampleVars.Depth.Value += (vars->Depth.dX * sx + vars->Depth.dY * sy) >> 4;
+		sampleEdges.edge12.CY += (edges->edge12.FDY * sx - edges->edge12.FDX * sy) >> 4;
+		sampleEdges.edge23.CY += (edges->edge23.FDY * sx - edges->edge23.FDX * sy) >> 4;
+		sampleEdges.edge31.CY += (edges->edge31.FDY * sx - edges->edge31.FDX * sy) >> 4;
+
+		surfaceInfo.DepthStencilBuffer = depthStencilBuffer + sample * surfaceInfo.SampleDepthStencilStride;
+
+#if EGL_USE_JIT
+		if (compiled) {
+			totalMask |= scissored ?
+				m_BlockEdgeDepthStencilFunction(&m_RasterInfo, &sampleVars, &sampleEdges, sampleMask) :
+				m_UnscissoredBlockEdgeDepthStencilFunction(&m_RasterInfo, &sampleVars, &sampleEdges, sampleMask);
+		}
+#endif
+#if EGL_USE_C_BLOCK_FUNCTIONS
+		if (!compiled) {
+			if (sample) {
+				memcpy(sampleMask, pixelMask, EGL_RASTER_BLOCK_SIZE * sizeof(PixelMask));
+			}
+
+			totalMask |= RasterBlockEdgeDepthStencil(&sampleVars, &sampleEdges, sampleMask);
+		}
 #endif
+	}
+
+	surfaceInfo.DepthStencilBuffer = depthStencilBuffer;
+
+	return totalMask;
+}
+
+void Rasterizer :: SelectTriangleMipmapLevels(const Variables * vars) {
+
+	for (I32 unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		I32 textureBase = m_VaryingInfo.textureBase[unit];
+
+		if (textureBase >= 0 && m_UseMipmap[unit]) {
+			// the gradients of affinely interpolated coordinates are constant
+			I32 dUdX = vars->VaryingInvW[textureBase].dX;
+			I32 dUdY = vars->VaryingInvW[textureBase].dY;
+			I32 dVdX = vars->VaryingInvW[textureBase + 1].dX;
+			I32 dVdY = vars->VaryingInvW[textureBase + 1].dY;
+
+			I32 maxDu = EGL_Max(EGL_Abs(dUdX), EGL_Abs(dUdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogWidth());
+			I32 maxDv = EGL_Max(EGL_Abs(dVdX), EGL_Abs(dVdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogHeight());
+
+			I32 rho = maxDu + maxDv;
+
+			m_RasterInfo.MipmapLevel[unit] = rho > 0 ? EGL_Min(Log2(rho), m_RasterInfo.MaxMipmapLevel[unit]) : 0;
+			m_RasterInfo.Textures[unit] = m_Texture[unit]->GetTexture(m_RasterInfo.MipmapLevel[unit]);
+		}
+	}
+}
 
 void Rasterizer :: RasterTriangle(const Vertex& a, const Vertex& b,
 								  const Vertex& c) {
 
-	I32 index, unit;			// index into varying variable array & texture unit
+	I32 index;					// index into varying variable array
 
 	Variables vars;
 
@@ -391,25 +1014,165 @@ void Rasterizer :: RasterTriangle(const Vertex& a, const Vertex& b,
 	if (area <= 0xf)
 		return;
 
-	// don't use perspective correction for small triangles; not sure if area is the
-	// right criteria, could also use extent in x and y for extremely skinny triangles
-	bool perspective = true; /*(area <= EGL_MIN_TRIANGLE_PERSPECTIVE) ? 
-					   false 
-					   : m_State->GetPerspectiveCorrection();*/
-	
+#if EGL_USE_JIT
+	// only the asynchronous JIT leaves states without compiled functions
+	const bool compiled = !EGL_USE_ASYNC_JIT || m_CompiledBlockFunctions;
+
+	// fully covered blocks inside of the scissor rectangle need no depth and
+	// stencil pass if neither test is enabled
+	const bool trivialDepthStencil = 
+		!m_State->IsEnabledDepthTest() && !m_State->IsEnabledStencilTest();
+#else
+	const bool compiled = false;
+#endif
+
 	// inv arera as 8.24
 	I32 invArea = EGL_InverseQ(area, 8);
 
+	// The samples of multisample surfaces reach pixels whose centers are
+	// outside of the triangle; extend the bounds by half a pixel (28.4).
+	// Clipped triangles cover no samples outside of the surface.
+	const I32 samples = m_Surface->GetSamples();
+	const I32 sampleMargin = samples > 1 ? (1 << 3) : 0;
+
+#if EGL_USE_JIT
+	// the colors written to the sample planes do not depend on their
+	// contents unless blending, a logic operation, a color mask or the
+	// alpha test is enabled; otherwise, the compiled color function shades
+	// a pixel once, and the other planes receive a copy
+	const bool copySamples = samples > 1 &&
+		!m_State->m_Blend.Enabled && !m_State->m_LogicOp.Enabled && !m_State->m_Alpha.Enabled &&
+		m_State->m_Mask.Red && m_State->m_Mask.Green && m_State->m_Mask.Blue && m_State->m_Mask.Alpha;
+#endif
+
     // Bounding rectangle; round lower bound down to block size
-    const I32 minx = ((min(X1, X2, X3) + 0x7) >> 4) & ~(EGL_RASTER_BLOCK_SIZE - 1);
-    const I32 miny = ((min(Y1, Y2, Y3) + 0x7) >> 4) & ~(EGL_RASTER_BLOCK_SIZE - 1);
-    const I32 maxx = ((max(X1, X2, X3) + 0x8) >> 4) + (EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1);
-    const I32 maxy = ((max(Y1, Y2, Y3) + 0x8) >> 4) + (EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1);
-	const I32 span = maxx - minx;
+    I32 minx = ((min(X1, X2, X3) - sampleMargin + 0x7) >> 4) & ~(EGL_RASTER_BLOCK_SIZE - 1);
+    I32 miny = ((min(Y1, Y2, Y3) - sampleMargin + 0x7) >> 4) & ~(EGL_RASTER_BLOCK_SIZE - 1);
+    I32 maxx = ((max(X1, X2, X3) + sampleMargin + 0x8) >> 4) + (EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1);
+    I32 maxy = ((max(Y1, Y2, Y3) + sampleMargin + 0x8) >> 4) + (EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1);
+
+	minx = EGL_Max(minx, 0);
+	miny = EGL_Max(miny, 0);
+
+	// Clamp the block range to the scissor rectangle; blocks entirely inside
+	// of [innerMinX, innerMaxX) x [innerMinY, innerMaxY) need no scissor test
+	I32 innerMinX = minx, innerMaxX = maxx;
+	I32 innerMinY = miny, innerMaxY = maxy;
+
+	if (m_State->IsEnabledScissorTest()) {
+		const I32 scissorMinX = m_State->m_ScissorTest.X;
+		const I32 scissorMinY = m_State->m_ScissorTest.Y;
+		const I32 scissorMaxX = scissorMinX + m_State->m_ScissorTest.Width;
+		const I32 scissorMaxY = scissorMinY + m_State->m_ScissorTest.Height;
+
+		minx = EGL_Max(minx, scissorMinX & ~(EGL_RASTER_BLOCK_SIZE - 1));
+		miny = EGL_Max(miny, scissorMinY & ~(EGL_RASTER_BLOCK_SIZE - 1));
+		maxx = EGL_Min(maxx, (scissorMaxX + EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1));
+		maxy = EGL_Min(maxy, (scissorMaxY + EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1));
+
+		if (minx >= maxx || miny >= maxy)
+			return;
+
+		innerMinX = (scissorMinX + EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1);
+		innerMinY = (scissorMinY + EGL_RASTER_BLOCK_SIZE - 1) & ~(EGL_RASTER_BLOCK_SIZE - 1);
+		innerMaxX = scissorMaxX & ~(EGL_RASTER_BLOCK_SIZE - 1);
+		innerMaxY = scissorMaxY & ~(EGL_RASTER_BLOCK_SIZE - 1);
+	}
+
+	m_Surface->AddDirtyRect(minx, miny, maxx, maxy);
+
+	// error bound of affine approximations, selected by GL_PERSPECTIVE_CORRECTION_HINT
+	I32 bound;
+
+	switch (m_State->GetPerspectiveCorrection()) {
+	case RasterizerState::PerspectiveCorrectionFastest:	bound = EGL_PERSPECTIVE_ERROR_FASTEST;		break;
+	case RasterizerState::PerspectiveCorrectionNicest:	bound = EGL_PERSPECTIVE_ERROR_NICEST;		break;
+	default:											bound = EGL_PERSPECTIVE_ERROR_DONT_CARE;	break;
+	}
+
+	// Triangles are interpolated affinely if the error of doing so stays
+	// below the bound. This saves the perspective division at the block
+	// corners, and selects a single mipmap level per triangle. As the error
+	// grows with the extent of the triangle, this covers most triangles
+	// within one or two raster blocks, as well as 2D, orthographic and
+	// near-planar geometry. The extent is taken from the vertices rather
+	// than the bounds clamped to the surface and the scissor rectangle, so
+	// that large triangles of which only a small part is visible are still
+	// interpolated correctly.
+	const I32 minInvW = min(a.m_WindowCoords.invW, b.m_WindowCoords.invW, c.m_WindowCoords.invW);
+	const I32 extent = EGL_Max(max(X1, X2, X3) - min(X1, X2, X3), max(Y1, Y2, Y3) - min(Y1, Y2, Y3));
+
+	bool perspective = ExceedsAffineError(
+		minInvW, max(a.m_WindowCoords.invW, b.m_WindowCoords.invW, c.m_WindowCoords.invW),
+		(extent >> 4) + 1, bound);
+
+    I32 DW12;
+    //I32 DW23;
+    I32 DW31;
+
+	if (perspective) {
+		DW12 = a.m_WindowCoords.invW - b.m_WindowCoords.invW;
+		//DW23 = b.m_WindowCoords.invW - c.m_WindowCoords.invW;
+		DW31 = c.m_WindowCoords.invW - a.m_WindowCoords.invW;
+
+		// dWdX, dWdY is 4.28
+		vars.InvW.dX =  Mul64(det2x2(DY12, DW12, DY31, DW31), invArea, 28);
+		vars.InvW.dY = -Mul64(det2x2(DX12, DW12, DX31, DW31), invArea, 28);
+	}
+
+#if EGL_RASTER_STATISTICS
+	m_TriangleStatistics.Area[EGL_Min(Log2((area >> 9) + 1), TriangleStatistics::NUM_AREA_BUCKETS - 1)]++;
+
+	if (!perspective) {
+		m_TriangleStatistics.AffineTriangles++;
+	}
+#endif
+
+	// Select the traversal granularity for this triangle. Large triangles
+	// are set up in blocks of 2x2 raster blocks, which shares the perspective
+	// division at the block corners among four raster blocks. Small triangles
+	// prune the quadrants of each raster block that lie outside of an edge
+	// before scan converting it.
+	// Multisample surfaces do not prune quadrants, as the quadrant tests
+	// are made at pixel centers.
+	I32 logBlockSize = EGL_LOG_RASTER_BLOCK_SIZE;
+
+	if (perspective &&
+		m_State->GetPerspectiveCorrection() != RasterizerState::PerspectiveCorrectionNicest &&
+		maxx - minx >= 4 * EGL_RASTER_BLOCK_SIZE && maxy - miny >= 4 * EGL_RASTER_BLOCK_SIZE &&
+		(area >> 9) >= EGL_LARGE_TRIANGLE_AREA) {
+		// The corners of the raster blocks within a large block are
+		// interpolated bilinearly between the perspective correct values at
+		// the corners of the large block. The change of 1/w across a large
+		// block bounds the error of this like that of an affine span.
+		const I32 largeBlockSize = 2 * EGL_RASTER_BLOCK_SIZE;
+		const I64 change = 
+			(static_cast<I64>(EGL_Abs(vars.InvW.dX)) + EGL_Abs(vars.InvW.dY)) * largeBlockSize;
+
+		if (change < 0x7fffffff - static_cast<I64>(minInvW) &&
+			!ExceedsAffineError(minInvW, minInvW + static_cast<I32>(change), largeBlockSize, bound)) {
+			logBlockSize = EGL_LOG_RASTER_BLOCK_SIZE + 1;
+		}
+	}
+
+#if EGL_USE_C_BLOCK_FUNCTIONS
+	// the compiled edge functions test the pixels of a block in one pass
+	const bool pruneQuadrants = logBlockSize == EGL_LOG_RASTER_BLOCK_SIZE &&
+		(area >> 9) < EGL_SMALL_TRIANGLE_AREA && samples == 1;
+#endif
+
+	const I32 blockSize = 1 << logBlockSize;
+
+	// distance traversed along a row of blocks
+	const I32 span = (maxx - minx + blockSize - 1) & ~(blockSize - 1);
 
 	m_RasterInfo.Init(m_Surface, miny, minx);
-	I32 blockStride = EGL_RASTER_BLOCK_SIZE * m_RasterInfo.RasterSurface.Pitch - span;
-	I32 depthStencilBlockStride = EGL_RASTER_BLOCK_SIZE * (m_RasterInfo.RasterSurface.Pitch - span);
+	I32 blockStride = blockSize * m_RasterInfo.RasterSurface.Pitch - span;
+	I32 depthStencilBlockStride = blockSize * m_RasterInfo.RasterSurface.Pitch - EGL_RASTER_BLOCK_SIZE * span;
+
+	// surface pointers at the origin of the current block
+	U8 * colorBuffer = m_RasterInfo.RasterSurface.ColorBuffer;
+	U8 * depthStencilBuffer = m_RasterInfo.RasterSurface.DepthStencilBuffer;
 
 	const U32 numVarying = m_VaryingInfo.numVarying;
 	U32 usedNumVarying = 0;
@@ -425,6 +1188,11 @@ void Rasterizer :: RasterTriangle(const Vertex& a, const Vertex& b,
 	if (DY23 < 0 || (DY23 == 0 && DX23 > 0)) C2++;
 	if (DY31 < 0 || (DY31 == 0 && DX31 > 0)) C3++;
 
+	// the edge tests of blocks are widened to the samples of their pixels
+	const I32 margin12 = samples > 1 ? SampleEdgeMargin(edges.edge12.FDY, edges.edge12.FDX) : 0;
+	const I32 margin23 = samples > 1 ? SampleEdgeMargin(edges.edge23.FDY, edges.edge23.FDX) : 0;
+	const I32 margin31 = samples > 1 ? SampleEdgeMargin(edges.edge31.FDY, edges.edge31.FDX) : 0;
+
 	I32 XMin1 = (minx << 4) + (1 << 3) - X1;
 	I32 YMin1 = (miny << 4) + (1 << 3) - Y1;
 
@@ -437,252 +1205,430 @@ void Rasterizer :: RasterTriangle(const Vertex& a, const Vertex& b,
 	vars.Depth.dY = -Mul64(det2x2(DX12, DD12, DX31, DD31), invArea, 28);
 	I32 depthSlope=  EGL_Max(EGL_Abs(vars.Depth.dX), EGL_Abs(vars.Depth.dY));
 	I32 factor    =  EGL_Mul(depthSlope, m_State->GetPolygonOffsetFactor());
-	vars.Depth.dBlockLine = vars.Depth.dY * EGL_RASTER_BLOCK_SIZE - vars.Depth.dX * span;
-	vars.Depth.Value = (a.m_WindowCoords.depth << 4) 
+	vars.Depth.dBlockLine = vars.Depth.dY * blockSize - vars.Depth.dX * span;
+
+	// depth at the origin of the current block
+	I32 depth = (a.m_WindowCoords.depth << 4) 
 							+ ((m_State->GetPolygonOffsetUnits() + (1 << 11)) >> 12)
 							+ factor
 							+ Mul(XMin1, vars.Depth.dX, 4)
 							+ Mul(YMin1, vars.Depth.dY, 4);
 
-    I32 DW12;
-    //I32 DW23;
-    I32 DW31;
-
 	if (perspective) {
-		DW12 = a.m_WindowCoords.invW - b.m_WindowCoords.invW;
-		//DW23 = b.m_WindowCoords.invW - c.m_WindowCoords.invW;
-		DW31 = c.m_WindowCoords.invW - a.m_WindowCoords.invW;
-
-	// dWdX, dWdY is 4.28
-	vars.InvW.dX =  Mul64(det2x2(DY12, DW12, DY31, DW31), invArea, 28);
-	vars.InvW.dY = -Mul64(det2x2(DX12, DW12, DX31, DW31), invArea, 28);
-	vars.InvW.dBlockLine = vars.InvW.dY * EGL_RASTER_BLOCK_SIZE - vars.InvW.dX * span;
-	vars.InvW.Value = a.m_WindowCoords.invW
-							  + Mul(XMin1, vars.InvW.dX, 4)
-					   		  + Mul(YMin1, vars.InvW.dY, 4);
+		vars.InvW.dBlockLine = vars.InvW.dY * blockSize - vars.InvW.dX * span;
+		vars.InvW.Value = a.m_WindowCoords.invW
+								  + Mul(XMin1, vars.InvW.dX, 4)
+						   		  + Mul(YMin1, vars.InvW.dY, 4);
+	} else {
+		// 1/w is not used, but it is advanced with the other interpolants
+		vars.InvW.Value = vars.InvW.dX = vars.InvW.dY = vars.InvW.dBlockLine = 0;
 	}
 
+	// the C color stage selects mipmap levels per quad only with perspective
+	m_MipmapPerQuad = perspective;
+
+	const I32 X[3] = { X1, X2, X3 };
+	const I32 Y[3] = { Y1, Y2, Y3 };
+
     // Loop through blocks
-    for (vars.y = miny; vars.y < maxy; vars.y += EGL_RASTER_BLOCK_SIZE) {
-
-        for (vars.x = minx; vars.x < maxx; vars.x += EGL_RASTER_BLOCK_SIZE) {
-
-            // Corners of block as 28.4; move to pixel centers
-            GLint x0 = (vars.x << 4) | (1 << 3);
-            GLint y0 = (vars.y << 4) | (1 << 3);
-
-            // Evaluate half-space functions
-            edges.edge12.CY = C1 + DY12 * x0 - DX12 * y0;
-
-            GLint pass1 = edges.edge12.CY > 0;
-            pass1 += edges.edge12.CY + (edges.edge12.FDY << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-            pass1 += edges.edge12.CY - (edges.edge12.FDX << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-            pass1 += edges.edge12.CY + (edges.edge12.FDY << EGL_LOG_RASTER_BLOCK_SIZE)
-						 - (edges.edge12.FDX << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-
-            edges.edge23.CY = C2 + DY23 * x0 - DX23 * y0;
-            GLint pass2 = edges.edge23.CY > 0;
-            pass2 += edges.edge23.CY + (edges.edge23.FDY << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-            pass2 += edges.edge23.CY - (edges.edge23.FDX << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-            pass2 += edges.edge23.CY + (edges.edge23.FDY << EGL_LOG_RASTER_BLOCK_SIZE)
-						 - (edges.edge23.FDX << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-
-            edges.edge31.CY = C3 + DY31 * x0 - DX31 * y0;
-            GLint pass3 = edges.edge31.CY > 0;
-            pass3 += edges.edge31.CY + (edges.edge31.FDY << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-            pass3 += edges.edge31.CY - (edges.edge31.FDX << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-            pass3 += edges.edge31.CY + (edges.edge31.FDY << EGL_LOG_RASTER_BLOCK_SIZE)
-						 - (edges.edge31.FDX << EGL_LOG_RASTER_BLOCK_SIZE) > 0;
-
-			PixelMask pixelMask[EGL_RASTER_BLOCK_SIZE];
-			PixelMask totalMask;
-
-            // Skip block when outside an edge
-			if (pass1 == 0x0 || pass2 == 0x0 || pass3 == 0x0) {
-				goto cont;
+    for (I32 by = miny; by < maxy; by += blockSize) {
+
+		// Visit only the blocks of this row that the triangle can reach; the
+		// interpolants and surface pointers skip over the others
+		I32 rowMinX = minx, rowMaxX = minx;
+		I32 spanMinX, spanMaxX;
+
+		if (RowExtent(X, Y, (by << 4) - sampleMargin, ((by + blockSize) << 4) + sampleMargin, spanMinX, spanMaxX)) {
+			spanMinX -= sampleMargin;
+			spanMaxX += sampleMargin;
+			rowMinX = minx + (EGL_Max((spanMinX >> 4) - minx, 0) & ~(blockSize - 1));
+			rowMaxX = EGL_Min((spanMaxX >> 4) + 1, maxx);
+
+			// the span may lie outside of a scissored block range
+			if (rowMinX >= rowMaxX) {
+				rowMinX = rowMaxX = minx;
 			}
+		}
 
-			// Accept whole block when totally covered
-            if (pass1 + pass2 + pass3 == 12) {
-#if !EGL_USE_JIT
-				totalMask = RasterBlockDepthStencil(&vars, pixelMask);
-#else
-				totalMask = m_BlockDepthStencilFunction(&m_RasterInfo, &vars, pixelMask);
+		AdvanceBlockRow(vars, depth, usedNumVarying, colorBuffer, depthStencilBuffer,
+						m_RasterInfo.RasterSurface, rowMinX - minx);
+
+		I32 bx;
+
+        for (bx = rowMinX; bx < rowMaxX; bx += blockSize) {
+
+			// values of the varying variables at the corners of the block
+			I32 corners[EGL_MAX_NUM_VARYING][2][2];
+			bool cornersValid = false;
+
+			if (blockSize > EGL_RASTER_BLOCK_SIZE) {
+				// Skip all raster blocks of the block when outside an edge
+				GLint x0 = (bx << 4) | (1 << 3);
+				GLint y0 = (by << 4) | (1 << 3);
+
+				if (!EdgeCorners(C1 + DY12 * x0 - DX12 * y0 + margin12, DY12 << 4, DX12 << 4, logBlockSize) ||
+					!EdgeCorners(C2 + DY23 * x0 - DX23 * y0 + margin23, DY23 << 4, DX23 << 4, logBlockSize) ||
+					!EdgeCorners(C3 + DY31 * x0 - DX31 * y0 + margin31, DY31 << 4, DX31 << 4, logBlockSize)) {
+					goto cont;
+				}
+			}
+
+			for (I32 oy = 0; oy < blockSize && by + oy < maxy; oy += EGL_RASTER_BLOCK_SIZE) {
+				for (I32 ox = 0; ox < blockSize && bx + ox < maxx; ox += EGL_RASTER_BLOCK_SIZE) {
+
+					vars.x = bx + ox;
+					vars.y = by + oy;
+					vars.Depth.Value = depth + vars.Depth.dX * ox + vars.Depth.dY * oy;
+
+					// Corners of raster block as 28.4; move to pixel centers
+					GLint x0 = (vars.x << 4) | (1 << 3);
+					GLint y0 = (vars.y << 4) | (1 << 3);
+
+					// Evaluate half-space functions
+					edges.edge12.CY = C1 + DY12 * x0 - DX12 * y0;
+					edges.edge23.CY = C2 + DY23 * x0 - DX23 * y0;
+					edges.edge31.CY = C3 + DY31 * x0 - DX31 * y0;
+
+					GLint pass1 = EdgeCorners(edges.edge12.CY + margin12, edges.edge12.FDY, edges.edge12.FDX, EGL_LOG_RASTER_BLOCK_SIZE);
+					GLint pass2 = EdgeCorners(edges.edge23.CY + margin23, edges.edge23.FDY, edges.edge23.FDX, EGL_LOG_RASTER_BLOCK_SIZE);
+					GLint pass3 = EdgeCorners(edges.edge31.CY + margin31, edges.edge31.FDY, edges.edge31.FDX, EGL_LOG_RASTER_BLOCK_SIZE);
+
+					PixelMask pixelMask[EGL_NUM_SAMPLES * EGL_RASTER_BLOCK_SIZE];
+					PixelMask totalMask;
+					bool scissored;
+#if EGL_USE_JIT
+					bool fullBlock = false;
+					bool singlePass = false;
 #endif
-            } else {
-				// Partially covered block
-				// initialize surface pointers in local info block
-#if !EGL_USE_JIT
-				totalMask = RasterBlockEdgeDepthStencil(&vars, &edges, pixelMask);
-#else
-				totalMask = m_BlockEdgeDepthStencilFunction(&m_RasterInfo, &vars, &edges, pixelMask);
+
+					// Skip raster block when outside an edge
+					if (pass1 == 0x0 || pass2 == 0x0 || pass3 == 0x0) {
+						continue;
+					}
+
+					scissored = vars.x < innerMinX || vars.x + EGL_RASTER_BLOCK_SIZE > innerMaxX ||
+								vars.y < innerMinY || vars.y + EGL_RASTER_BLOCK_SIZE > innerMaxY;
+
+#if EGL_USE_C_BLOCK_FUNCTIONS
+					// only blocks on the boundary of the scissor rectangle get a partial
+					// mask; the compiled block functions make the scissor test themselves
+					if (!compiled) {
+						if (scissored) {
+							if (!ScissorBlockMask(vars.x, vars.y, pixelMask)) {
+								continue;
+							}
+						} else {
+							for (index = 0; index < EGL_RASTER_BLOCK_SIZE; ++index) {
+								pixelMask[index] = SpanPixelMask(0, EGL_RASTER_BLOCK_SIZE);
+							}
+						}
+					}
 #endif
-            }
 
-			if (totalMask) {
-				I32 varying[EGL_MAX_NUM_VARYING][2][2];	
-				
-				if (perspective) {
-				if (numVarying != usedNumVarying) {
-					I32 XMin2 = x0 - X1;
-					I32 YMin2 = y0 - Y1;
+					m_RasterInfo.RasterSurface.ColorBuffer =
+						colorBuffer + ((oy * m_RasterInfo.RasterSurface.Pitch + ox) << m_RasterInfo.RasterSurface.ColorOffsetShift);
+					m_RasterInfo.RasterSurface.DepthStencilBuffer =
+						depthStencilBuffer + ((oy * m_RasterInfo.RasterSurface.Pitch + (ox << EGL_LOG_RASTER_BLOCK_SIZE))
+											  << m_RasterInfo.RasterSurface.DepthStencilOffsetShift);
+
+					if (samples > 1) {
+						// the corners are widened, so samples are always tested against the edges
+						totalMask = RasterBlockSamplesDepthStencil(&vars, &edges, scissored, pixelMask);
+					} else if (pass1 + pass2 + pass3 == 12) {
+						// Accept whole raster block when totally covered
+#if EGL_USE_JIT
+						if (compiled) {
+							if (!scissored && trivialDepthStencil && m_BlockFullColorAlphaFunction) {
+								// the full block variant does not read the pixel mask
+								totalMask = SpanPixelMask(0, EGL_RASTER_BLOCK_SIZE);
+								fullBlock = true;
+							} else if (!scissored && m_BlockDepthStencilColorAlphaFunction) {
+								// depth/stencil and color are processed together once
+								// the varyings of the block are known
+								totalMask = SpanPixelMask(0, EGL_RASTER_BLOCK_SIZE);
+								singlePass = true;
+							} else {
+								totalMask = scissored ?
+									m_BlockDepthStencilFunction(&m_RasterInfo, &vars, pixelMask) :
+									m_UnscissoredBlockDepthStencilFunction(&m_RasterInfo, &vars, pixelMask);
+								fullBlock = m_BlockFullColorAlphaFunction && IsFullBlockMask(pixelMask);
+							}
+						}
+#endif
+#if EGL_USE_C_BLOCK_FUNCTIONS
+						if (!compiled) {
+							totalMask = RasterBlockDepthStencil(&vars, pixelMask);
+						}
+#endif
+					} else {
+						// Partially covered raster block
+#if EGL_USE_JIT
+						if (compiled) {
+							totalMask = scissored ?
+								m_BlockEdgeDepthStencilFunction(&m_RasterInfo, &vars, &edges, pixelMask) :
+								m_UnscissoredBlockEdgeDepthStencilFunction(&m_RasterInfo, &vars, &edges, pixelMask);
+						}
+#endif
+#if EGL_USE_C_BLOCK_FUNCTIONS
+						if (!compiled) {
+							if (pruneQuadrants) {
+								PruneQuadrants(&edges, pixelMask);
+							}
 
-					usedNumVarying = numVarying;
+							totalMask = RasterBlockEdgeDepthStencil(&vars, &edges, pixelMask);
+						}
+#endif
+					}
 
-					for (index = usedNumVarying; --index >= 0; ) {
-						// 4.28
-						I32 V1OverW = Mul(a.m_Varying[index], a.m_WindowCoords.invW, 16);
-						I32 V2OverW = Mul(b.m_Varying[index], b.m_WindowCoords.invW, 16);
-						I32 V3OverW = Mul(c.m_Varying[index], c.m_WindowCoords.invW, 16);
-
-						I32 IVW12 = V1OverW - V2OverW;
-						I32 IVW31 = V3OverW - V1OverW;
-
-						// dVaryingDx, dVaryingDy is 4.28
-						vars.VaryingInvW[index].dX =  Mul64(det2x2(DY12, IVW12, DY31, IVW31), invArea, 28);
-						vars.VaryingInvW[index].dY = -Mul64(det2x2(DX12, IVW12, DX31, IVW31), invArea, 28);
-						vars.VaryingInvW[index].dBlockLine =
-							vars.VaryingInvW[index].dY * EGL_RASTER_BLOCK_SIZE - vars.VaryingInvW[index].dX * span;
-
-						// varyingStart is 4.28
-						vars.VaryingInvW[index].Value =
-							V1OverW
-								+ Mul(XMin2, vars.VaryingInvW[index].dX, 4)
-								+ Mul(YMin2, vars.VaryingInvW[index].dY, 4);
+					if (!totalMask) {
+						continue;
 					}
 
-				}
+#if EGL_RASTER_STATISTICS
+					m_TriangleStatistics.CoveredBlocks++;
+#endif
 
-				// interpolation values for the four corners
-				I32 w[2][2];				// w in all four corners of block 4.28 (?)
-
-				// compute w in all four corners
-				w[0][0] = EGL_InverseQ(vars.InvW.Value, 28);		// 4.28
-				w[0][1] = InvNewtonRaphson4q28(vars.InvW.Value + vars.InvW.dX * EGL_RASTER_BLOCK_SIZE, w[0][0]);
-				w[1][0] = InvNewtonRaphson4q28(vars.InvW.Value + vars.InvW.dY * EGL_RASTER_BLOCK_SIZE, w[0][0]);
-				w[1][1] = InvNewtonRaphson4q28(vars.InvW.Value + vars.InvW.dX * EGL_RASTER_BLOCK_SIZE
-												+ vars.InvW.dY * EGL_RASTER_BLOCK_SIZE, w[1][0]);
-
-				// compute values of varying at all four corners
-				for (index = usedNumVarying; --index >= 0; ) {
-					varying[index][0][0] = Mul(vars.VaryingInvW[index].Value, w[0][0], 16);
-					varying[index][0][1] =
-						(Mul(vars.VaryingInvW[index].Value
-										+ (vars.VaryingInvW[index].dY << EGL_LOG_RASTER_BLOCK_SIZE), w[1][0], 16)
-						 - varying[index][0][0]) >> EGL_LOG_RASTER_BLOCK_SIZE;
-
-					varying[index][1][0] =
-						Mul(vars.VaryingInvW[index].Value
-										+ (vars.VaryingInvW[index].dX << EGL_LOG_RASTER_BLOCK_SIZE), w[0][1], 16);
-					varying[index][1][1] =
-						(Mul(vars.VaryingInvW[index].Value
-										+ (vars.VaryingInvW[index].dX << EGL_LOG_RASTER_BLOCK_SIZE)
-										+ (vars.VaryingInvW[index].dY << EGL_LOG_RASTER_BLOCK_SIZE), w[1][1], 16)
-						 - varying[index][1][0]) >> EGL_LOG_RASTER_BLOCK_SIZE;
-				}
-				} else {
-					if (numVarying != usedNumVarying) {
-						I32 XMin2 = x0 - X1;
-						I32 YMin2 = y0 - Y1;
-
-						usedNumVarying = numVarying;
-
-						for (index = usedNumVarying; --index >= 0; ) {
-							// 16.16
-							I32 V1 = a.m_Varying[index];
-							I32 V2 = b.m_Varying[index];
-							I32 V3 = c.m_Varying[index];
-
-							I32 V12 = V1 - V2;
-							I32 V31 = V3 - V1;
-
-							// dVaryingDx, dVaryingDy is 16.16
-							vars.VaryingInvW[index].dX =  Mul64(det2x2(DY12, V12, DY31, V31), invArea, 4);
-							vars.VaryingInvW[index].dY = -Mul64(det2x2(DX12, V12, DX31, V31), invArea, 4);
-							vars.VaryingInvW[index].dBlockLine =
-								vars.VaryingInvW[index].dY * EGL_RASTER_BLOCK_SIZE - vars.VaryingInvW[index].dX * span;
-
-							// varyingStart is 16.16
-							vars.VaryingInvW[index].Value =
-								V1
-									+ Mul(XMin2, vars.VaryingInvW[index].dX, 4)
-									+ Mul(YMin2, vars.VaryingInvW[index].dY, 4);
+					if (!cornersValid) {
+						cornersValid = true;
+
+						// Corners of block as 28.4; move to pixel centers
+						GLint bx0 = (bx << 4) | (1 << 3);
+						GLint by0 = (by << 4) | (1 << 3);
+
+						if (perspective) {
+							if (numVarying != usedNumVarying) {
+								I32 XMin2 = bx0 - X1;
+								I32 YMin2 = by0 - Y1;
+
+								usedNumVarying = numVarying;
+
+								for (index = usedNumVarying; --index >= 0; ) {
+									// 4.28
+									I32 V1OverW = Mul(a.m_Varying[index], a.m_WindowCoords.invW, 16);
+									I32 V2OverW = Mul(b.m_Varying[index], b.m_WindowCoords.invW, 16);
+									I32 V3OverW = Mul(c.m_Varying[index], c.m_WindowCoords.invW, 16);
+
+									I32 IVW12 = V1OverW - V2OverW;
+									I32 IVW31 = V3OverW - V1OverW;
+
+									// dVaryingDx, dVaryingDy is 4.28
+									vars.VaryingInvW[index].dX =  Mul64(det2x2(DY12, IVW12, DY31, IVW31), invArea, 28);
+									vars.VaryingInvW[index].dY = -Mul64(det2x2(DX12, IVW12, DX31, IVW31), invArea, 28);
+									vars.VaryingInvW[index].dBlockLine =
+										vars.VaryingInvW[index].dY * blockSize - vars.VaryingInvW[index].dX * span;
+
+									// varyingStart is 4.28
+									vars.VaryingInvW[index].Value =
+										V1OverW
+											+ Mul(XMin2, vars.VaryingInvW[index].dX, 4)
+											+ Mul(YMin2, vars.VaryingInvW[index].dY, 4);
+								}
+							}
+
+							// compute w in all four corners; 4.28
+							I32 w[2][2];
+
+							w[0][0] = EGL_InverseQ(vars.InvW.Value, 28);
+							w[0][1] = InvNewtonRaphson4q28(vars.InvW.Value + (vars.InvW.dX << logBlockSize), w[0][0]);
+							w[1][0] = InvNewtonRaphson4q28(vars.InvW.Value + (vars.InvW.dY << logBlockSize), w[0][0]);
+							w[1][1] = InvNewtonRaphson4q28(vars.InvW.Value + (vars.InvW.dX << logBlockSize)
+															+ (vars.InvW.dY << logBlockSize), w[1][0]);
+
+							// compute values of varying at all four corners
+							for (index = usedNumVarying; --index >= 0; ) {
+								const Interpolant & varying = vars.VaryingInvW[index];
+
+								corners[index][0][0] = Mul(varying.Value, w[0][0], 16);
+								corners[index][0][1] = Mul(varying.Value + (varying.dX << logBlockSize), w[0][1], 16);
+								corners[index][1][0] = Mul(varying.Value + (varying.dY << logBlockSize), w[1][0], 16);
+								corners[index][1][1] = Mul(varying.Value + (varying.dX << logBlockSize)
+														   + (varying.dY << logBlockSize), w[1][1], 16);
+							}
+						} else {
+							if (numVarying != usedNumVarying) {
+								I32 XMin2 = bx0 - X1;
+								I32 YMin2 = by0 - Y1;
+
+								usedNumVarying = numVarying;
+
+								for (index = usedNumVarying; --index >= 0; ) {
+									// 16.16
+									I32 V1 = a.m_Varying[index];
+									I32 V2 = b.m_Varying[index];
+									I32 V3 = c.m_Varying[index];
+
+									I32 V12 = V1 - V2;
+									I32 V31 = V3 - V1;
+
+									// dVaryingDx, dVaryingDy is 16.16
+									vars.VaryingInvW[index].dX =  Mul64(det2x2(DY12, V12, DY31, V31), invArea, 28);
+									vars.VaryingInvW[index].dY = -Mul64(det2x2(DX12, V12, DX31, V31), invArea, 28);
+									vars.VaryingInvW[index].dBlockLine =
+										vars.VaryingInvW[index].dY * blockSize - vars.VaryingInvW[index].dX * span;
+
+									// varyingStart is 16.16
+									vars.VaryingInvW[index].Value =
+										V1
+											+ Mul(XMin2, vars.VaryingInvW[index].dX, 4)
+											+ Mul(YMin2, vars.VaryingInvW[index].dY, 4);
+								}
+
+								SelectTriangleMipmapLevels(&vars);
+							}
+
+							// compute values of varying at all four corners
+							for (index = usedNumVarying; --index >= 0; ) {
+								const Interpolant & varying = vars.VaryingInvW[index];
+
+								corners[index][0][0] = varying.Value;
+								corners[index][0][1] = varying.Value + (varying.dX << logBlockSize);
+								corners[index][1][0] = varying.Value + (varying.dY << logBlockSize);
+								corners[index][1][1] = varying.Value + (varying.dX << logBlockSize)
+													 + (varying.dY << logBlockSize);
+							}
 						}
-
 					}
 
-					// compute values of varying at all four corners
-					for (index = usedNumVarying; --index >= 0; ) {
-						varying[index][0][0] = vars.VaryingInvW[index].Value;
-						varying[index][0][1] = 
-						varying[index][1][1] = vars.VaryingInvW[index].dY;
+					// interpolate the values at the corners of the raster block
+					// from the corners of the block
+					I32 varying[EGL_MAX_NUM_VARYING][2][2];
 
-						varying[index][1][0] = vars.VaryingInvW[index].Value
-											 + (vars.VaryingInvW[index].dX << EGL_LOG_RASTER_BLOCK_SIZE);
+					for (index = usedNumVarying; --index >= 0; ) {
+						I32 topLeft		= BlockCorner(corners[index], ox, oy, logBlockSize);
+						I32 topRight	= BlockCorner(corners[index], ox + EGL_RASTER_BLOCK_SIZE, oy, logBlockSize);
+						I32 bottomLeft	= BlockCorner(corners[index], ox, oy + EGL_RASTER_BLOCK_SIZE, logBlockSize);
+						I32 bottomRight	= BlockCorner(corners[index], ox + EGL_RASTER_BLOCK_SIZE, oy + EGL_RASTER_BLOCK_SIZE, logBlockSize);
+
+						varying[index][0][0] = topLeft;
+						varying[index][0][1] = (bottomLeft - topLeft) >> EGL_LOG_RASTER_BLOCK_SIZE;
+						varying[index][1][0] = topRight;
+						varying[index][1][1] = (bottomRight - topRight) >> EGL_LOG_RASTER_BLOCK_SIZE;
 					}
-				}
 
-				// perform Mipmap selection; initialize local RasterInfo structure
-				unit = EGL_NUM_TEXTURE_UNITS - 1; 
-				do {
-					I32 textureBase = m_VaryingInfo.textureBase[unit];
-
-					if (textureBase >= 0 && m_UseMipmap[unit]) {
-						I32 dUdX = ((varying[textureBase][1][0] << 1)
-									+ (varying[textureBase][1][1] << EGL_LOG_RASTER_BLOCK_SIZE)
-									- (varying[textureBase][0][0] << 1)
-									- (varying[textureBase][0][1] << EGL_LOG_RASTER_BLOCK_SIZE))
-									>> (EGL_LOG_RASTER_BLOCK_SIZE + 1);
-						I32 dUdY = (varying[textureBase][0][1] + varying[textureBase][1][1]) 
-									>> 1;
-						I32 dVdX = ((varying[textureBase + 1][1][0] << 1)
-									+ (varying[textureBase + 1][1][1] << EGL_LOG_RASTER_BLOCK_SIZE)
-									- (varying[textureBase + 1][0][0] << 1)
-									- (varying[textureBase + 1][0][1] << EGL_LOG_RASTER_BLOCK_SIZE))
-									>> (EGL_LOG_RASTER_BLOCK_SIZE + 1);
-						I32 dVdY = (varying[textureBase + 1][0][1] + varying[textureBase + 1][1][1]) 
-									>> 1;
-
-						I32 maxDu = EGL_Max(EGL_Abs(dUdX), EGL_Abs(dUdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogWidth());
-						I32 maxDv = EGL_Max(EGL_Abs(dVdX), EGL_Abs(dVdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogHeight());
-
-						I32 rho = maxDu + maxDv;
-
-						// should actually plug in approximation formula from Blythe & McReynolds
-
-						// we start with nearest/minification only selection; will add LINEAR later
-						m_RasterInfo.MipmapLevel[unit] = EGL_Min(Log2(rho), m_RasterInfo.MaxMipmapLevel[unit]);
-						m_RasterInfo.Textures[unit] = m_Texture[unit]->GetTexture(m_RasterInfo.MipmapLevel[unit]);
+#if EGL_USE_C_BLOCK_FUNCTIONS
+					if (!compiled) {
+						// the C version selects mipmap levels per quad of pixels
+						RasterBlockColorAlpha(varying, pixelMask);
+						continue;
 					}
-				} while (--unit >= 0);
+#endif
 
-#if !EGL_USE_JIT
-				RasterBlockColorAlpha(varying, pixelMask);
-#else
-				m_BlockColorAlphaFunction(&m_RasterInfo, varying, pixelMask);
+#if EGL_USE_JIT
+					// perform Mipmap selection; initialize local RasterInfo structure
+					I32 unit = EGL_NUM_TEXTURE_UNITS - 1; 
+					do {
+						I32 textureBase = m_VaryingInfo.textureBase[unit];
+
+						// triangles without perspective use the level selected during setup
+						if (perspective && textureBase >= 0 && m_UseMipmap[unit]) {
+							I32 dUdX = ((varying[textureBase][1][0] << 1)
+										+ (varying[textureBase][1][1] << EGL_LOG_RASTER_BLOCK_SIZE)
+										- (varying[textureBase][0][0] << 1)
+										- (varying[textureBase][0][1] << EGL_LOG_RASTER_BLOCK_SIZE))
+										>> (EGL_LOG_RASTER_BLOCK_SIZE + 1);
+							I32 dUdY = (varying[textureBase][0][1] + varying[textureBase][1][1]) 
+										>> 1;
+							I32 dVdX = ((varying[textureBase + 1][1][0] << 1)
+										+ (varying[textureBase + 1][1][1] << EGL_LOG_RASTER_BLOCK_SIZE)
+										- (varying[textureBase + 1][0][0] << 1)
+										- (varying[textureBase + 1][0][1] << EGL_LOG_RASTER_BLOCK_SIZE))
+										>> (EGL_LOG_RASTER_BLOCK_SIZE + 1);
+							I32 dVdY = (varying[textureBase + 1][0][1] + varying[textureBase + 1][1][1]) 
+										>> 1;
+
+							I32 maxDu = EGL_Max(EGL_Abs(dUdX), EGL_Abs(dUdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogWidth());
+							I32 maxDv = EGL_Max(EGL_Abs(dVdX), EGL_Abs(dVdY)) >> (16 - m_Texture[unit]->GetTexture(0)->GetLogHeight());
+
+							I32 rho = maxDu + maxDv;
+
+							// should actually plug in approximation formula from Blythe & McReynolds
+
+							// we start with nearest/minification only selection; will add LINEAR later
+							m_RasterInfo.MipmapLevel[unit] = EGL_Min(Log2(rho), m_RasterInfo.MaxMipmapLevel[unit]);
+							m_RasterInfo.Textures[unit] = m_Texture[unit]->GetTexture(m_RasterInfo.MipmapLevel[unit]);
+						}
+					} while (--unit >= 0);
+
+					if (samples > 1) {
+						// the generated code advances the varyings it is passed
+						// and writes a single plane, so it runs for each sample
+						// that has pixels which are not copied from the plane
+						// shaded first
+						RasterInfo sampleInfo = m_RasterInfo;
+						const PixelMask * shadedMask = 0;
+						const U8 * shadedBuffer = 0;
+						const I32 pitch = m_RasterInfo.RasterSurface.Pitch << m_RasterInfo.RasterSurface.ColorOffsetShift;
+
+						for (I32 sample = 0; sample < samples; ++sample) {
+							const PixelMask * sampleMask = pixelMask + sample * EGL_RASTER_BLOCK_SIZE;
+							U8 * sampleBuffer = sampleInfo.RasterSurface.ColorBuffer;
+							PixelMask copyMask[EGL_RASTER_BLOCK_SIZE], shadeMask[EGL_RASTER_BLOCK_SIZE];
+							PixelMask copyTotal = 0, shadeTotal = 0;
+
+							for (index = 0; index < EGL_RASTER_BLOCK_SIZE; ++index) {
+								copyMask[index] = shadedMask ? sampleMask[index] & shadedMask[index] : 0;
+								shadeMask[index] = sampleMask[index] & ~copyMask[index];
+								copyTotal |= copyMask[index];
+								shadeTotal |= shadeMask[index];
+							}
+
+							if (copyTotal) {
+								if (m_RasterInfo.RasterSurface.ColorOffsetShift == 2) {
+									CopyBlockPixels<U32>(sampleBuffer, shadedBuffer, pitch, copyMask);
+								} else {
+									CopyBlockPixels<U16>(sampleBuffer, shadedBuffer, pitch, copyMask);
+								}
+							}
+
+							if (shadeTotal) {
+								I32 sampleVarying[EGL_MAX_NUM_VARYING][2][2];
+								memcpy(sampleVarying, varying, sizeof(sampleVarying));
+								m_BlockColorAlphaFunction(&sampleInfo, sampleVarying, shadeMask);
+
+								if (copySamples && !shadedMask) {
+									shadedMask = sampleMask;
+									shadedBuffer = sampleBuffer;
+								}
+							}
+
+							sampleInfo.RasterSurface.ColorBuffer += sampleInfo.RasterSurface.SampleColorStride;
+						}
+					} else if (singlePass) {
+						m_BlockDepthStencilColorAlphaFunction(&m_RasterInfo, &vars, varying);
+					} else if (fullBlock) {
+						m_BlockFullColorAlphaFunction(&m_RasterInfo, varying, pixelMask);
+					} else {
+						m_BlockColorAlphaFunction(&m_RasterInfo, varying, pixelMask);
+					}
 #endif
+				}
 			}
 cont:
-			vars.Depth.Value += vars.Depth.dX << EGL_LOG_RASTER_BLOCK_SIZE;
-			vars.InvW.Value += vars.InvW.dX << EGL_LOG_RASTER_BLOCK_SIZE;
+			depth += vars.Depth.dX << logBlockSize;
+			vars.InvW.Value += vars.InvW.dX << logBlockSize;
 
 			for (index = usedNumVarying; --index >= 0; ) {
-				vars.VaryingInvW[index].Value += vars.VaryingInvW[index].dX << EGL_LOG_RASTER_BLOCK_SIZE;
+				vars.VaryingInvW[index].Value += vars.VaryingInvW[index].dX << logBlockSize;
 			}
 
-			m_RasterInfo.RasterSurface.ColorBuffer			+= (EGL_RASTER_BLOCK_SIZE << m_RasterInfo.RasterSurface.ColorOffsetShift);
-			m_RasterInfo.RasterSurface.DepthStencilBuffer   += ((EGL_RASTER_BLOCK_SIZE * EGL_RASTER_BLOCK_SIZE) << m_RasterInfo.RasterSurface.DepthStencilOffsetShift);
+			colorBuffer			+= (blockSize << m_RasterInfo.RasterSurface.ColorOffsetShift);
+			depthStencilBuffer  += ((EGL_RASTER_BLOCK_SIZE * blockSize) << m_RasterInfo.RasterSurface.DepthStencilOffsetShift);
         }
 
-		vars.Depth.Value += vars.Depth.dBlockLine;
+		AdvanceBlockRow(vars, depth, usedNumVarying, colorBuffer, depthStencilBuffer,
+						m_RasterInfo.RasterSurface, EGL_Max(minx + span - bx, 0));
+
+		depth += vars.Depth.dBlockLine;
 		vars.InvW.Value += vars.InvW.dBlockLine;
 
 		for (index = usedNumVarying; --index >= 0; ) {
 			vars.VaryingInvW[index].Value += vars.VaryingInvW[index].dBlockLine;
 		}
 
-		m_RasterInfo.RasterSurface.ColorBuffer			+= (blockStride << m_RasterInfo.RasterSurface.ColorOffsetShift);
-		m_RasterInfo.RasterSurface.DepthStencilBuffer	+= (depthStencilBlockStride << m_RasterInfo.RasterSurface.DepthStencilOffsetShift);
+		colorBuffer			+= (blockStride << m_RasterInfo.RasterSurface.ColorOffsetShift);
+		depthStencilBuffer	+= (depthStencilBlockStride << m_RasterInfo.RasterSurface.DepthStencilOffsetShift);
     }
+
+	m_MipmapPerQuad = true;
 }
 
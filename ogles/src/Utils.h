@@ -71,10 +71,24 @@ namespace EGL {
 	}
 
 	inline void Interpolate(Vertex& result, const Vertex& inside, const Vertex& outside, I32 coeff4q28, size_t numVarying) {
-		result.m_ClipCoords.setX(Interpolate(inside.m_ClipCoords.x(), outside.m_ClipCoords.x(), coeff4q28));
-		result.m_ClipCoords.setY(Interpolate(inside.m_ClipCoords.y(), outside.m_ClipCoords.y(), coeff4q28));
-		result.m_ClipCoords.setZ(Interpolate(inside.m_ClipCoords.z(), outside.m_ClipCoords.z(), coeff4q28));
-		result.m_ClipCoords.setW(Interpolate(inside.m_ClipCoords.w(), outside.m_ClipCoords.w(), coeff4q28));
+#if EGL_USE_FLOAT_VERTEX
+		result.m_Float = inside.m_Float & outside.m_Float;
+
+		if (result.m_Float) {
+			float coeff = coeff4q28 * (1.0f / (1 << 28));
+
+			for (size_t index = 0; index < 4; ++index) {
+				result.m_FloatClipCoords[index] = inside.m_FloatClipCoords[index] + 
+					(outside.m_FloatClipCoords[index] - inside.m_FloatClipCoords[index]) * coeff;
+			}
+		} else
+#endif
+		{
+			result.m_ClipCoords.setX(Interpolate(inside.m_ClipCoords.x(), outside.m_ClipCoords.x(), coeff4q28));
+			result.m_ClipCoords.setY(Interpolate(inside.m_ClipCoords.y(), outside.m_ClipCoords.y(), coeff4q28));
+			result.m_ClipCoords.setZ(Interpolate(inside.m_ClipCoords.z(), outside.m_ClipCoords.z(), coeff4q28));
+			result.m_ClipCoords.setW(Interpolate(inside.m_ClipCoords.w(), outside.m_ClipCoords.w(), coeff4q28));
+		}
 
 		for (size_t index = 0; index < numVarying; ++index) {
 			result.m_Varying[index] = Interpolate(inside.m_Varying[index], outside.m_Varying[index], coeff4q28);
@@ -110,29 +110,51 @@ Surface :: Surface(const Config & config, HDC hdc)
 :	m_Config(config),
 	m_Rect (0, 0, config.GetConfigAttrib(EGL_WIDTH), config.GetConfigAttrib(EGL_HEIGHT)),
 	m_Bitmap(reinterpret_cast<HBITMAP>(INVALID_HANDLE_VALUE)),
-	m_HDC(reinterpret_cast<HDC>(INVALID_HANDLE_VALUE))
+	m_HDC(reinterpret_cast<HDC>(INVALID_HANDLE_VALUE)),
+	m_SampleColorBuffer(0),
+	m_DirtyX0(0x7fffffff),
+	m_DirtyY0(0x7fffffff),
+	m_DirtyX1(0),
+	m_DirtyY1(0)
 {
 	//m_ColorBuffer = new U16[m_Width * m_Height];
 	U32 width = GetWidth();
 	U32 height = GetHeight();
 
 	m_Pitch = width;
+	m_Samples = m_Config.GetConfigAttrib(EGL_SAMPLE_BUFFERS) ? m_Config.GetConfigAttrib(EGL_SAMPLES) : 1;
 
 	switch (m_Config.GetDepthStencilFormat()) {
 	case DepthStencilFormatDepth16:
-		m_DepthStencilBuffer = new U8[width * height * sizeof(U16)];
+		m_SampleDepthStencilStride = width * height * sizeof(U16);
 		break;
 
 	case DepthStencilFormatDepth16Stencil16:
-		m_DepthStencilBuffer = new U8[width * height * sizeof(U32)];
+		m_SampleDepthStencilStride = width * height * sizeof(U32);
 		break;
 
 	default:
-		m_DepthStencilBuffer = 0;
+		m_SampleDepthStencilStride = 0;
 		assert(false);
 		break;
 	}
 
+	m_DepthStencilBuffer = m_SampleDepthStencilStride ? new U8[m_SampleDepthStencilStride * m_Samples] : 0;
+
+	switch (m_Config.GetColorFormat()) {
+	case ColorFormatRGBA8:
+		m_SampleColorStride = width * height * sizeof(U32);
+		break;
+
+	default:
+		m_SampleColorStride = width * height * sizeof(U16);
+		break;
+	}
+
+	if (m_Samples > 1) {
+		m_SampleColorBuffer = new U8[m_SampleColorStride * m_Samples];
+	}
+
 	if (hdc != INVALID_HANDLE_VALUE) {
 		m_HDC = CreateCompatibleDC(hdc);
 	}
@@ -160,6 +182,11 @@ Surface :: ~Surface() {
 		delete[] m_DepthStencilBuffer;
 		m_DepthStencilBuffer = 0;
 	}
+
+	if (m_SampleColorBuffer != 0) {
+		delete[] m_SampleColorBuffer;
+		m_SampleColorBuffer = 0;
+	}
 }
 
 
@@ -243,51 +270,144 @@ void Surface :: ClearBuffer32(U8 * buffer, U32 value, U32 mask, const Rect& scis
 
 void Surface :: ClearDepthStencilBuffer(U32 depth, bool depthMask, U32 stencil, U32 stencilMask, const Rect& scissor) {
 
-	switch (GetDepthStencilFormat()) {
-	case DepthStencilFormatDepth16:
-		ClearBuffer16(m_DepthStencilBuffer, depth, depthMask ? 0xffff : 0, scissor);
-		break;
+	U8 * buffer = m_DepthStencilBuffer;
 
-	case DepthStencilFormatDepth16Stencil16:
-		stencilMask &= 0xffff;
-		depth &= 0xffff;
-		stencil &= 0xffff;
-		ClearBuffer32(m_DepthStencilBuffer, depth | (stencil << 16), (depthMask ? 0xffff : 0) | (stencilMask << 16), scissor);
-		break;
+	for (U32 sample = 0; sample < m_Samples; ++sample, buffer += m_SampleDepthStencilStride) {
+		switch (GetDepthStencilFormat()) {
+		case DepthStencilFormatDepth16:
+			ClearBuffer16(buffer, depth, depthMask ? 0xffff : 0, scissor);
+			break;
 
-	default:
-		assert(false);
+		case DepthStencilFormatDepth16Stencil16:
+			ClearBuffer32(buffer, (depth & 0xffff) | ((stencil & 0xffff) << 16),
+						  (depthMask ? 0xffff : 0) | ((stencilMask & 0xffff) << 16), scissor);
+			break;
+
+		default:
+			assert(false);
+		}
 	}
 }
 
 void Surface :: ClearColorBuffer(const Color & rgba, const Color & mask, const Rect& scissor) {
+
+	U8 * buffer = GetSampleColorBuffer();
+
+	AddDirtyRect(scissor.x, scissor.y, scissor.x + scissor.width, scissor.y + scissor.height);
+
+	for (U32 sample = 0; sample < m_Samples; ++sample, buffer += m_SampleColorStride) {
+		switch (GetColorFormat()) {
+		case ColorFormatRGB565:
+			ClearBuffer16(buffer, rgba.ConvertTo565(), mask.ConvertTo565(), scissor);
+			break;
+
+		case ColorFormatRGBA4444:
+			ClearBuffer16(buffer, rgba.ConvertTo4444(), mask.ConvertTo4444(), scissor);
+			break;
+
+		case ColorFormatRGBA5551:
+			ClearBuffer16(buffer, rgba.ConvertTo5551(), mask.ConvertTo5551(), scissor);
+			break;
+
+		case ColorFormatRGBA8:
+			ClearBuffer32(buffer, rgba.ConvertToRGBA(), mask.ConvertToRGBA(), scissor);
+			break;
+
+		default:
+			assert(false);
+		}
+	}
+}
+
+
+namespace {
+
+	// average the samples of the pixels x0 <= x < x1, y0 <= y < y1; the
+	// sample planes are one plane of pixels apart, and the number of
+	// samples is 1 << logSamples
+	template <class T>
+	void ResolveSamples(T * target, const T * samples, U32 planePixels, U32 logSamples,
+						U32 pitch, I32 x0, I32 y0, I32 x1, I32 y1,
+						Color (*unpack)(T), T (Color::*pack)() const) {
+		U32 numSamples = 1 << logSamples;
+
+		for (I32 y = y0; y < y1; ++y) {
+			for (I32 x = x0; x < x1; ++x) {
+				U32 index = x + y * pitch;
+				U32 r = 0, g = 0, b = 0, a = 0;
+
+				for (U32 sample = 0; sample < numSamples; ++sample) {
+					Color color = unpack(samples[index + sample * planePixels]);
+
+					r += color.R();
+					g += color.G();
+					b += color.B();
+					a += color.A();
+				}
+
+				Color average(r >> logSamples, g >> logSamples, b >> logSamples, a >> logSamples);
+				target[index] = (average.*pack)();
+			}
+		}
+	}
+}
+
+
+void Surface :: Resolve() {
+
+	I32 x0 = EGL_Max(m_DirtyX0, 0);
+	I32 y0 = EGL_Max(m_DirtyY0, 0);
+	I32 x1 = EGL_Min(m_DirtyX1, GetWidth());
+	I32 y1 = EGL_Min(m_DirtyY1, GetHeight());
+
+	m_DirtyX0 = m_DirtyY0 = 0x7fffffff;
+	m_DirtyX1 = m_DirtyY1 = 0;
+
+	if (m_Samples <= 1 || x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	U32 logSamples = 0;
+
+	while ((1u << logSamples) < m_Samples) {
+		++logSamples;
+	}
+
+	assert((1u << logSamples) == m_Samples && m_Samples <= EGL_NUM_SAMPLES);
+
+	U32 pixels = GetPixels();
+
 	switch (GetColorFormat()) {
 	case ColorFormatRGB565:
-		ClearBuffer16(m_ColorBuffer, rgba.ConvertTo565(), mask.ConvertTo565(), scissor);
+		ResolveSamples((U16 *) m_ColorBuffer, (const U16 *) m_SampleColorBuffer, pixels, logSamples,
+					   m_Pitch, x0, y0, x1, y1, &Color::From565, &Color::ConvertTo565);
 		break;
 
 	case ColorFormatRGBA4444:
-		ClearBuffer16(m_ColorBuffer, rgba.ConvertTo4444(), mask.ConvertTo4444(), scissor);
+		ResolveSamples((U16 *) m_ColorBuffer, (const U16 *) m_SampleColorBuffer, pixels, logSamples,
+					   m_Pitch, x0, y0, x1, y1, &Color::From4444, &Color::ConvertTo4444);
 		break;
 
 	case ColorFormatRGBA5551:
-		ClearBuffer16(m_ColorBuffer, rgba.ConvertTo5551(), mask.ConvertTo5551(), scissor);
+		ResolveSamples((U16 *) m_ColorBuffer, (const U16 *) m_SampleColorBuffer, pixels, logSamples,
+					   m_Pitch, x0, y0, x1, y1, &Color::From5551, &Color::ConvertTo5551);
 		break;
 
 	case ColorFormatRGBA8:
-		ClearBuffer32(m_ColorBuffer, rgba.ConvertToRGBA(), mask.ConvertToRGBA(), scissor);
+		ResolveSamples((U32 *) m_ColorBuffer, (const U32 *) m_SampleColorBuffer, pixels, logSamples,
+					   m_Pitch, x0, y0, x1, y1, &Color::FromRGBA, &Color::ConvertToRGBA);
 		break;
 
 	default:
 		assert(false);
 	}
-
-
 }
 
 
 bool Surface :: Save(const TCHAR * filename) {
 
+	Resolve();
+
 	InfoHeader info(GetColorFormat(), GetWidth(), GetHeight());
 
     BITMAPFILEHEADER header;
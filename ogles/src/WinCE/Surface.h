@@ -76,6 +76,20 @@ namespace EGL {
 		U8 * GetColorBuffer();
 		U8 * GetDepthStencilBuffer();
 
+		// Multisample surfaces keep color and depth/stencil planes per
+		// sample, which are stride bytes apart and share the layout of the
+		// color and depth/stencil buffers; the color buffer receives the
+		// resolved image. Single sample surfaces have a single plane.
+		U32 GetSamples() const;
+		U8 * GetSampleColorBuffer();
+		U32 GetSampleColorStride() const;
+		U32 GetSampleDepthStencilStride() const;
+
+		// the pixels x0 <= x < x1, y0 <= y < y1 of the sample planes have
+		// changed; Resolve averages the samples of the changed pixels only
+		void AddDirtyRect(I32 x0, I32 y0, I32 x1, I32 y1);
+		void Resolve();
+
 		Config * GetConfig();
 
 		bool Save(const TCHAR * filename);
@@ -98,6 +112,14 @@ namespace EGL {
 		Config	m_Config;			// configuration arguments
 		U8 *	m_ColorBuffer;		// pointer to frame buffer base address
 		U8 *	m_DepthStencilBuffer;	// pointer to Z/stencil-buffer base address
+		U8 *	m_SampleColorBuffer;	// color planes of multisample surfaces, or 0
+
+		U32		m_Samples;			// number of samples per pixel
+		U32		m_SampleColorStride;	// bytes between color planes of samples
+		U32		m_SampleDepthStencilStride;	// bytes between depth/stencil planes
+
+		I32		m_DirtyX0, m_DirtyY0;	// pixels of the sample planes changed since
+		I32		m_DirtyX1, m_DirtyY1;	// the last resolve; empty if x0 >= x1
 
 		Rect	m_Rect;
 		U32		m_Pitch;			// increment top move from y to y + 1
@@ -141,6 +163,29 @@ namespace EGL {
 		return m_DepthStencilBuffer;
 	}
 
+	inline U32 Surface :: GetSamples() const {
+		return m_Samples;
+	}
+
+	inline U8 * Surface :: GetSampleColorBuffer() {
+		return m_SampleColorBuffer ? m_SampleColorBuffer : m_ColorBuffer;
+	}
+
+	inline U32 Surface :: GetSampleColorStride() const {
+		return m_SampleColorStride;
+	}
+
+	inline U32 Surface :: GetSampleDepthStencilStride() const {
+		return m_SampleDepthStencilStride;
+	}
+
+	inline void Surface :: AddDirtyRect(I32 x0, I32 y0, I32 x1, I32 y1) {
+		m_DirtyX0 = EGL_Min(m_DirtyX0, x0);
+		m_DirtyY0 = EGL_Min(m_DirtyY0, y0);
+		m_DirtyX1 = EGL_Max(m_DirtyX1, x1);
+		m_DirtyY1 = EGL_Max(m_DirtyY1, y1);
+	}
+
 	inline U16 Surface :: GetWidth() const {
 		return m_Rect.width;
 	}
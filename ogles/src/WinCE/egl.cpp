@@ -166,6 +166,12 @@ static const struct {
 	/* OES_point_size_array */
 	FunctionEntry(glPointSizePointerOES),
 
+	/* OES_matrix_palette */
+	FunctionEntry(glCurrentPaletteMatrixOES),
+	FunctionEntry(glLoadPaletteFromModelViewMatrixOES),
+	FunctionEntry(glMatrixIndexPointerOES),
+	FunctionEntry(glWeightPointerOES),
+
 	FunctionEntry(eglSaveSurfaceHM)
 };
 
@@ -338,6 +344,7 @@ GLAPI EGLBoolean APIENTRY eglWaitNative (EGLint engine) {
 GLAPI EGLBoolean APIENTRY eglSwapBuffers (EGLDisplay dpy, EGLSurface draw) {
 
 	Context::GetCurrentContext()->Flush();
+	draw->Resolve();
 
 	HDC nativeDisplay = GetNativeDisplay(dpy);
 	HDC memoryDC = draw->GetMemoryDC();
@@ -367,6 +374,7 @@ GLAPI EGLBoolean APIENTRY eglCopyBuffers (EGLDisplay dpy, EGLSurface surface, Na
 	}
 
 	Context::GetCurrentContext()->Flush();
+	surface->Resolve();
 
 	HDC nativeDisplay = GetNativeDisplay(dpy);
 	HDC memoryDC = surface->GetMemoryDC();
@@ -723,8 +723,60 @@ bool FetchVertexPart :: CompareState(const void * first, const void * second) co
 	return !memcmp(firstState, secondState, sizeof(RenderState));
 }
 
+namespace {
+	void AppendArray(char * buffer, size_t size, const char * name, const ArrayState & array) {
+		if (!array.Enabled)
+			return;
+
+		const char * type;
+
+		switch (array.Type) {
+		case GL_BYTE:			type = "byte";		break;
+		case GL_UNSIGNED_BYTE:	type = "ubyte";		break;
+		case GL_SHORT:			type = "short";		break;
+		case GL_FIXED:			type = "fixed";		break;
+		case GL_FLOAT:			type = "float";		break;
+		default:				type = "?";			break;
+		}
+
+		char value[16];
+		sprintf(value, "%s%d", type, (int) array.Size);
+		PipelinePart::AppendState(buffer, size, name, value);
+	}
+}
+
+void FetchVertexPart :: DescribeState(char * buffer, size_t size, const void * state) const {
+	const RenderState * renderState = static_cast<const RenderState *>(state);
+
+	buffer[0] = '\0';
+
+	AppendArray(buffer, size, "coord", renderState->Coord);
+	AppendArray(buffer, size, "normal", renderState->Normal);
+	AppendArray(buffer, size, "color", renderState->Color);
+
+	for (size_t unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		char name[16];
+		sprintf(name, "texcoord%d", (int) unit);
+		AppendArray(buffer, size, name, renderState->TexCoord[unit]);
+
+		if (renderState->TexCoord[unit].Enabled && !renderState->TextureMatrixIdentity[unit])
+			AppendState(buffer, size, "matrix", "on");
+	}
+
+	AppendState(buffer, size, "varying", (I32) renderState->Varying.numVarying);
+
+	if (renderState->NeedsNormal)
+		AppendState(buffer, size, "needsnormal", "on");
+
+	if (renderState->NeedsColor)
+		AppendState(buffer, size, "needscolor", "on");
+
+	if (renderState->NeedsEyeCoords)
+		AppendState(buffer, size, "needseye", "on");
+}
+
 void FetchVertexPart :: Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state) {
-	BeginGenerateCode();
+	BeginGenerateCode(target);
 	GenerateFetch(static_cast<const RenderState *>(state));
 	EndGenerateCode(target, state);
 }
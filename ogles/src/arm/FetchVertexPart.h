@@ -134,6 +134,7 @@ namespace EGL {
 		bool CompareState(const void * first, const void * second) const;
 		void Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state);
 		Part GetPart() const;
+		void DescribeState(char * buffer, size_t size, const void * state) const;
 		
 	private:
 		// ----------------------------------------------------------------------
@@ -78,9 +78,35 @@ extern "C" {
 }
 #endif
 
+// code segments are mapped from the system, and are either writable or
+// executable, but never both; on desktop Windows, the pages are obtained
+// from VirtualAlloc and changed by VirtualProtect
+#if defined(EGL_ON_WINCE) || defined(EGL_ON_SYMBIAN)
+#	define EGL_CODE_PROTECTION	0
+#elif defined(_WIN32)
+#	define EGL_CODE_PROTECTION	1
+#else
+#	include <sys/mman.h>
+#	define EGL_CODE_PROTECTION	1
+#endif
+
 
 using namespace EGL;
 
+// the code cache is used by more than one thread
+#define EGL_CACHE_THREADS	(EGL_USE_SHARED_FUNCTION_CACHE || EGL_USE_ASYNC_JIT)
+
+// threads are synchronized by the primitives of Windows, or by POSIX threads
+#if EGL_CACHE_THREADS && !defined(_WIN32) && !defined(EGL_ON_WINCE)
+#	if defined(EGL_ON_SYMBIAN)
+#		error "The function cache has no threading support on Symbian"
+#	endif
+#	include <pthread.h>
+#	define EGL_CACHE_PTHREADS	1
+#else
+#	define EGL_CACHE_PTHREADS	0
+#endif
+
 // ----------------------------------------------------------------------
 // Info-Block to manage a single compiled function
 // ----------------------------------------------------------------------
@@ -88,310 +114,1252 @@ using namespace EGL;
 namespace EGL {
 	enum Flags {
 		FlagNone = 0,					// no flags
-		FlagUsed = 1,					// function is still in use
 		FlagExternal = 2,				// function is external
 	};
 
-	struct FunctionInfo {
-		FunctionInfo	* m_Prev;		// previous item in LRU chain
-		FunctionInfo	* m_Next;		// next item in LRU chain
+	// ----------------------------------------------------------------------
+	// Functions are only shared between clients that compile them with the
+	// same profile flags. The counters in the generated code are updated
+	// without synchronization, so a function with counters belongs to the
+	// client that compiled it; a context is current on one thread at a time.
+	// ----------------------------------------------------------------------
+	struct ProfileKey {
+		U32						m_Flags;	// JitProfileFlags of the function
+		const FunctionCache *	m_Owner;	// only client to execute it, or 0
+	};
+
+	inline ProfileKey KeyOf(const FunctionCache * client) {
+		ProfileKey key;
+		key.m_Flags = client->GetProfileFlags();
+		key.m_Owner = (key.m_Flags & JitProfileCounters) ? client : 0;
+		return key;
+	}
+
+	inline bool operator==(const ProfileKey & first, const ProfileKey & second) {
+		return first.m_Flags == second.m_Flags && first.m_Owner == second.m_Owner;
+	}
+
+	// size of the state that is compiled into a function
+	const size_t StateSize = sizeof(RasterizerState) > sizeof(RenderState) ?
+							 sizeof(RasterizerState) : sizeof(RenderState);
 
+	struct FunctionInfo {
 										// the state that was compiled into this function
-		U8				m_State[sizeof(RasterizerState) > sizeof(RenderState) ?
-							    sizeof(RasterizerState) : sizeof(RenderState)];
+		U8				m_State[StateSize];
 
-		union {
-			size_t		m_Offset;		// offset of function in code segment
-			const void *m_Pointer;		// external function pointer
-		};
-
+		const void *	m_Pointer;		// compiled or external function
 		size_t			m_Size;			// size of function in code segment
 		U32				m_Flags;		// flags for garbage collection
+		volatile U32	m_LastUsed;		// clock of the code cache at the latest request
 
 		PipelinePart::Part m_Part;		// what part of the pipeline is this?
+		ProfileKey		m_Key;			// profiling compiled into the function
+	};
+
+	// ----------------------------------------------------------------------
+	// A code area and the functions compiled into it. Functions are only
+	// ever appended, and become visible to lookups when m_Count is
+	// incremented; a compaction copies the functions to keep into a new
+	// segment and retires the old one.
+	// ----------------------------------------------------------------------
+	struct CodeSegment {
+		U8 *			m_Code;
+		size_t			m_Used;
+		size_t			m_Total;		// size of the code area
+		FunctionInfo *	m_Functions;
+		size_t			m_MaxFunctions;
+		volatile I32	m_Count;		// number of published functions
+		bool			m_Writable;		// code area is mapped for writing
+		CodeSegment *	m_NextRetired;	// next in the list of retired segments
+		U32				m_Epoch;		// epoch that began with the retirement
+	};
+
+#if EGL_USE_ASYNC_JIT
+	enum JobStatus {
+		JobQueued,						// waiting for the compiler thread
+		JobCompiling,					// being compiled
+		JobCompiled						// code is ready to be installed
+	};
+
+	// ----------------------------------------------------------------------
+	// A function to be compiled on the compiler thread
+	// ----------------------------------------------------------------------
+	struct CompileJob {
+		CompileJob		* m_Next;		// next job in queue order
+		U8				m_State[StateSize];
+		VaryingInfo		m_VaryingInfo;
+		void *			m_Code;			// compiled code
+		size_t			m_Size;			// size of compiled code
+		JobStatus		m_Status;
+		PipelinePart::Part m_Part;
+		ProfileKey		m_Key;
+		JitProfile *	m_Profile;		// profile of the compiled code, or 0
+	};
+#endif
+
+	// ----------------------------------------------------------------------
+	// Synchronization of the threads that use a code cache
+	// ----------------------------------------------------------------------
+	class CacheLock {
+	public:
+#if EGL_CACHE_PTHREADS
+		CacheLock()		{ pthread_mutex_init(&m_Mutex, 0); }
+		~CacheLock()	{ pthread_mutex_destroy(&m_Mutex); }
+
+		void Enter()	{ pthread_mutex_lock(&m_Mutex); }
+		void Leave()	{ pthread_mutex_unlock(&m_Mutex); }
+
+	private:
+		pthread_mutex_t		m_Mutex;
+#elif EGL_CACHE_THREADS
+		CacheLock()		{ InitializeCriticalSection(&m_Section); }
+		~CacheLock()	{ DeleteCriticalSection(&m_Section); }
+
+		void Enter()	{ EnterCriticalSection(&m_Section); }
+		void Leave()	{ LeaveCriticalSection(&m_Section); }
+
+	private:
+		CRITICAL_SECTION	m_Section;
+#else
+		void Enter()	{ }
+		void Leave()	{ }
+#endif
 	};
+
+	// store a value after all preceding stores
+	inline void Publish(volatile I32 * target, I32 value) {
+#if EGL_CACHE_PTHREADS
+		__sync_synchronize();
+		*target = value;
+		__sync_synchronize();
+#elif EGL_CACHE_THREADS
+		InterlockedExchange(reinterpret_cast<volatile LONG *>(target), value);
+#else
+		*target = value;
+#endif
+	}
+
+	inline void Publish(CodeSegment * volatile * target, CodeSegment * value) {
+#if EGL_CACHE_PTHREADS
+		__sync_synchronize();
+		*target = value;
+		__sync_synchronize();
+#elif EGL_CACHE_THREADS
+		InterlockedExchangePointer(reinterpret_cast<void * volatile *>(target), value);
+#else
+		*target = value;
+#endif
+	}
+
+	inline U32 Increment(volatile U32 * value) {
+#if EGL_CACHE_PTHREADS
+		return __sync_add_and_fetch(value, 1);
+#elif EGL_CACHE_THREADS
+		return InterlockedIncrement(reinterpret_cast<volatile LONG *>(value));
+#else
+		return ++*value;
+#endif
+	}
+
+#if EGL_USE_ASYNC_JIT
+	// ----------------------------------------------------------------------
+	// Wakes the compiler thread; a signal that arrives while the thread is
+	// busy is kept until its next wait
+	// ----------------------------------------------------------------------
+	class CacheEvent {
+	public:
+#if EGL_CACHE_PTHREADS
+		CacheEvent() : m_Signaled(false) {
+			pthread_mutex_init(&m_Mutex, 0);
+			pthread_cond_init(&m_Condition, 0);
+		}
+
+		~CacheEvent() {
+			pthread_cond_destroy(&m_Condition);
+			pthread_mutex_destroy(&m_Mutex);
+		}
+
+		void Signal() {
+			pthread_mutex_lock(&m_Mutex);
+			m_Signaled = true;
+			pthread_cond_signal(&m_Condition);
+			pthread_mutex_unlock(&m_Mutex);
+		}
+
+		void Wait() {
+			pthread_mutex_lock(&m_Mutex);
+
+			while (!m_Signaled) {
+				pthread_cond_wait(&m_Condition, &m_Mutex);
+			}
+
+			m_Signaled = false;
+			pthread_mutex_unlock(&m_Mutex);
+		}
+
+	private:
+		pthread_mutex_t		m_Mutex;
+		pthread_cond_t		m_Condition;
+		bool				m_Signaled;
+#else
+		CacheEvent()		{ m_Event = CreateEvent(0, FALSE, FALSE, 0); }
+		~CacheEvent()		{ CloseHandle(m_Event); }
+
+		void Signal()		{ SetEvent(m_Event); }
+		void Wait()			{ WaitForSingleObject(m_Event, INFINITE); }
+
+	private:
+		HANDLE				m_Event;
+#endif
+	};
+#endif
+
+	// ----------------------------------------------------------------------
+	// The code cache of the process; it is shared by the function caches of
+	// all contexts.
+	//
+	// Lookups read the current segment without taking a lock. Everything
+	// else, including the compiled functions being added, is serialized by
+	// m_Lock, and the code generator by m_CompileLock. After a compaction,
+	// the retired segment is released once every client that was between
+	// Enter and Leave at the time of the compaction has left; until then,
+	// functions obtained from it can still be executed.
+	//
+	// With code protection, the current segment becomes writable for the
+	// first function added to it, and executable again for the first
+	// function that is requested for execution after that; all compiles of a
+	// draw call cost a single pair of protection changes. Threads only share
+	// a code cache where the code is not protected.
+	// ----------------------------------------------------------------------
+	class CodeCache {
+	public:
+		static CodeCache * Acquire(size_t totalSize, float percentageKeep, size_t maxExternalFunctions,
+								   size_t maxTotalSize);
+		void Release();
+
+		void AddClient(FunctionCache * client);
+		void RemoveClient(FunctionCache * client);
+
+		void Enter(FunctionCache * client);
+		void Leave(FunctionCache * client);
+
+		// lookup of a function in the current segment, without a lock
+		FunctionInfo * FindFunction(PipelinePart::Part part, const void * state, const ProfileKey & key);
+
+		// lookup of a function that a compaction has dropped
+		FunctionInfo * FindRetiredFunction(PipelinePart::Part part, const void * state, const ProfileKey & key);
+
+		// compile a function on the calling thread, unless it is in the cache
+		bool CompileFunction(FunctionCache * client, PipelinePart::Part part, const void * state,
+							 const VaryingInfo * varyingInfo);
+
+		void * BeginAddFunction(PipelinePart::Part part, const void * state, const ProfileKey & key, size_t size);
+		void EndAddFunction(void * addr, size_t size);
+
+		bool SetFunction(PipelinePart::Part part, const void * state, const ProfileKey & key, const void * ptr);
+
+		// keep the profile of a function until the cache is destroyed, as
+		// the code may update its counters as long as it exists
+		void AddProfile(JitProfile * profile);
+
+		// make the functions added to the current segment executable
+		void MakeExecutable() {
+			if (m_Segment->m_Writable) {
+				m_Lock.Enter();
+				ProtectSegment(m_Segment, false);
+				m_Lock.Leave();
+			}
+		}
+
+#if EGL_USE_ASYNC_JIT
+		// queue a function for the compiler thread unless it is queued already
+		bool QueueFunction(PipelinePart::Part part, const void * state, const ProfileKey & key,
+						   const VaryingInfo * varyingInfo);
+
+		// add the functions that the compiler thread has completed to the cache
+		void InstallFunctions();
+
+		// compile the queued functions until the cache is destroyed
+		void CompileQueuedFunctions();
+#if EGL_CACHE_PTHREADS
+		static void * CompilerThread(void * cache);
+#else
+		static DWORD WINAPI CompilerThread(LPVOID cache);
+#endif
+
+		volatile I32		m_CompiledJobs;		// jobs waiting to be installed
+#endif
+
+		volatile U32		m_Clock;			// incremented by each Enter
+
+	private:
+		CodeCache(size_t totalSize, float percentageKeep, size_t maxExternalFunctions,
+				  size_t maxTotalSize);
+		~CodeCache();
+
+		CodeSegment * AllocateSegment(size_t totalSize);
+		void FreeSegment(CodeSegment * segment);
+
+		// map the code area of a segment for writing or for execution
+		void ProtectSegment(CodeSegment * segment, bool writable);
+
+		// the number of functions that fit into a segment of the given size
+		size_t MaxFunctions(size_t totalSize) const {
+			return totalSize / 256 + m_MaxExternalFunctions;
+		}
+
+		// allocate a new, unpublished cache entry in the current segment
+		FunctionInfo * AllocateFunction(PipelinePart::Part part, const void * state, const ProfileKey & key,
+										size_t size = 0);
+
+		// reserve the code of a new entry in the current segment; m_Lock is held
+		void * PlaceFunction(PipelinePart::Part part, const void * state, const ProfileKey & key, size_t size);
+
+		// make the entry allocated last visible to lookups
+		void PublishFunction();
+
+		// perform a GC on the function cache
+		void CompactCode();
+
+		// replace the current segment by a copy without the given function
+		void DropFunction(FunctionInfo * function);
+
+		// append a copy of a function to an unpublished segment
+		void CopyFunction(CodeSegment * target, const FunctionInfo * function);
+
+		// make a segment current, and retire the previous one
+		void ReplaceSegment(CodeSegment * segment);
+
+		// release the retired segments that no client can execute anymore
+		void ReclaimSegments();
+
+		// synchronize the processor cache
+		void SyncCache(void * base, size_t size);
+
+		// append a profile to m_Profiles; m_Lock is held
+		void LinkProfile(JitProfile * profile);
+
+	private:
+		CodeSegment * volatile	m_Segment;		// current segment
+		CodeSegment *		m_Retired;			// retired segments, most recent first
+		volatile U32		m_Epoch;			// incremented by each compaction
+		U32					m_CompactClock;		// m_Clock at the latest compaction
+		FunctionCache *		m_Clients;
+		FunctionInfo **		m_Order;			// functions ordered by their use
+		size_t				m_References;
+
+		JitProfile *		m_Profiles;			// profiles in compile order
+		JitProfile *		m_LastProfile;
+
+		size_t				m_Total;			// size of the current segment
+		size_t				m_MaxTotal;			// limit for growing segments
+		size_t				m_UsedExternalFunctions;
+		size_t				m_MaxExternalFunctions;
+		float				m_PercentageKeep;
+
+		CacheLock			m_Lock;
+		CacheLock			m_CompileLock;
+
+#if EGL_USE_ASYNC_JIT
+		// Functions are compiled on the compiler thread into a buffer of
+		// their job, and copied into the cache by a rendering thread.
+		CompileJob *		m_Jobs;
+#if EGL_CACHE_PTHREADS
+		pthread_t			m_Thread;
+#else
+		HANDLE				m_Thread;
+#endif
+		CacheEvent			m_QueueEvent;
+		bool				m_Exit;
+#endif
+	};
+}
+
+
+namespace {
+	CacheLock		s_SharedLock;				// guards s_SharedCache
+	CodeCache *		s_SharedCache = 0;
+
+	// most recently used functions first
+	int CompareLastUsed(const void * first, const void * second) {
+		U32 firstUsed = (*reinterpret_cast<FunctionInfo * const *>(first))->m_LastUsed;
+		U32 secondUsed = (*reinterpret_cast<FunctionInfo * const *>(second))->m_LastUsed;
+
+		return firstUsed > secondUsed ? -1 : firstUsed < secondUsed ? 1 : 0;
+	}
 }
 
-FunctionCache :: FunctionCache(size_t totalSize, float percentageKeep, size_t maxExternalFunctions) {
+
+// --------------------------------------------------------------------------
+// Function cache of a context
+// --------------------------------------------------------------------------
+
+FunctionCache :: FunctionCache(size_t totalSize, float percentageKeep, size_t maxExternalFunctions,
+							   size_t maxTotalSize) {
+	m_Cache = CodeCache::Acquire(totalSize, percentageKeep, maxExternalFunctions, maxTotalSize);
+	m_NextClient = 0;
+	m_Epoch = 0;
+	m_Active = 0;
+	m_Job = 0;
+	m_ProfileFlags = PipelinePart::GetDefaultProfileFlags();
+
+	ResetStatistics();
+	m_Cache->AddClient(this);
+}
+
+
+FunctionCache :: FunctionCache(CompileJob * job) {
+	m_Cache = 0;
+	m_NextClient = 0;
+	m_Epoch = 0;
+	m_Active = 0;
+	m_Job = job;
+	m_ProfileFlags = 0;
+
+#if EGL_USE_ASYNC_JIT
+	m_ProfileFlags = job->m_Key.m_Flags;
+#endif
+
+	ResetStatistics();
+}
+
+
+FunctionCache :: ~FunctionCache() {
+	if (m_Cache) {
+		m_Cache->RemoveClient(this);
+		m_Cache->Release();
+	}
+}
+
+
+void FunctionCache :: ResetStatistics() {
+	memset(&m_Statistics, 0, sizeof(m_Statistics));
+}
+
+
+void FunctionCache :: SetProfileFlags(U32 flags) {
+	m_ProfileFlags = flags & JitProfileAll;
+}
+
+
+void FunctionCache :: AddProfile(JitProfile * profile) {
+#if EGL_USE_ASYNC_JIT
+	if (m_Job) {
+		// the profile is installed along with the code
+		m_Job->m_Profile = profile;
+		return;
+	}
+#endif
+
+	m_Cache->AddProfile(profile);
+}
+
+
+void FunctionCache :: Enter() {
+	m_Cache->Enter(this);
+}
+
+
+void FunctionCache :: Leave() {
+	m_Cache->Leave(this);
+}
+
+
+void * FunctionCache :: GetFunction(PipelinePart::Part part, const void * state) {
+
+	ProfileKey key = KeyOf(this);
+	FunctionInfo * function = m_Cache->FindFunction(part, state, key);
+
+	if (!function) {
+		// a compaction on another thread has dropped the function
+		function = m_Cache->FindRetiredFunction(part, state, key);
+	}
+
+	assert(function);
+
+	// the function is about to be executed
+	m_Cache->MakeExecutable();
+
+	return function ? const_cast<void *>(function->m_Pointer) : 0;
+}
+
+bool FunctionCache :: SetFunction(PipelinePart::Part part, const void * state, const void * ptr) {
+	return m_Cache->SetFunction(part, state, KeyOf(this), ptr);
+}
+
+bool FunctionCache :: PrepareFunction(PipelinePart::Part part, const void * state, const VaryingInfo * varyingInfo,
+									  bool background) {
+
+	++m_Statistics.Requests;
+
+#if EGL_USE_ASYNC_JIT
+	if (m_Cache->m_CompiledJobs) {
+		m_Cache->InstallFunctions();
+	}
+#endif
+
+	FunctionInfo * function = m_Cache->FindFunction(part, state, KeyOf(this));
+
+	if (function) {
+		function->m_LastUsed = m_Cache->m_Clock;
+		++m_Statistics.Hits;
+		return true;
+	}
+
+	// not found in cache, need to compile
+
+#if EGL_USE_ASYNC_JIT
+	if (background) {
+		if (m_Cache->QueueFunction(part, state, KeyOf(this), varyingInfo)) {
+			++m_Statistics.Queued;
+		}
+
+		return false;
+	}
+#endif
+
+	if (m_Cache->CompileFunction(this, part, state, varyingInfo)) {
+		++m_Statistics.Compiles;
+	}
+
+	return true;
+}
+
+void * FunctionCache :: BeginAddFunction(PipelinePart::Part part, const void * state, size_t size) {
+
+#if EGL_USE_ASYNC_JIT
+	if (m_Job) {
+		// a rendering thread copies the code into the cache
+		m_Job->m_Code = malloc(size);
+		m_Job->m_Size = size;
+		return m_Job->m_Code;
+	}
+#endif
+
+	return m_Cache->BeginAddFunction(part, state, KeyOf(this), size);
+}
+
+void FunctionCache :: EndAddFunction(void * addr, size_t size) {
+#if EGL_USE_ASYNC_JIT
+	if (m_Job) {
+		// the cache is synchronized when the code is installed
+		return;
+	}
+#endif
+
+	m_Cache->EndAddFunction(addr, size);
+}
+
+
+// --------------------------------------------------------------------------
+// Code cache of the process
+// --------------------------------------------------------------------------
+
+CodeCache * CodeCache :: Acquire(size_t totalSize, float percentageKeep, size_t maxExternalFunctions,
+								 size_t maxTotalSize) {
+
+#if EGL_USE_SHARED_FUNCTION_CACHE
+	s_SharedLock.Enter();
+
+	if (!s_SharedCache) {
+		s_SharedCache = new CodeCache(totalSize, percentageKeep, maxExternalFunctions, maxTotalSize);
+	}
+
+	CodeCache * cache = s_SharedCache;
+	++cache->m_References;
+
+	s_SharedLock.Leave();
+	return cache;
+#else
+	CodeCache * cache = new CodeCache(totalSize, percentageKeep, maxExternalFunctions, maxTotalSize);
+	++cache->m_References;
+
+	return cache;
+#endif
+}
+
+void CodeCache :: Release() {
+
+	s_SharedLock.Enter();
+
+	if (--m_References == 0) {
+		if (s_SharedCache == this) {
+			s_SharedCache = 0;
+		}
+
+		delete this;
+	}
+
+	s_SharedLock.Leave();
+}
+
+CodeCache :: CodeCache(size_t totalSize, float percentageKeep, size_t maxExternalFunctions,
+					   size_t maxTotalSize) {
 	m_Total = totalSize;
-	m_Used = 0;
+	m_MaxTotal = maxTotalSize > totalSize ? maxTotalSize : totalSize;
 	m_PercentageKeep = percentageKeep;
+	m_References = 0;
 
 	m_UsedExternalFunctions = 0;
 	m_MaxExternalFunctions = maxExternalFunctions;
-	m_UsedFunctions = 0;
-	m_MaxFunctions = totalSize / 256 + m_MaxExternalFunctions;
 
-	m_MostRecentlyUsed = 0;
-	m_LeastRecentlyUsed = 0;
+	m_Clock = 0;
+	m_CompactClock = 0;
+	m_Epoch = 0;
+	m_Clients = 0;
+	m_Retired = 0;
+	m_Profiles = 0;
+	m_LastProfile = 0;
+	m_Order = (FunctionInfo **) malloc(sizeof(FunctionInfo *) * MaxFunctions(m_MaxTotal));
+	m_Segment = AllocateSegment(m_Total);
 
-	m_Functions = (FunctionInfo *) malloc(sizeof(FunctionInfo) * m_MaxFunctions);
-	memset(m_Functions, 0, sizeof(FunctionInfo)  * m_MaxFunctions);
+#if EGL_USE_ASYNC_JIT
+	m_Jobs = 0;
+	m_CompiledJobs = 0;
+	m_Exit = false;
+
+#if EGL_CACHE_PTHREADS
+	pthread_create(&m_Thread, 0, CompilerThread, this);
+#else
+	m_Thread = CreateThread(0, 0, CompilerThread, this, 0, 0);
+#endif
+#endif
+}
+
+
+CodeCache :: ~CodeCache() {
+#if EGL_USE_ASYNC_JIT
+	m_Lock.Enter();
+	m_Exit = true;
+	m_Lock.Leave();
+
+	m_QueueEvent.Signal();
+
+#if EGL_CACHE_PTHREADS
+	pthread_join(m_Thread, 0);
+#else
+	WaitForSingleObject(m_Thread, INFINITE);
+	CloseHandle(m_Thread);
+#endif
+
+	while (m_Jobs) {
+		CompileJob * job = m_Jobs;
+		m_Jobs = job->m_Next;
+
+		if (job->m_Status == JobCompiled) {
+			free(job->m_Code);
+			delete job->m_Profile;
+		}
+
+		free(job);
+	}
+#endif
+
+	// no code that updates the counters remains after the segments
+	// are released
+	if (m_Profiles) {
+		PipelinePart::WriteProfiles(m_Profiles);
+	}
+
+	while (m_Profiles) {
+		JitProfile * profile = m_Profiles;
+		m_Profiles = profile->m_Next;
+		delete profile;
+	}
+
+	while (m_Retired) {
+		CodeSegment * segment = m_Retired;
+		m_Retired = segment->m_NextRetired;
+		FreeSegment(segment);
+	}
+
+	FreeSegment(m_Segment);
+	free(m_Order);
+}
+
+
+CodeSegment * CodeCache :: AllocateSegment(size_t totalSize) {
+
+	CodeSegment * segment = (CodeSegment *) malloc(sizeof(CodeSegment));
+
+	segment->m_MaxFunctions = MaxFunctions(totalSize);
+	segment->m_Functions = (FunctionInfo *) malloc(sizeof(FunctionInfo) * segment->m_MaxFunctions);
+	memset(segment->m_Functions, 0, sizeof(FunctionInfo)  * segment->m_MaxFunctions);
 
 #if defined(EGL_ON_WINCE)
-	m_Code = reinterpret_cast<U8 *>(VirtualAlloc(0, totalSize, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+	segment->m_Code = reinterpret_cast<U8 *>(VirtualAlloc(0, totalSize, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
 #elif defined(EGL_ON_SYMBIAN)
-    m_Code = reinterpret_cast<U8*>(User::Alloc(totalSize));
+    segment->m_Code = reinterpret_cast<U8*>(User::Alloc(totalSize));
+#elif defined(_WIN32)
+	segment->m_Code = reinterpret_cast<U8 *>(VirtualAlloc(0, totalSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
 #else
-  m_Code = (U8 *)malloc(totalSize);
+	void * code = mmap(0, totalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	segment->m_Code = code != MAP_FAILED ? reinterpret_cast<U8 *>(code) : 0;
 #endif
+
+	segment->m_Used = 0;
+	segment->m_Total = totalSize;
+	segment->m_Count = 0;
+	segment->m_Writable = true;
+	segment->m_NextRetired = 0;
+	segment->m_Epoch = 0;
+
+	return segment;
 }
 
 
-FunctionCache :: ~FunctionCache() {
-	free(m_Functions);
+void CodeCache :: FreeSegment(CodeSegment * segment) {
+
+	free(segment->m_Functions);
 
 #if defined(EGL_ON_WINCE)
-	VirtualFree(m_Code, m_Total, MEM_DECOMMIT);
+	VirtualFree(segment->m_Code, segment->m_Total, MEM_DECOMMIT);
 #elif defined(EGL_ON_SYMBIAN)
-    User::Free(m_Code);
+    User::Free(segment->m_Code);
+#elif defined(_WIN32)
+	VirtualFree(segment->m_Code, 0, MEM_RELEASE);
 #else
-  free(m_Code);
+	munmap(segment->m_Code, segment->m_Total);
 #endif
+
+	free(segment);
 }
 
 
-void * FunctionCache :: GetFunction(PipelinePart::Part part, const void * state) {
+void CodeCache :: ProtectSegment(CodeSegment * segment, bool writable) {
+
+	if (segment->m_Writable == writable) {
+		return;
+	}
+
+#if EGL_CODE_PROTECTION && defined(_WIN32)
+	DWORD oldProtection;
+	VirtualProtect(segment->m_Code, segment->m_Total, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &oldProtection);
+
+	if (!writable) {
+		FlushInstructionCache(GetCurrentProcess(), segment->m_Code, segment->m_Total);
+	}
+#elif EGL_CODE_PROTECTION
+	mprotect(segment->m_Code, segment->m_Total, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+#endif
+
+	segment->m_Writable = writable;
+}
+
+
+void CodeCache :: AddClient(FunctionCache * client) {
+	m_Lock.Enter();
+	client->m_NextClient = m_Clients;
+	m_Clients = client;
+	m_Lock.Leave();
+}
+
+
+void CodeCache :: RemoveClient(FunctionCache * client) {
+	m_Lock.Enter();
+
+	for (FunctionCache ** link = &m_Clients; *link; link = &(*link)->m_NextClient) {
+		if (*link == client) {
+			*link = client->m_NextClient;
+			break;
+		}
+	}
+
+	ReclaimSegments();
+	m_Lock.Leave();
+}
+
+
+void CodeCache :: Enter(FunctionCache * client) {
+	// the segments of the current epoch stay until the client leaves
+	client->m_Epoch = m_Epoch;
+	Publish(&client->m_Active, 1);
+	Increment(&m_Clock);
+}
+
+
+void CodeCache :: Leave(FunctionCache * client) {
+	Publish(&client->m_Active, 0);
+
+	if (m_Retired) {
+		m_Lock.Enter();
+		ReclaimSegments();
+		m_Lock.Leave();
+	}
+}
+
+
+FunctionInfo * CodeCache :: FindFunction(PipelinePart::Part part, const void * state, const ProfileKey & key) {
 
 	PipelinePart & ppart = PipelinePart::Get(part);
+	CodeSegment * segment = m_Segment;
+	FunctionInfo * end = segment->m_Functions + segment->m_Count;
 
-	for (FunctionInfo * function = m_MostRecentlyUsed; function; function = function->m_Next) {
-		if (function->m_Part == part && ppart.CompareState(function->m_State, state)) {
-			if (function->m_Flags & FlagExternal) {
-				return const_cast<void *>(function->m_Pointer);
-			} else {
-				return reinterpret_cast<void *>(m_Code + function->m_Offset);
+	for (FunctionInfo * function = segment->m_Functions; function != end; ++function) {
+		if (function->m_Part == part && function->m_Key == key && ppart.CompareState(function->m_State, state)) {
+			return function;
+		}
+	}
+
+	return 0;
+}
+
+
+FunctionInfo * CodeCache :: FindRetiredFunction(PipelinePart::Part part, const void * state, const ProfileKey & key) {
+
+	PipelinePart & ppart = PipelinePart::Get(part);
+	FunctionInfo * result = 0;
+
+	m_Lock.Enter();
+
+	for (CodeSegment * segment = m_Retired; segment && !result; segment = segment->m_NextRetired) {
+		FunctionInfo * end = segment->m_Functions + segment->m_Count;
+
+		for (FunctionInfo * function = segment->m_Functions; function != end; ++function) {
+			if (function->m_Part == part && function->m_Key == key && ppart.CompareState(function->m_State, state)) {
+				result = function;
+				break;
 			}
 		}
 	}
 
-	assert(0);
-	return 0;
+	m_Lock.Leave();
+
+	return result;
 }
 
-bool FunctionCache :: SetFunction(PipelinePart::Part part, const void * state, const void * ptr) {
+
+bool CodeCache :: CompileFunction(FunctionCache * client, PipelinePart::Part part, const void * state,
+								  const VaryingInfo * varyingInfo) {
+
+	m_CompileLock.Enter();
+
+	// another thread may have compiled the function meanwhile
+	bool compile = !FindFunction(part, state, KeyOf(client));
+
+	if (compile) {
+		PipelinePart::Get(part).Compile(client, varyingInfo, state);
+	}
+
+	m_CompileLock.Leave();
+
+	return compile;
+}
+
+
+bool CodeCache :: SetFunction(PipelinePart::Part part, const void * state, const ProfileKey & key, const void * ptr) {
+
+	m_Lock.Enter();
 
 	// Determine existing cache entry for this configuration
-	PipelinePart & ppart = PipelinePart::Get(part);
-	FunctionInfo * function;
+	FunctionInfo * function = FindFunction(part, state, key);
+	bool external = function && (function->m_Flags & FlagExternal);
 
-	for (function = m_MostRecentlyUsed; function; function = function->m_Next) {
-		if (function->m_Part == part && ppart.CompareState(function->m_State, state)) {
-			break;
-		}
+	if (ptr && !external && m_UsedExternalFunctions >= m_MaxExternalFunctions) {
+		m_Lock.Leave();
+		return false;
 	}
 
-	if (!ptr) {
-		// clear existing entry if exists
+	if (function) {
+		// lookups may be looking at the entry, so it is not modified; it is
+		// left behind in the retired segment instead
+		DropFunction(function);
 
-		if (function) {
-			// clear the entry
+		if (external) {
 			--m_UsedExternalFunctions;
-			function->m_Part = PipelinePart::PartInvalid;
-			function->m_Pointer = 0;
-			function->m_Flags = 0;
-		}
-	} else {
-		if (!function) {
-			// Create a new entry
-
-			if (m_UsedExternalFunctions >= m_MaxExternalFunctions) {
-				return false;
-			}
-
-			++m_UsedExternalFunctions;
-
-			function = AllocateFunction(part, state);
-			assert(function);
-		} else if (!(function->m_Flags & FlagExternal)) {
-			if (m_UsedExternalFunctions >= m_MaxExternalFunctions) {
-				return false;
-			} else {
-				++m_UsedExternalFunctions;
-			}
 		}
+	}
+
+	if (ptr) {
+		function = AllocateFunction(part, state, key);
 
 		// record the function pointer
 		function->m_Flags = FlagExternal;
 		function->m_Pointer = ptr;
+		++m_UsedExternalFunctions;
+
+		PublishFunction();
 	}
 
+	m_Lock.Leave();
+
 	return true;
 }
 
-void FunctionCache :: PrepareFunction(PipelinePart::Part part, const void * state, const VaryingInfo * varyingInfo) {
+FunctionInfo * CodeCache :: AllocateFunction(PipelinePart::Part part, const void * state, const ProfileKey & key,
+											 size_t size) {
 
 	PipelinePart & ppart = PipelinePart::Get(part);
+	CodeSegment * segment = m_Segment;
 
-	for (FunctionInfo * function = m_MostRecentlyUsed; function; function = function->m_Next) {
-		if (function->m_Part == part && ppart.CompareState(function->m_State, state)) {
-			// move to front
-			if (function->m_Prev) {
-				function->m_Prev->m_Next = function->m_Next;
-
-				if (function->m_Next) {
-					function->m_Next->m_Prev = function->m_Prev;
-				} else {
-					m_LeastRecentlyUsed = function->m_Prev;
-				}
-
-				function->m_Next = m_MostRecentlyUsed;
-				function->m_Prev = 0;
-				m_MostRecentlyUsed->m_Prev = function;
-				m_MostRecentlyUsed = function;
-			}
-
-			return;
-		}
+	if (size + segment->m_Used >= segment->m_Total || (size_t) segment->m_Count >= segment->m_MaxFunctions) {
+		CompactCode();
+		segment = m_Segment;
 	}
 
-	// not found in cache, need to compile
+	assert((size_t) segment->m_Count < segment->m_MaxFunctions);
+	assert(size + segment->m_Used < segment->m_Total);
 
-	ppart.Compile(this, varyingInfo, state);
-}
-
-FunctionInfo * FunctionCache :: AllocateFunction(PipelinePart::Part part, const void * state, size_t size) {
-
-	PipelinePart & ppart = PipelinePart::Get(part);
-
-	if (size + m_Used >= m_Total || m_UsedFunctions >= m_MaxFunctions) {
-		CompactCode();
-	}
-
-	assert(m_UsedFunctions < m_MaxFunctions);
-	assert(size + m_Used < m_Total);
-
-	FunctionInfo * function = m_Functions + m_UsedFunctions++;
-
-	function->m_Next = m_MostRecentlyUsed;
-	function->m_Prev = 0;
-
-	if (m_MostRecentlyUsed) {
-		m_MostRecentlyUsed->m_Prev = function;
-	} else {
-		m_LeastRecentlyUsed = function;
-	}
-
-	m_MostRecentlyUsed = function;
-
+	FunctionInfo * function = segment->m_Functions + segment->m_Count;
+
+	function->m_Pointer = 0;
+	function->m_Size = size;
 	function->m_Flags = FlagNone;
+	function->m_LastUsed = m_Clock;
 	ppart.CopyState(function->m_State, state);
 	function->m_Part = part;
+	function->m_Key = key;
 
 	return function;
 }
 
-void * FunctionCache :: BeginAddFunction(PipelinePart::Part part, const void * state, size_t size) {
+void CodeCache :: PublishFunction() {
+	Publish(&m_Segment->m_Count, m_Segment->m_Count + 1);
+}
+
+void * CodeCache :: BeginAddFunction(PipelinePart::Part part, const void * state, const ProfileKey & key,
+									 size_t size) {
+
+	// held until EndAddFunction publishes the function
+	m_Lock.Enter();
+
+	return PlaceFunction(part, state, key, size);
+}
 
-	FunctionInfo * function = AllocateFunction(part, state, size);
+void * CodeCache :: PlaceFunction(PipelinePart::Part part, const void * state, const ProfileKey & key,
+								  size_t size) {
 
-	function->m_Offset = m_Used;
-	function->m_Size = size;
-	m_Used += size;
+	FunctionInfo * function = AllocateFunction(part, state, key, size);
+	CodeSegment * segment = m_Segment;
+
+	ProtectSegment(segment, true);
+
+	function->m_Pointer = segment->m_Code + segment->m_Used;
+	segment->m_Used += size;
 
-	return reinterpret_cast<void *>(m_Code + function->m_Offset);
+	return const_cast<void *>(function->m_Pointer);
 }
 
-void FunctionCache :: EndAddFunction(void * addr, size_t size) {
+void CodeCache :: EndAddFunction(void * addr, size_t size) {
 	SyncCache(addr, size);
+	PublishFunction();
+
+	m_Lock.Leave();
 }
 
-void FunctionCache :: CompactCode() {
+void CodeCache :: AddProfile(JitProfile * profile) {
+	m_Lock.Enter();
+	LinkProfile(profile);
+	m_Lock.Leave();
+}
 
-	size_t limit = (size_t) (m_Total * m_PercentageKeep);
-	size_t limitFunctions = (size_t) ((m_MaxFunctions - m_MaxExternalFunctions) * m_PercentageKeep);
-
-	size_t countExternalFunctions = 0;
+void CodeCache :: LinkProfile(JitProfile * profile) {
+	profile->m_Next = 0;
+
+	if (m_LastProfile) {
+		m_LastProfile->m_Next = profile;
+	} else {
+		m_Profiles = profile;
+	}
+
+	m_LastProfile = profile;
+}
+
+void CodeCache :: CompactCode() {
+
+	size_t usedFunctions = 0;
+	size_t usedMemory = 0;
 	size_t countFunctions = 0;
 	size_t countMemory = 0;
+	size_t count = 0;
+	size_t index;
+	bool full = false;
 
-	// mark those functions that need to be retained
-	FunctionInfo * function = m_MostRecentlyUsed;
+	CodeSegment * segment = m_Segment;
 
-	for (; function; function = function->m_Next) {
-		if (function->m_Flags & FlagExternal) {
-			++countExternalFunctions;
-			continue;
-		}
+	// order the functions by their most recent use
+	for (index = 0; index < (size_t) segment->m_Count; ++index) {
+		FunctionInfo * function = segment->m_Functions + index;
 
-		if (function->m_Size + countMemory > limit ||
-			countFunctions >= limitFunctions)
-			break;
+		m_Order[count++] = function;
 
-		function->m_Flags = 1;
-		++countFunctions;
-		countMemory += function->m_Size;
+		if (!(function->m_Flags & FlagExternal) && (I32) (function->m_LastUsed - m_CompactClock) >= 0) {
+			++usedFunctions;
+			usedMemory += function->m_Size;
+		}
 	}
+
+	qsort(m_Order, count, sizeof(FunctionInfo *), CompareLastUsed);
+
+	// rather than dropping functions that have been requested since the
+	// previous compaction, the segment grows up to the maximum size
+	while (m_Total < m_MaxTotal &&
+		   (usedMemory > (size_t) (m_Total * m_PercentageKeep) ||
+			usedFunctions > (size_t) ((MaxFunctions(m_Total) - m_MaxExternalFunctions) * m_PercentageKeep))) {
+		m_Total = m_Total * 2 < m_MaxTotal ? m_Total * 2 : m_MaxTotal;
+	}
+
+	size_t limit = (size_t) (m_Total * m_PercentageKeep);
+	size_t limitFunctions = (size_t) ((MaxFunctions(m_Total) - m_MaxExternalFunctions) * m_PercentageKeep);
+
+	CodeSegment * compacted = AllocateSegment(m_Total);
+
+	// copy those functions that need to be retained into the new segment
+	for (index = 0; index < count; ++index) {
+		FunctionInfo * function = m_Order[index];
 
-	for (; function; function = function->m_Next) {
-		if (function->m_Flags & FlagExternal) {
-			++countExternalFunctions;
-		} else {
-			function->m_Flags = 0;
+		if (!(function->m_Flags & FlagExternal)) {
+			if (full ||
+				function->m_Size + countMemory > limit ||
+				countFunctions >= limitFunctions) {
+				full = true;
+				continue;
+			}
+
+			++countFunctions;
+			countMemory += function->m_Size;
 		}
+
+		CopyFunction(compacted, function);
 	}
-
-	assert(countExternalFunctions == m_UsedExternalFunctions);
 
-	// now compact the list of functions
+	m_CompactClock = m_Clock;
+	ReplaceSegment(compacted);
+}
 
-	m_Used = 0;
+void CodeCache :: DropFunction(FunctionInfo * function) {
 
-	FunctionInfo * target = m_Functions;
+	CodeSegment * segment = m_Segment;
+	CodeSegment * copy = AllocateSegment(m_Total);
 
-	for (function = m_Functions; function < m_Functions + m_UsedFunctions; ++function) {
-		if (function->m_Flags) {
-			if (function->m_Flags & FlagExternal) {
-				target->m_Pointer = function->m_Pointer;
-			} else {
-				memmove(m_Code + m_Used, m_Code + function->m_Offset, function->m_Size);
-				target->m_Offset = m_Used;
-				m_Used += function->m_Size;
-			}
-
-			if (function != target) {
-				memmove(target->m_State, function->m_State, sizeof(target->m_State));
-			}
+	for (FunctionInfo * other = segment->m_Functions; other != segment->m_Functions + segment->m_Count; ++other) {
+		if (other != function) {
+			CopyFunction(copy, other);
+		}
+	}
+
+	ReplaceSegment(copy);
+}
+
+void CodeCache :: CopyFunction(CodeSegment * segment, const FunctionInfo * function) {
+
+	FunctionInfo * target = segment->m_Functions + segment->m_Count;
+
+	if (function->m_Flags & FlagExternal) {
+		target->m_Pointer = function->m_Pointer;
+	} else {
+		memcpy(segment->m_Code + segment->m_Used, function->m_Pointer, function->m_Size);
+		target->m_Pointer = segment->m_Code + segment->m_Used;
+		segment->m_Used += function->m_Size;
+	}
+
+	memcpy(target->m_State, function->m_State, sizeof(target->m_State));
+	target->m_Size = function->m_Size;
+	target->m_Flags = function->m_Flags;
+	target->m_LastUsed = function->m_LastUsed;
+	target->m_Part = function->m_Part;
+	target->m_Key = function->m_Key;
+
+	++segment->m_Count;
+}
+
+void CodeCache :: ReplaceSegment(CodeSegment * segment) {
+
+	CodeSegment * previous = m_Segment;
+
+	SyncCache(segment->m_Code, segment->m_Used);
+
+	// lookups find the copied functions in the new segment; clients that
+	// have entered before the replacement may still execute the old one
+	ProtectSegment(previous, false);
+	Publish(&m_Segment, segment);
 
-			target->m_Size = function->m_Size;
-			target->m_Part = function->m_Part;
+	previous->m_Epoch = Increment(&m_Epoch);
+	previous->m_NextRetired = m_Retired;
+	m_Retired = previous;
 
-			++target;
+	ReclaimSegments();
+}
+
+void CodeCache :: ReclaimSegments() {
+
+	// the earliest epoch in which a client has entered
+	U32 epoch = m_Epoch;
+
+	for (FunctionCache * client = m_Clients; client; client = client->m_NextClient) {
+		if (client->m_Active && (I32) (client->m_Epoch - epoch) < 0) {
+			epoch = client->m_Epoch;
 		}
 	}
 
-	m_UsedFunctions = countFunctions + countExternalFunctions;
+	CodeSegment ** link = &m_Retired;
 
-	// re-link LRU chain
+	while (*link) {
+		CodeSegment * segment = *link;
 
-	if (m_UsedFunctions == 0) {
-		m_MostRecentlyUsed = m_LeastRecentlyUsed = 0;
-	} else if (m_UsedFunctions == 1) {
-		m_MostRecentlyUsed = m_LeastRecentlyUsed = m_Functions;
-		m_Functions->m_Prev = m_Functions->m_Next = 0;
-	} else if (m_UsedFunctions > 1) {
-		m_MostRecentlyUsed = m_Functions;
-		m_LeastRecentlyUsed = m_Functions + m_UsedFunctions - 1;
-		m_Functions[0].m_Prev = m_Functions[m_UsedFunctions - 1].m_Next = 0;
-		m_Functions[0].m_Next = m_Functions + 1;
-		m_Functions[m_UsedFunctions - 1].m_Prev = m_Functions + m_UsedFunctions - 2;
-
-		for (size_t index = 1; index < m_UsedFunctions - 1; ++index) {
-			m_Functions[index].m_Prev = m_Functions + index - 1;
-			m_Functions[index].m_Next = m_Functions + index + 1;
+		if ((I32) (epoch - segment->m_Epoch) >= 0) {
+			*link = segment->m_NextRetired;
+			FreeSegment(segment);
+		} else {
+			link = &segment->m_NextRetired;
 		}
 	}
-
-	SyncCache(m_Code, m_Used);
 }
 
-void FunctionCache :: SyncCache(void * base, size_t size) {
+void CodeCache :: SyncCache(void * base, size_t size) {
 #if defined(EGL_ON_WINCE) && (defined(ARM) || defined(_ARM_))
 	// flush data cache and clear instruction cache to make new code visible to execution unit
 	CacheSync(CACHE_SYNC_INSTRUCTIONS | CACHE_SYNC_WRITEBACK);
 #elif defined(ARM) && defined(__gnu_linux__)
-	CLEAR_INSN_CACHE(targetBuffer, (U8 *) targetBuffer + cg_segment_size(cseg))
+	CLEAR_INSN_CACHE(base, (U8 *) base + size)
 #endif
 
 }
 
+
+#if EGL_USE_ASYNC_JIT
+
+// --------------------------------------------------------------------------
+// Background compilation
+//
+// A request with background set that misses the cache queues a job for the
+// compiler thread and returns; the rasterizer uses its C functions until a
+// later request finds the function in the cache. The compiler thread emits
+// the code into a buffer of the job, and a rendering thread copies it into
+// the cache at the beginning of its next request.
+// --------------------------------------------------------------------------
+
+bool CodeCache :: QueueFunction(PipelinePart::Part part, const void * state, const ProfileKey & key,
+								const VaryingInfo * varyingInfo) {
+
+	PipelinePart & ppart = PipelinePart::Get(part);
+	CompileJob ** link = &m_Jobs;
+
+	m_Lock.Enter();
+
+	for (; *link; link = &(*link)->m_Next) {
+		if ((*link)->m_Part == part && (*link)->m_Key == key && ppart.CompareState((*link)->m_State, state)) {
+			m_Lock.Leave();
+			return false;
+		}
+	}
+
+	CompileJob * job = reinterpret_cast<CompileJob *>(malloc(sizeof(CompileJob)));
+
+	if (job) {
+		job->m_Next = 0;
+		ppart.CopyState(job->m_State, state);
+		job->m_VaryingInfo = *varyingInfo;
+		job->m_Code = 0;
+		job->m_Size = 0;
+		job->m_Status = JobQueued;
+		job->m_Part = part;
+		job->m_Key = key;
+		job->m_Profile = 0;
+
+		*link = job;
+		m_QueueEvent.Signal();
+	}
+
+	m_Lock.Leave();
+
+	return job != 0;
+}
+
+void CodeCache :: InstallFunctions() {
+
+	CompileJob ** link = &m_Jobs;
+
+	m_Lock.Enter();
+
+	while (*link) {
+		CompileJob * job = *link;
+
+		if (job->m_Status != JobCompiled) {
+			link = &job->m_Next;
+			continue;
+		}
+
+		*link = job->m_Next;
+		--m_CompiledJobs;
+
+		// the function may have been compiled on another thread meanwhile
+		if (job->m_Code && !FindFunction(job->m_Part, job->m_State, job->m_Key)) {
+			// m_Lock is held already, so the function is not added through
+			// BeginAddFunction
+			void * code = PlaceFunction(job->m_Part, job->m_State, job->m_Key, job->m_Size);
+			memcpy(code, job->m_Code, job->m_Size);
+			SyncCache(code, job->m_Size);
+			PublishFunction();
+
+			if (job->m_Profile) {
+				LinkProfile(job->m_Profile);
+				job->m_Profile = 0;
+			}
+		}
+
+		delete job->m_Profile;
+		free(job->m_Code);
+		free(job);
+	}
+
+	m_Lock.Leave();
+}
+
+void CodeCache :: CompileQueuedFunctions() {
+
+	for (;;) {
+		CompileJob * job;
+
+		m_Lock.Enter();
+
+		for (job = m_Jobs; job && job->m_Status != JobQueued; job = job->m_Next)
+			;
+
+		if (job) {
+			job->m_Status = JobCompiling;
+		}
+
+		bool exit = m_Exit;
+
+		m_Lock.Leave();
+
+		if (exit) {
+			return;
+		}
+
+		if (!job) {
+			m_QueueEvent.Wait();
+			continue;
+		}
+
+		m_CompileLock.Enter();
+
+		if (!FindFunction(job->m_Part, job->m_State, job->m_Key)) {
+			// the compiled code goes into the buffer of the job
+			FunctionCache compiler(job);
+			PipelinePart::Get(job->m_Part).Compile(&compiler, &job->m_VaryingInfo, job->m_State);
+		}
+
+		m_CompileLock.Leave();
+
+		m_Lock.Enter();
+		job->m_Status = JobCompiled;
+		++m_CompiledJobs;
+		m_Lock.Leave();
+	}
+}
+
+#if EGL_CACHE_PTHREADS
+void * CodeCache :: CompilerThread(void * cache) {
+	reinterpret_cast<CodeCache *>(cache)->CompileQueuedFunctions();
+	return 0;
+}
+#else
+DWORD WINAPI CodeCache :: CompilerThread(LPVOID cache) {
+	reinterpret_cast<CodeCache *>(cache)->CompileQueuedFunctions();
+	return 0;
+}
+#endif
+
+#endif // EGL_USE_ASYNC_JIT
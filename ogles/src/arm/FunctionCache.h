@@ -45,16 +45,47 @@
 namespace EGL {
 
 	struct FunctionInfo;
+	struct CompileJob;
+	class CodeCache;
+
+	// requests of one client of the function cache
+	struct FunctionCacheStatistics {
+		U32		Requests;			// calls to PrepareFunction
+		U32		Hits;				// requests for functions in the cache
+		U32		Compiles;			// functions compiled on the requesting thread
+		U32		Queued;				// functions queued for the compiler thread
+	};
+
+	// ----------------------------------------------------------------------
+	// The compiled functions are kept in a code cache that is shared by the
+	// function caches of all contexts of the process. A function cache is the
+	// view of one context onto the code cache: lookups do not take a lock,
+	// and the code cache defers the release of code until no context that
+	// may still execute it is between Enter and Leave.
+	// ----------------------------------------------------------------------
 
 	class OGLES_API FunctionCache {
 		friend class CodeGenerator;
+		friend class CodeCache;
 
 	public:
-		FunctionCache(size_t totalSize = 65536, float percentageKeep = 0.6, size_t maxExternalFunctions = 32);
+		// the size of the shared code cache is determined by its first client;
+		// the code area grows up to maxTotalSize rather than dropping
+		// functions that are still in use
+		FunctionCache(size_t totalSize = 65536, float percentageKeep = 0.6, size_t maxExternalFunctions = 32,
+					  size_t maxTotalSize = 262144);
 		~FunctionCache();
 
-		// request a function pointer for a specific pipeline part and state
-		void PrepareFunction(PipelinePart::Part part, const void * state, const VaryingInfo * varyingInfo);
+		// the functions requested after Enter may be executed until Leave
+		void Enter();
+		void Leave();
+
+		// request a function pointer for a specific pipeline part and state;
+		// with background set, a function that is not in the cache yet is
+		// compiled on the compiler thread, and false is returned until a
+		// later request finds it compiled
+		bool PrepareFunction(PipelinePart::Part part, const void * state, const VaryingInfo * varyingInfo,
+							 bool background = false);
 
 		// request a function pointer for a specific pipeline part and state
 		void * GetFunction(PipelinePart::Part part, const void * state);
@@ -67,29 +98,34 @@ namespace EGL {
 
 		// set the function for a specific state
 		bool SetFunction(PipelinePart::Part part, const void * state, const void * ptr);
-		
-	private:
-		// perform a GC on the function cache
-		void CompactCode();
 
-		// synchronize the processor cache
-		void SyncCache(void * base, size_t size);
+		// statistics of the requests of this client
+		const FunctionCacheStatistics & GetStatistics() const	{ return m_Statistics; }
+		void ResetStatistics();
+
+		// profiling of the functions compiled for this client, a combination
+		// of JitProfileFlags; only functions compiled with the same flags are
+		// shared with other clients
+		void SetProfileFlags(U32 flags);
+		U32 GetProfileFlags() const								{ return m_ProfileFlags; }
 
-		// allocate a new cache entry for the given state
-		FunctionInfo * AllocateFunction(PipelinePart::Part part, const void * state, size_t size = 0);
+		// a code generator hands over the profile of the function it added;
+		// the record is released with the code
+		void AddProfile(JitProfile * profile);
+
+	private:
+		// client of the compiler thread for a single job; it is not
+		// attached to a code cache
+		FunctionCache(CompileJob * job);
 
 	private:
-		U8 *				m_Code;
-		size_t				m_Used;	
-		size_t				m_Total;
-		FunctionInfo *		m_Functions;
-		FunctionInfo *		m_MostRecentlyUsed;
-		FunctionInfo *		m_LeastRecentlyUsed;
-		size_t				m_UsedFunctions;
-		size_t				m_MaxFunctions;
-		size_t				m_UsedExternalFunctions;
-		size_t				m_MaxExternalFunctions;
-		float				m_PercentageKeep;
+		CodeCache *			m_Cache;
+		FunctionCache *		m_NextClient;		// in the client list of m_Cache
+		volatile U32		m_Epoch;			// epoch of m_Cache at Enter
+		volatile I32		m_Active;			// between Enter and Leave
+		CompileJob *		m_Job;				// job of the compiler thread
+		U32					m_ProfileFlags;
+		FunctionCacheStatistics	m_Statistics;
 	};
 
 }
@@ -59,6 +59,10 @@
 #include "RasterTriangleDepthStencilPart.h"
 #include "RasterTriangleEdgeDepthStencilPart.h"
 
+#if !defined(EGL_ON_WINCE) && !defined(_WIN32)
+#include <time.h>
+#endif
+
 
 using namespace EGL;
 
@@ -74,21 +78,181 @@ namespace {
 		cg_module_dump(module, fp);
 		fclose(fp);
 	}
+
+	// ----------------------------------------------------------------------
+	// Cycles until the result of a load or multiply can be used without
+	// stalling the pipeline
+	// ----------------------------------------------------------------------
+
+#ifdef EGL_XSCALE
+	const cg_latency_info_t Latency = { 3, 3, 2, 4 };
+#else
+	const cg_latency_info_t Latency = { 2, 3, 3, 4 };
+#endif
+
+	// ----------------------------------------------------------------------
+	// Profiling of the generated code
+	// ----------------------------------------------------------------------
+
+	const char * const PartNames[] = {
+		"Invalid", "RasterPoint", "RasterLine", "RasterBlockDepthStencil",
+		"RasterBlockEdgeDepthStencil", "RasterBlockColorAlpha", "RasterBlockFullColorAlpha",
+		"RasterBlockDepthStencilColorAlpha", "FetchVertex"
+	};
+
+	// Windows CE does not provide an environment; profiling is controlled 
+	// by GL_JIT_PROFILE_HINT_VIN only, and the output goes to \Temp
+	U32 ReadProfileFlags() {
+#ifdef EGL_ON_WINCE
+		return JitProfileOff;
+#else
+		const char * value = getenv("EGL_JIT_PROFILE");
+
+		if (!value) {
+			return JitProfileOff;
+		}
+
+		return strtoul(value, 0, 0) & JitProfileAll;
+#endif
+	}
+
+	// build the path of a profile output file; false if no output directory
+	// has been configured
+	bool ProfilePath(char * buffer, size_t size, const char * name) {
+#ifdef EGL_ON_WINCE
+		const char * directory = "\\Temp";
+		const char * separator = "\\";
+#else
+		const char * directory = getenv("EGL_JIT_PROFILE_DIR");
+		const char * separator = "/";
+#endif
+
+		if (!directory || strlen(directory) + strlen(name) + 2 > size) {
+			return false;
+		}
+
+		sprintf(buffer, "%s%s%s", directory, separator, name);
+		return true;
+	}
+
+	// milliseconds since an arbitrary point in time
+	U32 Ticks() {
+#if defined(EGL_ON_WINCE) || defined(_WIN32)
+		return GetTickCount();
+#else
+		return (U32) (clock() / (CLOCKS_PER_SEC / 1000));
+#endif
+	}
+
+	const U32		DefaultProfileFlags = ReadProfileFlags();
+	U32				NumProfiles = 0;		// numbers the dump files of the process
+}
+
+U32 PipelinePart::GetDefaultProfileFlags() {
+	return DefaultProfileFlags;
 }
 
-void PipelinePart::BeginGenerateCode() {
+void PipelinePart::WriteProfiles(const JitProfile * profiles) {
+	char path[256];
+
+	if (!ProfilePath(path, sizeof(path), "jitprofile.txt")) {
+		return;
+	}
+
+	// each code cache of the process appends its report
+	FILE * fp = fopen(path, "a");
+
+	if (!fp) {
+		return;
+	}
+
+	fprintf(fp, "id\tpart\tsize\tms\tcalls\tpixels\tstate\n");
+
+	for (const JitProfile * profile = profiles; profile; profile = profile->m_Next) {
+		fprintf(fp, "%u\t%s\t%u\t%u\t%u\t%u\t%s\n", 
+			profile->m_Id, PartNames[profile->m_Part], 
+			(U32) profile->m_Size, profile->m_CompileTime,
+			profile->m_Invocations, profile->m_Pixels, profile->m_State);
+	}
+
+	fclose(fp);
+}
+
+void PipelinePart::DescribeState(char * buffer, size_t size, const void * state) const {
+	buffer[0] = '\0';
+}
+
+void PipelinePart::AppendState(char * buffer, size_t size, const char * name, const char * value) {
+	size_t used = strlen(buffer);
+
+	if (used + strlen(name) + strlen(value) + 3 > size)
+		return;
+
+	sprintf(buffer + used, used ? " %s=%s" : "%s=%s", name, value);
+}
+
+void PipelinePart::AppendState(char * buffer, size_t size, const char * name, I32 value) {
+	char text[12];
+	sprintf(text, "%d", value);
+	AppendState(buffer, size, name, text);
+}
+
+void PipelinePart::GenerateCounter(cg_block_t * block, volatile U32 * counter) {
+	cg_proc_t * procedure = block->proc;
+
+	DECL_CONST_REG	(regAddr, static_cast<U32>(reinterpret_cast<size_t>(counter)));
+	DECL_REG		(regCount);
+	DECL_CONST_REG	(regOne, 1);
+	DECL_REG		(regNewCount);
+
+	LDW		(regCount, regAddr);
+	ADD		(regNewCount, regCount, regOne);
+	STW		(regNewCount, regAddr);
+}
+
+void PipelinePart::BeginGenerateCode(FunctionCache * target) {
 	cg_heap_t * heap = cg_heap_create(4096);
 	cg_module_t * module = cg_module_create(heap);
 
 	m_Module = module;
+	m_Profile = 0;
+	m_ProfileFlags = target->GetProfileFlags();
+
+	if (m_ProfileFlags != JitProfileOff) {
+		m_Profile = new JitProfile;
+		memset(m_Profile, 0, sizeof(JitProfile));
+
+		m_Profile->m_Part = GetPart();
+		m_Profile->m_CompileTime = Ticks();
+	}
 }
 
 void PipelinePart::EndGenerateCode(FunctionCache * target, const void * state) {
+	if (m_Profile && (m_ProfileFlags & JitProfileCounters)) {
+		// count invocations at the start of the entry block of each procedure
+		for (cg_proc_t * proc = m_Module->procs; proc; proc = proc->next) {
+			cg_block_t * block = proc->blocks;
+			cg_inst_t * head = block->insts.head;
+			cg_inst_t * tail = block->insts.tail;
+
+			block->insts.head = block->insts.tail = 0;
+			GenerateCounter(block, &m_Profile->m_Invocations);
+
+			if (head) {
+				block->insts.tail->base.next = head;
+				block->insts.tail = tail;
+			}
+		}
+	}
+
 #ifdef DEBUG
 	Dump("dump1.txt", m_Module);
 #endif
 
 	cg_module_inst_def(m_Module);
+	cg_module_fold_constants(m_Module);
+	cg_module_hoist_invariants(m_Module);
+	cg_module_eliminate_common_subexpressions(m_Module);
 	cg_module_amode(m_Module);
 
 #ifdef DEBUG
@@ -104,7 +268,7 @@ void PipelinePart::EndGenerateCode(FunctionCache * target, const void * state) {
 	cg_module_unify_registers(m_Module);
 	cg_module_allocate_variables(m_Module);
 	cg_module_inst_use_chains(m_Module);
-	//cg_module_reorder_instructions(m_Module);
+	cg_module_reorder_instructions(m_Module, &Latency);
 
 #ifdef DEBUG
 	Dump("dump35.txt", m_Module);
@@ -158,6 +322,36 @@ void PipelinePart::EndGenerateCode(FunctionCache * target, const void * state) {
 	cg_segment_get_block(cseg, 0, targetBuffer, cg_segment_size(cseg));
 
 	target->EndAddFunction(targetBuffer, cg_segment_size(cseg));
+
+	if (m_Profile) {
+		m_Profile->m_Id = NumProfiles++;
+		m_Profile->m_Size = cg_segment_size(cseg);
+		m_Profile->m_CompileTime = Ticks() - m_Profile->m_CompileTime;
+		DescribeState(m_Profile->m_State, sizeof(m_Profile->m_State), state);
+
+		if (m_ProfileFlags & JitProfileDump) {
+			char name[16], path[256];
+			sprintf(name, "jit%04u.txt", m_Profile->m_Id);
+
+			FILE * fp = ProfilePath(path, sizeof(path), name) ? fopen(path, "w") : 0;
+
+			if (fp) {
+				fprintf(fp, "%s: %s\n\n", PartNames[m_Profile->m_Part], m_Profile->m_State);
+				cg_module_dump(m_Module, fp);
+				fprintf(fp, "\n");
+
+				ARMDis dis;
+				armdis_init(&dis);
+				armdis_set_output(&dis, fp);
+				armdis_decode(&dis, cseg);
+
+				fclose(fp);
+			}
+		}
+
+		target->AddProfile(m_Profile);
+		m_Profile = 0;
+	}
 	
 	cg_codegen_destroy(codegen);
 	cg_heap_destroy(m_Module->heap);
@@ -169,7 +363,9 @@ namespace {
 	RasterLinePart						rasterLinePart;
 	RasterPointPart						rasterPointPart;
 	RasterTriangleColorAlphaPart		rasterTriangleColorAlphaPart;
+	RasterTriangleColorAlphaPart		rasterTriangleFullColorAlphaPart(true);
 	RasterTriangleDepthStencilPart		rasterTriangleDepthStencilPart;
+	RasterTriangleDepthStencilPart		rasterTriangleDepthStencilColorAlphaPart(true);
 	RasterTriangleEdgeDepthStencilPart	rasterTriangleEdgeDepthStencilPart;
 }
 
@@ -182,6 +378,8 @@ PipelinePart & PipelinePart :: Get(Part part) {
 	case PartRasterBlockDepthStencil:		return rasterTriangleDepthStencilPart;
 	case PartRasterBlockEdgeDepthStencil:	return rasterTriangleEdgeDepthStencilPart;
 	case PartRasterBlockColorAlpha:			return rasterTriangleColorAlphaPart;
+	case PartRasterBlockFullColorAlpha:		return rasterTriangleFullColorAlphaPart;
+	case PartRasterBlockDepthStencilColorAlpha:	return rasterTriangleDepthStencilColorAlphaPart;
 	case PartFetchVertex:					return fetchVertexPart;
 	}
 }
@@ -79,6 +79,34 @@ namespace EGL {
 
 	class FunctionCache;
 	struct VaryingInfo;
+
+	// ----------------------------------------------------------------------
+	// Introspection of the generated code; the flags of a context default to
+	// the environment variable EGL_JIT_PROFILE and can be changed using
+	// GL_JIT_PROFILE_HINT_VIN. Reports and dumps are written to the
+	// directory named by EGL_JIT_PROFILE_DIR, and not at all without it.
+	// ----------------------------------------------------------------------
+
+	enum JitProfileFlags {
+		JitProfileOff			= 0,
+		JitProfileStatistics	= 1,	// record size and compile time
+		JitProfileDump			= 2,	// write IR and disassembly to jitNNNN.txt
+		JitProfileCounters		= 4,	// count invocations and shaded pixels
+		JitProfileAll			= 7
+	};
+
+	// one record per compiled function; the code cache releases the records
+	// along with the code that updates their counters
+	struct JitProfile {
+		JitProfile *	m_Next;				// next record in compile order
+		int				m_Part;				// PipelinePart::Part
+		U32				m_Id;				// sequence number of the function
+		size_t			m_Size;				// size of the code in bytes
+		U32				m_CompileTime;		// milliseconds
+		volatile U32	m_Invocations;		// updated by the generated code
+		volatile U32	m_Pixels;			// updated by the generated code
+		char			m_State[256];		// decoded state key
+	};
 	
 	class PipelinePart {
 	public:
@@ -89,6 +117,8 @@ namespace EGL {
 			PartRasterBlockDepthStencil,
 			PartRasterBlockEdgeDepthStencil,
 			PartRasterBlockColorAlpha,
+			PartRasterBlockFullColorAlpha,
+			PartRasterBlockDepthStencilColorAlpha,
 			PartFetchVertex
 		};
 			
@@ -96,15 +126,33 @@ namespace EGL {
 		virtual bool CompareState(const void * first, const void * second) const = 0;
 		virtual void Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state) = 0;
 		virtual Part GetPart() const = 0;
+
+		// write a readable description of the state key into buffer
+		virtual void DescribeState(char * buffer, size_t size, const void * state) const;
 		
 		static PipelinePart & Get(Part part);
+
+		static U32 GetDefaultProfileFlags();
+
+		// append a report of the given records to jitprofile.txt
+		static void WriteProfiles(const JitProfile * profiles);
+
+		// append name=value to the state description in buffer
+		static void AppendState(char * buffer, size_t size, const char * name, const char * value);
+		static void AppendState(char * buffer, size_t size, const char * name, I32 value);
 		
 	protected:
 		// Common code generator stuff goes here
-		void BeginGenerateCode();
+		void BeginGenerateCode(FunctionCache * target);
 		void EndGenerateCode(FunctionCache * target, const void * state);
+
+		// increment the given counter when control passes through block; the
+		// update is not atomic, so the code may only be run by one thread
+		void GenerateCounter(cg_block_t * block, volatile U32 * counter);
 		
 		struct cg_module_t *m_Module;
+		JitProfile *		m_Profile;		// record of the function being compiled, or 0
+		U32					m_ProfileFlags;	// profiling of the function being compiled
 	};
 }
 
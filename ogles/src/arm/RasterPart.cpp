@@ -251,6 +251,150 @@ cg_virtual_reg_t * RasterPart :: BitFieldFrom255(cg_block_t * block, cg_virtual_
 	return value;
 }
 
+// ----------------------------------------------------------------------
+// log2 of the size of a pixel in the color buffer
+// ----------------------------------------------------------------------
+U32 RasterPart :: ColorShift() const {
+	switch (m_State->GetColorFormat()) {
+	case ColorFormatRGB565:
+	case ColorFormatRGBA5551:
+	case ColorFormatRGBA4444:	return 1;
+	case ColorFormatRGBA8:		return 2;
+	default:					assert(false);	return 0;
+	}
+}
+
+// ----------------------------------------------------------------------
+// Emit code to retrieve the thresholds of the 4x4 ordered dither matrix
+// for the row at y, one nibble per pixel of the row.
+//
+// Row 0 of the matrix holds 0, 8, 2, 10; rows 1, 2 and 3 are row 0
+// xor'ed with 12, 3 and 15, respectively.
+// ----------------------------------------------------------------------
+cg_virtual_reg_t * RasterPart :: DitherRow(cg_block_t * block, cg_virtual_reg_t * y) {
+	cg_proc_t * procedure = block->proc;
+
+	DECL_CONST_REG	(constant1, 1);
+	DECL_CONST_REG	(constant2, 2);
+	DECL_CONST_REG	(constantXor1, 0xcccc);
+	DECL_CONST_REG	(constantXor2, 0x3333);
+	DECL_CONST_REG	(constantRow0, 0xa280);
+
+	DECL_REG		(regBit0);
+	DECL_REG		(regBit1);
+	DECL_REG		(regShiftedBit1);
+	DECL_REG		(regXor1);
+	DECL_REG		(regXor2);
+	DECL_REG		(regXor);
+	DECL_REG		(regResult);
+
+	AND				(regBit0,			y, constant1);
+	AND				(regBit1,			y, constant2);
+	LSR				(regShiftedBit1,	regBit1, constant1);
+	MUL				(regXor1,			regBit0, constantXor1);
+	MUL				(regXor2,			regShiftedBit1, constantXor2);
+	OR				(regXor,			regXor1, regXor2);
+	XOR				(regResult,			regXor, constantRow0);
+
+	return regResult;
+}
+
+// ----------------------------------------------------------------------
+// Emit code to extract the dither threshold (0..15) of the pixel at x
+// from the thresholds of its row
+// ----------------------------------------------------------------------
+cg_virtual_reg_t * RasterPart :: DitherThreshold(cg_block_t * block, cg_virtual_reg_t * ditherRow,
+												 cg_virtual_reg_t * x) {
+	cg_proc_t * procedure = block->proc;
+
+	DECL_CONST_REG	(constant2, 2);
+	DECL_CONST_REG	(constant3, 3);
+	DECL_CONST_REG	(constant15, 15);
+
+	DECL_REG		(regColumn);
+	DECL_REG		(regShift);
+	DECL_REG		(regShifted);
+	DECL_REG		(regResult);
+
+	AND				(regColumn,		x, constant3);
+	LSL				(regShift,		regColumn, constant2);
+	LSR				(regShifted,	ditherRow, regShift);
+	AND				(regResult,		regShifted, constant15);
+
+	return regResult;
+}
+
+// ----------------------------------------------------------------------
+// Emit code to add the dither offset to a component in the range 0..0xff
+// that is subsequently truncated to the given number of bits. The value is
+// scaled down first so that the sum cannot exceed 0xff; exact 8 bit
+// expansions of stored values are left unchanged.
+// ----------------------------------------------------------------------
+cg_virtual_reg_t * RasterPart :: DitherComponent(cg_block_t * block, cg_virtual_reg_t * value,
+												 cg_virtual_reg_t * threshold, size_t bits) {
+	cg_proc_t * procedure = block->proc;
+
+	cg_virtual_reg_t * regOffset = threshold;
+
+	if (bits > 4) {
+		DECL_CONST_REG		(constantShift,	bits - 4);
+		DECL_REG			(regShifted);
+
+		LSR					(regShifted,	threshold, constantShift);
+		regOffset = regShifted;
+	} else if (bits < 4) {
+		DECL_CONST_REG		(constantShift,	4 - bits);
+		DECL_REG			(regShifted);
+
+		LSL					(regShifted,	threshold, constantShift);
+		regOffset = regShifted;
+	}
+
+	DECL_CONST_REG	(constantBits, bits);
+	DECL_REG		(regScaled);
+	DECL_REG		(regReduced);
+	DECL_REG		(regResult);
+
+	LSR				(regScaled,		value, constantBits);
+	SUB				(regReduced,	value, regScaled);
+	ADD				(regResult,		regReduced, regOffset);
+
+	return regResult;
+}
+
+// ----------------------------------------------------------------------
+// Emit code to dither the components of a color for the current color
+// buffer format
+// ----------------------------------------------------------------------
+void RasterPart :: DitherColor(cg_block_t * block, cg_virtual_reg_t * threshold,
+							   cg_virtual_reg_t *& r, cg_virtual_reg_t *& g,
+							   cg_virtual_reg_t *& b, cg_virtual_reg_t *& a) {
+	switch (m_State->GetColorFormat()) {
+	case ColorFormatRGB565:
+		r = DitherComponent(block, r, threshold, 5);
+		g = DitherComponent(block, g, threshold, 6);
+		b = DitherComponent(block, b, threshold, 5);
+		break;
+
+	case ColorFormatRGBA5551:
+		r = DitherComponent(block, r, threshold, 5);
+		g = DitherComponent(block, g, threshold, 5);
+		b = DitherComponent(block, b, threshold, 5);
+		a = DitherComponent(block, a, threshold, 1);
+		break;
+
+	case ColorFormatRGBA4444:
+		r = DitherComponent(block, r, threshold, 4);
+		g = DitherComponent(block, g, threshold, 4);
+		b = DitherComponent(block, b, threshold, 4);
+		a = DitherComponent(block, a, threshold, 4);
+		break;
+
+	default:
+		break;
+	}
+}
+
 // ----------------------------------------------------------------------
 // Emit code to convert a representation of a color as individual
 // R, G and B components into a 16-bit 565 representation
@@ -1076,7 +1220,6 @@ void RasterPart :: WriteDepthStencil(cg_block_t * block, cg_virtual_reg_t * regD
 									 cg_virtual_reg_t * regOldStencil, cg_virtual_reg_t * regNewStencil) {
 
 	cg_proc_t * procedure = block->proc;
-	int stencilBits;
 	U32 stencilBitMask, stencilWriteMask = m_State->GetStencilMask();
 	U32 depthWriteMask = m_State->GetDepthMask() ? 0xffffffff : 0;
 	int stencilShift, depthShift;
@@ -1088,7 +1231,6 @@ void RasterPart :: WriteDepthStencil(cg_block_t * block, cg_virtual_reg_t * regD
 		return;
 
 	case DepthStencilFormatDepth16:
-		stencilBits = 0;
 		stencilBitMask = 0;
 		stencilWriteMask = 0;
 		depthWriteMask &= 0xffff;
@@ -1097,7 +1239,6 @@ void RasterPart :: WriteDepthStencil(cg_block_t * block, cg_virtual_reg_t * regD
 		break;
 
 	case DepthStencilFormatDepth16Stencil16:
-		stencilBits = 16;
 		stencilBitMask = 0xffff;
 		stencilWriteMask &= stencilBitMask;
 		depthWriteMask &= 0xffff;
@@ -1468,6 +1609,7 @@ cg_block_t * RasterPart :: GenerateFragmentDepthStencil(cg_proc_t * procedure, c
 		cg_opcode_t passedTest;
 
 		switch (m_State->GetDepthStencilFormat()) {
+		default:
 		case DepthStencilFormatDepth16:
 			// no stencil buffer: behave as if always passed
 			passedTest = cg_op_bra;
@@ -1516,6 +1658,8 @@ cg_block_t * RasterPart :: GenerateFragmentDepthStencil(cg_proc_t * procedure, c
 					passedTest = cg_op_bra;
 					break;
 			}
+
+			break;
 		}
 
 		// branch on stencil test
@@ -1602,6 +1746,10 @@ void RasterPart :: GenerateFragmentColorAlpha(cg_proc_t * procedure, cg_block_t
 
 	cg_block_t * block = currentBlock;
 
+	if (m_Profile && (m_ProfileFlags & JitProfileCounters)) {
+		GenerateCounter(block, &m_Profile->m_Pixels);
+	}
+
 	//bool depthTest;
 	//U32 offset = x + y * m_Surface->GetWidth();
 	//I32 zBufferValue = m_Surface->GetDepthBuffer()[offset];
@@ -1837,6 +1985,8 @@ void RasterPart :: GenerateFragmentColorAlpha(cg_proc_t * procedure, cg_block_t
 					//combineAlpha = SubU8(arg[0].a, arg[1].a, scaleAlpha);
 					regCombineAlpha = Sub(block, regArgA[0], regArgA[1]);
 					break;
+				default:
+					break;
 				}
 
 				switch (m_State->m_Texture[unit].CombineFuncRGB) {
@@ -2029,6 +2179,8 @@ void RasterPart :: GenerateFragmentColorAlpha(cg_proc_t * procedure, cg_block_t
 								regColorA = Mul255(block, regColorA, regTexColorA);
 								}
 
+								break;
+							default:
 								break;
 						}
 						break;
@@ -2093,6 +2245,8 @@ void RasterPart :: GenerateFragmentColorAlpha(cg_proc_t * procedure, cg_block_t
 								regColorB	= AddSaturate255(block, regColorB, regTexColorB);
 								}
 
+								break;
+							default:
 								break;
 						}
 						break;
@@ -2171,6 +2325,8 @@ void RasterPart :: GenerateFragmentColorAlpha(cg_proc_t * procedure, cg_block_t
 								regColorA	= Mul255(block, regColorA, regTexColorA);
 								}
 
+								break;
+							default:
 								break;
 						}
 						break;
@@ -2648,6 +2804,14 @@ void RasterPart :: GenerateFragmentColorAlpha(cg_proc_t * procedure, cg_block_t
 	}
 
 	if (!regColorWord) {
+		if (m_State->m_DitherEnabled && (fragmentInfo.regDitherRow || fragmentInfo.regY)) {
+			cg_virtual_reg_t * regDitherRow = fragmentInfo.regDitherRow ?
+				fragmentInfo.regDitherRow : DitherRow(block, fragmentInfo.regY);
+			cg_virtual_reg_t * regThreshold = DitherThreshold(block, regDitherRow, fragmentInfo.regX);
+
+			DitherColor(block, regThreshold, regColorR, regColorG, regColorB, regColorA);
+		}
+
 		regColorWord = ColorWordFromRGBA(block, regColorR, regColorG, regColorB, regColorA);
 	}
 
@@ -2835,5 +2999,140 @@ void RasterPart :: CopyState(void * target, const void * source) const {
 	new (target) RasterizerState(*static_cast<const RasterizerState *>(source));
 }
 
+namespace {
+	const char * const ColorFormatNames[] = {
+		"A8", "L8", "LA8", "RGB8", "RGBA8", "RGB565", "RGBA4444", "RGBA5551"
+	};
+
+	const char * const ComparisonFuncNames[] = {
+		"never", "less", "equal", "lequal", "greater", "notequal", "gequal", "always"
+	};
+
+	const char * const BlendFuncSrcNames[] = {
+		"zero", "one", "dstcolor", "1-dstcolor", "srcalpha", "1-srcalpha",
+		"dstalpha", "1-dstalpha", "srcalphasat"
+	};
+
+	const char * const BlendFuncDstNames[] = {
+		"zero", "one", "srccolor", "1-srccolor", "srcalpha", "1-srcalpha",
+		"dstalpha", "1-dstalpha"
+	};
+
+	const char * const StencilOpNames[] = {
+		"zero", "keep", "replace", "incr", "decr", "invert"
+	};
+
+	const char * const TextureModeNames[] = {
+		"decal", "replace", "blend", "add", "modulate", "combine"
+	};
+
+	const char * const CombineFuncNames[] = {
+		"replace", "modulate", "add", "addsigned", "interpolate", "subtract", 
+		"dot3rgb", "dot3rgba"
+	};
+
+	const char * const FilterModeNames[] = {
+		"none", "nearest", "linear"
+	};
+
+	const char * const WrappingModeNames[] = {
+		"clamp", "repeat"
+	};
+
+	// name of value in table, or ? for invalid values
+	const char * Name(const char * const names[], size_t count, int value) {
+		return value >= 0 && static_cast<size_t>(value) < count ? names[value] : "?";
+	}
+}
+
+#define NAME(names, value) Name(names, sizeof(names) / sizeof(names[0]), value)
+
+void RasterPart :: DescribeState(char * buffer, size_t size, const void * state) const {
+	const RasterizerState * rasterState = static_cast<const RasterizerState *>(state);
+
+	buffer[0] = '\0';
+
+	AppendState(buffer, size, "color", NAME(ColorFormatNames, rasterState->m_ColorFormat));
+	AppendState(buffer, size, "depth", 
+		rasterState->m_DepthStencilFormat == DepthStencilFormatDepth16Stencil16 ? "D16S16" : "D16");
+	AppendState(buffer, size, "shade", rasterState->m_ShadingModel == RasterizerState::ShadeModelFlat ? "flat" : "smooth");
+
+	for (size_t unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		const RasterizerState::TextureState & texture = rasterState->m_Texture[unit];
+
+		if (!texture.Enabled)
+			continue;
+
+		char name[8];
+		sprintf(name, "tex%d", (int) unit);
+
+		AppendState(buffer, size, name, NAME(TextureModeNames, texture.Mode));
+
+		if (texture.Mode == RasterizerState::TextureModeCombine) {
+			AppendState(buffer, size, "rgb", NAME(CombineFuncNames, texture.CombineFuncRGB));
+			AppendState(buffer, size, "alpha", NAME(CombineFuncNames, texture.CombineFuncAlpha));
+		}
+
+		AppendState(buffer, size, "format", NAME(ColorFormatNames, texture.InternalFormat));
+		AppendState(buffer, size, "min", NAME(FilterModeNames, texture.MinFilterMode));
+		AppendState(buffer, size, "mag", NAME(FilterModeNames, texture.MagFilterMode));
+		AppendState(buffer, size, "mip", NAME(FilterModeNames, texture.MipmapFilterMode));
+		AppendState(buffer, size, "wrap", NAME(WrappingModeNames, texture.WrappingModeS));
+	}
+
+	if (rasterState->m_Fog.Enabled)
+		AppendState(buffer, size, "fog", "on");
+
+	if (rasterState->m_Alpha.Enabled)
+		AppendState(buffer, size, "alphatest", NAME(ComparisonFuncNames, rasterState->m_Alpha.Func));
+
+	if (rasterState->m_Blend.Enabled) {
+		AppendState(buffer, size, "blendsrc", NAME(BlendFuncSrcNames, rasterState->m_Blend.FuncSrc));
+		AppendState(buffer, size, "blenddst", NAME(BlendFuncDstNames, rasterState->m_Blend.FuncDst));
+	}
+
+	if (rasterState->m_LogicOp.Enabled)
+		AppendState(buffer, size, "logicop", rasterState->m_LogicOp.Opcode);
+
+	if (rasterState->m_DepthTest.Enabled)
+		AppendState(buffer, size, "depthtest", NAME(ComparisonFuncNames, rasterState->m_DepthTest.Func));
+
+	if (rasterState->m_Stencil.Enabled) {
+		AppendState(buffer, size, "stenciltest", NAME(ComparisonFuncNames, rasterState->m_Stencil.Func));
+		AppendState(buffer, size, "fail", NAME(StencilOpNames, rasterState->m_Stencil.Fail));
+		AppendState(buffer, size, "zfail", NAME(StencilOpNames, rasterState->m_Stencil.ZFail));
+		AppendState(buffer, size, "zpass", NAME(StencilOpNames, rasterState->m_Stencil.ZPass));
+	}
+
+	if (rasterState->m_ScissorTest.Enabled)
+		AppendState(buffer, size, "scissor", "on");
+
+	if (!rasterState->m_Mask.Red || !rasterState->m_Mask.Green || 
+		!rasterState->m_Mask.Blue || !rasterState->m_Mask.Alpha) {
+		char mask[5];
+		mask[0] = rasterState->m_Mask.Red ? 'r' : '-';
+		mask[1] = rasterState->m_Mask.Green ? 'g' : '-';
+		mask[2] = rasterState->m_Mask.Blue ? 'b' : '-';
+		mask[3] = rasterState->m_Mask.Alpha ? 'a' : '-';
+		mask[4] = '\0';
+		AppendState(buffer, size, "colormask", mask);
+	}
+
+	if (!rasterState->m_Mask.Depth)
+		AppendState(buffer, size, "depthmask", "off");
+
+	if (rasterState->m_DitherEnabled)
+		AppendState(buffer, size, "dither", "on");
+
+	if (rasterState->m_MultisampleEnabled)
+		AppendState(buffer, size, "multisample", "on");
+
+	if (rasterState->m_Point.SpriteEnabled)
+		AppendState(buffer, size, "pointsprite", "on");
+
+	if (rasterState->m_Line.SmoothEnabled)
+		AppendState(buffer, size, "linesmooth", "on");
+}
 
 
+
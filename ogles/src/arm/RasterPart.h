@@ -51,8 +51,9 @@ namespace EGL {
 
 	class RasterPart: public PipelinePart {
 	public:
-		// virtual method defined in PipelinePart
+		// virtual methods defined in PipelinePart
 		void CopyState(void * target, const void * source) const;
+		void DescribeState(char * buffer, size_t size, const void * state) const;
 
 	
 	protected:
@@ -80,6 +81,9 @@ namespace EGL {
 			cg_block_ref_t * continuation, FragmentGenerationInfo & fragmentInfo,
 			int weight, cg_virtual_reg_t * regColorBuffer = 0);
 
+		// log2 of the size of a pixel in the color buffer
+		U32 ColorShift() const;
+
 		void GenerateFetchTexColor(cg_proc_t * proc, cg_block_t * currentBlock,
 								   size_t unit,
 								   FragmentGenerationInfo & fragmentInfo,
@@ -107,6 +111,11 @@ namespace EGL {
 		cg_virtual_reg_t * ClampTo255(cg_block_t * currentBlock, cg_virtual_reg_t * value);
 		cg_virtual_reg_t * ExtractBitFieldTo255(cg_block_t * currentBlock, cg_virtual_reg_t * value, size_t low, size_t high);
 		cg_virtual_reg_t * BitFieldFrom255(cg_block_t * currentBlock, cg_virtual_reg_t * value, size_t low, size_t high);
+		cg_virtual_reg_t * DitherRow(cg_block_t * currentBlock, cg_virtual_reg_t * y);
+		cg_virtual_reg_t * DitherThreshold(cg_block_t * currentBlock, cg_virtual_reg_t * ditherRow, cg_virtual_reg_t * x);
+		cg_virtual_reg_t * DitherComponent(cg_block_t * currentBlock, cg_virtual_reg_t * value, cg_virtual_reg_t * threshold, size_t bits);
+		void DitherColor(cg_block_t * currentBlock, cg_virtual_reg_t * threshold,
+						 cg_virtual_reg_t *& r, cg_virtual_reg_t *& g, cg_virtual_reg_t *& b, cg_virtual_reg_t *& a);
 		cg_virtual_reg_t * Dot3(cg_block_t * currentBlock, cg_virtual_reg_t * r[], cg_virtual_reg_t * g[], cg_virtual_reg_t * b[]);
 		cg_virtual_reg_t * SignedVal(cg_block_t * block, cg_virtual_reg_t * value);
 
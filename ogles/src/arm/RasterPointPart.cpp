@@ -356,7 +356,7 @@ bool RasterPointPart :: CompareState(const void * first, const void * second) co
 
 void RasterPointPart :: Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state) {
 	m_State = static_cast<const RasterizerState *>(state);
-	BeginGenerateCode();
+	BeginGenerateCode(target);
 	GenerateRasterPoint(varyingInfo);
 	EndGenerateCode(target, state);
 }
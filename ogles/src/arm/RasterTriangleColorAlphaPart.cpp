@@ -62,6 +62,9 @@ void RasterTriangleColorAlphaPart :: GenerateRasterBlockColorAlpha(const Varying
 
 	procedure->num_args = 3;	// the previous three declarations make up the arguments
 
+	// neither the rasterizer info nor the textures are written while shading a block
+	regRasterInfo->is_readonly = 1;
+
 	cg_block_t * block = cg_block_create(procedure, 1);
 
 	//const PixelMask * mask = pixelMask;
@@ -97,9 +100,11 @@ void RasterTriangleColorAlphaPart :: GenerateRasterBlockColorAlpha(const Varying
 
 	info.regInfo = regRasterInfo;
 	info.regTexture[0] = regTexture;
+	regTexture->is_readonly = 1;
 
 	for (unit = 1; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
 		info.regTexture[unit] =  LOAD_DATA(block, regRasterInfo, OFFSET_TEXTURES + unit * sizeof(void *));
+		info.regTexture[unit]->is_readonly = 1;
 	}
 
     //for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
@@ -140,6 +145,15 @@ void RasterTriangleColorAlphaPart :: GenerateRasterBlockColorAlpha(const Varying
 
 	ADD			(regMask1, regMask0, maskSize);
 
+	if (m_State->m_DitherEnabled) {
+		// the dither thresholds of the row are computed once per row;
+		// blocks are aligned to the dither matrix
+		DECL_REG	(regRowIndex);
+
+		SUB			(regRowIndex, blockSize, regIY0);
+		info.regDitherRow = DitherRow(block, regRowIndex);
+	}
+
 	DECL_FLAGS	(skipEndLoop);
 
 	CMP		(skipEndLoop, regRowMask, zero);
@@ -313,17 +327,214 @@ void RasterTriangleColorAlphaPart :: GenerateRasterBlockColorAlpha(const Varying
 
 	//	surfaceInfo.ColorBuffer += surfaceInfo.Pitch;
 	DECL_REG		(regPitch2);
-	U32				shift = 0;
-
-	switch (m_State->GetColorFormat()) {
-	case ColorFormatRGB565:
-	case ColorFormatRGBA5551:
-	case ColorFormatRGBA4444:	shift = 1;		break;
-	case ColorFormatRGBA8:		shift = 2;		break;
-	default:					assert(false);	break;
-	}
-
-	DECL_CONST_REG	(constShift, shift);
+	DECL_CONST_REG	(constShift, ColorShift());
+
+	LSL			(regPitch2, regPitch, constShift);
+	ADD			(regColorBuffer1, regColorBuffer0, regPitch2);
+
+    //}
+	BRA			(yLoopTop);
+
+	block = cg_block_create(procedure, 1);
+	yLoopEnd->block = block;
+
+	RET();
+}
+
+// --------------------------------------------------------------------------
+// Variant for raster blocks of which all pixels are covered and passed the
+// depth and stencil test. The pixel mask is not read, and the pixels of a
+// row are generated in sequence without a loop.
+// --------------------------------------------------------------------------
+
+void RasterTriangleColorAlphaPart :: GenerateRasterBlockFullColorAlpha(const VaryingInfo * varyingInfo) {
+	cg_proc_t * procedure = cg_proc_create(m_Module);
+
+	FragmentGenerationInfo info;
+	memset(&info, 0, sizeof(info));
+
+	//typedef void (BlockColorAlphaFunction)(const RasterInfo * info, I32 varying[][2][2], const PixelMask * pixelMask);
+
+	DECL_REG	(regRasterInfo);// RasterInfo structure pointer
+	DECL_REG	(regVarying);	// Varying array pointer
+
+	procedure->num_args = 2;	// the previous two declarations make up the arguments read
+
+	// neither the rasterizer info nor the textures are written while shading a block
+	regRasterInfo->is_readonly = 1;
+
+	cg_block_t * block = cg_block_create(procedure, 1);
+
+	DECL_CONST_REG	(zero, 0);		// 0
+	DECL_CONST_REG	(one, 1);		// 1
+	DECL_CONST_REG	(sixteen, 16);	// 16
+	DECL_CONST_REG	(blockSize, EGL_RASTER_BLOCK_SIZE);
+	DECL_CONST_REG	(logBlockSize, EGL_LOG_RASTER_BLOCK_SIZE);
+
+	DECL_REG	(regColorBuffer0);	// begin y loop
+	DECL_REG	(regColorBuffer1);	// end y loop
+
+	cg_virtual_reg_t * regColorBuffer = LOAD_DATA(block, regRasterInfo, OFFSET_SURFACE_COLOR_BUFFER);
+	cg_virtual_reg_t * regPitch = LOAD_DATA(block, regRasterInfo, OFFSET_SURFACE_PITCH);
+	
+	cg_virtual_reg_t * regTexture = LOAD_DATA(block, regRasterInfo, OFFSET_TEXTURES);
+
+	size_t unit;
+
+	info.regInfo = regRasterInfo;
+	info.regTexture[0] = regTexture;
+	regTexture->is_readonly = 1;
+
+	for (unit = 1; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		info.regTexture[unit] =  LOAD_DATA(block, regRasterInfo, OFFSET_TEXTURES + unit * sizeof(void *));
+		info.regTexture[unit]->is_readonly = 1;
+	}
+
+    //for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+
+	DECL_REG	(regIY0);				// begin y loop
+	DECL_REG	(regIY1);				// end y loop
+
+	DECL_CONST_REG(initIY1, EGL_RASTER_BLOCK_SIZE);
+
+	cg_block_ref_t * yLoopTop = cg_block_ref_create(procedure);
+	cg_block_ref_t * yLoopEnd = cg_block_ref_create(procedure);
+
+	block = cg_block_create(procedure, 2);
+	yLoopTop->block = block;
+
+	PHI			(regIY0, cg_create_virtual_reg_list(procedure->module->heap, regIY1, initIY1, NULL));
+	PHI			(regColorBuffer0, cg_create_virtual_reg_list(procedure->module->heap, regColorBuffer, regColorBuffer1, NULL));
+
+	size_t index;
+
+	//	I32 varying0[EGL_MAX_NUM_VARYING][2];
+	cg_virtual_reg_t * regVaryingInc[EGL_MAX_NUM_VARYING];
+	cg_virtual_reg_t * regVarying0[EGL_MAX_NUM_VARYING];
+
+	if (m_State->m_DitherEnabled) {
+		// the dither thresholds of the row are computed once per row;
+		// blocks are aligned to the dither matrix
+		DECL_REG	(regRowIndex);
+
+		SUB			(regRowIndex, blockSize, regIY0);
+		info.regDitherRow = DitherRow(block, regRowIndex);
+	}
+
+	for (index = 0; index < varyingInfo->numVarying; ++index) {
+		//	varying0[index][0] = varying[index][0][0];
+		regVarying0[index] = LOAD_DATA(block, regVarying, index * 16);
+
+		//	varying0[index][1] = (varying[index][1][0] - varying[index][0][0]) >> EGL_LOG_RASTER_BLOCK_SIZE;
+		cg_virtual_reg_t * regLimit = LOAD_DATA(block, regVarying, index * 16 + 8);
+
+		DECL_REG	(regDiff);
+		DECL_REG	(regShifted);
+
+		SUB			(regDiff, regLimit, regVarying0[index]);
+		ASR			(regShifted, regDiff, logBlockSize);
+
+		regVaryingInc[index] = regShifted;
+	}
+
+    //    for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ix++) {
+	for (size_t ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ++ix) {
+		DECL_CONST_REG	(regIX, ix);
+
+		info.regX = regIX;
+
+		for (unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+			I32 textureBase = varyingInfo->textureBase[unit];
+
+			if (textureBase >= 0) {
+				info.regU[unit] = regVarying0[textureBase];
+				info.regV[unit] = regVarying0[textureBase + 1];
+			}
+		}
+
+		if (varyingInfo->colorIndex >= 0) {
+			info.regR = regVarying0[varyingInfo->colorIndex];
+			info.regG = regVarying0[varyingInfo->colorIndex + 1];
+			info.regB = regVarying0[varyingInfo->colorIndex + 2];
+			info.regA = regVarying0[varyingInfo->colorIndex + 3];
+		}
+
+		if (varyingInfo->fogIndex >= 0) {
+			info.regFog = regVarying0[varyingInfo->fogIndex];
+		}
+
+		// a fragment may still be discarded by the alpha test
+		cg_block_ref_t * nextPixel = cg_block_ref_create(procedure);
+
+		GenerateFragmentColorAlpha(procedure, block, nextPixel, 
+			info, 2, regColorBuffer0);
+
+		block = cg_block_create(procedure, 2);
+		nextPixel->block = block;
+
+		if (ix == EGL_RASTER_BLOCK_SIZE - 1)
+			break;
+
+		for (index = 0; index < varyingInfo->numVarying; ++index) {
+			//		varying0[index][0] += varying0[index][1];
+			DECL_REG	(regVarying1);
+
+			ADD			(regVarying1, regVarying0[index], regVaryingInc[index]);
+			regVarying0[index] = regVarying1;
+		}
+	}
+
+	DECL_FLAGS	(regReachedYLoopEnd);
+	SUB_S		(regIY1, regReachedYLoopEnd, regIY0, one);
+	BEQ			(regReachedYLoopEnd, yLoopEnd);
+
+	block = cg_block_create(procedure, 2);
+
+	//	for (index = 0; index < m_VaryingInfo.numVarying; ++index) {
+	DECL_REG	(regCounter0);
+	DECL_REG	(regCounter1);
+	DECL_REG	(regPointer0);
+	DECL_REG	(regPointer1);
+
+	DECL_CONST_REG	(initCounter0, varyingInfo->numVarying);
+	DECL_REG		(initPointer0);
+
+	OR			(initPointer0, regVarying, zero);
+
+	cg_block_ref_t * incrLoopTop = cg_block_ref_create(procedure);
+	block = cg_block_create(procedure, 4);
+	incrLoopTop->block = block;
+
+	PHI			(regCounter0, cg_create_virtual_reg_list(procedure->module->heap, regCounter1, initCounter0, NULL));
+	PHI			(regPointer0, cg_create_virtual_reg_list(procedure->module->heap, regPointer1, initPointer0, NULL));
+
+	//		varying[index][0][0] += varying[index][0][1];
+	//		varying[index][1][0] += varying[index][1][1];
+	cg_virtual_reg_t * regPtrVal0 = LOAD_DATA(block, regPointer0, 0);
+	cg_virtual_reg_t * regPtrInc0 = LOAD_DATA(block, regPointer0, 4);
+	cg_virtual_reg_t * regPtrVal1 = LOAD_DATA(block, regPointer0, 8);
+	cg_virtual_reg_t * regPtrInc1 = LOAD_DATA(block, regPointer0, 12);
+	
+	DECL_REG	(regPtrValInc0);
+	DECL_REG	(regPtrValInc1);
+
+	ADD			(regPtrValInc0, regPtrVal0, regPtrInc0);	
+	STORE_DATA	(block, regPointer0, 0, regPtrValInc0);
+	ADD			(regPtrValInc1, regPtrVal1, regPtrInc1);	
+	STORE_DATA	(block, regPointer0, 8, regPtrValInc1);
+
+	//	}
+	DECL_FLAGS	(regEndIncrLoop);
+
+	ADD			(regPointer1, regPointer0, sixteen);
+	SUB_S		(regCounter1, regEndIncrLoop, regCounter0, one);
+	BNE			(regEndIncrLoop, incrLoopTop);
+
+	block = cg_block_create(procedure, 1);
+
+	//	surfaceInfo.ColorBuffer += surfaceInfo.Pitch;
+	DECL_REG		(regPitch2);
+	DECL_CONST_REG	(constShift, ColorShift());
 
 	LSL			(regPitch2, regPitch, constShift);
 	ADD			(regColorBuffer1, regColorBuffer0, regPitch2);
@@ -350,11 +561,17 @@ bool RasterTriangleColorAlphaPart :: CompareState(const void * first, const void
 
 void RasterTriangleColorAlphaPart :: Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state) {
 	m_State = static_cast<const RasterizerState *>(state);
-	BeginGenerateCode();
-	GenerateRasterBlockColorAlpha(varyingInfo);
+	BeginGenerateCode(target);
+
+	if (m_FullBlock) {
+		GenerateRasterBlockFullColorAlpha(varyingInfo);
+	} else {
+		GenerateRasterBlockColorAlpha(varyingInfo);
+	}
+
 	EndGenerateCode(target, state);
 }
 
 PipelinePart::Part RasterTriangleColorAlphaPart :: GetPart() const {
-	return PipelinePart::PartRasterBlockColorAlpha;
+	return m_FullBlock ? PipelinePart::PartRasterBlockFullColorAlpha : PipelinePart::PartRasterBlockColorAlpha;
 }
\ No newline at end of file
@@ -49,12 +49,18 @@
 namespace EGL {
 	class RasterTriangleColorAlphaPart: public RasterPart {
 	public:
+		// fullBlock selects the variant for raster blocks without masked pixels
+		RasterTriangleColorAlphaPart(bool fullBlock = false): m_FullBlock(fullBlock) {}
+
 		bool CompareState(const void * first, const void * second) const;
 		void Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state);
 		Part GetPart() const;
 		
 	private:
 		void GenerateRasterBlockColorAlpha(const VaryingInfo * varyingInfo);
+		void GenerateRasterBlockFullColorAlpha(const VaryingInfo * varyingInfo);
+
+		bool m_FullBlock;
 	};
 	
 }
@@ -48,6 +48,18 @@
 using namespace EGL;
 
 
+namespace {
+	// log2 of the size of a pixel in the depth/stencil buffer
+	U32 DepthStencilShift(const RasterizerState * state) {
+		switch (state->GetDepthStencilFormat()) {
+		case DepthStencilFormatDepth16:				return 1;
+		case DepthStencilFormatDepth16Stencil16:	return 2;
+		default:					assert(false);	return 0;
+		}
+	}
+}
+
+
 void RasterTriangleDepthStencilPart :: GenerateRasterBlockDepthStencil(const VaryingInfo * varyingInfo) {
 	cg_proc_t * procedure = cg_proc_create(m_Module);
 
@@ -62,6 +74,10 @@ void RasterTriangleDepthStencilPart :: GenerateRasterBlockDepthStencil(const Var
 
 	procedure->num_args = 3;	// the previous three declarations make up the arguments
 
+	// rasterizer info and interpolation variables do not change while the block is processed
+	regRasterInfo->is_readonly = 1;
+	regVars->is_readonly = 1;
+
 	cg_block_t * block = cg_block_create(procedure, 1);
 
 	//PixelMask * mask = pixelMask, totalMask = 0;
@@ -251,17 +267,7 @@ void RasterTriangleDepthStencilPart :: GenerateRasterBlockDepthStencil(const Var
 	ADD			(regDepth1, regDepth2, regDepthStepY);
 
 	//	surfaceInfo.DepthBuffer += surfaceInfo.Pitch;
-	U32				shift = 0;
-
-	switch (m_State->GetDepthStencilFormat()) {
-	case DepthStencilFormatDepth16:				shift = 1;		break;
-	case DepthStencilFormatDepth16Stencil16:	shift = 2;		break;
-
-	default:					
-		assert(false);	break;
-	}
-
-	DECL_CONST_REG	(regDepthStencilIncrement, EGL_RASTER_BLOCK_SIZE << shift);
+	DECL_CONST_REG	(regDepthStencilIncrement, EGL_RASTER_BLOCK_SIZE << DepthStencilShift(m_State));
 	ADD			(regDepthBuffer1, regDepthBuffer0, regDepthStencilIncrement);
 
     //}
@@ -274,6 +280,313 @@ void RasterTriangleDepthStencilPart :: GenerateRasterBlockDepthStencil(const Var
 	RET_VALUE(regTotalMask1);
 }
 
+// --------------------------------------------------------------------------
+// Variant for fully covered raster blocks that processes each pixel 
+// completely: the color and alpha of a pixel is determined right after it 
+// passed the depth and stencil test, so no pixel mask is written and read,
+// and the rows of the depth and color buffer are visited only once.
+// --------------------------------------------------------------------------
+
+void RasterTriangleDepthStencilPart :: GenerateRasterBlockDepthStencilColorAlpha(const VaryingInfo * varyingInfo) {
+	cg_proc_t * procedure = cg_proc_create(m_Module);
+
+	FragmentGenerationInfo info;
+	memset(&info, 0, sizeof(info));
+
+	//typedef void (BlockDepthStencilColorAlphaFunction)(const RasterInfo * info, const Variables * variables, I32 varying[][2][2]);
+
+	DECL_REG	(regRasterInfo);// RasterInfo structure pointer
+	DECL_REG	(regVars);		// variable structure pointer
+	DECL_REG	(regVarying);	// Varying array pointer
+
+	procedure->num_args = 3;	// the previous three declarations make up the arguments
+
+	// rasterizer info, textures and interpolation variables do not change while the block is processed
+	regRasterInfo->is_readonly = 1;
+	regVars->is_readonly = 1;
+
+	cg_block_t * block = cg_block_create(procedure, 1);
+
+	DECL_CONST_REG	(zero, 0);		// 0
+	DECL_CONST_REG	(one, 1);		// 1
+	DECL_CONST_REG	(four, 4);		// 4
+	DECL_CONST_REG	(sixteen, 16);	// 16
+	DECL_CONST_REG	(blockSize, EGL_RASTER_BLOCK_SIZE);
+	DECL_CONST_REG	(logBlockSize, EGL_LOG_RASTER_BLOCK_SIZE);
+
+	cg_virtual_reg_t *	regBaseX = LOAD_DATA(block, regVars, OFFSET_VARIABLES_X);
+	cg_virtual_reg_t *	regBaseY = LOAD_DATA(block, regVars, OFFSET_VARIABLES_Y);
+
+	//I32 depth0 = vars->Depth.Value;
+	cg_virtual_reg_t *	regDepthInit = LOAD_DATA(block, regVars, OFFSET_VARIABLES_DEPTH + OFFSET_INTERPOLANT_VALUE);
+	cg_virtual_reg_t *	regDepthDx = LOAD_DATA(block, regVars, OFFSET_VARIABLES_DEPTH + OFFSET_INTERPOLANT_DX);
+	cg_virtual_reg_t *	regDepthDy = LOAD_DATA(block, regVars, OFFSET_VARIABLES_DEPTH + OFFSET_INTERPOLANT_DY);
+
+	DECL_REG	(regDepth0);		// beginning of y loop
+	DECL_REG	(regDepth1);		// end of y loop
+	DECL_REG	(regDepth2);		// end of x loop
+	DECL_REG	(regDepth3);		// beginning of x loop
+	DECL_REG	(regDepthStepY);
+
+	//vars->Depth.dY - (vars->Depth.dX << EGL_LOG_RASTER_BLOCK_SIZE);
+	DECL_REG	(regShiftedDx);
+
+	LSL			(regShiftedDx, regDepthDx, logBlockSize);
+	SUB			(regDepthStepY, regDepthDy, regShiftedDx);
+
+	// initialize surface pointers in local info block
+	//SurfaceInfo surfaceInfo = m_RasterInfo.SurfaceInfo;
+
+	DECL_REG	(regDepthBuffer0);		// begin y loop
+	DECL_REG	(regDepthBuffer1);		// end y loop
+	DECL_REG	(regColorBuffer0);		// begin y loop
+	DECL_REG	(regColorBuffer1);		// end y loop
+
+	cg_virtual_reg_t * regDepthBuffer = LOAD_DATA(block, regRasterInfo, OFFSET_SURFACE_DEPTH_STENCIL_BUFFER);
+	cg_virtual_reg_t * regColorBuffer = LOAD_DATA(block, regRasterInfo, OFFSET_SURFACE_COLOR_BUFFER);
+	cg_virtual_reg_t * regPitch = LOAD_DATA(block, regRasterInfo, OFFSET_SURFACE_PITCH);
+	
+	cg_virtual_reg_t * regTexture = LOAD_DATA(block, regRasterInfo, OFFSET_TEXTURES);
+
+	size_t unit;
+
+	info.regInfo = regRasterInfo;
+	info.regTexture[0] = regTexture;
+	regTexture->is_readonly = 1;
+
+	for (unit = 1; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		info.regTexture[unit] =  LOAD_DATA(block, regRasterInfo, OFFSET_TEXTURES + unit * sizeof(void *));
+		info.regTexture[unit]->is_readonly = 1;
+	}
+
+    //for (I32 iy = 0; iy < EGL_RASTER_BLOCK_SIZE; iy++) {
+
+	DECL_REG	(regIY0);				// begin y loop
+	DECL_REG	(regIY1);				// end y loop
+
+	DECL_CONST_REG(initIY1, EGL_RASTER_BLOCK_SIZE);
+
+	cg_block_ref_t * yLoopTop = cg_block_ref_create(procedure);
+	cg_block_ref_t * yLoopEnd = cg_block_ref_create(procedure);
+
+	block = cg_block_create(procedure, 2);
+	yLoopTop->block = block;
+
+	PHI			(regIY0, cg_create_virtual_reg_list(procedure->module->heap, regIY1, initIY1, NULL));
+	PHI			(regDepth0, cg_create_virtual_reg_list(procedure->module->heap, regDepthInit, regDepth1, NULL));
+	PHI			(regDepthBuffer0, cg_create_virtual_reg_list(procedure->module->heap, regDepthBuffer, regDepthBuffer1, NULL));
+	PHI			(regColorBuffer0, cg_create_virtual_reg_list(procedure->module->heap, regColorBuffer, regColorBuffer1, NULL));
+
+	size_t index;
+
+	//	I32 varying0[EGL_MAX_NUM_VARYING][2];
+	cg_virtual_reg_t * regVaryingInc[EGL_MAX_NUM_VARYING];
+	cg_virtual_reg_t * regVaryingInit[EGL_MAX_NUM_VARYING];
+
+	if (m_State->m_DitherEnabled) {
+		// the dither thresholds of the row are computed once per row;
+		// blocks are aligned to the dither matrix
+		DECL_REG	(regRowIndex);
+
+		SUB			(regRowIndex, blockSize, regIY0);
+		info.regDitherRow = DitherRow(block, regRowIndex);
+	}
+
+	for (index = 0; index < varyingInfo->numVarying; ++index) {
+		//	varying0[index][0] = varying[index][0][0];
+		regVaryingInit[index] = LOAD_DATA(block, regVarying, index * 16);
+
+		//	varying0[index][1] = (varying[index][1][0] - varying[index][0][0]) >> EGL_LOG_RASTER_BLOCK_SIZE;
+		cg_virtual_reg_t * regLimit = LOAD_DATA(block, regVarying, index * 16 + 8);
+
+		DECL_REG	(regDiff);
+		DECL_REG	(regShifted);
+
+		SUB			(regDiff, regLimit, regVaryingInit[index]);
+		ASR			(regShifted, regDiff, logBlockSize);
+
+		regVaryingInc[index] = regShifted;
+	}
+
+	cg_virtual_reg_t * regVarying0[EGL_MAX_NUM_VARYING];		// begin of x loop
+	cg_virtual_reg_t * regVarying1[EGL_MAX_NUM_VARYING];		// end of x loop
+
+	DECL_REG		(regIX0);									// begin of x loop
+	DECL_REG		(regIX1);									// end of x loop
+
+	DECL_CONST_REG	(initIX0, 0);
+
+    //    for (I32 ix = 0; ix < EGL_RASTER_BLOCK_SIZE; ix++) {
+	cg_block_ref_t * xLoopTop = cg_block_ref_create(procedure);
+	block = cg_block_create(procedure, 4);
+	xLoopTop->block = block;
+
+	for (index = 0; index < varyingInfo->numVarying; ++index) {
+		regVarying0[index] = cg_virtual_reg_create(block->proc, cg_reg_type_general);
+		regVarying1[index] = cg_virtual_reg_create(block->proc, cg_reg_type_general);
+
+		PHI		(regVarying0[index], cg_create_virtual_reg_list(procedure->module->heap, regVaryingInit[index], regVarying1[index], NULL));
+	}
+
+	PHI			(regIX0, cg_create_virtual_reg_list(procedure->module->heap, initIX0, regIX1, NULL));
+	PHI			(regDepth3, cg_create_virtual_reg_list(procedure->module->heap, regDepth0, regDepth2, NULL));
+
+	// pixels failing one of the tests continue with the next pixel
+	cg_block_ref_t * nextPixel = cg_block_ref_create(procedure);
+
+	if (m_State->IsEnabledScissorTest()) {
+		DECL_REG	(regX);
+		DECL_REG	(regY);
+		DECL_REG	(regTempY);
+
+		ADD		(regX, regIX0, regBaseX);
+		SUB		(regTempY, blockSize, regIY0);
+		ADD		(regY, regTempY, regBaseY);
+
+		DECL_CONST_REG	(xBottom, m_State->m_ScissorTest.X);
+		DECL_CONST_REG	(xTop, m_State->m_ScissorTest.X + m_State->m_ScissorTest.Width);
+		DECL_CONST_REG	(yBottom, m_State->m_ScissorTest.Y);
+		DECL_CONST_REG	(yTop, m_State->m_ScissorTest.Y + m_State->m_ScissorTest.Height);
+
+		DECL_FLAGS	(xLow);
+		DECL_FLAGS	(xHigh);
+		DECL_FLAGS	(yLow);
+		DECL_FLAGS	(yHigh);
+
+		CMP		(xLow, regX, xBottom);
+		BLT		(xLow, nextPixel);
+		CMP		(xHigh, regX, xTop);
+		BGE		(xHigh, nextPixel);
+		CMP		(yLow, regY, yBottom);
+		BLT		(yLow, nextPixel);
+		CMP		(yHigh, regY, yTop);
+		BGE		(yHigh, nextPixel);
+	}
+
+	DECL_REG(regShiftedDepth);
+
+	LSR		(regShiftedDepth, regDepth3, four);
+
+	info.regX = regIX0;
+	info.regDepth = regShiftedDepth;
+
+	for (unit = 0; unit < EGL_NUM_TEXTURE_UNITS; ++unit) {
+		I32 textureBase = varyingInfo->textureBase[unit];
+
+		if (textureBase >= 0) {
+			info.regU[unit] = regVarying0[textureBase];
+			info.regV[unit] = regVarying0[textureBase + 1];
+		}
+	}
+
+	if (varyingInfo->colorIndex >= 0) {
+		info.regR = regVarying0[varyingInfo->colorIndex];
+		info.regG = regVarying0[varyingInfo->colorIndex + 1];
+		info.regB = regVarying0[varyingInfo->colorIndex + 2];
+		info.regA = regVarying0[varyingInfo->colorIndex + 3];
+	}
+
+	if (varyingInfo->fogIndex >= 0) {
+		info.regFog = regVarying0[varyingInfo->fogIndex];
+	}
+
+	block = GenerateFragmentDepthStencil(procedure, block, nextPixel, 
+		info, 4, regDepthBuffer0, false, true);
+
+	GenerateFragmentColorAlpha(procedure, block, nextPixel, 
+		info, 4, regColorBuffer0);
+
+	block = cg_block_create(procedure, 4);
+	nextPixel->block = block;
+
+	for (index = 0; index < varyingInfo->numVarying; ++index) {
+		//		varying0[index][0] += varying0[index][1];
+		ADD		(regVarying1[index], regVarying0[index], regVaryingInc[index]);
+	}
+
+	//		depth0 += vars->Depth.dX;
+	ADD			(regDepth2, regDepth3, regDepthDx);
+
+	DECL_FLAGS	(regReachedXLoopEnd);
+	ADD			(regIX1, regIX0, one);
+	CMP			(regReachedXLoopEnd, regIX1, blockSize);
+	BNE			(regReachedXLoopEnd, xLoopTop);
+    //    }
+
+	block = cg_block_create(procedure, 2);
+
+	// <---- loop termination goes here
+	DECL_FLAGS	(regReachedYLoopEnd);
+	SUB_S		(regIY1, regReachedYLoopEnd, regIY0, one);
+	BEQ			(regReachedYLoopEnd, yLoopEnd);
+
+	block = cg_block_create(procedure, 2);
+
+	//	depth0 += vars->Depth.dY - (vars->Depth.dX << EGL_LOG_RASTER_BLOCK_SIZE);
+	ADD			(regDepth1, regDepth2, regDepthStepY);
+
+	//	for (index = 0; index < m_VaryingInfo.numVarying; ++index) {
+	DECL_REG	(regCounter0);
+	DECL_REG	(regCounter1);
+	DECL_REG	(regPointer0);
+	DECL_REG	(regPointer1);
+
+	DECL_CONST_REG	(initCounter0, varyingInfo->numVarying);
+	DECL_REG		(initPointer0);
+
+	OR			(initPointer0, regVarying, zero);
+
+	cg_block_ref_t * incrLoopTop = cg_block_ref_create(procedure);
+	block = cg_block_create(procedure, 4);
+	incrLoopTop->block = block;
+
+	PHI			(regCounter0, cg_create_virtual_reg_list(procedure->module->heap, regCounter1, initCounter0, NULL));
+	PHI			(regPointer0, cg_create_virtual_reg_list(procedure->module->heap, regPointer1, initPointer0, NULL));
+
+	//		varying[index][0][0] += varying[index][0][1];
+	//		varying[index][1][0] += varying[index][1][1];
+	cg_virtual_reg_t * regPtrVal0 = LOAD_DATA(block, regPointer0, 0);
+	cg_virtual_reg_t * regPtrInc0 = LOAD_DATA(block, regPointer0, 4);
+	cg_virtual_reg_t * regPtrVal1 = LOAD_DATA(block, regPointer0, 8);
+	cg_virtual_reg_t * regPtrInc1 = LOAD_DATA(block, regPointer0, 12);
+	
+	DECL_REG	(regPtrValInc0);
+	DECL_REG	(regPtrValInc1);
+
+	ADD			(regPtrValInc0, regPtrVal0, regPtrInc0);	
+	STORE_DATA	(block, regPointer0, 0, regPtrValInc0);
+	ADD			(regPtrValInc1, regPtrVal1, regPtrInc1);	
+	STORE_DATA	(block, regPointer0, 8, regPtrValInc1);
+
+	//	}
+	DECL_FLAGS	(regEndIncrLoop);
+
+	ADD			(regPointer1, regPointer0, sixteen);
+	SUB_S		(regCounter1, regEndIncrLoop, regCounter0, one);
+	BNE			(regEndIncrLoop, incrLoopTop);
+
+	block = cg_block_create(procedure, 1);
+
+	//	surfaceInfo.DepthBuffer += surfaceInfo.Pitch;
+	DECL_CONST_REG	(regDepthStencilIncrement, EGL_RASTER_BLOCK_SIZE << DepthStencilShift(m_State));
+	ADD			(regDepthBuffer1, regDepthBuffer0, regDepthStencilIncrement);
+
+	//	surfaceInfo.ColorBuffer += surfaceInfo.Pitch;
+	DECL_REG		(regPitch2);
+	DECL_CONST_REG	(constShift, ColorShift());
+
+	LSL			(regPitch2, regPitch, constShift);
+	ADD			(regColorBuffer1, regColorBuffer0, regPitch2);
+
+    //}
+	BRA			(yLoopTop);
+
+	block = cg_block_create(procedure, 1);
+	yLoopEnd->block = block;
+
+	RET();
+}
+
 // --------------------------------------------------------------------------
 // Implementation of virtual functions in PipelinePart
 // --------------------------------------------------------------------------
@@ -282,16 +595,23 @@ bool RasterTriangleDepthStencilPart :: CompareState(const void * first, const vo
 	const RasterizerState * firstState = static_cast<const RasterizerState *>(first);
 	const RasterizerState * secondState = static_cast<const RasterizerState *>(second);
 	
-	return firstState->ComparePolygonDepthStencil(*secondState);
+	return firstState->ComparePolygonDepthStencil(*secondState) &&
+		(!m_ColorAlpha || firstState->ComparePolygonColorAlpha(*secondState));
 }
 
 void RasterTriangleDepthStencilPart :: Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state) {
 	m_State = static_cast<const RasterizerState *>(state);
-	BeginGenerateCode();
-	GenerateRasterBlockDepthStencil(varyingInfo);
+	BeginGenerateCode(target);
+
+	if (m_ColorAlpha) {
+		GenerateRasterBlockDepthStencilColorAlpha(varyingInfo);
+	} else {
+		GenerateRasterBlockDepthStencil(varyingInfo);
+	}
+
 	EndGenerateCode(target, state);
 }
 
 PipelinePart::Part RasterTriangleDepthStencilPart :: GetPart() const {
-	return PipelinePart::PartRasterBlockDepthStencil;
+	return m_ColorAlpha ? PipelinePart::PartRasterBlockDepthStencilColorAlpha : PipelinePart::PartRasterBlockDepthStencil;
 }
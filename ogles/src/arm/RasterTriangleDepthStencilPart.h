@@ -50,12 +50,19 @@
 namespace EGL {
 	class RasterTriangleDepthStencilPart: public RasterPart {
 	public:
+		// colorAlpha selects the variant that also performs the color/alpha
+		// processing of the fully covered raster blocks it is called for
+		RasterTriangleDepthStencilPart(bool colorAlpha = false): m_ColorAlpha(colorAlpha) {}
+
 		bool CompareState(const void * first, const void * second) const;
 		void Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state);
 		Part GetPart() const;
 		
 	private:
 		void GenerateRasterBlockDepthStencil(const VaryingInfo * varyingInfo);	
+		void GenerateRasterBlockDepthStencilColorAlpha(const VaryingInfo * varyingInfo);
+
+		bool m_ColorAlpha;
 	};
 	
 }
@@ -62,6 +62,10 @@ void RasterTriangleEdgeDepthStencilPart :: GenerateRasterBlockEdgeDepthStencil(c
 
 	procedure->num_args = 4;	// the previous three declarations make up the arguments
 
+	regRasterInfo->is_readonly = 1;
+	regVars->is_readonly = 1;
+	regEdges->is_readonly = 1;
+
 	cg_block_t * block = cg_block_create(procedure, 1);
 
 	//PixelMask * mask = pixelMask, totalMask = 0;
@@ -401,7 +405,7 @@ bool RasterTriangleEdgeDepthStencilPart :: CompareState(const void * first, cons
 
 void RasterTriangleEdgeDepthStencilPart :: Compile(FunctionCache * target, const VaryingInfo * varyingInfo, const void * state) {
 	m_State = static_cast<const RasterizerState *>(state);
-	BeginGenerateCode();
+	BeginGenerateCode(target);
 	GenerateRasterBlockEdgeDepthStencil(varyingInfo);
 	EndGenerateCode(target, state);
 }
@@ -64,6 +64,7 @@ namespace EGL {
 		cg_virtual_reg_t * regB;
 		cg_virtual_reg_t * regA;
 		cg_virtual_reg_t * regCoverage;
+		cg_virtual_reg_t * regDitherRow;	// dither thresholds of the row, or 0 to derive them from regY
 
 		cg_virtual_reg_t * regInfo;
 		cg_virtual_reg_t * regTexture[EGL_NUM_TEXTURE_UNITS];
@@ -107,6 +107,28 @@ int cg_bitset_union(cg_bitset_t * target, cg_bitset_t * source)
 }
 
 
+int cg_bitset_intersect(cg_bitset_t * target, cg_bitset_t * source)
+{
+	size_t index;
+	int result = 0;
+	size_t words = (target->elements + CG_BITSET_BITS_PER_WORD - 1) / CG_BITSET_BITS_PER_WORD;
+	
+	assert(target);
+	assert(source);
+	assert(target->elements == source->elements);
+	
+	for (index = 0; index < words; ++index)
+	{
+		U32 old = target->bits[index];
+		target->bits[index] &= source->bits[index];
+
+		result |= (target->bits[index] != old);
+	}
+
+	return result;
+}
+
+
 int cg_bitset_intersects(const cg_bitset_t * first, const cg_bitset_t * second) 
 {
 	size_t index;
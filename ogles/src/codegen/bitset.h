@@ -62,6 +62,9 @@ int cg_bitset_union_minus(cg_bitset_t * target, cg_bitset_t * source,
 
 int cg_bitset_union(cg_bitset_t * target, cg_bitset_t * source);
 
+/* target = target & source (intersection) */
+int cg_bitset_intersect(cg_bitset_t * target, cg_bitset_t * source);
+
 int cg_bitset_intersects(const cg_bitset_t * first, const cg_bitset_t * second);
 
 #define CG_BITSET_TEST(bitset, element) \
@@ -36,6 +36,7 @@
 
 
 #define SAVE_AREA_SIZE (10 * sizeof(U32))		/* this really depends on the function prolog */
+#define MIN_GLOBAL_REGS 4					/* registers each block grants to global values */
 
 
 typedef struct reference_t
@@ -1599,6 +1600,28 @@ static void emit_branch(cg_codegen_t * gen, cg_inst_branch_t * inst)
 }
 
 
+static void bind_result(cg_codegen_t * gen, cg_virtual_reg_t * reg)
+{
+	/* bind the result of a call, which is returned in A1, to reg			*/
+
+	cg_physical_reg_t * physical_reg;
+
+	if (reg->representative->is_global)
+	{
+		physical_reg = allocate_reg(gen, reg, 0);
+		assign_reg(gen, physical_reg, reg);
+		ARM_MOV_REG_REG(gen->cseg, physical_reg->regno, ARMREG_A1);
+	}
+	else
+	{
+		physical_reg = allocate_reg(gen, reg, 1u << ARMREG_A1);
+		assign_reg(gen, physical_reg, reg);
+	}
+
+	physical_reg->dirty = physical_reg->defined = 1;
+}
+
+
 static void emit_call(cg_codegen_t * gen, cg_inst_call_t * inst)
 {
 	call(gen, inst->proc->prologue, inst->args, (cg_inst_t *) inst);
@@ -1606,9 +1629,7 @@ static void emit_call(cg_codegen_t * gen, cg_inst_call_t * inst)
 	// deal with results
 	if (inst->dest)
 	{
-		cg_physical_reg_t * physical_reg = allocate_reg(gen, inst->dest, 1 << ARMREG_A1);
-		assign_reg(gen, physical_reg, inst->dest);
-		physical_reg->dirty = physical_reg->defined = 1;
+		bind_result(gen, inst->dest);
 	}
 }
 
@@ -1823,6 +1844,15 @@ static cg_physical_reg_t * allocate_reg(cg_codegen_t * gen, cg_virtual_reg_t * r
 		mask = ~0u;
 	}
 	
+	// a global register always resides in its own physical register
+	
+	if (reg->representative && reg->representative->is_global && 
+		((1u << reg->physical_reg->regno) & mask))
+	{
+		assert(reg->physical_reg->list == &gen->global_regs);
+		return reg->physical_reg;
+	}
+	
 	// check if the virtual register is already present in a matching
 	// physical register
 	// if so, return that register
@@ -1885,8 +1915,12 @@ static void assign_reg(cg_codegen_t * gen,
 			physical_reg->defined = physical_reg->dirty = 0;
 	}
 
-	if (reg->physical_reg == (cg_physical_reg_t *) 0 ||
-		reg->physical_reg->virtual_reg != reg)
+	/* global registers stay bound to their physical register, any other	*/
+	/* register holding their value is just a copy							*/
+
+	if (!(reg->representative && reg->representative->is_global) &&
+		(reg->physical_reg == (cg_physical_reg_t *) 0 ||
+		 reg->physical_reg->virtual_reg != reg))
 	{
 		reg->physical_reg = physical_reg;
 	}
@@ -2147,67 +2181,47 @@ void cg_codegen_emit_inst(cg_codegen_t * gen, cg_inst_t * inst)
 	{
 		case cg_op_finv:
 			{
-				cg_physical_reg_t * physical_reg;
-
 				load_register_arg(gen, inst->unary.operand.source, ARMREG_A1, inst);
 				kill_flags(gen);
 				kill_argument_registers(gen);
 				call_runtime(gen, gen->runtime->inv_LP_16_32s);
 
-				/* load result from stack position */
-				physical_reg = allocate_reg(gen, inst->unary.dest_value, 1);
-				assign_reg(gen, physical_reg, inst->unary.dest_value);
-				physical_reg->dirty = physical_reg->defined = 1;
+				bind_result(gen, inst->unary.dest_value);
 			}
 			break;
 
 		case cg_op_cnv_flt:
 			{
-				cg_physical_reg_t * physical_reg;
-
 				load_register_arg(gen, inst->unary.operand.source, ARMREG_A1, inst);
 				kill_flags(gen);
 				kill_argument_registers(gen);
 				call_runtime(gen, gen->runtime->convert_float);
 
-				/* load result from stack position */
-				physical_reg = allocate_reg(gen, inst->unary.dest_value, 1);
-				assign_reg(gen, physical_reg, inst->unary.dest_value);
-				physical_reg->dirty = physical_reg->defined = 1;
+				bind_result(gen, inst->unary.dest_value);
 			}
 			break;
 
 		case cg_op_fdiv:
 			{
-				cg_physical_reg_t * physical_reg;
-
 				load_register_arg(gen, inst->binary.source, ARMREG_A1, inst);
 				load_register_arg(gen, inst->binary.operand.source, ARMREG_A2, inst);
 				kill_flags(gen);
 				kill_argument_registers(gen);
 				call_runtime(gen, gen->runtime->div_LP_16_32s);
 
-				/* load result from stack position */
-				physical_reg = allocate_reg(gen, inst->unary.dest_value, 1);
-				assign_reg(gen, physical_reg, inst->unary.dest_value);
-				physical_reg->dirty = physical_reg->defined = 1;
+				bind_result(gen, inst->unary.dest_value);
 			}
 			break;
 
 
 		case cg_op_fsqrt:
 			{
-				cg_physical_reg_t * physical_reg;
-
 				load_register_arg(gen, inst->unary.operand.source, ARMREG_A1, inst);
 				kill_flags(gen);
 				kill_argument_registers(gen);
 				call_runtime(gen, gen->runtime->sqrt_LP_16_32s);
 
-				/* load result from stack position */
-				physical_reg = allocate_reg(gen, inst->unary.dest_value, 1);
-				assign_reg(gen, physical_reg, inst->unary.dest_value);
-				physical_reg->dirty = physical_reg->defined = 1;
+				bind_result(gen, inst->unary.dest_value);
 			}
 			break;
 
@@ -2280,33 +2294,90 @@ static void init_flags(cg_codegen_t * gen)
 }
 
 
+static int is_block_reg(cg_block_t * block, cg_virtual_reg_t * reg)
+{
+	/* does reg occupy a register anywhere within block?					*/
+
+	return 
+		CG_BITSET_TEST(block->live_in, reg->reg_no) ||
+		CG_BITSET_TEST(block->live_out, reg->reg_no) ||
+		CG_BITSET_TEST(block->def, reg->reg_no) ||
+		CG_BITSET_TEST(block->use, reg->reg_no);
+}
+
+
 static void allocate_globals(cg_codegen_t * gen)
+	/************************************************************************/
+	/* Reserve the physical registers of all global registers that are		*/
+	/* live in or referenced by the current block, and bind the ones that	*/
+	/* carry a value into the block											*/
+	/************************************************************************/
 {
 	cg_block_t * block = gen->current_block;
 	cg_proc_t * proc = block->proc;
 	cg_virtual_reg_list_t * node;
+	cg_virtual_reg_t * reg;
+	size_t index;
 	
+	if (block == proc->blocks)
+	{
+		/********************************************************************/
+		/* On procedure entry, move arguments into their global registers	*/
+		/********************************************************************/
+
+		for (reg = proc->registers, index = 0; reg && index < proc->num_args; reg = reg->next, ++index)
+		{
+			if (!reg->representative->is_global || 
+				!CG_BITSET_TEST(block->live_in, reg->reg_no))
+				continue;
+
+			if (index < ARM_NUM_ARG_REGS)
+			{
+				cg_physical_reg_t * arg_reg = &gen->registers[ARMREG_A1 + index];
+
+				ARM_MOV_REG_REG(gen->cseg, reg->physical_reg->regno, arg_reg->regno);
+
+				reg_list_remove(arg_reg->list, arg_reg);
+				reg_list_add(&gen->free_regs, arg_reg);
+				arg_reg->virtual_reg = (cg_virtual_reg_t *) 0;
+				arg_reg->dirty = arg_reg->defined = 0;
+			}
+			else
+			{
+				ARM_LDR_IMM(gen->cseg, reg->physical_reg->regno, ARMREG_FP, fp_offset(gen, reg));
+			}
+		}
+	}
+
 	for (node = proc->globals; node; node = node->next)
 	{
-		if (CG_BITSET_TEST(block->live_in, node->reg->reg_no))
+		cg_physical_reg_t * physical_reg;
+
+		reg = node->reg;
+		physical_reg = reg->physical_reg;
+
+		if (!is_block_reg(block, reg))
+			continue;
+
+		if (physical_reg->list == &gen->used_regs)
 		{
-			cg_virtual_reg_t * reg = node->reg;
-			cg_physical_reg_t * physical_reg = reg->physical_reg;
-			assert(physical_reg->list == &gen->free_regs);
-			reg_list_remove(physical_reg->list, physical_reg);
-			assign_reg(gen, physical_reg, node->reg);
-			reg_list_add(&gen->global_regs, physical_reg);
-			physical_reg->defined = 1;
+			/* argument register that is handed over to a global value		*/
+			deallocate_reg(gen, physical_reg);
 		}
-		else if (CG_BITSET_TEST(block->live_out, node->reg->reg_no))
+
+		if (physical_reg->list != &gen->global_regs)
 		{
-			cg_virtual_reg_t * reg = node->reg;
-			cg_physical_reg_t * physical_reg = reg->physical_reg;
 			assert(physical_reg->list == &gen->free_regs);
 			reg_list_remove(physical_reg->list, physical_reg);
-			assign_reg(gen, physical_reg, node->reg);
 			reg_list_add(&gen->global_regs, physical_reg);
-			physical_reg->defined = 0;
+			physical_reg->virtual_reg = (cg_virtual_reg_t *) 0;
+			physical_reg->defined = physical_reg->dirty = 0;
+		}
+
+		if (CG_BITSET_TEST(block->live_in, reg->reg_no))
+		{
+			assign_reg(gen, physical_reg, reg);
+			physical_reg->defined = 1;
 		}
 	}
 }
@@ -2613,14 +2684,151 @@ static int register_sort(const void * first, const void * second)
 }
 
 
+static int is_leaf_proc(cg_proc_t * proc)
+{
+	/* does the procedure run without calling out to any other code?		*/
+
+	cg_block_t * block;
+	cg_inst_t * inst;
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		for (inst = block->insts.head; inst; inst = inst->base.next)
+		{
+			if (!is_simple_inst(inst))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+static int is_local_value(cg_virtual_reg_t * reg, cg_bitset_t * crossing)
+{
+	return reg->type == cg_reg_type_general && !CG_BITSET_TEST(crossing, reg->reg_no);
+}
+
+
+static size_t block_local_pressure(cg_block_t * block, cg_bitset_t * crossing, int * uses)
+	/************************************************************************/
+	/* Determine the maximum number of values local to the block that need	*/
+	/* a register at the same time											*/
+	/************************************************************************/
+{
+	cg_inst_t * inst;
+	cg_virtual_reg_t * buffer[64];
+	cg_virtual_reg_t **iter, ** end;
+	cg_bitset_t * live = cg_bitset_create(block->proc->module->heap, block->proc->num_registers);
+	size_t count = 0, max_count = 0;
+
+	for (inst = block->insts.head; inst; inst = inst->base.next)
+	{
+		end = cg_inst_use(inst, buffer, buffer + 64);
+
+		for (iter = buffer; iter != end; ++iter)
+			uses[(*iter)->reg_no] = 0;
+
+		end = cg_inst_def(inst, buffer, buffer + 64);
+
+		for (iter = buffer; iter != end; ++iter)
+			uses[(*iter)->reg_no] = 0;
+	}
+
+	for (inst = block->insts.head; inst; inst = inst->base.next)
+	{
+		end = cg_inst_use(inst, buffer, buffer + 64);
+
+		for (iter = buffer; iter != end; ++iter)
+			++uses[(*iter)->reg_no];
+	}
+
+	for (inst = block->insts.head; inst; inst = inst->base.next)
+	{
+		size_t operands = 0;
+
+		end = cg_inst_use(inst, buffer, buffer + 64);
+
+		/* operands carried in from other blocks may end up without a		*/
+		/* global register, and then need a local one for the instruction	*/
+
+		for (iter = buffer; iter != end; ++iter)
+		{
+			if ((*iter)->type == cg_reg_type_general && !is_local_value(*iter, crossing))
+				++operands;
+		}
+
+		if (count + operands > max_count)
+			max_count = count + operands;
+
+		for (iter = buffer; iter != end; ++iter)
+		{
+			cg_virtual_reg_t * reg = *iter;
+
+			if (is_local_value(reg, crossing) && 
+				--uses[reg->reg_no] == 0 && CG_BITSET_TEST(live, reg->reg_no))
+			{
+				CG_BITSET_CLEAR(live, reg->reg_no);
+				--count;
+			}
+		}
+
+		end = cg_inst_def(inst, buffer, buffer + 64);
+
+		for (iter = buffer; iter != end; ++iter)
+		{
+			cg_virtual_reg_t * reg = *iter;
+
+			if (is_local_value(reg, crossing) && !CG_BITSET_TEST(live, reg->reg_no))
+			{
+				CG_BITSET_SET(live, reg->reg_no);
+				++count;
+			}
+		}
+
+		if (count > max_count)
+			max_count = count;
+
+		/* values that are never used again do not keep their register		*/
+
+		for (iter = buffer; iter != end; ++iter)
+		{
+			cg_virtual_reg_t * reg = *iter;
+
+			if (is_local_value(reg, crossing) && 
+				uses[reg->reg_no] == 0 && CG_BITSET_TEST(live, reg->reg_no))
+			{
+				CG_BITSET_CLEAR(live, reg->reg_no);
+				--count;
+			}
+		}
+	}
+
+	return max_count;
+}
+
+
 static void select_global_regs(cg_codegen_t * gen, cg_proc_t * proc)
+	/************************************************************************/
+	/* Assign the variable ARM registers to the virtual registers whose		*/
+	/* values are carried across basic blocks. Candidates are colored in	*/
+	/* the order of their weighted def/use cost, so that values used within	*/
+	/* the innermost loops are served first. Registers that do not			*/
+	/* interfere with each other can share a physical register. Values		*/
+	/* that live within a single block are left to the local allocator.		*/
+	/************************************************************************/
 {
 	size_t used_register_count = 0, index, reg_index;
 	cg_virtual_reg_t * reg;
 	cg_virtual_reg_t ** all_regs, **current_reg;
-	cg_virtual_reg_list_t * node;
-	//cg_bitset_t * conflicts[ARM_NUM_VARIABLE_REGS];
-	//cg_virtual_reg_list_t * interferences;
+	cg_virtual_reg_list_t * node, * interferences;
+	cg_bitset_t * conflicts[ARM_NUM_VARIABLE_REGS + ARM_NUM_ARG_REGS];
+	size_t num_colors_avail = ARM_NUM_VARIABLE_REGS;
+	cg_bitset_t * crossing;
+	cg_block_t * block;
+	size_t num_blocks, * budget, * num_colors;
+	U32 * used_colors;
+	int * uses;
 
 	for (reg = proc->registers, index = 0; reg && index < proc->num_args; reg = reg->next, ++index)
 	{
@@ -2630,80 +2838,160 @@ static void select_global_regs(cg_codegen_t * gen, cg_proc_t * proc)
 			reg->representative->is_arg = 1;
 	}
 
+	/************************************************************************/
+	/* Determine the registers that are live on entry of any block but the	*/
+	/* first one															*/
+	/************************************************************************/
+
+	crossing = cg_bitset_create(proc->module->heap, proc->num_registers);
+
+	for (block = proc->blocks->next; block; block = block->next)
+	{
+		cg_bitset_union(crossing, block->live_in);
+	}
+
 	for (reg = proc->registers; reg; reg = reg->next)
 	{
-		if (reg->representative == NULL || reg->representative == reg)
+		if ((reg->representative == NULL || reg->representative == reg) &&
+			reg->type == cg_reg_type_general && CG_BITSET_TEST(crossing, reg->reg_no))
 			used_register_count++;
 	}
 
+	if (used_register_count == 0)
+		return;
+
 	all_regs = (cg_virtual_reg_t **) malloc(used_register_count * sizeof (cg_virtual_reg_t *));
 
 	for (reg = proc->registers, current_reg = all_regs; reg; reg = reg->next)
 	{
-		if (reg->representative == NULL || reg->representative == reg)
+		if ((reg->representative == NULL || reg->representative == reg) &&
+			reg->type == cg_reg_type_general && CG_BITSET_TEST(crossing, reg->reg_no))
 			*current_reg++ = reg;
 	}
 
 	qsort(all_regs, used_register_count, sizeof(cg_virtual_reg_t *), register_sort);
 
-	/* simplest choice: do not try to pack registers */
-	/* mark up registers that are to be treated globally */
-	/* for each basic block where the register is used in live_in or live_out, perform a global
-	   allocation of that register */
-	/* initially, we do global allocation only among variable ARM registers */
+	/* without calls, the argument registers can hold global values as well	*/
+
+	if (is_leaf_proc(proc))
+		num_colors_avail += ARM_NUM_ARG_REGS;
 
-#if 1
-	for (index = 0, reg_index = 0; index < ARM_NUM_VARIABLE_REGS && reg_index < used_register_count; ++reg_index)
+	for (index = 0; index < num_colors_avail; ++index) 
 	{
-		cg_virtual_reg_t * reg = all_regs[reg_index];
+		conflicts[index] = cg_bitset_create(proc->module->heap, proc->num_registers);
+	}
 
-		if (!reg->is_arg && reg->type == cg_reg_type_general)
-		{
-			reg->is_global = 1;
-			reg->physical_reg = &gen->registers[index++ + ARMREG_V1];
+	/************************************************************************/
+	/* Each block can hand as many registers to global values as are not	*/
+	/* needed for the values local to the block								*/
+	/************************************************************************/
 
-			node = (cg_virtual_reg_list_t *) cg_heap_allocate(proc->module->heap, sizeof(cg_virtual_reg_list_t));
-			node->reg = reg;
-			node->next = proc->globals;
-			proc->globals = node;
-		}
+	for (block = proc->blocks, num_blocks = 0; block; block = block->next)
+	{
+		block->index = num_blocks++;
 	}
-#else
-	for (index = 0; index < ARM_NUM_VARIABLE_REGS; ++index) {
-		conflicts[index] = cg_bitset_create(proc->module->heap, proc->num_registers);
+
+	budget = (size_t *) malloc(num_blocks * sizeof(size_t));
+	used_colors = (U32 *) malloc(num_blocks * sizeof(U32));
+	num_colors = (size_t *) malloc(num_blocks * sizeof(size_t));
+	uses = (int *) malloc(proc->num_registers * sizeof(int));
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		size_t pressure = block_local_pressure(block, crossing, uses);
+		size_t available = ARM_NUM_VARIABLE_REGS + ARM_NUM_ARG_REGS;
+
+		/* loop carried values pay off on every iteration, so keep a few	*/
+		/* registers for them even if local values need to be spilled		*/
+
+		budget[block->index] = pressure + MIN_GLOBAL_REGS < available ? 
+			available - pressure : MIN_GLOBAL_REGS;
+		used_colors[block->index] = 0;
+		num_colors[block->index] = 0;
 	}
 
+	free(uses);
+
 	for (reg_index = 0; reg_index < used_register_count; ++reg_index)
 	{
 		cg_virtual_reg_t * reg = all_regs[reg_index];
+		size_t best_index = num_colors_avail, best_added = ~0u;
 
-		if (!reg->is_arg && reg->type == cg_reg_type_general)
-		{
-			for (index = 0; index < ARM_NUM_VARIABLE_REGS; ++index) {
-				
-				if (!CG_BITSET_TEST(conflicts[index], reg->reg_no)) {
-					reg->is_global = 1;
-					reg->physical_reg = &gen->registers[index + ARMREG_V1];
+		/********************************************************************/
+		/* Among the colors not taken by interfering registers, choose the	*/
+		/* one that needs to be newly reserved in the fewest blocks			*/
+		/********************************************************************/
 
-					for (interferences = reg->interferences; interferences; interferences = interferences->next) {
-						CG_BITSET_SET(conflicts[index], interferences->reg->reg_no);
-					}
+		for (index = 0; index < num_colors_avail; ++index) 
+		{
+			size_t added = 0;
 
-					CG_BITSET_SET(conflicts[index], reg->reg_no);
+			if (CG_BITSET_TEST(conflicts[index], reg->reg_no) ||
+				(index >= ARM_NUM_VARIABLE_REGS && reg->is_arg)) 
+				continue;
 
-					node = (cg_virtual_reg_list_t *) cg_heap_allocate(proc->module->heap, sizeof(cg_virtual_reg_list_t));
-					node->reg = reg;
-					node->next = proc->globals;
-					proc->globals = node;
+			for (block = proc->blocks; block; block = block->next)
+			{
+				if (!is_block_reg(block, reg) || (used_colors[block->index] & (1u << index)))
+					continue;
 
+				if (num_colors[block->index] >= budget[block->index])
 					break;
-				}
+
+				++added;
 			}
+
+			if (block == NULL && added < best_added)
+			{
+				best_index = index;
+				best_added = added;
+			}
+		}
+
+		if (best_index == num_colors_avail)
+			continue;
+
+		reg->is_global = 1;
+		reg->physical_reg = best_index < ARM_NUM_VARIABLE_REGS ?
+			&gen->registers[ARMREG_V1 + best_index] : 
+			&gen->registers[ARMREG_A1 + best_index - ARM_NUM_VARIABLE_REGS];
+
+		for (interferences = reg->interferences; interferences; interferences = interferences->next) 
+		{
+			CG_BITSET_SET(conflicts[best_index], interferences->reg->reg_no);
 		}
+
+		CG_BITSET_SET(conflicts[best_index], reg->reg_no);
+
+		for (block = proc->blocks; block; block = block->next)
+		{
+			if (is_block_reg(block, reg) && !(used_colors[block->index] & (1u << best_index)))
+			{
+				used_colors[block->index] |= 1u << best_index;
+				++num_colors[block->index];
+			}
+		}
+
+		node = (cg_virtual_reg_list_t *) cg_heap_allocate(proc->module->heap, sizeof(cg_virtual_reg_list_t));
+		node->reg = reg;
+		node->next = proc->globals;
+		proc->globals = node;
 	}
-#endif
 
+	free(budget);
+	free(used_colors);
+	free(num_colors);
 	free(all_regs);
+
+	/************************************************************************/
+	/* All members of a global register set share its physical register		*/
+	/************************************************************************/
+
+	for (reg = proc->registers; reg; reg = reg->next)
+	{
+		if (reg->representative && reg->representative->is_global)
+			reg->physical_reg = reg->representative->physical_reg;
+	}
 }
 
 
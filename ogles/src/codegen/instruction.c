@@ -464,6 +464,11 @@ static void proc_controlflow(cg_proc_t * proc)
 	cg_block_t * block;
 	cg_inst_t * inst;
 
+	for (block = proc->blocks; block; block = block->next)
+	{
+		block->pred = block->succ = (cg_block_list_t *) 0;
+	}
+
 	for (block = proc->blocks; block; block = block->next)
 	{
 		int last_inst_is_bra = 0;
@@ -922,163 +927,1173 @@ static cg_virtual_reg_t * find_set(cg_virtual_reg_t * reg)
 	if (result != reg->representative)
 		reg->representative = result;
 
-	return result;
+	return result;
+}
+
+
+static void find_union(cg_virtual_reg_t * first, cg_virtual_reg_t * second)
+{
+	cg_virtual_reg_t * first_set = find_set(first);
+	cg_virtual_reg_t * second_set = find_set(second);
+
+	second_set->representative = first_set;
+}
+
+
+void cg_module_unify_registers(cg_module_t * module)
+{
+	cg_proc_t * proc;
+	cg_block_t * block;
+	cg_inst_t * inst;
+	cg_virtual_reg_t * reg;
+
+	for (proc = module->procs; proc; proc = proc->next)
+	{
+		/********************************************************************/
+		/* Initialize all registers as being distinct						*/
+		/********************************************************************/
+
+		for (reg = proc->registers; reg; reg = reg->next)
+		{
+			reg->representative = reg;
+		}
+
+		/********************************************************************/
+		/* Perform union-find for all registers that occur in a phi			*/
+		/* instruction														*/
+		/********************************************************************/
+
+		for (block = proc->blocks; block; block = block->next)
+		{
+			cg_virtual_reg_list_t * list;
+
+			for (inst = block->insts.head; inst && inst->base.opcode == cg_op_phi; 
+				 inst = inst->base.next)
+			{
+				for (list = inst->phi.regs; list; list = list->next)
+				{
+					find_union(inst->phi.dest, list->reg);
+				}
+			}
+		}
+
+		/********************************************************************/
+		/* Flatten out indirections so that there is at most one level of	*/
+		/* indirection between any register and its representative			*/
+		/********************************************************************/
+
+		for (reg = proc->registers; reg; reg = reg->next)
+		{
+			find_set(reg);
+		}
+	}
+}
+
+
+
+static void proc_inst_def(cg_proc_t * proc)
+{
+	cg_virtual_reg_t * reg;
+	cg_block_t * block;
+	cg_inst_t * inst;
+
+	/************************************************************************/
+	/* Clear out def and use information associated with virtual registers	*/
+	/************************************************************************/
+
+	for (reg = proc->registers; reg; reg = reg->next)
+	{
+		reg->def = (cg_inst_t *) 0;
+		reg->use = (cg_inst_list_t *) 0;
+	}
+
+	/************************************************************************/
+	/* Add def and use information for each register						*/
+	/************************************************************************/
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		for (inst = block->insts.head; inst; inst = inst->base.next)
+		{
+			cg_virtual_reg_t * buffer[64];
+			cg_virtual_reg_t **iter, ** end = cg_inst_def(inst, buffer, buffer + 64);
+
+			for (iter = buffer; iter != end; ++iter)
+			{
+				cg_virtual_reg_t * reg = *iter;
+				assert(reg->def == (cg_inst_t *) 0);
+				reg->def = inst;
+			}
+		}
+	}
+}
+
+
+void cg_module_inst_def(cg_module_t * module)
+{
+	cg_proc_t * proc;
+
+	for (proc = module->procs; proc; proc = proc->next)
+		proc_inst_def(proc);
+}
+
+
+static void proc_inst_use_chains(cg_proc_t * proc)
+{
+	cg_virtual_reg_t * reg;
+	cg_block_t * block;
+	cg_inst_t * inst;
+
+	/************************************************************************/
+	/* Clear out def and use information associated with virtual registers	*/
+	/************************************************************************/
+
+	for (reg = proc->registers; reg; reg = reg->next)
+	{
+		reg->def = (cg_inst_t *) 0;
+		reg->use = (cg_inst_list_t *) 0;
+	}
+
+	/************************************************************************/
+	/* Add def qand use information for each register						*/
+	/************************************************************************/
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		for (inst = block->insts.head; inst; inst = inst->base.next)
+		{
+			cg_virtual_reg_t * buffer[64];
+			cg_virtual_reg_t **iter, ** end = cg_inst_use(inst, buffer, buffer + 64);
+
+			for (iter = buffer; iter != end; ++iter)
+			{
+				cg_virtual_reg_t * reg = *iter;
+				cg_inst_list_t * list = cg_heap_allocate(proc->module->heap, sizeof(cg_inst_list_t));
+				list->inst = inst;
+				list->next = reg->use;
+				reg->use = list;
+			}
+		}
+	}
+}
+
+
+void cg_module_inst_use_chains(cg_module_t * module)
+{
+	cg_proc_t * proc;
+
+	for (proc = module->procs; proc; proc = proc->next)
+		proc_inst_use_chains(proc);
+}
+
+
+/****************************************************************************/
+/* Optimization passes on the SSA form of the intermediate code.			*/
+/*																			*/
+/* Registers that occur in a phi instruction end up sharing their storage   */
+/* once cg_module_unify_registers has run, so their value changes while		*/
+/* they are live. The passes below never substitute, move or propagate		*/
+/* such registers, nor instructions that read them.							*/
+/****************************************************************************/
+
+#define CG_EXPRESSION_BUCKETS 64
+
+
+static cg_bitset_t * proc_phi_registers(cg_proc_t * proc)
+{
+	cg_bitset_t * result = cg_bitset_create(proc->module->heap, proc->num_registers);
+	cg_block_t * block;
+	cg_inst_t * inst;
+	cg_virtual_reg_list_t * list;
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		for (inst = block->insts.head; inst; inst = inst->base.next)
+		{
+			if (inst->base.kind != cg_inst_phi)
+				continue;
+
+			CG_BITSET_SET(result, inst->phi.dest->reg_no);
+
+			for (list = inst->phi.regs; list; list = list->next)
+				CG_BITSET_SET(result, list->reg->reg_no);
+		}
+	}
+
+	return result;
+}
+
+
+static int uses_phi_registers(const cg_inst_t * inst, cg_bitset_t * pinned)
+{
+	cg_virtual_reg_t * buffer[64];
+	cg_virtual_reg_t **iter, ** end = cg_inst_use(inst, buffer, buffer + 64);
+
+	for (iter = buffer; iter != end; ++iter)
+	{
+		if (CG_BITSET_TEST(pinned, (*iter)->reg_no))
+			return 1;
+	}
+
+	return 0;
+}
+
+
+static cg_virtual_reg_t * subst_reg(cg_virtual_reg_t ** subst, cg_virtual_reg_t * reg)
+{
+	while (reg && subst[reg->reg_no])
+		reg = subst[reg->reg_no];
+
+	return reg;
+}
+
+
+static void subst_reg_list(cg_virtual_reg_t ** subst, cg_virtual_reg_list_t * list)
+{
+	for (; list; list = list->next)
+		list->reg = subst_reg(subst, list->reg);
+}
+
+
+/****************************************************************************/
+/* Replace the registers used by the instruction according to subst. The   */
+/* ARM specific formats are only introduced by cg_module_amode, which runs  */
+/* after the passes using this function.									*/
+/****************************************************************************/
+static void inst_subst_uses(cg_inst_t * inst, cg_virtual_reg_t ** subst)
+{
+	switch (inst->base.kind)
+	{
+		case cg_inst_unary:
+			inst->unary.operand.source = subst_reg(subst, inst->unary.operand.source);
+			break;
+
+		case cg_inst_binary:
+			inst->binary.source = subst_reg(subst, inst->binary.source);
+			inst->binary.operand.source = subst_reg(subst, inst->binary.operand.source);
+			break;
+
+		case cg_inst_compare:
+			inst->compare.source = subst_reg(subst, inst->compare.source);
+			inst->compare.operand.source = subst_reg(subst, inst->compare.operand.source);
+			break;
+
+		case cg_inst_load:
+			inst->load.mem.base = subst_reg(subst, inst->load.mem.base);
+			break;
+
+		case cg_inst_store:
+			inst->store.source = subst_reg(subst, inst->store.source);
+			inst->store.mem.base = subst_reg(subst, inst->store.mem.base);
+			break;
+
+		case cg_inst_load_immed:
+		case cg_inst_branch_label:
+			break;
+
+		case cg_inst_branch_cond:
+			inst->branch.cond = subst_reg(subst, inst->branch.cond);
+			break;
+
+		case cg_inst_phi:
+			subst_reg_list(subst, inst->phi.regs);
+			break;
+
+		case cg_inst_call:
+			subst_reg_list(subst, inst->call.args);
+			break;
+
+		case cg_inst_ret:
+			inst->ret.result = subst_reg(subst, inst->ret.result);
+			break;
+
+		default:
+			assert(0);
+	}
+}
+
+
+static void proc_subst_uses(cg_proc_t * proc, cg_virtual_reg_t ** subst)
+{
+	cg_block_t * block;
+	cg_inst_t * inst;
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		for (inst = block->insts.head; inst; inst = inst->base.next)
+		{
+			inst_subst_uses(inst, subst);
+		}
+	}
+}
+
+
+static cg_virtual_reg_t ** proc_create_subst(cg_proc_t * proc)
+{
+	return (cg_virtual_reg_t **) 
+		cg_heap_allocate(proc->module->heap, sizeof(cg_virtual_reg_t *) * proc->num_registers);
+}
+
+
+static void block_update_tail(cg_block_t * block)
+{
+	cg_inst_t * inst;
+
+	block->insts.tail = (cg_inst_t *) 0;
+
+	for (inst = block->insts.head; inst; inst = inst->base.next)
+		block->insts.tail = inst;
+}
+
+
+static size_t proc_number_blocks(cg_proc_t * proc)
+{
+	cg_block_t * block;
+	size_t count = 0;
+
+	for (block = proc->blocks; block; block = block->next)
+		block->index = count++;
+
+	return count;
+}
+
+
+static void proc_dominators(cg_proc_t * proc)
+{
+	cg_heap_t * heap = proc->module->heap;
+	size_t count = proc_number_blocks(proc), index;
+	cg_bitset_t * temp = cg_bitset_create(heap, count);
+	cg_block_t * block;
+	cg_block_list_t * list;
+	int changed;
+
+	// dom(entry) := { entry }, dom(b) := all blocks otherwise
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		block->dom = cg_bitset_create(heap, count);
+
+		if (block == proc->blocks) 
+		{
+			CG_BITSET_SET(block->dom, block->index);
+		}
+		else
+		{
+			for (index = 0; index < count; ++index)
+				CG_BITSET_SET(block->dom, index);
+		}
+	}
+
+	// repeat until no further change:
+	//	dom(b) := { b } U (^ dom(p), p in pred(b))
+	do
+	{
+		changed = 0;
+
+		for (block = proc->blocks->next; block; block = block->next)
+		{
+			if (!block->pred)
+				continue;
+
+			cg_bitset_assign(temp, block->pred->block->dom);
+
+			for (list = block->pred->next; list; list = list->next)
+				cg_bitset_intersect(temp, list->block->dom);
+
+			CG_BITSET_SET(temp, block->index);
+			changed |= cg_bitset_intersect(block->dom, temp);
+		}
+	}
+	while (changed);
+}
+
+
+/****************************************************************************/
+/* A load reads memory that is not modified while the procedure runs if		*/
+/* the base register of its address has been marked as read-only by the		*/
+/* code generator.															*/
+/****************************************************************************/
+static int is_readonly_load(const cg_inst_t * inst)
+{
+	cg_virtual_reg_t * base;
+
+	if (inst->base.kind != cg_inst_load)
+		return 0;
+
+	for (base = inst->load.mem.base; 
+		 base->def && base->def->base.kind == cg_inst_binary && base->def->base.opcode == cg_op_add;
+		 base = base->def->binary.source)
+		;
+
+	return base->is_readonly != 0;
+}
+
+
+static int is_cheap_constant(I32 value)
+{
+	return is_arm_const(value) || is_arm_const(~value);
+}
+
+
+static int is_constant(cg_virtual_reg_t * reg, cg_bitset_t * pinned, I32 * value)
+{
+	if (!reg->def || reg->def->base.kind != cg_inst_load_immed ||
+		CG_BITSET_TEST(pinned, reg->reg_no))
+		return 0;
+
+	*value = reg->def->immed.value;
+	return 1;
+}
+
+
+/****************************************************************************/
+/* Split the address of a load into a base register and a constant offset  */
+/****************************************************************************/
+static cg_virtual_reg_t * load_address(const cg_inst_t * inst, cg_bitset_t * pinned, I32 * offset)
+{
+	cg_virtual_reg_t * base = inst->load.mem.base;
+	I32 value;
+
+	*offset = 0;
+
+	while (base->def && base->def->base.kind == cg_inst_binary && 
+		   base->def->base.opcode == cg_op_add && !base->def->binary.dest_flags &&
+		   !CG_BITSET_TEST(pinned, base->reg_no) &&
+		   is_constant(base->def->binary.operand.source, pinned, &value))
+	{
+		*offset += value;
+		base = base->def->binary.source;
+	}
+
+	return base;
+}
+
+
+static int fold_unary(cg_opcode_t opcode, I32 operand, I32 * result)
+{
+	switch (opcode)
+	{
+		case cg_op_neg:
+		case cg_op_fneg:
+			*result = (I32) (0u - (U32) operand);
+			return 1;
+
+		case cg_op_not:
+			*result = ~operand;
+			return 1;
+
+		case cg_op_abs:
+			*result = operand < 0 ? (I32) (0u - (U32) operand) : operand;
+			return 1;
+
+		default:
+			return 0;
+	}
+}
+
+
+static int fold_binary(cg_opcode_t opcode, I32 left, I32 right, I32 * result)
+{
+	U32 shift = (U32) right & 0xff;		/* ARM uses the lowest byte only	*/
+
+	switch (opcode)
+	{
+		case cg_op_add:
+		case cg_op_fadd:
+			*result = (I32) ((U32) left + (U32) right);
+			return 1;
+
+		case cg_op_sub:
+		case cg_op_fsub:
+			*result = (I32) ((U32) left - (U32) right);
+			return 1;
+
+		case cg_op_mul:
+			*result = (I32) ((U32) left * (U32) right);
+			return 1;
+
+		case cg_op_and:
+			*result = left & right;
+			return 1;
+
+		case cg_op_or:
+			*result = left | right;
+			return 1;
+
+		case cg_op_xor:
+			*result = left ^ right;
+			return 1;
+
+		case cg_op_min:
+			*result = left < right ? left : right;
+			return 1;
+
+		case cg_op_max:
+			*result = left > right ? left : right;
+			return 1;
+
+		case cg_op_lsl:
+			*result = shift >= 32 ? 0 : (I32) ((U32) left << shift);
+			return 1;
+
+		case cg_op_lsr:
+			*result = shift >= 32 ? 0 : (I32) ((U32) left >> shift);
+			return 1;
+
+		case cg_op_asr:
+			*result = left >> (shift >= 32 ? 31 : shift);
+			return 1;
+
+		default:
+			return 0;
+	}
+}
+
+
+static void make_load_immed(cg_inst_t * inst, cg_virtual_reg_t * dest, I32 value)
+{
+	inst->base.kind = cg_inst_load_immed;
+	inst->base.opcode = cg_op_ldi;
+	inst->immed.dest = dest;
+	inst->immed.value = value;
+}
+
+
+/****************************************************************************/
+/* Fold the instruction if its operands are constant. If the instruction	*/
+/* merely copies one of its operands, that operand is returned so that the	*/
+/* caller can substitute it for the result.									*/
+/****************************************************************************/
+static cg_virtual_reg_t * inst_fold_constants(cg_inst_t * inst, cg_bitset_t * pinned)
+{
+	cg_virtual_reg_t * dest, * copy = (cg_virtual_reg_t *) 0;
+	I32 left, right, result;
+	int is_left_const, is_right_const;
+
+	switch (inst->base.kind)
+	{
+		case cg_inst_unary:
+			if (!inst->unary.dest_flags &&
+				is_constant(inst->unary.operand.source, pinned, &left) &&
+				fold_unary(inst->base.opcode, left, &result))
+			{
+				make_load_immed(inst, inst->unary.dest_value, result);
+			}
+
+			return (cg_virtual_reg_t *) 0;
+
+		case cg_inst_binary:
+			break;
+
+		default:
+			return (cg_virtual_reg_t *) 0;
+	}
+
+	if (inst->binary.dest_flags)
+		return (cg_virtual_reg_t *) 0;
+
+	dest = inst->binary.dest_value;
+	is_left_const = is_constant(inst->binary.source, pinned, &left);
+	is_right_const = is_constant(inst->binary.operand.source, pinned, &right);
+
+	if (is_left_const && is_right_const)
+	{
+		if (fold_binary(inst->base.opcode, left, right, &result))
+			make_load_immed(inst, dest, result);
+
+		return (cg_virtual_reg_t *) 0;
+	}
+
+	if (!is_left_const && !is_right_const)
+		return (cg_virtual_reg_t *) 0;
+
+	switch (inst->base.opcode)
+	{
+		case cg_op_sub:
+		case cg_op_fsub:
+		case cg_op_lsl:
+		case cg_op_lsr:
+		case cg_op_asr:
+			if (is_right_const && right == 0)
+				copy = inst->binary.source;
+
+			break;
+
+		case cg_op_add:
+		case cg_op_fadd:
+		case cg_op_or:
+		case cg_op_xor:
+			if (is_right_const && right == 0)
+				copy = inst->binary.source;
+			else if (is_left_const && left == 0)
+				copy = inst->binary.operand.source;
+
+			break;
+
+		case cg_op_and:
+		case cg_op_mul:
+			if ((is_right_const && right == 0) || (is_left_const && left == 0))
+			{
+				make_load_immed(inst, dest, 0);
+				return (cg_virtual_reg_t *) 0;
+			}
+
+			if (inst->base.opcode == cg_op_and ? 
+				(is_right_const && right == ~0) : (is_right_const && right == 1))
+				copy = inst->binary.source;
+			else if (inst->base.opcode == cg_op_and ? 
+				(is_left_const && left == ~0) : (is_left_const && left == 1))
+				copy = inst->binary.operand.source;
+
+			break;
+
+		default:
+			break;
+	}
+
+	if (copy && 
+		(CG_BITSET_TEST(pinned, dest->reg_no) || CG_BITSET_TEST(pinned, copy->reg_no)))
+		copy = (cg_virtual_reg_t *) 0;
+
+	return copy;
+}
+
+
+static void proc_fold_constants(cg_proc_t * proc)
+{
+	cg_bitset_t * pinned = proc_phi_registers(proc);
+	cg_virtual_reg_t ** subst = proc_create_subst(proc);
+	cg_block_t * block;
+	cg_inst_t * inst;
+
+	/************************************************************************/
+	/* Definitions are visited before their uses, except for the operands	*/
+	/* of phi instructions, so a single pass propagates constants along		*/
+	/* chains of instructions. Copies are left to dead code elimination.	*/
+	/************************************************************************/
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		for (inst = block->insts.head; inst; inst = inst->base.next)
+		{
+			cg_virtual_reg_t * copy;
+
+			inst_subst_uses(inst, subst);
+			copy = inst_fold_constants(inst, pinned);
+
+			if (copy)
+				subst[inst->binary.dest_value->reg_no] = copy;
+		}
+	}
+
+	proc_subst_uses(proc, subst);
+}
+
+
+void cg_module_fold_constants(cg_module_t * module)
+{
+	cg_proc_t * proc;
+
+	for (proc = module->procs; proc; proc = proc->next)
+		proc_fold_constants(proc);
+}
+
+
+/****************************************************************************/
+/* Determine the register holding the value of an instruction that can		*/
+/* take part in common subexpression elimination, or NULL.					*/
+/****************************************************************************/
+static cg_virtual_reg_t * expression_dest(const cg_inst_t * inst, cg_bitset_t * pinned)
+{
+	cg_virtual_reg_t * dest;
+
+	switch (inst->base.kind)
+	{
+		case cg_inst_unary:
+			if (inst->unary.dest_flags)
+				return (cg_virtual_reg_t *) 0;
+
+			dest = inst->unary.dest_value;
+			break;
+
+		case cg_inst_binary:
+			if (inst->binary.dest_flags)
+				return (cg_virtual_reg_t *) 0;
+
+			dest = inst->binary.dest_value;
+			break;
+
+		case cg_inst_load:
+			if (!is_readonly_load(inst))
+				return (cg_virtual_reg_t *) 0;
+
+			dest = inst->load.dest;
+			break;
+
+		case cg_inst_load_immed:
+			dest = inst->immed.dest;
+			break;
+
+		default:
+			return (cg_virtual_reg_t *) 0;
+	}
+
+	if (CG_BITSET_TEST(pinned, dest->reg_no) || uses_phi_registers(inst, pinned))
+		return (cg_virtual_reg_t *) 0;
+
+	return dest;
+}
+
+
+static int is_commutative(cg_opcode_t opcode)
+{
+	switch (opcode)
+	{
+		case cg_op_add:
+		case cg_op_and:
+		case cg_op_or:
+		case cg_op_xor:
+		case cg_op_mul:
+		case cg_op_min:
+		case cg_op_max:
+		case cg_op_fadd:
+		case cg_op_fmul:
+			return 1;
+
+		default:
+			return 0;
+	}
+}
+
+
+static size_t expression_hash(const cg_inst_t * inst, cg_bitset_t * pinned)
+{
+	size_t hash = inst->base.opcode;
+	cg_virtual_reg_t * base;
+	I32 offset;
+
+	switch (inst->base.kind)
+	{
+		case cg_inst_unary:
+			hash += inst->unary.operand.source->reg_no * 7;
+			break;
+
+		case cg_inst_binary:
+			hash += (inst->binary.source->reg_no + inst->binary.operand.source->reg_no) * 7;
+			break;
+
+		case cg_inst_load:
+			base = load_address(inst, pinned, &offset);
+			hash += base->reg_no * 7 + (U32) offset;
+			break;
+
+		case cg_inst_load_immed:
+			hash += (U32) inst->immed.value;
+			break;
+
+		default:
+			assert(0);
+	}
+
+	return hash % CG_EXPRESSION_BUCKETS;
+}
+
+
+static int is_same_expression(const cg_inst_t * first, const cg_inst_t * second,
+							  cg_bitset_t * pinned)
+{
+	I32 first_offset, second_offset;
+
+	if (first->base.kind != second->base.kind ||
+		first->base.opcode != second->base.opcode)
+		return 0;
+
+	switch (first->base.kind)
+	{
+		case cg_inst_unary:
+			return first->unary.operand.source == second->unary.operand.source;
+
+		case cg_inst_binary:
+			return 
+				(first->binary.source == second->binary.source &&
+				 first->binary.operand.source == second->binary.operand.source) ||
+				(is_commutative(first->base.opcode) &&
+				 first->binary.source == second->binary.operand.source &&
+				 first->binary.operand.source == second->binary.source);
+
+		case cg_inst_load:
+			return 
+				load_address(first, pinned, &first_offset) == load_address(second, pinned, &second_offset) &&
+				first_offset == second_offset;
+
+		case cg_inst_load_immed:
+			return first->immed.value == second->immed.value;
+
+		default:
+			return 0;
+	}
+}
+
+
+/****************************************************************************/
+/* Values that cross a block boundary live in the stack frame unless they	*/
+/* get a global register, so only memory loads and constants that take		*/
+/* more than a single instruction are worth reusing across blocks.			*/
+/****************************************************************************/
+static int is_worth_reusing_across_blocks(const cg_inst_t * inst)
+{
+	return inst->base.kind == cg_inst_load ||
+		(inst->base.kind == cg_inst_load_immed && !is_cheap_constant(inst->immed.value));
+}
+
+
+static void proc_eliminate_common_subexpressions(cg_proc_t * proc)
+{
+	cg_bitset_t * pinned = proc_phi_registers(proc);
+	cg_virtual_reg_t ** subst = proc_create_subst(proc);
+	cg_inst_list_t * buckets[CG_EXPRESSION_BUCKETS];
+	cg_block_t * block;
+	cg_inst_t * inst;
+
+	memset(buckets, 0, sizeof buckets);
+
+	proc_controlflow(proc);
+	proc_dominators(proc);
+
+	/************************************************************************/
+	/* Blocks are laid out such that dominators precede the blocks they		*/
+	/* dominate, so any earlier expression that is available has been		*/
+	/* recorded by the time an instruction is visited.						*/
+	/************************************************************************/
+
+	for (block = proc->blocks; block; block = block->next)
+	{
+		for (inst = block->insts.head; inst; inst = inst->base.next)
+		{
+			cg_virtual_reg_t * dest;
+			cg_inst_list_t * list;
+			size_t hash;
+
+			inst_subst_uses(inst, subst);
+			dest = expression_dest(inst, pinned);
+
+			if (!dest)
+				continue;
+
+			hash = expression_hash(inst, pinned);
+
+			for (list = buckets[hash]; list; list = list->next)
+			{
+				cg_inst_t * other = list->inst;
+
+				if (!is_same_expression(other, inst, pinned))
+					continue;
+
+				if (other->base.block == block ||
+					(CG_BITSET_TEST(block->dom, other->base.block->index) &&
+					 is_worth_reusing_across_blocks(inst)))
+					break;
+			}
+
+			if (list)
+			{
+				subst[dest->reg_no] = expression_dest(list->inst, pinned);
+			}
+			else
+			{
+				list = (cg_inst_list_t *) cg_heap_allocate(proc->module->heap, sizeof(cg_inst_list_t));
+				list->inst = inst;
+				list->next = buckets[hash];
+				buckets[hash] = list;
+			}
+		}
+	}
+
+	proc_subst_uses(proc, subst);
+}
+
+
+void cg_module_eliminate_common_subexpressions(cg_module_t * module)
+{
+	cg_proc_t * proc;
+
+	for (proc = module->procs; proc; proc = proc->next)
+		proc_eliminate_common_subexpressions(proc);
+}
+
+
+/****************************************************************************/
+/* Only instructions that cannot fault and that leave the flags untouched	*/
+/* are moved, as they are executed even if the loop body is not.			*/
+/****************************************************************************/
+static int is_hoistable(const cg_inst_t * inst, cg_bitset_t * pinned)
+{
+	cg_virtual_reg_t * dest;
+
+	switch (inst->base.kind)
+	{
+		case cg_inst_unary:
+			switch (inst->base.opcode)
+			{
+				case cg_op_neg:
+				case cg_op_fneg:
+				case cg_op_not:
+					break;
+
+				default:
+					return 0;
+			}
+
+			if (inst->unary.dest_flags)
+				return 0;
+
+			dest = inst->unary.dest_value;
+			break;
+
+		case cg_inst_binary:
+			switch (inst->base.opcode)
+			{
+				case cg_op_add:
+				case cg_op_sub:
+				case cg_op_and:
+				case cg_op_or:
+				case cg_op_xor:
+				case cg_op_lsl:
+				case cg_op_lsr:
+				case cg_op_asr:
+				case cg_op_mul:
+				case cg_op_fadd:
+				case cg_op_fsub:
+				case cg_op_fmul:
+					break;
+
+				default:
+					return 0;
+			}
+
+			if (inst->binary.dest_flags)
+				return 0;
+
+			dest = inst->binary.dest_value;
+			break;
+
+		case cg_inst_load:
+			if (!is_readonly_load(inst))
+				return 0;
+
+			dest = inst->load.dest;
+			break;
+
+		case cg_inst_load_immed:
+			dest = inst->immed.dest;
+			break;
+
+		default:
+			return 0;
+	}
+
+	return !CG_BITSET_TEST(pinned, dest->reg_no);
 }
 
 
-static void find_union(cg_virtual_reg_t * first, cg_virtual_reg_t * second)
+static int is_loop_invariant(const cg_inst_t * inst, cg_bitset_t * pinned,
+							 size_t first, size_t last)
 {
-	cg_virtual_reg_t * first_set = find_set(first);
-	cg_virtual_reg_t * second_set = find_set(second);
+	cg_virtual_reg_t * buffer[64];
+	cg_virtual_reg_t **iter, ** end = cg_inst_use(inst, buffer, buffer + 64);
 
-	second_set->representative = first_set;
+	for (iter = buffer; iter != end; ++iter)
+	{
+		cg_virtual_reg_t * reg = *iter;
+
+		if (CG_BITSET_TEST(pinned, reg->reg_no))
+			return 0;
+
+		if (reg->def && 
+			reg->def->base.block->index >= first && reg->def->base.block->index <= last)
+			return 0;
+	}
+
+	return 1;
 }
 
 
-void cg_module_unify_registers(cg_module_t * module)
+static int is_branch(const cg_inst_t * inst)
 {
-	cg_proc_t * proc;
-	cg_block_t * block;
-	cg_inst_t * inst;
-	cg_virtual_reg_t * reg;
+	return inst->base.kind == cg_inst_branch_label || inst->base.kind == cg_inst_branch_cond;
+}
 
-	for (proc = module->procs; proc; proc = proc->next)
-	{
-		/********************************************************************/
-		/* Initialize all registers as being distinct						*/
-		/********************************************************************/
 
-		for (reg = proc->registers; reg; reg = reg->next)
-		{
-			reg->representative = reg;
-		}
+/****************************************************************************/
+/* Loads may only be moved out of blocks that are executed on every path	*/
+/* through the loop, i.e. that dominate each block leaving the loop. Any	*/
+/* other block may be skipped by a condition that guards the load.			*/
+/****************************************************************************/
+static cg_bitset_t * loop_unconditional_blocks(cg_proc_t * proc, cg_block_t ** blocks,
+											   size_t first, size_t last)
+{
+	cg_bitset_t * result = cg_bitset_create(proc->module->heap, blocks[first]->dom->elements);
+	cg_block_list_t * list;
+	size_t index;
 
-		/********************************************************************/
-		/* Perform union-find for all registers that occur in a phi			*/
-		/* instruction														*/
-		/********************************************************************/
+	for (index = first; index <= last; ++index)
+		CG_BITSET_SET(result, index);
 
-		for (block = proc->blocks; block; block = block->next)
+	for (index = first; index <= last; ++index)
+	{
+		for (list = blocks[index]->succ; list; list = list->next)
 		{
-			cg_virtual_reg_list_t * list;
-
-			for (inst = block->insts.head; inst && inst->base.opcode == cg_op_phi; 
-				 inst = inst->base.next)
+			if (list->block->index < first || list->block->index > last)
 			{
-				for (list = inst->phi.regs; list; list = list->next)
-				{
-					find_union(inst->phi.dest, list->reg);
-				}
+				cg_bitset_intersect(result, blocks[index]->dom);
+				break;
 			}
 		}
-
-		/********************************************************************/
-		/* Flatten out indirections so that there is at most one level of	*/
-		/* indirection between any register and its representative			*/
-		/********************************************************************/
-
-		for (reg = proc->registers; reg; reg = reg->next)
-		{
-			find_set(reg);
-		}
 	}
-}
 
+	return result;
+}
 
 
-static void proc_inst_def(cg_proc_t * proc)
+/****************************************************************************/
+/* Move the invariant instructions of the loop formed by the blocks first	*/
+/* to last (in block order) into the single block entering the loop.		*/
+/****************************************************************************/
+static void proc_hoist_loop(cg_proc_t * proc, cg_block_t ** blocks, 
+							size_t first, size_t last, cg_bitset_t * pinned)
 {
-	cg_virtual_reg_t * reg;
-	cg_block_t * block;
-	cg_inst_t * inst;
+	cg_block_t * header = blocks[first], * preheader = (cg_block_t *) 0;
+	cg_block_list_t * list;
+	cg_inst_t ** insert = (cg_inst_t **) 0, ** pinst, * inst;
+	cg_bitset_t * unconditional;
+	size_t index;
+	int changed;
 
 	/************************************************************************/
-	/* Clear out def and use information associated with virtual registers	*/
+	/* The loop may only be entered through its header						*/
 	/************************************************************************/
 
-	for (reg = proc->registers; reg; reg = reg->next)
+	for (index = first; index <= last; ++index)
 	{
-		reg->def = (cg_inst_t *) 0;
-		reg->use = (cg_inst_list_t *) 0;
+		for (list = blocks[index]->pred; list; list = list->next)
+		{
+			if (list->block->index >= first && list->block->index <= last)
+				continue;
+
+			if (index != first || (preheader && preheader != list->block))
+				return;
+
+			preheader = list->block;
+		}
 	}
 
+	if (!preheader)
+		return;
+
 	/************************************************************************/
-	/* Add def and use information for each register						*/
+	/* Hoisted instructions go in front of the branches ending the			*/
+	/* preheader, which must not branch to the header any earlier			*/
 	/************************************************************************/
 
-	for (block = proc->blocks; block; block = block->next)
+	for (pinst = &preheader->insts.head; *pinst; pinst = &(*pinst)->base.next)
 	{
-		for (inst = block->insts.head; inst; inst = inst->base.next)
+		if (!is_branch(*pinst))
+			insert = (cg_inst_t **) 0;
+		else if (!insert)
+			insert = pinst;
+	}
+
+	if (!insert)
+		insert = pinst;
+
+	for (inst = preheader->insts.head; inst != *insert; inst = inst->base.next)
+	{
+		if (is_branch(inst) && inst->branch.target->block == header)
+			return;
+	}
+
+	unconditional = loop_unconditional_blocks(proc, blocks, first, last);
+
+	do
+	{
+		changed = 0;
+
+		for (index = first; index <= last; ++index)
 		{
-			cg_virtual_reg_t * buffer[64];
-			cg_virtual_reg_t **iter, ** end = cg_inst_def(inst, buffer, buffer + 64);
+			cg_block_t * block = blocks[index];
 
-			for (iter = buffer; iter != end; ++iter)
+			for (pinst = &block->insts.head; *pinst; )
 			{
-				cg_virtual_reg_t * reg = *iter;
-				assert(reg->def == (cg_inst_t *) 0);
-				reg->def = inst;
+				inst = *pinst;
+
+				if (!is_hoistable(inst, pinned) || 
+					!is_loop_invariant(inst, pinned, first, last) ||
+					(inst->base.kind == cg_inst_load && !CG_BITSET_TEST(unconditional, index)))
+				{
+					pinst = &inst->base.next;
+					continue;
+				}
+
+				*pinst = inst->base.next;
+
+				inst->base.block = preheader;
+				inst->base.next = *insert;
+				*insert = inst;
+				insert = &inst->base.next;
+
+				changed = 1;
 			}
+
+			block_update_tail(block);
 		}
 	}
-}
-
-
-void cg_module_inst_def(cg_module_t * module)
-{
-	cg_proc_t * proc;
+	while (changed);
 
-	for (proc = module->procs; proc; proc = proc->next)
-		proc_inst_def(proc);
+	block_update_tail(preheader);
 }
 
 
-static void proc_inst_use_chains(cg_proc_t * proc)
+static void proc_hoist_invariants(cg_proc_t * proc)
 {
-	cg_virtual_reg_t * reg;
-	cg_block_t * block;
-	cg_inst_t * inst;
+	cg_bitset_t * pinned = proc_phi_registers(proc);
+	size_t count = proc_number_blocks(proc), span;
+	cg_block_t ** blocks, * block;
+	cg_block_list_t * list;
 
-	/************************************************************************/
-	/* Clear out def and use information associated with virtual registers	*/
-	/************************************************************************/
+	blocks = (cg_block_t **) cg_heap_allocate(proc->module->heap, sizeof(cg_block_t *) * count);
 
-	for (reg = proc->registers; reg; reg = reg->next)
-	{
-		reg->def = (cg_inst_t *) 0;
-		reg->use = (cg_inst_list_t *) 0;
-	}
+	for (block = proc->blocks; block; block = block->next)
+		blocks[block->index] = block;
+
+	proc_controlflow(proc);
+	proc_dominators(proc);
 
 	/************************************************************************/
-	/* Add def qand use information for each register						*/
+	/* A branch back to an earlier block closes a loop. Loops are processed */
+	/* from the innermost outwards, so that instructions hoisted out of an	*/
+	/* inner loop can move further out of the enclosing one.				*/
 	/************************************************************************/
 
-	for (block = proc->blocks; block; block = block->next)
+	for (span = 0; span < count; ++span)
 	{
-		for (inst = block->insts.head; inst; inst = inst->base.next)
+		for (block = proc->blocks; block; block = block->next)
 		{
-			cg_virtual_reg_t * buffer[64];
-			cg_virtual_reg_t **iter, ** end = cg_inst_use(inst, buffer, buffer + 64);
-
-			for (iter = buffer; iter != end; ++iter)
+			for (list = block->succ; list; list = list->next)
 			{
-				cg_virtual_reg_t * reg = *iter;
-				cg_inst_list_t * list = cg_heap_allocate(proc->module->heap, sizeof(cg_inst_list_t));
-				list->inst = inst;
-				list->next = reg->use;
-				reg->use = list;
+				if (list->block->index + span == block->index)
+					proc_hoist_loop(proc, blocks, list->block->index, block->index, pinned);
 			}
 		}
 	}
 }
 
 
-void cg_module_inst_use_chains(cg_module_t * module)
+void cg_module_hoist_invariants(cg_module_t * module)
 {
 	cg_proc_t * proc;
 
 	for (proc = module->procs; proc; proc = proc->next)
-		proc_inst_use_chains(proc);
+		proc_hoist_invariants(proc);
 }
 
 
@@ -1880,12 +2895,249 @@ static void inst_list_append(cg_inst_list_head_t * insts, cg_inst_t * inst)
 }
 
 
-static void block_reschedule(cg_block_t * block, cg_inst_list_head_t * insts)
+/****************************************************************************/
+/* Instruction scheduling													*/
+/*																			*/
+/* The instructions between two branches are reordered by a list scheduler	*/
+/* so that loads and multiplies are issued ahead of the instructions that	*/
+/* consume their results. Registers of a phi class share their storage,		*/
+/* so dependencies are tracked on the representatives, and all flags		*/
+/* registers are treated as a single resource.								*/
+/****************************************************************************/
+
+typedef struct sched_node_t
+{
+	cg_inst_t *					inst;
+	cg_virtual_reg_t *			uses[64];
+	cg_virtual_reg_t **			uses_end;
+	cg_virtual_reg_t *			defs[64];
+	cg_virtual_reg_t **			defs_end;
+	int							latency;		/* cycles until result is available */
+	int							height;			/* longest latency path to the end	*/
+	int							earliest;		/* cycle when operands are ready	*/
+	int							num_preds;		/* unscheduled predecessors			*/
+}
+sched_node_t;
+
+
+static int inst_latency(const cg_inst_t * inst, const cg_latency_info_t * latency)
+{
+	switch (inst->base.opcode)
+	{
+	case cg_op_ldw:		return latency->load_word;
+	case cg_op_ldb:
+	case cg_op_ldh:		return latency->load_byte;
+	case cg_op_mul:		return latency->multiply;
+	case cg_op_fmul:	return latency->multiply_fixed;
+	default:			return 1;
+	}
+}
+
+
+static int sched_key(const cg_virtual_reg_t * reg)
+{
+	if (reg->type == cg_reg_type_flags)
+		return -1;
+
+	return reg->representative ? reg->representative->reg_no : reg->reg_no;
+}
+
+
+static int sched_conflict(cg_virtual_reg_t * const * first, cg_virtual_reg_t * const * first_end,
+						  cg_virtual_reg_t * const * second, cg_virtual_reg_t * const * second_end)
+{
+	cg_virtual_reg_t * const * iter, * const * other;
+
+	for (iter = first; iter != first_end; ++iter)
+		for (other = second; other != second_end; ++other)
+			if (sched_key(*iter) == sched_key(*other))
+				return 1;
+
+	return 0;
+}
+
+
+static int sched_dependency(const sched_node_t * first, const sched_node_t * second)
+	/************************************************************************/
+	/* Determine the number of cycles second has to be issued after first,	*/
+	/* or 0 if the two instructions can be reordered freely					*/
+	/************************************************************************/
+{
+	cg_inst_kind_t first_kind = first->inst->base.kind;
+	cg_inst_kind_t second_kind = second->inst->base.kind;
+
+	if (sched_conflict(first->defs, first->defs_end, second->uses, second->uses_end))
+		return first->latency;
+
+	if (sched_conflict(first->uses, first->uses_end, second->defs, second->defs_end) ||
+		sched_conflict(first->defs, first->defs_end, second->defs, second->defs_end))
+		return 1;
+
+	/************************************************************************/
+	/* Memory accesses keep their order unless one of them is a load from	*/
+	/* read-only memory														*/
+	/************************************************************************/
+
+	if (first_kind == cg_inst_call || second_kind == cg_inst_call)
+		return (first_kind == cg_inst_call || first_kind == cg_inst_load || first_kind == cg_inst_store) &&
+			(second_kind == cg_inst_call || second_kind == cg_inst_load || second_kind == cg_inst_store);
+
+	if ((first_kind == cg_inst_store && second_kind == cg_inst_store) ||
+		(first_kind == cg_inst_store && second_kind == cg_inst_load && !is_readonly_load(second->inst)) ||
+		(first_kind == cg_inst_load && second_kind == cg_inst_store && !is_readonly_load(first->inst)))
+		return 1;
+
+	return 0;
+}
+
+
+static void block_reschedule(cg_block_t * block, cg_inst_list_head_t * insts, 
+							 const cg_latency_info_t * latency)
 {
+	sched_node_t * nodes;
+	U8 * deps;
+	cg_inst_t * inst, * last = NULL;
+	size_t num_nodes = 0, index, other, count;
+	int cycle = 0;
+
+	/************************************************************************/
+	/* A branch or return terminating the sequence stays in place			*/
+	/************************************************************************/
+
+	switch (insts->tail->base.kind)
+	{
+	case cg_inst_branch_label:
+	case cg_inst_branch_cond:
+	case cg_inst_ret:
+		last = insts->tail;
+		break;
+
+	default:
+		break;
+	}
+
+	for (inst = insts->head; inst != last; inst = inst->base.next)
+		++num_nodes;
+
+	if (num_nodes < 2)
+	{
+		for (inst = insts->head; inst; )
+		{
+			cg_inst_t * next = inst->base.next;
+			inst_list_append(&block->insts, inst);
+			inst = next;
+		}
+
+		return;
+	}
+
+	nodes = (sched_node_t *) malloc(num_nodes * sizeof(sched_node_t));
+	deps = (U8 *) malloc(num_nodes * num_nodes);
+
+	for (inst = insts->head, index = 0; inst != last; inst = inst->base.next, ++index)
+	{
+		sched_node_t * node = nodes + index;
+
+		node->inst = inst;
+		node->uses_end = cg_inst_use(inst, node->uses, node->uses + 64);
+		node->defs_end = cg_inst_def(inst, node->defs, node->defs + 64);
+		node->latency = inst_latency(inst, latency);
+		node->earliest = 0;
+		node->num_preds = 0;
+	}
+
+	/************************************************************************/
+	/* Build the dependency graph and determine the critical path length	*/
+	/* from each instruction to the end of the sequence						*/
+	/************************************************************************/
+
+	for (index = 0; index < num_nodes; ++index)
+	{
+		for (other = 0; other < num_nodes; ++other)
+		{
+			deps[index * num_nodes + other] = (U8)
+				(other > index ? sched_dependency(nodes + index, nodes + other) : 0);
+
+			if (deps[index * num_nodes + other])
+				++nodes[other].num_preds;
+		}
+	}
+
+	for (index = num_nodes; index-- > 0; )
+	{
+		nodes[index].height = nodes[index].latency;
+
+		for (other = index + 1; other < num_nodes; ++other)
+		{
+			int dep = deps[index * num_nodes + other];
+
+			if (dep && dep + nodes[other].height > nodes[index].height)
+				nodes[index].height = dep + nodes[other].height;
+		}
+	}
+
+	/************************************************************************/
+	/* Issue instructions cycle by cycle. Among the instructions whose		*/
+	/* operands are available, the one on the longest path goes first; if	*/
+	/* there is none, the one that becomes available soonest is issued.		*/
+	/************************************************************************/
+
+	for (count = 0; count < num_nodes; ++count)
+	{
+		sched_node_t * best = NULL;
+		int best_ready = 0;
+
+		for (index = 0; index < num_nodes; ++index)
+		{
+			sched_node_t * node = nodes + index;
+			int ready;
+
+			if (node->num_preds != 0)
+				continue;
+
+			ready = node->earliest <= cycle;
+
+			if (best == NULL || ready > best_ready ||
+				(ready && best_ready && node->height > best->height) ||
+				(!ready && !best_ready && node->earliest < best->earliest))
+			{
+				best = node;
+				best_ready = ready;
+			}
+		}
+
+		if (best->earliest > cycle)
+			cycle = best->earliest;
+
+		index = best - nodes;
+		best->num_preds = -1;
+		inst_list_append(&block->insts, best->inst);
+
+		for (other = index + 1; other < num_nodes; ++other)
+		{
+			int dep = deps[index * num_nodes + other];
+
+			if (dep)
+			{
+				--nodes[other].num_preds;
+
+				if (cycle + dep > nodes[other].earliest)
+					nodes[other].earliest = cycle + dep;
+			}
+		}
+
+		++cycle;
+	}
+
+	if (last)
+		inst_list_append(&block->insts, last);
+
+	free(deps);
+	free(nodes);
 }
 
 
-static void block_reorder_instructions(cg_block_t * block)
+static void block_reorder_instructions(cg_block_t * block, const cg_latency_info_t * latency)
 {
 	// phi, branch, ret have to stay in order
 
@@ -1923,12 +3175,12 @@ static void block_reorder_instructions(cg_block_t * block)
 			last_inst->base.opcode != cg_op_bra &&
 			last_inst->base.opcode != cg_op_ret);
 
-		block_reschedule(block, &temp_list);
+		block_reschedule(block, &temp_list, latency);
 	}
 }
 
 
-void cg_module_reorder_instructions(cg_module_t * module)
+void cg_module_reorder_instructions(cg_module_t * module, const cg_latency_info_t * latency)
 {
 	cg_proc_t * proc;
 	cg_block_t * block;
@@ -1937,7 +3189,7 @@ void cg_module_reorder_instructions(cg_module_t * module)
 	{
 		for (block = proc->blocks; block; block = block->next) 
 		{
-			block_reorder_instructions(block);
+			block_reorder_instructions(block, latency);
 		}
 	}
 }
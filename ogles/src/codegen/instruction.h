@@ -311,6 +311,8 @@ struct cg_block_t
 	struct cg_bitset_t *	live_out;		/* set of regs live on leaving  */
 	cg_block_list_t *		pred;			/* list of predecessor blocks	*/
 	cg_block_list_t *		succ;			/* list of successor blocks		*/
+	struct cg_bitset_t *	dom;			/* set of dominating blocks		*/
+	size_t					index;			/* position within procedure	*/
 	int						weight;			/* weighting factor for block	*/
 };
 
@@ -354,6 +356,7 @@ struct cg_virtual_reg_t
 	short						def_cost;			/* definition cost				*/
 	int							is_global : 1;		/* is this a global register?   */
 	int							is_arg : 1;			/* is passed in as argument val.*/
+	int							is_readonly : 1;	/* points to read-only memory	*/
 };
 
 
@@ -618,18 +621,35 @@ cg_inst_t * cg_create_inst_ret_value(cg_block_t * block,
 cg_block_ref_t * cg_block_ref_create(cg_proc_t * proc);
 
 
+/****************************************************************************/
+/* Latency model of the target processor used for instruction scheduling	*/
+/****************************************************************************/
+
+typedef struct cg_latency_info_t 
+{
+	int		load_word;			/* cycles until a loaded word can be used	*/
+	int		load_byte;			/* same for bytes and half words			*/
+	int		multiply;			/* cycles until a product can be used		*/
+	int		multiply_fixed;		/* same for fixed point multiplication		*/
+}
+cg_latency_info_t;
+
+
 /****************************************************************************/
 /* The intermediate code needs to be processed by the following				*/
 /* functions in this given order											*/
 /****************************************************************************/
 
 void cg_module_inst_def(cg_module_t * module);
+void cg_module_fold_constants(cg_module_t * module);
+void cg_module_hoist_invariants(cg_module_t * module);
+void cg_module_eliminate_common_subexpressions(cg_module_t * module);
 void cg_module_amode(cg_module_t * module);
 void cg_module_eliminate_dead_code(cg_module_t * module);
 void cg_module_unify_registers(cg_module_t * module);
 void cg_module_allocate_variables(cg_module_t * module);
 void cg_module_inst_use_chains(cg_module_t * module);
-void cg_module_reorder_instructions(cg_module_t * module);
+void cg_module_reorder_instructions(cg_module_t * module, const cg_latency_info_t * latency);
 void cg_module_dataflow(cg_module_t * module);
 void cg_module_interferences(cg_module_t * module);
 
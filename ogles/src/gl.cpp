@@ -621,3 +621,20 @@ GLAPI void APIENTRY glViewport (GLint x, GLint y, GLsizei width, GLsizei height)
 GLAPI void APIENTRY glPointSizePointerOES(GLenum type, GLsizei stride, const GLvoid *pointer) {
 	CONTEXT_EXEC(PointSizePointer(type, stride, pointer));
 }
+
+/* OES_matrix_palette */
+GLAPI void APIENTRY glCurrentPaletteMatrixOES(GLuint matrixpaletteindex) {
+	CONTEXT_EXEC(CurrentPaletteMatrix(matrixpaletteindex));
+}
+
+GLAPI void APIENTRY glLoadPaletteFromModelViewMatrixOES(void) {
+	CONTEXT_EXEC(LoadPaletteFromModelViewMatrix());
+}
+
+GLAPI void APIENTRY glMatrixIndexPointerOES(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer) {
+	CONTEXT_EXEC(MatrixIndexPointer(size, type, stride, pointer));
+}
+
+GLAPI void APIENTRY glWeightPointerOES(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer) {
+	CONTEXT_EXEC(WeightPointer(size, type, stride, pointer));
+}
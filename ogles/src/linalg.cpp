@@ -58,6 +58,118 @@ namespace {
 	}
 }
 
+#if EGL_USE_SIMD_MATRIX
+
+// --------------------------------------------------------------------------
+// Vector version of the 3x3 inverse below; the nine 2x2 determinants and
+// the scaling of the adjoint are computed four elements at a time. Each
+// cofactor (row, column) is the determinant of the elements a, b, c, d
+// given as indices into m_elements.
+// --------------------------------------------------------------------------
+
+namespace {
+	struct Cofactor {
+		U8	row, column;
+		I8	sign;
+		U8	a, b, c, d;
+	};
+
+#	define INDEX(row, column) ((row) + (column) * 4)
+
+	const Cofactor cofactors[9] = {
+		{ 0, 0,  1, INDEX(1,1), INDEX(1,2), INDEX(2,1), INDEX(2,2) },
+		{ 0, 1, -1, INDEX(1,0), INDEX(1,2), INDEX(2,0), INDEX(2,2) },
+		{ 0, 2,  1, INDEX(1,0), INDEX(1,1), INDEX(2,0), INDEX(2,1) },
+		{ 1, 0, -1, INDEX(0,1), INDEX(0,2), INDEX(2,1), INDEX(2,2) },
+		{ 1, 1,  1, INDEX(0,0), INDEX(0,2), INDEX(2,0), INDEX(2,2) },
+		{ 1, 2, -1, INDEX(0,0), INDEX(0,1), INDEX(2,0), INDEX(2,1) },
+		{ 2, 0,  1, INDEX(0,1), INDEX(0,2), INDEX(1,1), INDEX(1,2) },
+		{ 2, 1, -1, INDEX(0,0), INDEX(0,2), INDEX(1,0), INDEX(1,2) },
+		{ 2, 2,  1, INDEX(0,0), INDEX(0,1), INDEX(1,0), INDEX(1,1) },
+	};
+
+#	undef INDEX
+}
+
+Matrix4x4 Matrix4x4 :: InverseUpper3(bool rescale) const {
+
+	Matrix4x4 result;
+
+	// operands of the determinants, padded to a multiple of 4
+	EGL_Fixed a[12], b[12], c[12], d[12], ad[12], cb[12], adjoint[12];
+	int i;
+
+	for (i = 0; i < 12; ++i) {
+		if (i < 9) {
+			a[i] = m_elements[cofactors[i].a];
+			b[i] = m_elements[cofactors[i].b];
+			c[i] = m_elements[cofactors[i].c];
+			d[i] = m_elements[cofactors[i].d];
+		} else {
+			a[i] = b[i] = c[i] = d[i] = 0;
+		}
+	}
+
+	for (i = 0; i < 12; i += 4) {
+		EGL_Mul4(a + i, d + i, ad + i);
+		EGL_Mul4(c + i, b + i, cb + i);
+	}
+
+	for (i = 0; i < 9; ++i) {
+		EGL_Fixed det = ad[i] - cb[i];
+		adjoint[i] = cofactors[i].sign > 0 ? det : -det;
+		result.Element(cofactors[i].row, cofactors[i].column) = adjoint[i];
+	}
+
+	adjoint[9] = adjoint[10] = adjoint[11] = 0;
+
+	// determinant; the first row of the adjoint lines up with the first row
+	// of this matrix
+	EGL_Fixed row[4] = { Element(0, 0), Element(0, 1), Element(0, 2), 0 };
+	EGL_Fixed products[4];
+
+	EGL_Mul4(row, adjoint, products);
+	EGL_Fixed det = products[0] + products[1] + products[2];
+
+	if (det == 0) {
+		// singluar matrix
+		return result;
+	}
+
+	EGL_Fixed r = EGL_Inverse(det);
+	EGL_Fixed factors[4] = { r, r, r, r };
+
+	for (i = 0; i < 12; i += 4) {
+		EGL_Mul4(adjoint + i, factors, adjoint + i);
+	}
+
+	for (i = 0; i < 9; ++i) {
+		result.Element(cofactors[i].row, cofactors[i].column) = adjoint[i];
+	}
+
+	result.m_identity = false;
+
+	if (rescale) {
+		EGL_Fixed row2[4] = { result.Element(2, 0), result.Element(2, 1), result.Element(2, 2), 0 };
+		EGL_Mul4(row2, row2, products);
+
+		EGL_Fixed sumOfSquares = products[0] + products[1] + products[2];
+
+		if (sumOfSquares != EGL_ONE) {
+			EGL_Fixed factor = EGL_InvSqrt(sumOfSquares);
+			factors[0] = factors[1] = factors[2] = factors[3] = factor;
+
+			for (i = 0; i < ELEMENTS; i += 4) {
+				EGL_Mul4(result.m_elements + i, factors, result.m_elements + i);
+			}
+		}
+	}
+
+	return result;
+}
+
+#else
+
 Matrix4x4 Matrix4x4 :: InverseUpper3(bool rescale) const {
 
 	Matrix4x4 result;
@@ -120,6 +232,8 @@ Matrix4x4 Matrix4x4 :: InverseUpper3(bool rescale) const {
 	return result;
 }
 
+#endif
+
 
 #define SWAP_ROWS(a, b) { EGL_Fixed *_tmp = a; (a)=(b); (b)=_tmp; }
 
@@ -344,3 +458,176 @@ Matrix4x4 Matrix4x4 :: CreateOrtho(EGL_Fixed l, EGL_Fixed r,
 	matrix.m_identity = false;
 	return matrix;
 }
+
+
+#if EGL_USE_FLOAT_VERTEX
+
+// --------------------------------------------------------------------------
+// Floating point matrices
+//
+// These follow the fixed point versions above, and are used to carry the
+// parameters of the floating point API functions into the floating point
+// vertex pipeline without loss of precision or range.
+// --------------------------------------------------------------------------
+
+Matrix4x4f Matrix4x4f :: InverseUpper3(bool rescale) const {
+
+	Matrix4x4f result;
+
+	// compute 3x3 inverse using Cramer's rule: A^-1 = adj(A)/det(A); as
+	// for the fixed point version, the result is the transposed inverse
+	result.Element(0,0) = Element(1,1) * Element(2,2) - Element(2,1) * Element(1,2);
+	result.Element(0,1) = Element(2,0) * Element(1,2) - Element(1,0) * Element(2,2);
+	result.Element(0,2) = Element(1,0) * Element(2,1) - Element(2,0) * Element(1,1);
+
+	result.Element(1,0) = Element(2,1) * Element(0,2) - Element(0,1) * Element(2,2);
+	result.Element(1,1) = Element(0,0) * Element(2,2) - Element(2,0) * Element(0,2);
+	result.Element(1,2) = Element(2,0) * Element(0,1) - Element(0,0) * Element(2,1);
+
+	result.Element(2,0) = Element(0,1) * Element(1,2) - Element(1,1) * Element(0,2);
+	result.Element(2,1) = Element(1,0) * Element(0,2) - Element(0,0) * Element(1,2);
+	result.Element(2,2) = Element(0,0) * Element(1,1) - Element(1,0) * Element(0,1);
+
+	float det = 
+		Element(0,0) * result.Element(0,0) + 
+		Element(0,1) * result.Element(0,1) + 
+		Element(0,2) * result.Element(0,2);
+
+	if (det == 0.0f) {
+		// singular matrix
+		return result;
+	}
+
+	float r = 1.0f / det;
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			result.Element(i, j) *= r;
+		}
+	}
+
+	if (rescale) {
+		float sumOfSquares = 
+			result.Element(2, 0) * result.Element(2, 0) +
+			result.Element(2, 1) * result.Element(2, 1) +
+			result.Element(2, 2) * result.Element(2, 2);
+
+		if (sumOfSquares != 1.0f && sumOfSquares > 0.0f) {
+			float factor = 1.0f / static_cast<float>(sqrt(sumOfSquares));
+
+			for (int index = 0; index < ELEMENTS; ++index) {
+				result.Element(index) *= factor;
+			}
+		}
+	}
+
+	return result;
+}
+
+
+Matrix4x4f Matrix4x4f :: CreateScale(float x, float y, float z) {
+	Matrix4x4f result;
+
+	result.Element(0, 0) = x;
+	result.Element(1, 1) = y;
+	result.Element(2, 2) = z;
+
+	return result;
+}
+
+
+Matrix4x4f Matrix4x4f :: CreateRotate(float angle, float x, float y, float z) {
+
+	Matrix4x4f matrix;
+	float length = static_cast<float>(sqrt(x * x + y * y + z * z));
+
+	if (length == 0.0f) {
+		return matrix;
+	}
+
+	float r_x = x / length;
+	float r_y = y / length;
+	float r_z = z / length;
+
+	angle *= static_cast<float>(M_PI) / 180.0f;
+
+	float sine = static_cast<float>(sin(angle));
+	float cosine = static_cast<float>(cos(angle));
+	
+	float one_minus_cosine = 1.0f - cosine;
+
+	matrix.Element(0, 0) = cosine + one_minus_cosine * r_x * r_x;
+	matrix.Element(0, 1) = one_minus_cosine * r_x * r_y - r_z * sine;
+	matrix.Element(0, 2) = one_minus_cosine * r_x * r_z + r_y * sine;
+
+	matrix.Element(1, 0) = one_minus_cosine * r_x * r_y + r_z * sine;
+	matrix.Element(1, 1) = cosine + one_minus_cosine * r_y * r_y;
+	matrix.Element(1, 2) = one_minus_cosine * r_y * r_z - r_x * sine;
+
+	matrix.Element(2, 0) = one_minus_cosine * r_x * r_z - r_y * sine;
+	matrix.Element(2, 1) = one_minus_cosine * r_y * r_z + r_x * sine;
+	matrix.Element(2, 2) = cosine + one_minus_cosine * r_z * r_z;
+
+	return matrix;
+}
+
+
+Matrix4x4f Matrix4x4f :: CreateTranslate(float x, float y, float z) {
+	Matrix4x4f result;
+
+	result.Element(0, 3) = x;
+	result.Element(1, 3) = y;
+	result.Element(2, 3) = z;
+
+	return result;
+}
+
+
+Matrix4x4f Matrix4x4f :: CreateFrustrum(float l, float r, float b, float t, float n, float f) {
+	Matrix4x4f matrix;
+
+	float inv_width = (r - l) != 0.0f ? 1.0f / (r - l) : 0.0f;
+	float inv_height = (t - b) != 0.0f ? 1.0f / (t - b) : 0.0f;
+	float inv_depth = (f - n) != 0.0f ? 1.0f / (f - n) : 0.0f;
+
+	float two_n = n * 2.0f;
+
+	matrix.Element(0, 0) = two_n * inv_width;
+	matrix.Element(0, 2) = (r + l) * inv_width;
+
+	matrix.Element(1, 1) = two_n * inv_height;
+	matrix.Element(1, 2) = (t + b) * inv_height;
+
+	matrix.Element(2, 2) = (-f - n) * inv_depth;
+	matrix.Element(2, 3) = -two_n * inv_depth * f;
+
+	matrix.Element(3, 2) = -1.0f;
+	matrix.Element(3, 3) = 0.0f;
+
+#ifdef EGL_USE_TOP_DOWN_SURFACE
+	matrix = CreateScale(1.0f, -1.0f, 1.0f) * matrix;
+#endif
+	return matrix;
+}
+
+
+Matrix4x4f Matrix4x4f :: CreateOrtho(float l, float r, float b, float t, float n, float f) {
+	Matrix4x4f matrix;
+
+	float inv_width = (r - l) != 0.0f ? 1.0f / (r - l) : 0.0f;
+	float inv_height = (t - b) != 0.0f ? 1.0f / (t - b) : 0.0f;
+	float inv_depth = (f - n) != 0.0f ? 1.0f / (f - n) : 0.0f;
+
+	matrix.Element(0, 0) = 2.0f * inv_width;
+	matrix.Element(0, 3) = -(r + l) * inv_width;
+
+	matrix.Element(1, 1) = 2.0f * inv_height;
+	matrix.Element(1, 3) = -(t + b) * inv_height;
+
+	matrix.Element(2, 2) = -2.0f * inv_depth;
+	matrix.Element(2, 3) = (-f - n) * inv_depth;
+
+	return matrix;
+}
+
+#endif // EGL_USE_FLOAT_VERTEX
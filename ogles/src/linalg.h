@@ -41,6 +41,21 @@
 #include "OGLES.h"
 #include "fixed.h"
 
+#if EGL_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+#if EGL_USE_SSE2
+#include <emmintrin.h>
+#	ifdef __SSE4_1__
+#	include <smmintrin.h>
+#	endif
+#endif
+
+#if EGL_USE_NEON
+#include <arm_neon.h>
+#endif
+
 namespace EGL {
 
 	// --------------------------------------------------------------------------
@@ -523,6 +538,135 @@ namespace EGL {
 		return vector * factor;
 	}
 
+	// --------------------------------------------------------------------------
+	// Vector kernels for the fixed point matrix operations. Their results
+	// are bit-identical to the scalar code using EGL_Mul64, EGL_Round32 and
+	// EGL_Mul; all wrap-around happens modulo 2^64 for the products and
+	// sums, and modulo 2^32 for the results.
+	// --------------------------------------------------------------------------
+
+#if EGL_USE_SSE2
+	// ----------------------------------------------------------------------
+	// Signed 32x32->64 bit products of the even 32-bit lanes of a and b
+	// ----------------------------------------------------------------------
+	inline __m128i EGL_Mul64Even(__m128i a, __m128i b) {
+#	ifdef __SSE4_1__
+		return _mm_mul_epi32(a, b);
+#	else
+		// SSE2 only provides the unsigned multiply; for a negative operand
+		// the unsigned product is too large by the other operand times 2^32
+		__m128i product = _mm_mul_epu32(a, b);
+		__m128i correction = 
+			_mm_add_epi32(
+				_mm_and_si128(_mm_srai_epi32(a, 31), b),
+				_mm_and_si128(_mm_srai_epi32(b, 31), a));
+
+		return _mm_sub_epi64(product, _mm_slli_epi64(correction, 32));
+#	endif
+	}
+
+	// ----------------------------------------------------------------------
+	// Interleave the low halves of the 64-bit lanes of even and odd
+	// ----------------------------------------------------------------------
+	inline __m128i EGL_Interleave64(__m128i even, __m128i odd) {
+		return 
+			_mm_unpacklo_epi32(
+				_mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 2, 0)),
+				_mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+#endif
+
+	// --------------------------------------------------------------------------
+	// Linear combination of columns of 4 elements each:
+	//
+	//	result[i] = EGL_Round32(sum over k of EGL_Mul64(columns[4 * k + i], factors[k]))
+	//
+	// Parameters:
+	//	columns		-	count columns stored one after the other
+	//	factors		-	count factors to apply to the columns
+	//	count		-	number of columns
+	//	result		-	array of 4 elements receiving the result
+	// --------------------------------------------------------------------------
+	inline void EGL_CombineColumns(const EGL_Fixed * columns, const EGL_Fixed * factors,
+								   int count, EGL_Fixed * result) {
+#if EGL_USE_SSE2
+		__m128i even = _mm_setzero_si128(), odd = _mm_setzero_si128();
+
+		for (int k = 0; k < count; ++k, columns += 4) {
+			__m128i column = _mm_loadu_si128(reinterpret_cast<const __m128i *>(columns));
+			__m128i factor = _mm_set1_epi32(factors[k]);
+
+			even = _mm_add_epi64(even, EGL_Mul64Even(column, factor));
+			odd = _mm_add_epi64(odd, EGL_Mul64Even(_mm_srli_epi64(column, 32), factor));
+		}
+
+		// only the low halves of the shifted sums are kept, so a logical
+		// shift yields the same bits as the arithmetic one
+		__m128i round = _mm_set_epi32(0, 1 << (EGL_PRECISION - 1), 0, 1 << (EGL_PRECISION - 1));
+		even = _mm_srli_epi64(_mm_add_epi64(even, round), EGL_PRECISION);
+		odd = _mm_srli_epi64(_mm_add_epi64(odd, round), EGL_PRECISION);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(result), EGL_Interleave64(even, odd));
+#elif EGL_USE_NEON
+		int64x2_t low = vdupq_n_s64(0), high = vdupq_n_s64(0);
+
+		for (int k = 0; k < count; ++k, columns += 4) {
+			int32x4_t column = vld1q_s32(columns);
+			int32x2_t factor = vdup_n_s32(factors[k]);
+
+			low = vmlal_s32(low, vget_low_s32(column), factor);
+			high = vmlal_s32(high, vget_high_s32(column), factor);
+		}
+
+		vst1q_s32(result, 
+			vcombine_s32(
+				vrshrn_n_s64(low, EGL_PRECISION), 
+				vrshrn_n_s64(high, EGL_PRECISION)));
+#else
+		for (int i = 0; i < 4; ++i) {
+			I64 sum = 0;
+
+			for (int k = 0; k < count; ++k) {
+				sum += EGL_Mul64(columns[4 * k + i], factors[k]);
+			}
+
+			result[i] = EGL_Round32(sum);
+		}
+#endif
+	}
+
+	// --------------------------------------------------------------------------
+	// Element-wise product of 4 fixed point numbers:
+	//
+	//	result[i] = EGL_Mul(a[i], b[i])
+	// --------------------------------------------------------------------------
+	inline void EGL_Mul4(const EGL_Fixed * a, const EGL_Fixed * b, EGL_Fixed * result) {
+#if EGL_USE_SSE2
+		__m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+		__m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+
+		__m128i even = EGL_Mul64Even(left, right);
+		__m128i odd = EGL_Mul64Even(_mm_srli_epi64(left, 32), _mm_srli_epi64(right, 32));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(result), 
+			EGL_Interleave64(
+				_mm_srli_epi64(even, EGL_PRECISION), 
+				_mm_srli_epi64(odd, EGL_PRECISION)));
+#elif EGL_USE_NEON
+		int32x4_t left = vld1q_s32(a);
+		int32x4_t right = vld1q_s32(b);
+
+		vst1q_s32(result, 
+			vcombine_s32(
+				vshrn_n_s64(vmull_s32(vget_low_s32(left), vget_low_s32(right)), EGL_PRECISION), 
+				vshrn_n_s64(vmull_s32(vget_high_s32(left), vget_high_s32(right)), EGL_PRECISION)));
+#else
+		for (int i = 0; i < 4; ++i) {
+			result[i] = EGL_Mul(a[i], b[i]);
+		}
+#endif
+	}
+
 	// --------------------------------------------------------------------------
 	// 4x4 Matrix class
 	// --------------------------------------------------------------------------
@@ -684,8 +828,25 @@ namespace EGL {
 		//	other		-	RHS in matrix multiplication
 		// ----------------------------------------------------------------------
 		inline Matrix4x4 operator*(const Matrix4x4& other) const {
+			if (m_identity) {
+				return other;
+			} else if (other.m_identity) {
+				return *this;
+			}
+
 			Matrix4x4 result;
 
+#if EGL_USE_SIMD_MATRIX
+			// each column of the result combines the columns of this matrix
+			for (int j = 0; j < COLUMNS; ++j) {
+				EGL_CombineColumns(m_elements, other.m_elements + j * ROWS, COLUMNS, 
+					result.m_elements + j * ROWS);
+			}
+#else
+			if (IsAffine() && other.IsAffine()) {
+				return MultiplyAffine(other);
+			}
+
 			for (int i = 0; i < ROWS; ++i) {
 				for (int j = 0; j < COLUMNS; ++j) {
 					I64 sum = 0;
@@ -697,8 +858,59 @@ namespace EGL {
 					result.Element(i, j) = EGL_Round32(sum);
 				}
 			}
+#endif
 
-			result.m_identity = m_identity && other.m_identity;
+			result.m_identity = false;
+			return result;
+		}
+
+		// ----------------------------------------------------------------------
+		// Does the last row of this matrix equal (0, 0, 0, 1)?
+		// ----------------------------------------------------------------------
+		inline bool IsAffine() const {
+			return 
+				Element(3, 0) == 0 && Element(3, 1) == 0 && 
+				Element(3, 2) == 0 && Element(3, 3) == EGL_ONE;
+		}
+
+		// ----------------------------------------------------------------------
+		// Matrix multiplication as (*this) * other for two affine matrices.
+		// This is the common case for the modelview matrix; 36 instead of
+		// 64 multiplications are needed, and each column of other is only
+		// read once. The vector kernel computes the full product faster,
+		// and yields the same result for affine matrices.
+		//
+		// Parameters:
+		//	other		-	RHS in matrix multiplication
+		// ----------------------------------------------------------------------
+		inline Matrix4x4 MultiplyAffine(const Matrix4x4& other) const {
+			Matrix4x4 result;
+
+			const EGL_Fixed * a = m_elements;
+			const EGL_Fixed * b = other.m_elements;
+			EGL_Fixed * r = result.m_elements;
+
+			for (int j = 0; j < COLUMNS; ++j, b += ROWS, r += ROWS) {
+				EGL_Fixed b0 = b[0], b1 = b[1], b2 = b[2];
+				
+				for (int i = 0; i < ROWS - 1; ++i) {
+					I64 sum = 
+						EGL_Mul64(a[i], b0) +
+						EGL_Mul64(a[i + ROWS], b1) + 
+						EGL_Mul64(a[i + 2 * ROWS], b2);
+
+					// translation column picks up the translation of this
+					if (j == COLUMNS - 1) {
+						sum += static_cast<I64>(a[i + 3 * ROWS]) << EGL_PRECISION;
+					}
+
+					r[i] = EGL_Round32(sum);
+				}
+
+				r[3] = b[3];
+			}
+
+			result.m_identity = false;
 			return result;
 		}
 
@@ -727,6 +939,14 @@ namespace EGL {
 		//	vector		-	The vector to be transformed
 		// ----------------------------------------------------------------------
 		inline Vec4D operator*(const Vec3D& vector) const {
+#if EGL_USE_SIMD_MATRIX
+			// the translation column is added exactly, as it is scaled by 1
+			EGL_Fixed factors[4] = { vector.x(), vector.y(), vector.z(), EGL_ONE };
+			EGL_Fixed result[4];
+
+			EGL_CombineColumns(m_elements, factors, COLUMNS, result);
+			return Vec4D(result[0], result[1], result[2], result[3]);
+#else
 			return Vec4D(
 				EGL_Round32(
 					EGL_Mul64(vector.x(), Element(0, 0)) +
@@ -751,6 +971,7 @@ namespace EGL {
 					EGL_Mul64(vector.y(), Element(3, 1)) +
 					EGL_Mul64(vector.z(), Element(3, 2))) +
 				Element(3, 3));
+#endif
 		}
 
 
@@ -763,6 +984,12 @@ namespace EGL {
 		//	vector		-	The vector to be transformed
 		// ----------------------------------------------------------------------
 		inline Vec3D Multiply3x3(const Vec3D& vector) const {
+#if EGL_USE_SIMD_MATRIX
+			EGL_Fixed result[4];
+
+			EGL_CombineColumns(m_elements, vector.getArray(), 3, result);
+			return Vec3D(result[0], result[1], result[2]);
+#else
 			return Vec3D(
 				EGL_Round32(
 					EGL_Mul64(vector.x(), Element(0, 0)) +
@@ -778,6 +1005,7 @@ namespace EGL {
 					EGL_Mul64(vector.x(), Element(2, 0)) +
 					EGL_Mul64(vector.y(), Element(2, 1)) +
 					EGL_Mul64(vector.z(), Element(2, 2))));
+#endif
 		}
 
 
@@ -803,6 +1031,12 @@ namespace EGL {
 		//	vector		-	The vector to be transformed
 		// ----------------------------------------------------------------------
 		inline Vec4D operator*(const Vec4D& vector) const {
+#if EGL_USE_SIMD_MATRIX
+			Vec4D result;
+
+			EGL_CombineColumns(m_elements, vector.getArray(), COLUMNS, result.getArray());
+			return result;
+#else
 			return Vec4D(
 				EGL_Round32(
 					EGL_Mul64(vector.x(), Element(0, 0)) +
@@ -827,10 +1061,15 @@ namespace EGL {
 					EGL_Mul64(vector.y(), Element(3, 1)) +
 					EGL_Mul64(vector.z(), Element(3, 2)) +
 					EGL_Mul64(vector.w(), Element(3, 3))));
+#endif
 		}
 
 
 		inline void Multiply(const Vec4D& vector, Vec4D& result) const {
+#if EGL_USE_SIMD_MATRIX
+			// the kernel reads all of vector before writing, so result may alias it
+			EGL_CombineColumns(m_elements, vector.getArray(), COLUMNS, result.getArray());
+#else
 			result = Vec4D(
 				EGL_Round32(
 					EGL_Mul64(vector.x(), Element(0, 0)) +
@@ -855,9 +1094,19 @@ namespace EGL {
 					EGL_Mul64(vector.y(), Element(3, 1)) +
 					EGL_Mul64(vector.z(), Element(3, 2)) +
 					EGL_Mul64(vector.w(), Element(3, 3))));
+#endif
 		}
 
 		inline void Multiply(const Vec4D& vector, EGL_Fixed * result, int dim = 4) const {
+#if EGL_USE_SIMD_MATRIX
+			EGL_Fixed temp[4];
+
+			EGL_CombineColumns(m_elements, vector.getArray(), COLUMNS, temp);
+
+			for (int idx = 0; idx < dim; ++idx) {
+				*result++ = temp[idx];
+			}
+#else
 			for (int idx = 0; idx < dim; ++idx) {
 				*result++ =
 					EGL_Round32(
@@ -866,6 +1115,7 @@ namespace EGL {
 						EGL_Mul64(vector.z(), Element(idx, 2)) +
 						EGL_Mul64(vector.w(), Element(idx, 3)));
 			}
+#endif
 		}
 
 		// ----------------------------------------------------------------------
@@ -952,6 +1202,193 @@ namespace EGL {
 		static Matrix4x4 CreateOrtho(EGL_Fixed left, EGL_Fixed right, 
 			EGL_Fixed bottom, EGL_Fixed top, EGL_Fixed zNear, EGL_Fixed zFar);
 	};
+
+#if EGL_USE_FLOAT_VERTEX
+
+	// --------------------------------------------------------------------------
+	// 4x4 Matrix class using floating point arithmetic
+	//
+	// This is the matrix type of the floating point vertex pipeline; the
+	// matrix stacks keep one for each Matrix4x4, which is computed from
+	// the floating point API parameters where these are given. Elements 
+	// are stored in the same column-major order as for Matrix4x4.
+	// --------------------------------------------------------------------------
+
+
+	class Matrix4x4f {
+
+		enum {
+			ROWS = 4,			// number of rows per matrix
+			COLUMNS = 4,		// number of columns per matrix
+			ELEMENTS = 16,		// total number of elements
+		};
+
+		float m_elements[16];
+
+	public:
+		inline float& Element(int row, int column) {
+			return m_elements[row + column * ROWS]; 
+		}
+
+		inline const float& Element(int row, int column) const {
+			return m_elements[row + column * ROWS]; 
+		}
+
+		inline float& Element(int index) {
+			return m_elements[index]; 
+		}
+
+		inline const float& Element(int index) const {
+			return m_elements[index]; 
+		}
+
+		inline const float * GetArray() const {
+			return m_elements;
+		}
+
+		inline Matrix4x4f() {
+			MakeIdentity();
+		}
+
+		// ----------------------------------------------------------------------
+		// Construct matrix from vector of elements, which are stored column
+		// by column
+		// ----------------------------------------------------------------------
+		inline Matrix4x4f(const float * elements) {
+			for (int index = 0; index < ELEMENTS; ++index) {
+				m_elements[index] = elements[index];
+			}
+		}
+
+		inline void MakeIdentity() {
+			for (int index = 0; index < ELEMENTS; ++index) {
+				m_elements[index] = (index % (ROWS + 1)) ? 0.0f : 1.0f;
+			}
+		}
+
+		// ----------------------------------------------------------------------
+		// Convert a fixed point matrix
+		// ----------------------------------------------------------------------
+		inline Matrix4x4f(const Matrix4x4& other) {
+			*this = other;
+		}
+
+		inline Matrix4x4f& operator=(const Matrix4x4& other) {
+			for (int index = 0; index < ELEMENTS; ++index) {
+				m_elements[index] = EGL_FloatFromFixed(other.Element(index));
+			}
+
+			return *this;
+		}
+
+		// ----------------------------------------------------------------------
+		// Convert to a fixed point matrix; out of range elements saturate
+		// ----------------------------------------------------------------------
+		inline Matrix4x4 ToFixed() const {
+			EGL_Fixed elements[ELEMENTS];
+
+			for (int index = 0; index < ELEMENTS; ++index) {
+				elements[index] = EGL_FixedFromFloat(m_elements[index]);
+			}
+
+			return Matrix4x4(elements);
+		}
+
+		// ----------------------------------------------------------------------
+		// Matrix multiplication as (*this) * other
+		// ----------------------------------------------------------------------
+		inline Matrix4x4f operator*(const Matrix4x4f& other) const {
+			Matrix4x4f result;
+
+			for (int column = 0; column < COLUMNS; ++column) {
+				Multiply(other.m_elements + column * ROWS, ROWS, result.m_elements + column * ROWS);
+			}
+
+			return result;
+		}
+
+		// ----------------------------------------------------------------------
+		// Transform a vector of 2, 3 or 4 elements using this matrix. Missing
+		// coordinates are taken from (0, 0, 0, 1).
+		//
+		// Parameters:
+		//	vector		-	The vector to be transformed
+		//	size		-	The number of elements in vector
+		//	result		-	The 4 elements of the transformed vector
+		// ----------------------------------------------------------------------
+		inline void Multiply(const float * vector, size_t size, float * result) const {
+			float x = vector[0];
+			float y = vector[1];
+			float z = size > 2 ? vector[2] : 0.0f;
+			float w = size > 3 ? vector[3] : 1.0f;
+
+#if EGL_USE_SSE
+			// columns are stored contiguously, so the result is the sum
+			// of the four columns scaled by the vector coordinates
+			__m128 sum = 
+				_mm_add_ps(
+					_mm_add_ps(
+						_mm_mul_ps(_mm_loadu_ps(m_elements),				_mm_set1_ps(x)),
+						_mm_mul_ps(_mm_loadu_ps(m_elements + ROWS),		_mm_set1_ps(y))),
+					_mm_add_ps(
+						_mm_mul_ps(_mm_loadu_ps(m_elements + 2 * ROWS),	_mm_set1_ps(z)),
+						_mm_mul_ps(_mm_loadu_ps(m_elements + 3 * ROWS),	_mm_set1_ps(w))));
+
+			_mm_storeu_ps(result, sum);
+#else
+			for (int row = 0; row < ROWS; ++row) {
+				result[row] = 
+					x * Element(row, 0) +
+					y * Element(row, 1) +
+					z * Element(row, 2) +
+					w * Element(row, 3);
+			}
+#endif
+		}
+
+		// ----------------------------------------------------------------------
+		// Transform a 3-D vector using the upper left 3x3 sub-matrix
+		// ----------------------------------------------------------------------
+		inline void Multiply3x3(const float * vector, float * result) const {
+#if EGL_USE_SSE
+			__m128 sum = 
+				_mm_add_ps(
+					_mm_add_ps(
+						_mm_mul_ps(_mm_loadu_ps(m_elements),				_mm_set1_ps(vector[0])),
+						_mm_mul_ps(_mm_loadu_ps(m_elements + ROWS),		_mm_set1_ps(vector[1]))),
+					_mm_mul_ps(_mm_loadu_ps(m_elements + 2 * ROWS),		_mm_set1_ps(vector[2])));
+
+			float temp[4];
+			_mm_storeu_ps(temp, sum);
+
+			result[0] = temp[0];
+			result[1] = temp[1];
+			result[2] = temp[2];
+#else
+			for (int row = 0; row < 3; ++row) {
+				result[row] = 
+					vector[0] * Element(row, 0) +
+					vector[1] * Element(row, 1) +
+					vector[2] * Element(row, 2);
+			}
+#endif
+		}
+
+		// ----------------------------------------------------------------------
+		// Floating point versions of the corresponding Matrix4x4 functions
+		// ----------------------------------------------------------------------
+		Matrix4x4f InverseUpper3(bool rescale) const;
+
+		static Matrix4x4f CreateScale(float x, float y, float z);
+		static Matrix4x4f CreateRotate(float angle, float x, float y, float z);
+		static Matrix4x4f CreateTranslate(float x, float y, float z);
+		static Matrix4x4f CreateFrustrum(float left, float right, 
+			float bottom, float top, float zNear, float zFar);
+		static Matrix4x4f CreateOrtho(float left, float right, 
+			float bottom, float top, float zNear, float zFar);
+	};
+
+#endif // EGL_USE_FLOAT_VERTEX
 }
 
 #endif // ndef EGL_LINALG_H
@@ -0,0 +1,273 @@
+// ==========================================================================
+//
+// BufferTest.cpp		Tests for the index buffer optimization
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "unittest.h"
+#include "Buffer.h"
+
+
+using namespace EGL;
+
+
+namespace {
+
+	enum {
+		GridSize = 24,
+		NumTriangles = 2 * (GridSize - 1) * (GridSize - 1),
+		NumIndices = 3 * NumTriangles
+	};
+
+	// a regular grid of triangles, emitted in a scrambled order so that
+	// the vertex cache is of no use
+	void MakeGrid(GLushort * indices) {
+		GLushort * triangle = indices;
+
+		for (I32 y = 0; y < GridSize - 1; ++y) {
+			for (I32 x = 0; x < GridSize - 1; ++x) {
+				GLushort corner = static_cast<GLushort>(y * GridSize + x);
+
+				*triangle++ = corner;
+				*triangle++ = corner + 1;
+				*triangle++ = corner + GridSize;
+				*triangle++ = corner + 1;
+				*triangle++ = corner + GridSize + 1;
+				*triangle++ = corner + GridSize;
+			}
+		}
+
+		U32 seed = 1;
+
+		for (I32 index = NumTriangles - 1; index > 0; --index) {
+			seed = seed * 1103515245 + 12345;
+			I32 other = (seed >> 8) % (index + 1);
+
+			for (I32 corner = 0; corner < 3; ++corner) {
+				GLushort temp = indices[index * 3 + corner];
+				indices[index * 3 + corner] = indices[other * 3 + corner];
+				indices[other * 3 + corner] = temp;
+			}
+		}
+	}
+
+	// a FIFO cache simulation independent of the one in the library
+	U32 CacheMisses(const GLushort * indices, size_t count) {
+		I32 cache[EGL_VERTEX_CACHE_SIZE];
+		U32 misses = 0, next = 0;
+
+		for (size_t slot = 0; slot < EGL_VERTEX_CACHE_SIZE; ++slot) {
+			cache[slot] = -1;
+		}
+
+		for (size_t index = 0; index < count; ++index) {
+			bool hit = false;
+
+			for (size_t slot = 0; slot < EGL_VERTEX_CACHE_SIZE; ++slot) {
+				hit = hit || cache[slot] == indices[index];
+			}
+
+			if (!hit) {
+				cache[next] = indices[index];
+				next = (next + 1) % EGL_VERTEX_CACHE_SIZE;
+				++misses;
+			}
+		}
+
+		return misses;
+	}
+
+	// rotate the smallest index of a triangle to the front, which keeps 
+	// the winding, and encode it as sort key
+	U64 TriangleKey(const GLushort * triangle) {
+		I32 first = 0;
+
+		if (triangle[1] < triangle[first]) first = 1;
+		if (triangle[2] < triangle[first]) first = 2;
+
+		return	(static_cast<U64>(triangle[first]) << 32) |
+				(static_cast<U64>(triangle[(first + 1) % 3]) << 16) |
+				 static_cast<U64>(triangle[(first + 2) % 3]);
+	}
+
+	int CompareKeys(const void * left, const void * right) {
+		U64 a = *static_cast<const U64 *>(left);
+		U64 b = *static_cast<const U64 *>(right);
+
+		return a < b ? -1 : a > b ? 1 : 0;
+	}
+
+	bool SameTriangles(const GLushort * left, const GLushort * right, size_t count) {
+		U64 leftKeys[NumTriangles], rightKeys[NumTriangles];
+		size_t numTriangles = count / 3;
+
+		for (size_t index = 0; index < numTriangles; ++index) {
+			leftKeys[index] = TriangleKey(left + index * 3);
+			rightKeys[index] = TriangleKey(right + index * 3);
+		}
+
+		qsort(leftKeys, numTriangles, sizeof(U64), CompareKeys);
+		qsort(rightKeys, numTriangles, sizeof(U64), CompareKeys);
+
+		return !memcmp(leftKeys, rightKeys, numTriangles * sizeof(U64));
+	}
+
+	void InitBuffer(Buffer & buffer, const GLushort * indices, size_t count) {
+		buffer.Allocate(count * sizeof(GLushort), BufferUsageStaticDraw);
+		memcpy(buffer.GetData(), indices, count * sizeof(GLushort));
+		buffer.SetOptimizationPending(true);
+	}
+}
+
+
+TEST(ReorderKeepsBufferContents) {
+	GLushort indices[NumIndices];
+	MakeGrid(indices);
+
+	Buffer buffer;
+	InitBuffer(buffer, indices, NumIndices);
+
+	const GLushort * drawn = static_cast<const GLushort *>(
+		buffer.GetIndices(GL_TRIANGLES, NumIndices, GL_UNSIGNED_SHORT, 0));
+
+	CHECK(drawn != buffer.GetData());
+	CHECK(!memcmp(buffer.GetData(), indices, sizeof indices));
+	CHECK(!buffer.IsOptimizationPending());
+	CHECK(SameTriangles(indices, drawn, NumIndices));
+
+	// the copy is made once
+	CHECK(drawn == buffer.GetIndices(GL_TRIANGLES, NumIndices, GL_UNSIGNED_SHORT, 0));
+}
+
+TEST(ReorderStatistics) {
+	GLushort indices[NumIndices];
+	MakeGrid(indices);
+
+	Buffer buffer;
+	InitBuffer(buffer, indices, NumIndices);
+
+	CHECK(!buffer.IsOptimized());
+	CHECK_EQUAL(0u, buffer.GetCacheMissesBefore());
+	CHECK_EQUAL(0u, buffer.GetCacheMissesAfter());
+
+	const GLushort * drawn = static_cast<const GLushort *>(
+		buffer.GetIndices(GL_TRIANGLES, NumIndices, GL_UNSIGNED_SHORT, 0));
+
+	CHECK(buffer.IsOptimized());
+	CHECK_EQUAL(CacheMisses(indices, NumIndices), buffer.GetCacheMissesBefore());
+	CHECK_EQUAL(CacheMisses(drawn, NumIndices), buffer.GetCacheMissesAfter());
+
+	// a grid needs about one transformation per triangle after reordering, 
+	// the scrambled input close to three
+	CHECK(buffer.GetCacheMissesAfter() * 2 < buffer.GetCacheMissesBefore());
+	CHECK(buffer.GetCacheMissesAfter() < static_cast<U32>(NumTriangles));
+}
+
+TEST(PartialDrawsReadSpecifiedIndices) {
+	GLushort indices[NumIndices];
+	MakeGrid(indices);
+
+	Buffer buffer;
+	InitBuffer(buffer, indices, NumIndices);
+
+	const U8 * data = static_cast<const U8 *>(buffer.GetData());
+
+	// none of these draw calls creates the copy
+	CHECK(buffer.GetIndices(GL_TRIANGLES, NumIndices - 3, GL_UNSIGNED_SHORT, 0) == data);
+	CHECK(buffer.GetIndices(GL_TRIANGLES, NumIndices - 3, GL_UNSIGNED_SHORT, 6) == data + 6);
+	CHECK(buffer.GetIndices(GL_TRIANGLE_STRIP, NumIndices, GL_UNSIGNED_SHORT, 0) == data);
+	CHECK(buffer.GetIndices(GL_TRIANGLES, NumIndices * 2, GL_UNSIGNED_BYTE, 0) == data);
+	CHECK(buffer.IsOptimizationPending());
+	CHECK(!buffer.IsOptimized());
+
+	// and after the copy has been made, they still read the buffer
+	CHECK(buffer.GetIndices(GL_TRIANGLES, NumIndices, GL_UNSIGNED_SHORT, 0) != data);
+	CHECK(buffer.GetIndices(GL_TRIANGLES, NumIndices - 3, GL_UNSIGNED_SHORT, 6) == data + 6);
+	CHECK(buffer.GetIndices(GL_TRIANGLE_STRIP, NumIndices, GL_UNSIGNED_SHORT, 0) == data);
+}
+
+TEST(NoReorderWithoutHint) {
+	GLushort indices[NumIndices];
+	MakeGrid(indices);
+
+	Buffer buffer;
+	InitBuffer(buffer, indices, NumIndices);
+	buffer.SetOptimizationPending(false);
+
+	CHECK(buffer.GetIndices(GL_TRIANGLES, NumIndices, GL_UNSIGNED_SHORT, 0) == buffer.GetData());
+	CHECK(!buffer.IsOptimized());
+}
+
+TEST(NoCopyWithoutGain) {
+	const GLushort indices[] = { 0, 1, 2, 2, 1, 3 };
+
+	Buffer buffer;
+	InitBuffer(buffer, indices, 6);
+
+	CHECK(buffer.GetIndices(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0) == buffer.GetData());
+	CHECK(buffer.IsOptimized());
+	CHECK_EQUAL(4u, buffer.GetCacheMissesBefore());
+	CHECK_EQUAL(4u, buffer.GetCacheMissesAfter());
+}
+
+TEST(ResetDropsCopy) {
+	GLushort indices[NumIndices];
+	MakeGrid(indices);
+
+	Buffer buffer;
+	InitBuffer(buffer, indices, NumIndices);
+	buffer.GetIndices(GL_TRIANGLES, NumIndices, GL_UNSIGNED_SHORT, 0);
+
+	// as done by glBufferSubData on an optimized buffer
+	buffer.SetOptimizationPending(buffer.IsOptimizationPending() || buffer.IsOptimized());
+	buffer.ResetOptimization();
+
+	CHECK(!buffer.IsOptimized());
+	CHECK_EQUAL(0u, buffer.GetCacheMissesBefore());
+	CHECK_EQUAL(0u, buffer.GetCacheMissesAfter());
+
+	// the new contents are optimized by the next draw call
+	GLushort * data = static_cast<GLushort *>(buffer.GetData());
+	GLushort temp = data[0]; data[0] = data[1]; data[1] = temp;
+
+	const GLushort * drawn = static_cast<const GLushort *>(
+		buffer.GetIndices(GL_TRIANGLES, NumIndices, GL_UNSIGNED_SHORT, 0));
+
+	CHECK(drawn != buffer.GetData());
+	CHECK(buffer.IsOptimized());
+	CHECK(SameTriangles(data, drawn, NumIndices));
+
+	// reallocation discards the copy
+	buffer.Allocate(6 * sizeof(GLushort), BufferUsageStaticDraw);
+	CHECK(!buffer.IsOptimized());
+	CHECK(!buffer.IsOptimizationPending());
+	CHECK(buffer.GetIndices(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0) == buffer.GetData());
+}
@@ -0,0 +1,426 @@
+// ==========================================================================
+//
+// CodegenTest.cpp		Tests for the code generator
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "unittest.h"
+#include "instruction.h"
+#include "emit.h"
+#include "arm-codegen.h"
+
+
+namespace {
+
+	enum {
+		MaxCodeWords = 1024,
+		MaxSums = 8
+	};
+
+	// latencies of an ARM9-class core, as used by PipelinePart
+	const cg_latency_info_t Latency = { 2, 3, 3, 3 };
+
+	// run the passes of PipelinePart::EndGenerateCode on a module
+	void Optimize(cg_module_t * module) {
+		cg_module_inst_def(module);
+		cg_module_fold_constants(module);
+		cg_module_hoist_invariants(module);
+		cg_module_eliminate_common_subexpressions(module);
+		cg_module_amode(module);
+		cg_module_eliminate_dead_code(module);
+		cg_module_unify_registers(module);
+		cg_module_allocate_variables(module);
+		cg_module_inst_use_chains(module);
+		cg_module_reorder_instructions(module, &Latency);
+		cg_module_dataflow(module);
+		cg_module_interferences(module);
+	}
+
+	// generate the ARM code of an optimized module; returns the number of
+	// code words
+	size_t Emit(cg_module_t * module, U32 * code) {
+		cg_runtime_info_t runtime;
+		memset(&runtime, 0, sizeof runtime);
+
+		cg_processor_info_t processor;
+		processor.useV5 = 0;
+
+		cg_codegen_t * codegen = cg_codegen_create(module->heap, &runtime, &processor);
+		cg_codegen_emit_module(codegen, module);
+		cg_codegen_fix_refs(codegen);
+
+		cg_segment_t * segment = cg_codegen_segment(codegen);
+		size_t size = cg_segment_size(segment);
+
+		CHECK(size <= MaxCodeWords * sizeof(U32));
+
+		if (size > MaxCodeWords * sizeof(U32)) {
+			size = MaxCodeWords * sizeof(U32);
+		}
+
+		cg_segment_get_block(segment, 0, code, size);
+		cg_codegen_destroy(codegen);
+
+		return size / sizeof(U32);
+	}
+
+	// number of single loads and stores relative to the frame pointer,
+	// i.e. of the accesses to values that did not get a register
+	int CountFrameAccesses(const U32 * code, size_t words) {
+		int count = 0;
+
+		for (size_t index = 0; index < words; ++index) {
+			if ((code[index] & 0x0c000000) == 0x04000000 &&
+				((code[index] >> 16) & 0xf) == ARMREG_FP) {
+				++count;
+			}
+		}
+
+		return count;
+	}
+
+	// two loops after another, each adding up rows of sums words:
+	//
+	//	(const I32 * in, I32 * out, I32 count)
+	//
+	//	for (loop = 0; loop < 2; ++loop) {
+	//		I32 acc[sums] = { 0 };
+	//
+	//		for (n = count; n; --n, in += sums)
+	//			for (i = 0; i < sums; ++i)
+	//				acc[i] += in[i];
+	//
+	//		for (i = 0; i < sums; ++i)
+	//			*out++ = acc[i];
+	//	}
+	cg_module_t * BuildSumLoops(int sums) {
+		assert(sums <= MaxSums);
+
+		cg_heap_t * heap = cg_heap_create(4096);
+		cg_module_t * module = cg_module_create(heap);
+		cg_proc_t * procedure = cg_proc_create(module);
+
+		cg_virtual_reg_t * regIn = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regOut = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regCount = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+		procedure->num_args = 3;
+
+		cg_block_t * block = cg_block_create(procedure, 1);
+
+		cg_virtual_reg_t * regZero = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regOne = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regStride = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regWord = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+		LDI(regZero, 0);
+		LDI(regOne, 1);
+		LDI(regStride, sums * sizeof(I32));
+		LDI(regWord, sizeof(I32));
+
+		cg_virtual_reg_t * regInNext = regIn;
+		cg_virtual_reg_t * regOutNext = regOut;
+
+		for (int loop = 0; loop < 2; ++loop) {
+			block = cg_block_create(procedure, 9);
+			cg_block_ref_t * loopBegin = cg_block_ref_create(procedure);
+			loopBegin->block = block;
+
+			cg_virtual_reg_t * regInEnter = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regInExit = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regCountEnter = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regCountExit = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regAccEnter[MaxSums], * regAccExit[MaxSums];
+
+			// the phi instructions lead the block
+			PHI(regInEnter, cg_create_virtual_reg_list(heap, regInExit, regInNext, NULL));
+			PHI(regCountEnter, cg_create_virtual_reg_list(heap, regCountExit, regCount, NULL));
+
+			for (int i = 0; i < sums; ++i) {
+				regAccEnter[i] = cg_virtual_reg_create(procedure, cg_reg_type_general);
+				regAccExit[i] = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+				PHI(regAccEnter[i], cg_create_virtual_reg_list(heap, regAccExit[i], regZero, NULL));
+			}
+
+			cg_virtual_reg_t * regAddr = regInEnter;
+
+			for (int i = 0; i < sums; ++i) {
+				cg_virtual_reg_t * regValue = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+				if (i) {
+					cg_virtual_reg_t * regNextAddr = cg_virtual_reg_create(procedure, cg_reg_type_general);
+					ADD(regNextAddr, regAddr, regWord);
+					regAddr = regNextAddr;
+				}
+
+				LDW(regValue, regAddr);
+				ADD(regAccExit[i], regAccEnter[i], regValue);
+			}
+
+			cg_virtual_reg_t * regFlags = cg_virtual_reg_create(procedure, cg_reg_type_flags);
+
+			ADD(regInExit, regInEnter, regStride);
+			SUB_S(regCountExit, regFlags, regCountEnter, regOne);
+			BNE(regFlags, loopBegin);
+
+			block = cg_block_create(procedure, 1);
+
+			for (int i = 0; i < sums; ++i) {
+				cg_virtual_reg_t * regNextOut = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+				STW(regAccExit[i], regOutNext);
+				ADD(regNextOut, regOutNext, regWord);
+				regOutNext = regNextOut;
+			}
+
+			regInNext = regInExit;
+		}
+
+		RET();
+
+		return module;
+	}
+
+	// a single block of independent chains, each in the order that gives
+	// the most stalls:
+	//
+	//	(const I32 * in, I32 * out)
+	//
+	//	for (i = 0; i < chains; ++i)
+	//		out[i] = in[i] * in[i];
+	//
+	// The store instructions are returned in program order.
+	cg_module_t * BuildChains(int chains, cg_inst_t ** stores) {
+		cg_heap_t * heap = cg_heap_create(4096);
+		cg_module_t * module = cg_module_create(heap);
+		cg_proc_t * procedure = cg_proc_create(module);
+
+		cg_virtual_reg_t * regIn = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regOut = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+		procedure->num_args = 2;
+
+		// loads from the input may move past stores to the output
+		regIn->is_readonly = 1;
+
+		cg_block_t * block = cg_block_create(procedure, 1);
+
+		for (int i = 0; i < chains; ++i) {
+			cg_virtual_reg_t * regOffset = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regInAddr = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regOutAddr = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regValue = cg_virtual_reg_create(procedure, cg_reg_type_general);
+			cg_virtual_reg_t * regSquare = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+			LDI(regOffset, i * sizeof(I32));
+			ADD(regInAddr, regIn, regOffset);
+			LDW(regValue, regInAddr);
+			MUL(regSquare, regValue, regValue);
+			ADD(regOutAddr, regOut, regOffset);
+			stores[i] = STW(regSquare, regOutAddr);
+		}
+
+		RET();
+
+		return module;
+	}
+
+	// a loop with two loads of invariant addresses, only one of which is
+	// executed in every iteration:
+	//
+	//	(const I32 * in, I32 * out, I32 count)
+	//
+	//	for (n = count; n; --n) {
+	//		if (n > limit)
+	//			out[0] = in[0];
+	//
+	//		out[1] = in[1];
+	//	}
+	//
+	// The conditional load is returned in the first, the unconditional one
+	// in the second element of loads.
+	cg_module_t * BuildConditionalLoad(cg_inst_t ** loads) {
+		cg_heap_t * heap = cg_heap_create(4096);
+		cg_module_t * module = cg_module_create(heap);
+		cg_proc_t * procedure = cg_proc_create(module);
+
+		cg_virtual_reg_t * regIn = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regOut = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regCount = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+		procedure->num_args = 3;
+		regIn->is_readonly = 1;
+
+		cg_block_t * block = cg_block_create(procedure, 1);
+
+		cg_virtual_reg_t * regOne = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regLimit = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regWord = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+		LDI(regOne, 1);
+		LDI(regLimit, 16);
+		LDI(regWord, sizeof(I32));
+
+		block = cg_block_create(procedure, 9);
+		cg_block_ref_t * loopBegin = cg_block_ref_create(procedure);
+		cg_block_ref_t * skip = cg_block_ref_create(procedure);
+		loopBegin->block = block;
+
+		cg_virtual_reg_t * regCountEnter = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regCountExit = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regCompare = cg_virtual_reg_create(procedure, cg_reg_type_flags);
+
+		PHI(regCountEnter, cg_create_virtual_reg_list(heap, regCountExit, regCount, NULL));
+		CMP(regCompare, regCountEnter, regLimit);
+		BLE(regCompare, skip);
+
+		block = cg_block_create(procedure, 5);
+
+		cg_virtual_reg_t * regFirst = cg_virtual_reg_create(procedure, cg_reg_type_general);
+
+		loads[0] = LDW(regFirst, regIn);
+		STW(regFirst, regOut);
+
+		block = cg_block_create(procedure, 9);
+		skip->block = block;
+
+		cg_virtual_reg_t * regInAddr = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regOutAddr = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regSecond = cg_virtual_reg_create(procedure, cg_reg_type_general);
+		cg_virtual_reg_t * regFlags = cg_virtual_reg_create(procedure, cg_reg_type_flags);
+
+		ADD(regInAddr, regIn, regWord);
+		loads[1] = LDW(regSecond, regInAddr);
+		ADD(regOutAddr, regOut, regWord);
+		STW(regSecond, regOutAddr);
+		SUB_S(regCountExit, regFlags, regCountEnter, regOne);
+		BNE(regFlags, loopBegin);
+
+		block = cg_block_create(procedure, 1);
+		RET();
+
+		return module;
+	}
+
+	bool IsLoad(const cg_inst_t * inst) {
+		return inst->base.kind == cg_inst_load ||
+			inst->base.kind == cg_inst_arm_load_immed_offset ||
+			inst->base.kind == cg_inst_arm_load_reg_offset;
+	}
+
+	// true if the second instruction reads a register that the first one
+	// writes
+	bool Depends(const cg_inst_t * first, const cg_inst_t * second) {
+		cg_virtual_reg_t * defs[64], * uses[64];
+		cg_virtual_reg_t ** endDefs = cg_inst_def(first, defs, defs + 64);
+		cg_virtual_reg_t ** endUses = cg_inst_use(second, uses, uses + 64);
+
+		for (cg_virtual_reg_t ** def = defs; def != endDefs; ++def) {
+			for (cg_virtual_reg_t ** use = uses; use != endUses; ++use) {
+				if (*def == *use) {
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+}
+
+
+// values that are live in one loop only share registers with those of the
+// other loop, so neither loop spills
+TEST(CodegenLoopValuesShareRegisters) {
+	cg_module_t * module = BuildSumLoops(5);
+	U32 code[MaxCodeWords];
+
+	Optimize(module);
+	size_t words = Emit(module, code);
+
+	CHECK(words > 0);
+	CHECK_EQUAL(0, CountFrameAccesses(code, words));
+
+	cg_heap_destroy(module->heap);
+}
+
+
+// an invariant load is only moved in front of the loop if every iteration
+// executes it; a load that a condition skips may not be valid to execute
+TEST(CodegenHoistKeepsConditionalLoads) {
+	cg_inst_t * loads[2];
+	cg_module_t * module = BuildConditionalLoad(loads);
+	cg_block_t * entry = module->procs->blocks;
+	cg_block_t * conditional = entry->next->next;
+
+	cg_module_inst_def(module);
+	cg_module_fold_constants(module);
+	cg_module_hoist_invariants(module);
+
+	CHECK(loads[0]->base.block == conditional);
+	CHECK(loads[1]->base.block == entry);
+
+	cg_heap_destroy(module->heap);
+}
+
+
+// with enough independent work in a block, no loaded value is used by the
+// instruction right after the load, and the stores keep their order
+TEST(CodegenScheduleHidesLoadLatency) {
+	cg_inst_t * stores[4];
+	cg_module_t * module = BuildChains(4, stores);
+
+	Optimize(module);
+
+	cg_block_t * block = module->procs->blocks;
+	int loads = 0, stalls = 0, storeIndex = 0;
+
+	for (const cg_inst_t * inst = block->insts.head; inst; inst = inst->base.next) {
+		if (IsLoad(inst)) {
+			++loads;
+
+			if (inst->base.next && Depends(inst, inst->base.next)) {
+				++stalls;
+			}
+		} else if (storeIndex < 4 && inst == stores[storeIndex]) {
+			++storeIndex;
+		}
+	}
+
+	CHECK_EQUAL(4, loads);
+	CHECK_EQUAL(0, stalls);
+	CHECK_EQUAL(4, storeIndex);
+
+	U32 code[MaxCodeWords];
+	CHECK(Emit(module, code) > 0);
+
+	cg_heap_destroy(module->heap);
+}
@@ -0,0 +1,376 @@
+// ==========================================================================
+//
+// MatrixTest.cpp		Tests for the matrix kernels and the matrix stack
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "unittest.h"
+#include "linalg.h"
+#include "MatrixStack.h"
+
+
+using namespace EGL;
+
+
+// --------------------------------------------------------------------------
+// The vector kernels of the matrix class need to produce the same bits as 
+// the scalar reference implementations below, which are the original
+// scalar versions of these operations.
+// --------------------------------------------------------------------------
+
+
+namespace {
+
+	U32 s_Seed = 1;
+
+	I32 Random() {
+		s_Seed = s_Seed * 1103515245 + 12345;
+		U32 high = s_Seed >> 16;
+		s_Seed = s_Seed * 1103515245 + 12345;
+		return static_cast<I32>((high << 16) ^ (s_Seed >> 8));
+	}
+
+	// values covering small and large magnitudes of both signs
+	EGL_Fixed RandomFixed() {
+		switch (Random() & 7) {
+		case 0:		return 0;
+		case 1:		return EGL_ONE;
+		case 2:		return -EGL_ONE;
+		case 3:		return Random();
+		case 4:		return Random() >> 8;
+		default:	return Random() >> 14;
+		}
+	}
+
+	Matrix4x4 RandomMatrix() {
+		EGL_Fixed elements[16];
+
+		for (int index = 0; index < 16; ++index) {
+			elements[index] = RandomFixed();
+		}
+
+		return Matrix4x4(elements);
+	}
+
+	Matrix4x4 RandomAffineMatrix() {
+		Matrix4x4 matrix = RandomMatrix();
+
+		matrix.Element(3, 0) = matrix.Element(3, 1) = matrix.Element(3, 2) = 0;
+		matrix.Element(3, 3) = EGL_ONE;
+
+		return matrix;
+	}
+
+	bool Equal(const Matrix4x4 & left, const Matrix4x4 & right) {
+		return !memcmp(left.GetArray(), right.GetArray(), 16 * sizeof(EGL_Fixed));
+	}
+
+	Matrix4x4 ReferenceMultiply(const Matrix4x4 & left, const Matrix4x4 & right) {
+		Matrix4x4 result;
+
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 4; ++j) {
+				I64 sum = 0;
+
+				for (int k = 0; k < 4; ++k) {
+					sum += EGL_Mul64(left.Element(i, k), right.Element(k, j));
+				}
+
+				result.Element(i, j) = EGL_Round32(sum);
+			}
+		}
+
+		return result;
+	}
+
+	void ReferenceTransform(const Matrix4x4 & matrix, const EGL_Fixed * vector, 
+							int size, EGL_Fixed * result) {
+		for (int i = 0; i < 4; ++i) {
+			I64 sum = 0;
+
+			for (int k = 0; k < size; ++k) {
+				sum += EGL_Mul64(vector[k], matrix.Element(i, k));
+			}
+
+			result[i] = EGL_Round32(sum);
+		}
+	}
+
+	EGL_Fixed Det2X2(EGL_Fixed a, EGL_Fixed b, EGL_Fixed c, EGL_Fixed d) {
+		return EGL_Mul(a, d) - EGL_Mul(c, b);
+	}
+
+	Matrix4x4 ReferenceInverseUpper3(const Matrix4x4 & m, bool rescale) {
+		Matrix4x4 result;
+
+		result.Element(0,0) =  Det2X2(m.Element(1,1), m.Element(1,2), m.Element(2,1), m.Element(2,2));
+		result.Element(0,1) = -Det2X2(m.Element(1,0), m.Element(1,2), m.Element(2,0), m.Element(2,2));
+		result.Element(0,2) =  Det2X2(m.Element(1,0), m.Element(1,1), m.Element(2,0), m.Element(2,1));
+		result.Element(1,0) = -Det2X2(m.Element(0,1), m.Element(0,2), m.Element(2,1), m.Element(2,2));
+		result.Element(1,1) =  Det2X2(m.Element(0,0), m.Element(0,2), m.Element(2,0), m.Element(2,2));
+		result.Element(1,2) = -Det2X2(m.Element(0,0), m.Element(0,1), m.Element(2,0), m.Element(2,1));
+		result.Element(2,0) =  Det2X2(m.Element(0,1), m.Element(0,2), m.Element(1,1), m.Element(1,2));
+		result.Element(2,1) = -Det2X2(m.Element(0,0), m.Element(0,2), m.Element(1,0), m.Element(1,2));
+		result.Element(2,2) =  Det2X2(m.Element(0,0), m.Element(0,1), m.Element(1,0), m.Element(1,1));
+
+		EGL_Fixed d = 0;
+
+		for (int i = 0; i < 3; ++i) {
+			d += EGL_Mul(m.Element(0, i), result.Element(0, i));
+		}
+
+		if (d == 0) {
+			return result;
+		}
+
+		EGL_Fixed r = EGL_Inverse(d);
+
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				result.Element(i, j) = EGL_Mul(result.Element(i, j), r);
+			}
+		}
+
+		if (rescale) {
+			EGL_Fixed sumOfSquares = 
+				EGL_Mul(result.Element(2, 0), result.Element(2, 0)) +
+				EGL_Mul(result.Element(2, 1), result.Element(2, 1)) +
+				EGL_Mul(result.Element(2, 2), result.Element(2, 2));
+
+			if (sumOfSquares != EGL_ONE) {
+				EGL_Fixed factor = EGL_InvSqrt(sumOfSquares);
+
+				for (int index = 0; index < 16; ++index) {
+					result.Element(index) = EGL_Mul(result.Element(index), factor);
+				}
+			}
+		}
+
+		return result;
+	}
+
+	enum {
+		Iterations = 20000
+	};
+}
+
+
+TEST(MatrixMultiply) {
+	for (int iteration = 0; iteration < Iterations; ++iteration) {
+		Matrix4x4 left = RandomMatrix(), right = RandomMatrix();
+		CHECK(Equal(ReferenceMultiply(left, right), left * right));
+	}
+}
+
+TEST(MatrixMultiplyAffine) {
+	for (int iteration = 0; iteration < Iterations; ++iteration) {
+		Matrix4x4 left = RandomAffineMatrix(), right = RandomAffineMatrix();
+		CHECK(Equal(ReferenceMultiply(left, right), left * right));
+		CHECK(Equal(ReferenceMultiply(left, right), left.MultiplyAffine(right)));
+	}
+}
+
+TEST(MatrixMultiplyIdentity) {
+	Matrix4x4 identity, matrix = RandomMatrix();
+
+	CHECK(Equal(matrix, identity * matrix));
+	CHECK(Equal(matrix, matrix * identity));
+	CHECK(!(matrix * matrix).IsIdentity());
+}
+
+TEST(MatrixTransformVec4D) {
+	for (int iteration = 0; iteration < Iterations; ++iteration) {
+		Matrix4x4 matrix = RandomMatrix();
+		Vec4D vector(RandomFixed(), RandomFixed(), RandomFixed(), RandomFixed());
+		EGL_Fixed expected[4];
+
+		ReferenceTransform(matrix, vector.getArray(), 4, expected);
+
+		Vec4D product = matrix * vector;
+		CHECK(!memcmp(expected, product.getArray(), sizeof expected));
+
+		Vec4D result;
+		matrix.Multiply(vector, result);
+		CHECK(!memcmp(expected, result.getArray(), sizeof expected));
+
+		// in place
+		matrix.Multiply(vector, vector);
+		CHECK(!memcmp(expected, vector.getArray(), sizeof expected));
+
+		EGL_Fixed partial[4] = { 0, 0, 0, 0x12345678 };
+		EGL_Fixed twice[4];
+		matrix.Multiply(Vec4D(expected), partial, 3);
+		ReferenceTransform(matrix, expected, 4, twice);
+		CHECK(!memcmp(twice, partial, 3 * sizeof(EGL_Fixed)));
+		CHECK_EQUAL(0x12345678, partial[3]);
+	}
+}
+
+TEST(MatrixTransformVec3D) {
+	for (int iteration = 0; iteration < Iterations; ++iteration) {
+		Matrix4x4 matrix = RandomMatrix();
+		Vec3D vector(RandomFixed(), RandomFixed(), RandomFixed());
+		EGL_Fixed homogenous[4] = { vector.x(), vector.y(), vector.z(), EGL_ONE };
+		EGL_Fixed expected[4];
+
+		ReferenceTransform(matrix, homogenous, 4, expected);
+
+		Vec4D product = matrix * vector;
+		CHECK(!memcmp(expected, product.getArray(), sizeof expected));
+
+		ReferenceTransform(matrix, homogenous, 3, expected);
+
+		Vec3D product3 = matrix.Multiply3x3(vector);
+		CHECK(!memcmp(expected, product3.getArray(), 3 * sizeof(EGL_Fixed)));
+	}
+}
+
+TEST(MatrixInverseUpper3) {
+	for (int iteration = 0; iteration < Iterations; ++iteration) {
+		Matrix4x4 matrix = RandomMatrix();
+		bool rescale = (iteration & 1) != 0;
+
+		Matrix4x4 expected = ReferenceInverseUpper3(matrix, rescale);
+		Matrix4x4 inverse = matrix.InverseUpper3(rescale);
+
+		CHECK(Equal(expected, inverse));
+	}
+
+	// a rotation by 90 degrees around z, scaled by 2; the result is the
+	// transposed inverse as used for transforming normals
+	Matrix4x4 matrix = Matrix4x4::CreateRotate(90 * EGL_ONE, 0, 0, EGL_ONE) * 
+		Matrix4x4::CreateScale(2 * EGL_ONE, 2 * EGL_ONE, 2 * EGL_ONE);
+	Matrix4x4 inverse = matrix.InverseUpper3(false);
+	Matrix4x4 product = inverse.Transpose() * matrix;
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			EGL_Fixed error = product.Element(i, j) - (i == j ? EGL_ONE : 0);
+			CHECK(error > -16 && error < 16);
+		}
+	}
+}
+
+
+#if EGL_USE_FLOAT_VERTEX
+
+// --------------------------------------------------------------------------
+// The floating point matrices are built from the float arguments directly;
+// they need to agree with the fixed point matrices where those are in range,
+// and keep their precision where the fixed point matrices overflow.
+// --------------------------------------------------------------------------
+
+
+namespace {
+
+	bool Close(const Matrix4x4& fixed, const Matrix4x4f& matrix, float tolerance) {
+		for (int index = 0; index < 16; ++index) {
+			float difference = EGL_FloatFromFixed(fixed.Element(index)) - matrix.Element(index);
+
+			if (difference < -tolerance || difference > tolerance)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+
+TEST(FloatMatrixCreate) {
+	CHECK(Close(Matrix4x4::CreateScale(2 * EGL_ONE, EGL_ONE / 2, -3 * EGL_ONE),
+		Matrix4x4f::CreateScale(2.0f, 0.5f, -3.0f), 1.0f / 65536));
+	CHECK(Close(Matrix4x4::CreateTranslate(5 * EGL_ONE, -7 * EGL_ONE, EGL_ONE / 4),
+		Matrix4x4f::CreateTranslate(5.0f, -7.0f, 0.25f), 1.0f / 65536));
+	CHECK(Close(Matrix4x4::CreateRotate(30 * EGL_ONE, EGL_ONE, 2 * EGL_ONE, 3 * EGL_ONE),
+		Matrix4x4f::CreateRotate(30.0f, 1.0f, 2.0f, 3.0f), 1.0f / 1024));
+
+	// the fixed point projections lose precision in the divisions, so
+	// these are compared against the exact values
+	Matrix4x4f frustrum = Matrix4x4f::CreateFrustrum(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f);
+	CHECK(frustrum.Element(0, 0) == 1.0f && frustrum.Element(1, 1) == 1.0f);
+	CHECK(frustrum.Element(2, 2) > -101.0f / 99.0f - 1.0e-6f && frustrum.Element(2, 2) < -101.0f / 99.0f + 1.0e-6f);
+	CHECK(frustrum.Element(2, 3) > -200.0f / 99.0f - 1.0e-6f && frustrum.Element(2, 3) < -200.0f / 99.0f + 1.0e-6f);
+	CHECK(frustrum.Element(3, 2) == -1.0f && frustrum.Element(3, 3) == 0.0f);
+
+	Matrix4x4f ortho = Matrix4x4f::CreateOrtho(0.0f, 320.0f, 0.0f, 240.0f, -1.0f, 1.0f);
+	CHECK(ortho.Element(0, 0) == 2.0f / 320.0f && ortho.Element(1, 1) == 2.0f / 240.0f);
+	CHECK(ortho.Element(0, 3) == -1.0f && ortho.Element(1, 3) == -1.0f);
+	CHECK(ortho.Element(2, 2) == -1.0f && ortho.Element(3, 3) == 1.0f);
+}
+
+TEST(FloatMatrixInverseUpper3) {
+	Matrix4x4f matrix = Matrix4x4f::CreateRotate(90.0f, 0.0f, 0.0f, 1.0f) *
+		Matrix4x4f::CreateScale(2.0f, 2.0f, 2.0f);
+	Matrix4x4f inverse = matrix.InverseUpper3(false);
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			// the result is the transposed inverse
+			float sum = 0;
+
+			for (int k = 0; k < 3; ++k) {
+				sum += inverse.Element(k, i) * matrix.Element(k, j);
+			}
+
+			float error = sum - (i == j ? 1.0f : 0.0f);
+			CHECK(error > -1.0e-5f && error < 1.0e-5f);
+		}
+	}
+}
+
+TEST(FloatMatrixStack) {
+	MatrixStack stack;
+
+	// a translation beyond the 16.16 range, undone by a scale
+	stack.MultMatrix(Matrix4x4f::CreateScale(1.0f / 1024, 1.0f / 1024, 1.0f / 1024));
+	stack.MultMatrix(Matrix4x4f::CreateTranslate(100000.0f, -100000.0f, 0.0f));
+
+	float position[4] = { 1024.0f, 2048.0f, 0.0f, 1.0f }, result[4];
+	stack.CurrentFloatMatrix().Multiply(position, 4, result);
+
+	CHECK(result[0] == 98.65625f);
+	CHECK(result[1] == -95.65625f);
+
+	// the fixed point matrix is derived from the float matrix
+	CHECK(stack.CurrentMatrix().Element(0, 0) == EGL_FixedFromFloat(1.0f / 1024));
+
+	CHECK(stack.PushMatrix());
+	stack.LoadIdentity();
+	CHECK(stack.CurrentFloatMatrix().Element(0, 3) == 0.0f);
+	CHECK(stack.PopMatrix());
+	CHECK(stack.CurrentFloatMatrix().Element(0, 3) > 97.65f && stack.CurrentFloatMatrix().Element(0, 3) < 97.66f);
+
+	// fixed point operations are reflected in the float matrix
+	stack.LoadMatrix(Matrix4x4::CreateTranslate(3 * EGL_ONE, 0, 0));
+	CHECK(stack.CurrentFloatMatrix().Element(0, 3) == 3.0f);
+}
+
+#endif // EGL_USE_FLOAT_VERTEX
@@ -0,0 +1,148 @@
+// ==========================================================================
+//
+// RasterBenchmark.cpp		Triangle rasterization time by triangle size
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "RasterFixture.h"
+#include <time.h>
+
+
+using namespace EGL;
+using namespace UnitTest;
+
+
+// --------------------------------------------------------------------------
+// Rasterize random triangles of a histogram of sizes, and report the time
+// per triangle and per pixel for each size and perspective correction hint.
+// The surface is cleared between sizes only, so that the depth test passes
+// for about half of the pixels of the larger triangles.
+//
+//	rasterbench [triangles per size]
+// --------------------------------------------------------------------------
+
+
+namespace {
+
+	const I32 Width = 320;
+	const I32 Height = 240;
+
+	// triangles of area 2^k for k in [0, NumSizes)
+	const int NumSizes = 15;
+
+	U32 s_Seed = 1;
+
+	I32 Random(I32 range) {
+		s_Seed = s_Seed * 1103515245 + 12345;
+		return static_cast<I32>((s_Seed >> 8) % static_cast<U32>(range));
+	}
+
+	// a right triangle of the given area at a random position and
+	// orientation; w varies by up to a factor of two across the triangle
+	void MakeTriangle(RasterFixture & fixture, I32 area, Vertex vertices[3]) {
+		EGL_Fixed side = EGL_FixedFromFloat(static_cast<float>(sqrt(2.0 * area)));
+		side = EGL_Min(side, EGL_FixedFromInt(Height) - 1);
+
+		EGL_Fixed x = Random(EGL_FixedFromInt(Width) - side);
+		EGL_Fixed y = Random(EGL_FixedFromInt(Height) - side);
+
+		EGL_Fixed xs[3] = { x, x + side, x };
+		EGL_Fixed ys[3] = { y, y, y + side };
+
+		if (Random(2)) {
+			xs[1] = x + side;
+			ys[2] = y + side;
+			xs[2] = x + side;
+		}
+
+		for (int index = 0; index < 3; ++index) {
+			fixture.MakeVertex(vertices[index], xs[index], ys[index],
+							   EGL_ONE / 2 + Random(EGL_ONE / 2), Random(EGL_ONE));
+			vertices[index].m_WindowCoords.depth = Random(0xffff);
+		}
+	}
+}
+
+
+int main(int argc, char ** argv) {
+
+	int count = argc > 1 ? atoi(argv[1]) : 2000;
+
+	static const struct {
+		RasterizerState::PerspectiveCorrection	hint;
+		const char *							name;
+	} hints[] = {
+		{ RasterizerState::PerspectiveCorrectionFastest,	"fastest" },
+		{ RasterizerState::PerspectiveCorrectionDontCare,	"dont_care" },
+		{ RasterizerState::PerspectiveCorrectionNicest,		"nicest" }
+	};
+
+	printf("%8s", "area");
+
+	for (size_t hint = 0; hint < sizeof hints / sizeof hints[0]; ++hint) {
+		printf(" %12s ns/tri  ns/pixel", hints[hint].name);
+	}
+
+	printf("\n");
+
+	RasterFixture fixture(Width, Height);
+	fixture.GetState().EnableDepthTest(true);
+	fixture.GetState().SetDepthFunc(RasterizerState::CompFuncLess);
+
+	for (int size = 0; size < NumSizes; ++size) {
+		I32 area = 1 << size;
+		printf("%8d", area);
+
+		for (size_t hint = 0; hint < sizeof hints / sizeof hints[0]; ++hint) {
+			fixture.GetState().SetPerspectiveCorrection(hints[hint].hint);
+			fixture.Clear(Color(0, 0, 0, 0));
+			fixture.Prepare();
+
+			// the same triangles for each hint
+			s_Seed = size + 1;
+
+			clock_t start = clock();
+
+			for (int triangle = 0; triangle < count; ++triangle) {
+				Vertex vertices[3];
+				MakeTriangle(fixture, area, vertices);
+				fixture.GetRasterizer().RasterTriangle(vertices[0], vertices[1], vertices[2]);
+			}
+
+			double ns = 1.0e9 * (clock() - start) / CLOCKS_PER_SEC / count;
+			printf(" %19.0f %9.2f", ns, ns / area);
+		}
+
+		printf("\n");
+	}
+
+	return 0;
+}
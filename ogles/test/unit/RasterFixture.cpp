@@ -0,0 +1,236 @@
+// ==========================================================================
+//
+// RasterFixture.cpp		Host surface and rasterizer for the unit tests
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "RasterFixture.h"
+
+
+using namespace EGL;
+using namespace UnitTest;
+
+
+// --------------------------------------------------------------------------
+// Host implementation of the surface; unlike the Windows surface, the
+// color buffer is allocated from the heap rather than a DIB section.
+// --------------------------------------------------------------------------
+
+
+Surface :: Surface(const Config & config, HDC hdc)
+:	m_HDC(hdc),
+	m_Bitmap(0),
+	m_Config(config),
+	m_SampleColorBuffer(0),
+	m_DirtyX0(0x7fffffff),
+	m_DirtyY0(0x7fffffff),
+	m_DirtyX1(0),
+	m_DirtyY1(0),
+	m_Rect (0, 0, config.GetConfigAttrib(EGL_WIDTH), config.GetConfigAttrib(EGL_HEIGHT)),
+	m_CurrentContext(0),
+	m_Disposed(false)
+{
+	U32 width = GetWidth();
+	U32 height = GetHeight();
+
+	m_Pitch = width;
+	m_Samples = m_Config.GetConfigAttrib(EGL_SAMPLE_BUFFERS) ? m_Config.GetConfigAttrib(EGL_SAMPLES) : 1;
+
+	switch (m_Config.GetDepthStencilFormat()) {
+	case DepthStencilFormatDepth16Stencil16:
+		m_SampleDepthStencilStride = width * height * sizeof(U32);
+		break;
+
+	default:
+		m_SampleDepthStencilStride = width * height * sizeof(U16);
+		break;
+	}
+
+	switch (m_Config.GetColorFormat()) {
+	case ColorFormatRGBA8:
+		m_SampleColorStride = width * height * sizeof(U32);
+		break;
+
+	default:
+		m_SampleColorStride = width * height * sizeof(U16);
+		break;
+	}
+
+	m_DepthStencilBuffer = new U8[m_SampleDepthStencilStride * m_Samples];
+	m_ColorBuffer = new U8[m_SampleColorStride];
+
+	if (m_Samples > 1) {
+		m_SampleColorBuffer = new U8[m_SampleColorStride * m_Samples];
+	}
+}
+
+
+Surface :: ~Surface() {
+	delete[] m_ColorBuffer;
+	delete[] m_DepthStencilBuffer;
+	delete[] m_SampleColorBuffer;
+}
+
+
+// --------------------------------------------------------------------------
+// Functions are never compiled on the host; the rasterizer uses its C
+// implementation of all pipeline parts.
+// --------------------------------------------------------------------------
+
+
+FunctionCache :: FunctionCache(size_t, float, size_t, size_t) {
+}
+
+
+FunctionCache :: ~FunctionCache() {
+}
+
+
+bool FunctionCache :: PrepareFunction(PipelinePart::Part, const void *, const VaryingInfo *, bool) {
+	return !EGL_USE_JIT;
+}
+
+
+void * FunctionCache :: GetFunction(PipelinePart::Part, const void *) {
+	return 0;
+}
+
+
+// --------------------------------------------------------------------------
+// RasterFixture
+// --------------------------------------------------------------------------
+
+
+RasterFixture :: RasterFixture(EGLint width, EGLint height, ColorFormat colorFormat, EGLint samples)
+:	m_Rasterizer(&m_State, &m_FunctionCache)
+{
+	EGLint bits = colorFormat == ColorFormatRGBA8 ? 32 : 16;
+
+	Config config(colorFormat, DepthStencilFormatDepth16,
+		bits, 0, 0, 0, 0,						// buffer and component sizes
+		EGL_NONE, 1, 16, 0,						// caveat, id, depth size, level
+		width, height, width * height,			// maximum PBuffer size
+		EGL_FALSE, 0, EGL_NONE,					// native rendering
+		samples > 1, samples, 0,				// sample buffers, samples, stencil size
+		EGL_PBUFFER_BIT, EGL_NONE, 0, 0, 0,		// surface type and transparency
+		width, height);
+
+	m_Surface = new Surface(config);
+
+	m_State.SetColorFormat(colorFormat);
+	m_State.SetDepthStencilFormat(DepthStencilFormatDepth16);
+	m_Rasterizer.SetState(&m_State);
+	m_Rasterizer.SetSurface(m_Surface);
+
+	Clear(Color(0, 0, 0, 0));
+}
+
+
+RasterFixture :: ~RasterFixture() {
+	delete m_Surface;
+}
+
+
+void RasterFixture :: Clear(const Color & color) {
+
+	U32 pixels = m_Surface->GetPixels();
+	U8 * colorPlane = m_Surface->GetSampleColorBuffer();
+	U8 * depthPlane = m_Surface->GetDepthStencilBuffer();
+
+	for (U32 sample = 0; sample < m_Surface->GetSamples(); ++sample) {
+		for (U32 index = 0; index < pixels; ++index) {
+			switch (m_Surface->GetColorFormat()) {
+			case ColorFormatRGBA4444:
+				reinterpret_cast<U16 *>(colorPlane)[index] = color.ConvertTo4444();
+				break;
+
+			case ColorFormatRGBA5551:
+				reinterpret_cast<U16 *>(colorPlane)[index] = color.ConvertTo5551();
+				break;
+
+			case ColorFormatRGBA8:
+				reinterpret_cast<U32 *>(colorPlane)[index] = color.ConvertToRGBA();
+				break;
+
+			default:
+				reinterpret_cast<U16 *>(colorPlane)[index] = color.ConvertTo565();
+				break;
+			}
+
+			reinterpret_cast<U16 *>(depthPlane)[index] = 0xffff;
+		}
+
+		colorPlane += m_Surface->GetSampleColorStride();
+		depthPlane += m_Surface->GetSampleDepthStencilStride();
+	}
+}
+
+
+void RasterFixture :: Prepare() {
+	m_Rasterizer.AllocateVaryings();
+	m_Rasterizer.PrepareTriangle();
+	m_Rasterizer.BeginTriangle();
+}
+
+
+void RasterFixture :: MakeVertex(Vertex & vertex, EGL_Fixed x, EGL_Fixed y, EGL_Fixed invW,
+								 EGL_Fixed value) const {
+	memset(static_cast<void *>(&vertex), 0, sizeof vertex);
+
+	vertex.m_WindowCoords.x = x;
+	vertex.m_WindowCoords.y = y;
+	vertex.m_WindowCoords.depth = 0;
+	vertex.m_WindowCoords.invW = invW;
+
+	for (size_t index = 0; index < EGL_MAX_NUM_VARYING; ++index) {
+		vertex.m_Varying[index] = value;
+	}
+}
+
+
+Color RasterFixture :: GetPixel(I32 x, I32 y) const {
+	const U8 * buffer = m_Surface->GetColorBuffer();
+	U32 index = x + y * m_Surface->GetPitch();
+
+	switch (m_Surface->GetColorFormat()) {
+	case ColorFormatRGBA4444:
+		return Color::From4444(reinterpret_cast<const U16 *>(buffer)[index]);
+
+	case ColorFormatRGBA5551:
+		return Color::From5551(reinterpret_cast<const U16 *>(buffer)[index]);
+
+	case ColorFormatRGBA8:
+		return Color::FromRGBA(reinterpret_cast<const U32 *>(buffer)[index]);
+
+	default:
+		return Color::From565(reinterpret_cast<const U16 *>(buffer)[index]);
+	}
+}
@@ -0,0 +1,86 @@
+// ==========================================================================
+//
+// RasterFixture.h		Host surface and rasterizer for the unit tests
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#ifndef RASTERFIXTURE_H
+#define RASTERFIXTURE_H 1
+
+
+#include "Rasterizer.h"
+#include "RasterizerState.h"
+#include "Surface.h"
+#include "Config.h"
+#include "arm/FunctionCache.h"
+
+
+namespace UnitTest {
+
+	// ----------------------------------------------------------------------
+	// A rasterizer drawing into a surface of width x height pixels, which
+	// is kept in host memory rather than a device context. Tests modify the
+	// state through GetState and call Prepare before rasterizing.
+	// ----------------------------------------------------------------------
+
+	class RasterFixture {
+	public:
+		RasterFixture(EGLint width, EGLint height, EGL::ColorFormat colorFormat = EGL::ColorFormatRGB565,
+					  EGLint samples = 0);
+		~RasterFixture();
+
+		EGL::RasterizerState & GetState()		{ return m_State; }
+		EGL::Rasterizer & GetRasterizer()		{ return m_Rasterizer; }
+		EGL::Surface & GetSurface()				{ return *m_Surface; }
+
+		// clear all color planes to color and all depth planes to the far plane
+		void Clear(const EGL::Color & color);
+
+		// apply the current state, and begin a sequence of triangles
+		void Prepare();
+
+		// initialize a vertex at the window coordinates x, y with the given
+		// 1/w; varying variables are set to value
+		void MakeVertex(EGL::Vertex & vertex, EGL_Fixed x, EGL_Fixed y, EGL_Fixed invW,
+						EGL_Fixed value = 0) const;
+
+		// color of a pixel of the color buffer
+		EGL::Color GetPixel(I32 x, I32 y) const;
+
+	private:
+		EGL::RasterizerState	m_State;
+		EGL::FunctionCache		m_FunctionCache;
+		EGL::Rasterizer			m_Rasterizer;
+		EGL::Surface *			m_Surface;
+	};
+}
+
+
+#endif //ndef RASTERFIXTURE_H
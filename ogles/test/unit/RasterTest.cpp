@@ -0,0 +1,505 @@
+// ==========================================================================
+//
+// RasterTest.cpp		Tests for the triangle rasterizer
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "unittest.h"
+#include "RasterFixture.h"
+#include "Texture.h"
+
+
+using namespace EGL;
+using namespace UnitTest;
+
+
+// --------------------------------------------------------------------------
+// Triangles are rasterized into a host surface using the C implementation
+// of the pipeline.
+// --------------------------------------------------------------------------
+
+
+namespace {
+
+	const I32 Width = 48;
+	const I32 Height = 40;
+
+	// draw the surface as a pair of triangles, with a color gradient from
+	// the top left to the bottom right corner; the right column of vertices
+	// is at 1/w = invW. The texture coordinates of unit 0 run from -1/4 to
+	// 5/4 across the surface.
+	void DrawGradient(RasterFixture & fixture, EGL_Fixed invW) {
+		fixture.Prepare();
+
+		Rasterizer & rasterizer = fixture.GetRasterizer();
+		I32 colorIndex = rasterizer.GetVaryingInfo()->colorIndex;
+		I32 textureBase = rasterizer.GetVaryingInfo()->textureBase[0];
+
+		Vertex corners[4];
+		EGL_Fixed x[4] = { 0, Width << 16, Width << 16, 0 };
+		EGL_Fixed y[4] = { 0, 0, Height << 16, Height << 16 };
+
+		for (int index = 0; index < 4; ++index) {
+			fixture.MakeVertex(corners[index], x[index], y[index], x[index] ? invW : EGL_ONE, EGL_ONE);
+			corners[index].m_Varying[colorIndex + 0] = x[index] / Width;
+			corners[index].m_Varying[colorIndex + 1] = y[index] / Height;
+			corners[index].m_Varying[colorIndex + 3] = (x[index] / Width + y[index] / Height) / 2;
+
+			if (textureBase >= 0) {
+				corners[index].m_Varying[textureBase + 0] = x[index] / Width * 3 / 2 - EGL_ONE / 4;
+				corners[index].m_Varying[textureBase + 1] = y[index] / Height * 3 / 2 - EGL_ONE / 4;
+			}
+		}
+
+		rasterizer.RasterTriangle(corners[0], corners[1], corners[2]);
+		rasterizer.RasterTriangle(corners[0], corners[2], corners[3]);
+	}
+
+	// fill the surface with a single color; all color components are
+	// set to value
+	void DrawFlat(RasterFixture & fixture, EGL_Fixed value) {
+		fixture.Prepare();
+
+		Vertex corners[4];
+		EGL_Fixed x[4] = { 0, Width << 16, Width << 16, 0 };
+		EGL_Fixed y[4] = { 0, 0, Height << 16, Height << 16 };
+
+		for (int index = 0; index < 4; ++index) {
+			fixture.MakeVertex(corners[index], x[index], y[index], EGL_ONE, value);
+		}
+
+		fixture.GetRasterizer().RasterTriangle(corners[0], corners[1], corners[2]);
+		fixture.GetRasterizer().RasterTriangle(corners[0], corners[2], corners[3]);
+	}
+
+	// largest difference of the red and green components of two images
+	I32 MaxDifference(RasterFixture & left, RasterFixture & right) {
+		I32 result = 0;
+
+		for (I32 y = 0; y < Height; ++y) {
+			for (I32 x = 0; x < Width; ++x) {
+				Color leftColor = left.GetPixel(x, y), rightColor = right.GetPixel(x, y);
+				I32 red = leftColor.R() - rightColor.R(), green = leftColor.G() - rightColor.G();
+
+				result = EGL_Max(result, EGL_Max(EGL_Abs(red), EGL_Abs(green)));
+			}
+		}
+
+		return result;
+	}
+
+	bool EqualImages(RasterFixture & left, RasterFixture & right) {
+		for (I32 y = 0; y < Height; ++y) {
+			for (I32 x = 0; x < Width; ++x) {
+				if (left.GetPixel(x, y).ConvertToRGBA() != right.GetPixel(x, y).ConvertToRGBA()) {
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// the color output of the pixels of a block row goes through the row
+	// functions, unless a logic operation is enabled; the copy operation
+	// leaves the colors unchanged, and selects FragmentColorOutput instead
+	void UseFragmentColorOutput(RasterFixture & fixture) {
+		fixture.GetState().EnableLogicOp(true);
+		fixture.GetState().SetLogicOp(RasterizerState::LogicOpCopy);
+	}
+
+	// draw a perspective gradient, and the affine gradient on top of it
+	// with the given blend function
+	void DrawBlended(RasterFixture & fixture, bool blend,
+					 RasterizerState::BlendFuncSrc funcSrc, RasterizerState::BlendFuncDst funcDst) {
+		RasterizerState & state = fixture.GetState();
+
+		state.SetPerspectiveCorrection(RasterizerState::PerspectiveCorrectionNicest);
+		DrawGradient(fixture, EGL_ONE / 2);
+
+		state.EnableBlending(blend);
+		state.SetBlendFunc(funcSrc, funcDst);
+		DrawGradient(fixture, EGL_ONE);
+	}
+}
+
+
+TEST(RasterTriangleCoverage) {
+	RasterFixture fixture(Width, Height);
+	fixture.Clear(Color(0xff, 0, 0, 0xff));
+	DrawGradient(fixture, EGL_ONE);
+
+	// every pixel is covered by exactly one of the triangles, and the
+	// blue component of the gradient is constant
+	for (I32 y = 0; y < Height; ++y) {
+		for (I32 x = 0; x < Width; ++x) {
+			Color color = fixture.GetPixel(x, y);
+			CHECK(color.B() == 0xff);
+			CHECK(color.R() <= 0xff * (x + 1) / Width + 8);
+			CHECK(color.G() <= 0xff * (y + 1) / Height + 8);
+		}
+	}
+}
+
+
+TEST(RasterAffineMatchesPerspective) {
+	// at constant w, the affine interpolation selected under
+	// GL_FASTEST is exact, and matches the perspective path of GL_NICEST
+	RasterFixture affine(Width, Height), perspective(Width, Height);
+
+	affine.GetState().SetPerspectiveCorrection(RasterizerState::PerspectiveCorrectionFastest);
+	perspective.GetState().SetPerspectiveCorrection(RasterizerState::PerspectiveCorrectionNicest);
+
+	DrawGradient(affine, EGL_ONE);
+	DrawGradient(perspective, EGL_ONE);
+
+	CHECK_EQUAL(0, MaxDifference(affine, perspective));
+}
+
+
+TEST(RasterAffineErrorBound) {
+	// with a small change of w across the surface, GL_DONT_CARE interpolates
+	// affinely; the colors stay within one step of the color buffer of the
+	// perspective correct values
+	RasterFixture affine(Width, Height), perspective(Width, Height);
+
+	perspective.GetState().SetPerspectiveCorrection(RasterizerState::PerspectiveCorrectionNicest);
+
+	DrawGradient(affine, EGL_ONE + EGL_ONE / 64);
+	DrawGradient(perspective, EGL_ONE + EGL_ONE / 64);
+
+	// one step of the 5-bit red component
+	CHECK(MaxDifference(affine, perspective) <= 8);
+}
+
+
+TEST(RasterColorRowMatchesFragmentOutput) {
+	// the row functions cover opaque, additive and alpha blending of RGB565
+	// and RGBA8 surfaces
+	static const ColorFormat formats[] = { ColorFormatRGB565, ColorFormatRGBA8 };
+
+	static const struct {
+		bool							blend;
+		RasterizerState::BlendFuncSrc	funcSrc;
+		RasterizerState::BlendFuncDst	funcDst;
+	} blends[] = {
+		{ false,	RasterizerState::BlendFuncSrcOne,		RasterizerState::BlendFuncDstZero },
+		{ true,		RasterizerState::BlendFuncSrcOne,		RasterizerState::BlendFuncDstOne },
+		{ true,		RasterizerState::BlendFuncSrcSrcAlpha,	RasterizerState::BlendFuncDstOneMinusSrcAlpha },
+	};
+
+	for (size_t format = 0; format < sizeof formats / sizeof formats[0]; ++format) {
+		for (size_t blend = 0; blend < sizeof blends / sizeof blends[0]; ++blend) {
+			RasterFixture row(Width, Height, formats[format]), fragment(Width, Height, formats[format]);
+			UseFragmentColorOutput(fragment);
+
+			DrawBlended(row, blends[blend].blend, blends[blend].funcSrc, blends[blend].funcDst);
+			DrawBlended(fragment, blends[blend].blend, blends[blend].funcSrc, blends[blend].funcDst);
+
+			CHECK(EqualImages(row, fragment));
+		}
+	}
+}
+
+
+TEST(RasterDitherRowMatchesFragmentOutput) {
+	static const struct {
+		bool							blend;
+		RasterizerState::BlendFuncSrc	funcSrc;
+		RasterizerState::BlendFuncDst	funcDst;
+	} blends[] = {
+		{ false,	RasterizerState::BlendFuncSrcOne,		RasterizerState::BlendFuncDstZero },
+		{ true,		RasterizerState::BlendFuncSrcOne,		RasterizerState::BlendFuncDstOne },
+		{ true,		RasterizerState::BlendFuncSrcSrcAlpha,	RasterizerState::BlendFuncDstOneMinusSrcAlpha },
+	};
+
+	for (size_t blend = 0; blend < sizeof blends / sizeof blends[0]; ++blend) {
+		RasterFixture row(Width, Height), fragment(Width, Height);
+		UseFragmentColorOutput(fragment);
+
+		row.GetState().EnableDither(true);
+		fragment.GetState().EnableDither(true);
+
+		DrawBlended(row, blends[blend].blend, blends[blend].funcSrc, blends[blend].funcDst);
+		DrawBlended(fragment, blends[blend].blend, blends[blend].funcSrc, blends[blend].funcDst);
+
+		CHECK(EqualImages(row, fragment));
+	}
+}
+
+
+TEST(RasterDitherAverage) {
+	// a color between two levels of the color buffer is dithered to both
+	// levels, and the average over the 4x4 dither matrix is close to the
+	// color; without dither, all pixels are at one of the levels
+	static const ColorFormat formats[] = { ColorFormatRGB565, ColorFormatRGBA4444, ColorFormatRGBA5551 };
+	const I32 value = 0x8b;
+
+	for (size_t format = 0; format < sizeof formats / sizeof formats[0]; ++format) {
+		RasterFixture dithered(Width, Height, formats[format]), plain(Width, Height, formats[format]);
+
+		dithered.GetState().EnableDither(true);
+		DrawFlat(dithered, value * EGL_ONE / 0xff);
+		DrawFlat(plain, value * EGL_ONE / 0xff);
+
+		I32 low = 0xff, high = 0, sum = 0;
+
+		for (I32 y = 0; y < 4; ++y) {
+			for (I32 x = 0; x < 4; ++x) {
+				I32 red = dithered.GetPixel(x, y).R();
+
+				low = EGL_Min(low, red);
+				high = EGL_Max(high, red);
+				sum += red;
+			}
+		}
+
+		I32 level = plain.GetPixel(0, 0).R();
+
+		CHECK(low < value && value < high);
+		CHECK(level == low || level == high);
+		CHECK(EGL_Abs(sum / 16 - value) <= 2);
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// Wide and smooth lines are rasterized as quads through the triangle path
+// --------------------------------------------------------------------------
+
+
+namespace {
+
+	// draw a white line of the given width between two points in window
+	// coordinates; smooth lines are blended onto the black surface
+	void DrawLine(RasterFixture & fixture, EGL_Fixed width, bool smooth,
+				  EGL_Fixed x0, EGL_Fixed y0, EGL_Fixed x1, EGL_Fixed y1) {
+		RasterizerState & state = fixture.GetState();
+		Rasterizer & rasterizer = fixture.GetRasterizer();
+
+		state.SetLineWidth(width);
+		state.SetLineSmoothEnabled(smooth);
+		state.EnableBlending(smooth);
+		state.SetBlendFunc(RasterizerState::BlendFuncSrcSrcAlpha, RasterizerState::BlendFuncDstOneMinusSrcAlpha);
+
+		rasterizer.AllocateVaryings();
+		rasterizer.PrepareLine();
+		rasterizer.BeginLine();
+
+		Vertex from, to;
+		fixture.MakeVertex(from, x0, y0, EGL_ONE, EGL_ONE);
+		fixture.MakeVertex(to, x1, y1, EGL_ONE, EGL_ONE);
+
+		rasterizer.RasterLine(from, to);
+	}
+
+	// number of pixels of a column that are not black
+	I32 ColumnCoverage(RasterFixture & fixture, I32 x) {
+		I32 count = 0;
+
+		for (I32 y = 0; y < Height; ++y) {
+			if (fixture.GetPixel(x, y).R()) {
+				++count;
+			}
+		}
+
+		return count;
+	}
+
+	// sum of the red components of a column, in units of 1/255
+	I32 ColumnIntensity(RasterFixture & fixture, I32 x) {
+		I32 sum = 0;
+
+		for (I32 y = 0; y < Height; ++y) {
+			sum += fixture.GetPixel(x, y).R();
+		}
+
+		return sum;
+	}
+}
+
+
+TEST(RasterWideLineCoverage) {
+	// an aliased wide line covers width pixels of each column along its
+	// x-major extent, and no pixels beyond its ends
+	static const I32 widths[] = { 2, 3, 5 };
+
+	for (size_t index = 0; index < sizeof widths / sizeof widths[0]; ++index) {
+		RasterFixture fixture(Width, Height);
+		DrawLine(fixture, EGL_FixedFromInt(widths[index]), false,
+				 EGL_FixedFromInt(4), EGL_FixedFromInt(8), EGL_FixedFromInt(40), EGL_FixedFromInt(26));
+
+		for (I32 x = 0; x < Width; ++x) {
+			CHECK_EQUAL(x >= 4 && x < 40 ? widths[index] : 0, ColumnCoverage(fixture, x));
+		}
+	}
+}
+
+
+TEST(RasterWideLineHorizontal) {
+	// a horizontal line of width 3 through the center of row 20 covers the
+	// rows 19 to 21 between its ends
+	RasterFixture fixture(Width, Height);
+	DrawLine(fixture, EGL_FixedFromInt(3), false,
+			 EGL_FixedFromInt(4), EGL_FixedFromInt(20) + EGL_ONE / 2,
+			 EGL_FixedFromInt(40), EGL_FixedFromInt(20) + EGL_ONE / 2);
+
+	for (I32 y = 0; y < Height; ++y) {
+		for (I32 x = 0; x < Width; ++x) {
+			bool covered = x >= 4 && x < 40 && y >= 19 && y <= 21;
+			CHECK_EQUAL(covered, fixture.GetPixel(x, y).R() != 0);
+		}
+	}
+}
+
+
+TEST(RasterSmoothLineCoverage) {
+	// the alpha of a smooth line approximates the pixel coverage, so the
+	// intensity of each column crossed by the line is close to the width of
+	// the line times the length of the line per column; the alpha is sampled
+	// at pixel centers, which for thin diagonal lines is within 20 percent
+	static const EGL_Fixed widths[] = { EGL_ONE, EGL_ONE * 3 / 2, EGL_ONE * 3 };
+
+	for (size_t index = 0; index < sizeof widths / sizeof widths[0]; ++index) {
+		RasterFixture horizontal(Width, Height), diagonal(Width, Height);
+
+		DrawLine(horizontal, widths[index], true,
+				 EGL_FixedFromInt(4), EGL_FixedFromInt(20), EGL_FixedFromInt(40), EGL_FixedFromInt(20));
+		DrawLine(diagonal, widths[index], true,
+				 EGL_FixedFromInt(4), EGL_FixedFromInt(2), EGL_FixedFromInt(40), EGL_FixedFromInt(38));
+
+		I32 expected = EGL_IntFromFixed(widths[index] * 0xff);
+
+		for (I32 x = 8; x < 36; ++x) {
+			CHECK(EGL_Abs(ColumnIntensity(horizontal, x) - expected) <= expected / 8);
+			CHECK(EGL_Abs(ColumnIntensity(diagonal, x) * 1000 / 1414 - expected) <= expected / 5);
+		}
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// The specialized shade functions of the C block rasterizer
+// --------------------------------------------------------------------------
+
+
+namespace {
+
+	U32 s_Seed = 1;
+
+	U8 RandomByte() {
+		s_Seed = s_Seed * 1103515245 + 12345;
+		return static_cast<U8>(s_Seed >> 16);
+	}
+
+	// the shade functions are selected unless fog or the alpha test are
+	// enabled; an alpha test that always passes leaves the colors unchanged,
+	// and selects FragmentShade instead
+	void UseFragmentShade(RasterFixture & fixture) {
+		fixture.GetState().EnableAlphaTest(true);
+		fixture.GetState().SetAlphaFunc(RasterizerState::CompFuncAlways, 0);
+	}
+
+	// a texture of random texels
+	void InitTexture(MultiTexture & texture, RasterizerState::TextureFormat format,
+					 RasterizerState::WrappingMode wrap, RasterizerState::FilterMode filter) {
+		const U32 width = 16, height = 32;
+
+		texture.GetTexture(0)->Initialize(width, height, format);
+
+		U8 * data = reinterpret_cast<U8 *>(texture.GetTexture(0)->GetData());
+		U32 bytes = width * height * (format == ColorFormatRGBA8 ? 4 : 2);
+
+		for (U32 index = 0; index < bytes; ++index) {
+			data[index] = RandomByte();
+		}
+
+		texture.SetMinFilterMode(filter);
+		texture.SetMagFilterMode(filter);
+		texture.SetMipmapFilterMode(RasterizerState::FilterModeNone);
+		texture.SetWrappingModeS(wrap);
+		texture.SetWrappingModeT(wrap);
+	}
+}
+
+
+TEST(RasterShadeColorMatchesFragmentShade) {
+	RasterFixture table(Width, Height), fragment(Width, Height);
+	UseFragmentShade(fragment);
+
+	DrawGradient(table, EGL_ONE / 2);
+	DrawGradient(fragment, EGL_ONE / 2);
+
+	CHECK(EqualImages(table, fragment));
+}
+
+
+TEST(RasterShadeTextureMatchesFragmentShade) {
+	// all entries of the shade table: RGB565 and RGBA8 textures, repeat and
+	// clamp to edge wrapping, nearest and linear filtering, and replace,
+	// modulate and, for opaque textures, decal environment
+	static const RasterizerState::TextureFormat formats[] = { ColorFormatRGB565, ColorFormatRGBA8 };
+	static const RasterizerState::WrappingMode wraps[] = {
+		RasterizerState::WrappingModeRepeat, RasterizerState::WrappingModeClampToEdge
+	};
+	static const RasterizerState::FilterMode filters[] = {
+		RasterizerState::FilterModeNearest, RasterizerState::FilterModeLinear
+	};
+	static const RasterizerState::TextureMode modes[] = {
+		RasterizerState::TextureModeReplace, RasterizerState::TextureModeModulate, RasterizerState::TextureModeDecal
+	};
+
+	for (size_t format = 0; format < sizeof formats / sizeof formats[0]; ++format) {
+		for (size_t wrap = 0; wrap < sizeof wraps / sizeof wraps[0]; ++wrap) {
+			for (size_t filter = 0; filter < sizeof filters / sizeof filters[0]; ++filter) {
+				for (size_t mode = 0; mode < sizeof modes / sizeof modes[0]; ++mode) {
+					MultiTexture texture;
+					InitTexture(texture, formats[format], wraps[wrap], filters[filter]);
+
+					RasterFixture table(Width, Height, ColorFormatRGBA8), fragment(Width, Height, ColorFormatRGBA8);
+					UseFragmentShade(fragment);
+
+					RasterFixture * fixtures[] = { &table, &fragment };
+
+					for (size_t index = 0; index < 2; ++index) {
+						fixtures[index]->GetState().EnableTexture(0, true);
+						fixtures[index]->GetState().SetTextureMode(0, modes[mode]);
+						fixtures[index]->GetRasterizer().SetTexture(0, &texture);
+
+						DrawGradient(*fixtures[index], EGL_ONE / 2);
+					}
+
+					CHECK(EqualImages(table, fragment));
+				}
+			}
+		}
+	}
+}
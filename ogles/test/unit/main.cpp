@@ -0,0 +1,94 @@
+// ==========================================================================
+//
+// main.cpp		Test runner for the unit tests
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#include "stdafx.h"
+#include "unittest.h"
+
+
+using namespace UnitTest;
+
+
+namespace {
+	TestCase *	s_Tests = 0;
+	TestCase *	s_Current = 0;
+	int			s_Failures = 0;
+	bool		s_Failed = false;
+}
+
+
+TestCase :: TestCase(const char * name, Function function):
+	m_Name(name), m_Function(function), m_Next(0) {
+
+	// keep the order of definition
+	TestCase ** last = &s_Tests;
+
+	while (*last) {
+		last = &(*last)->m_Next;
+	}
+
+	*last = this;
+}
+
+int TestCase :: RunAll() {
+
+	int count = 0, failed = 0;
+
+	for (s_Current = s_Tests; s_Current; s_Current = s_Current->m_Next) {
+		s_Failed = false;
+		s_Current->m_Function();
+
+		++count;
+
+		if (s_Failed) {
+			++failed;
+		}
+	}
+
+	printf("%d tests, %d failed, %d checks failed\n", count, failed, s_Failures);
+	return failed ? 1 : 0;
+}
+
+void UnitTest :: Check(bool condition, const char * expression, const char * file, int line) {
+
+	if (!condition) {
+		printf("%s(%d): %s: check failed: %s\n", file, line, 
+			s_Current ? s_Current->m_Name : "", expression);
+		++s_Failures;
+		s_Failed = true;
+	}
+}
+
+
+int main(int, char **) {
+	return TestCase::RunAll();
+}
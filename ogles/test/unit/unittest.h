@@ -0,0 +1,71 @@
+// ==========================================================================
+//
+// unittest.h		Minimal unit test framework
+//
+// --------------------------------------------------------------------------
+//
+// Copyright (c) 2004, Hans-Martin Will. All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without 
+// modification, are permitted provided that the following conditions are 
+// met:
+// 
+//	 *  Redistributions of source code must retain the above copyright
+// 		notice, this list of conditions and the following disclaimer. 
+//   *	Redistributions in binary form must reproduce the above copyright
+// 		notice, this list of conditions and the following disclaimer in the 
+// 		documentation and/or other materials provided with the distribution. 
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, 
+// OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+// THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ==========================================================================
+
+
+#ifndef UNITTEST_H
+#define UNITTEST_H 1
+
+
+namespace UnitTest {
+
+	// a test case; all test cases are linked into a single list when
+	// the static constructors run
+	class TestCase {
+	public:
+		typedef void (*Function)();
+
+		TestCase(const char * name, Function function);
+
+		static int RunAll();
+
+		const char *	m_Name;
+		Function		m_Function;
+		TestCase *		m_Next;
+	};
+
+	void Check(bool condition, const char * expression, const char * file, int line);
+}
+
+
+#define TEST(name) \
+	static void Test##name(); \
+	static UnitTest::TestCase s_Test##name(#name, Test##name); \
+	static void Test##name()
+
+#define CHECK(condition) \
+	UnitTest::Check((condition), #condition, __FILE__, __LINE__)
+
+#define CHECK_EQUAL(expected, actual) \
+	UnitTest::Check((expected) == (actual), #expected " == " #actual, __FILE__, __LINE__)
+
+
+#endif //ndef UNITTEST_H